@@ -0,0 +1,2570 @@
+/*
+ *  bench_json.c -- Benchmarks for the "RedJson" module.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ *
+ *  Usage: bench_json [--ndjson] <benchmark> [size]
+ *
+ *  Each benchmark runs in its own process so that peak RSS figures are not
+ *  polluted by earlier runs.  With --ndjson every result is printed as one
+ *  JSON object per line ({"bench", "metric", "value", "unit"}) for scripts
+ *  to collect; "make bench" runs the corpus suite that way.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "red_json.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+static double _Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long _PeakRssKb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static bool _ndjson;
+
+static void _Report(const char *bench, const char *metric, double value, const char *unit)
+{
+    if (_ndjson)
+        printf("{\"bench\":\"%s\",\"metric\":\"%s\",\"value\":%.6g,\"unit\":\"%s\"}\n",
+                bench, metric, value, unit);
+    else
+        printf("%-20s %-16s %14.2f %s\n", bench, metric, value, unit);
+}
+
+/*
+ * Allocation counting: with glibc the allocator is wrapped so that
+ * benchmarks can report allocations per operation; _allocations counts
+ * malloc, calloc and realloc calls made anywhere in the process.
+ */
+#ifdef __GLIBC__
+#define _HAVE_ALLOCATION_COUNT 1
+
+static unsigned long _allocations;
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    _allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    _allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    _allocations++;
+    return __libc_realloc(ptr, size);
+}
+#else
+#define _HAVE_ALLOCATION_COUNT 0
+static unsigned long _allocations;
+#endif
+
+/*
+ * _GenRecord -- Write record number <i> of the synthetic "records" corpus into
+ * <dest>.  Returns the number of bytes written.
+ */
+static int _GenRecord(char *dest, size_t maxLength, unsigned i)
+{
+    return snprintf(dest, maxLength,
+            "%s{\"id\":%u,\"name\":\"user %u\",\"score\":%u.%02u,"
+            "\"active\":%s,\"tags\":[\"red\",\"green\"],\"parent\":null}",
+            i ? "," : "", i, i, i % 1000, i % 100, (i & 1) ? "true" : "false");
+}
+
+static char * _GenRecordsDocument(unsigned numRecords, size_t *pLength)
+{
+    size_t capacity = 128 + (size_t)numRecords * 128;
+    size_t length = 0;
+    char *text = malloc(capacity);
+    unsigned i;
+    length += sprintf(text, "{\"records\":[");
+    for (i = 0; i < numRecords; i++)
+        length += _GenRecord(&text[length], capacity - length, i);
+    length += sprintf(&text[length], "]}");
+    *pLength = length;
+    return text;
+}
+
+static bool _CountRecord(RedJsonValue value, const char *szKey, void *userData)
+{
+    (*(unsigned *)userData)++;
+    return true;
+}
+
+/*
+ * stream_memory -- Generate the records corpus on the fly in 64KB chunks and
+ * push it through a DOM mode stream parser delivering each record.  The whole
+ * document never exists in memory, so peak RSS should stay flat as the record
+ * count grows.
+ */
+static void _BenchStreamMemory(unsigned numRecords)
+{
+    enum { CHUNK = 65536 };
+    char chunk[CHUNK + 256];
+    size_t fill = 0, total = 0;
+    unsigned count = 0, i;
+    double start, elapsed;
+    RedJsonStreamParser parser;
+
+    parser = RedJsonStreamParser_NewDom(2, _CountRecord, &count);
+    start = _Now();
+    fill = sprintf(chunk, "{\"records\":[");
+    for (i = 0; i < numRecords; i++)
+    {
+        fill += _GenRecord(&chunk[fill], sizeof(chunk) - fill, i);
+        if (fill >= CHUNK)
+        {
+            RedJsonStreamParser_Feed(parser, chunk, fill);
+            total += fill;
+            fill = 0;
+        }
+    }
+    fill += sprintf(&chunk[fill], "]}");
+    RedJsonStreamParser_Feed(parser, chunk, fill);
+    total += fill;
+    if (RedJsonStreamParser_Finish(parser) != RED_JSON_OK || count != numRecords)
+        fprintf(stderr, "stream_memory: parse failed\n");
+    elapsed = _Now() - start;
+    RedJsonStreamParser_Free(parser);
+
+    _Report("stream_memory", "throughput", total / elapsed / 1e6, "MB/s");
+    _Report("stream_memory", "peak_rss", _PeakRssKb() / 1024.0, "MB");
+}
+
+/*
+ * parse_memory -- Baseline for stream_memory: materialize the whole document
+ * and parse it with RedJson_Parse.
+ */
+static void _BenchParseMemory(unsigned numRecords)
+{
+    size_t length;
+    char *text;
+    double start, elapsed;
+    RedJsonObject obj;
+
+    text = _GenRecordsDocument(numRecords, &length);
+    start = _Now();
+    obj = RedJson_Parse(text);
+    elapsed = _Now() - start;
+    if (!obj)
+        fprintf(stderr, "parse_memory: parse failed\n");
+
+    _Report("parse_memory", "throughput", length / elapsed / 1e6, "MB/s");
+    _Report("parse_memory", "peak_rss", _PeakRssKb() / 1024.0, "MB");
+    free(text);
+}
+
+static bool _TouchRecord(RedJsonValue record, void *userData)
+{
+    return RedJsonValue_IsObject(record);
+}
+
+/*
+ * ndjson_threads -- Write <numRecords> lines of the records corpus to a
+ * temporary file and read it back with RedJson_ReadNdjsonFile using 1 to 32
+ * worker threads, in both ordered and unordered mode.
+ */
+static void _BenchNdjsonThreads(unsigned numRecords)
+{
+    static const unsigned threadCounts[] = {1, 2, 4, 8, 16, 32};
+    char path[] = "/tmp/bench_json_ndjsonXXXXXX";
+    char line[512];
+    char metric[32];
+    RedJsonNdjsonOptions_t options;
+    size_t total = 0;
+    double start, elapsed;
+    unsigned i, t;
+    int fd;
+    FILE *fp;
+
+    fd = mkstemp(path);
+    fp = fdopen(fd, "w");
+    for (i = 0; i < numRecords; i++)
+    {
+        /* _GenRecord prefixes every record after the first with a comma */
+        int n = _GenRecord(line, sizeof(line), i + 1);
+        fprintf(fp, "%s\n", &line[1]);
+        total += n;
+    }
+    fclose(fp);
+
+    for (t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++)
+    {
+        options.numThreads = threadCounts[t];
+        options.chunkSize = 0;
+
+        options.ordered = true;
+        start = _Now();
+        RedJson_ReadNdjsonFile(path, &options, _TouchRecord, NULL, NULL);
+        elapsed = _Now() - start;
+        snprintf(metric, sizeof(metric), "ordered_t%u", threadCounts[t]);
+        _Report("ndjson_threads", metric, total / elapsed / 1e6, "MB/s");
+
+        options.ordered = false;
+        start = _Now();
+        RedJson_ReadNdjsonFile(path, &options, _TouchRecord, NULL, NULL);
+        elapsed = _Now() - start;
+        snprintf(metric, sizeof(metric), "unordered_t%u", threadCounts[t]);
+        _Report("ndjson_threads", metric, total / elapsed / 1e6, "MB/s");
+    }
+    unlink(path);
+}
+
+/*
+ * _GenCoordinatesDocument -- canada.json-style corpus: a GeoJSON polygon of
+ * <numPoints> [longitude, latitude] pairs printed with 17 significant digits.
+ */
+static char * _GenCoordinatesDocument(unsigned numPoints, size_t *pLength)
+{
+    size_t capacity = 128 + (size_t)numPoints * 48;
+    size_t length = 0;
+    char *text = malloc(capacity);
+    unsigned seed = 12345, i;
+    double lon, lat;
+    length += sprintf(text, "{\"type\":\"Polygon\",\"coordinates\":[[");
+    for (i = 0; i < numPoints; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        lon = -141.0 + (seed >> 8) * (88.0 / (1 << 24));
+        seed = seed * 1103515245 + 12345;
+        lat = 41.0 + (seed >> 8) * (42.0 / (1 << 24));
+        length += sprintf(&text[length], "%s[%.17g,%.17g]", i ? "," : "", lon, lat);
+    }
+    length += sprintf(&text[length], "]]}");
+    *pLength = length;
+    return text;
+}
+
+static bool _SumNumbers(const RedJsonEvent_t *event, void *userData)
+{
+    if (event->type == RED_JSON_EVENT_NUMBER)
+        *(double *)userData += event->number;
+    return true;
+}
+
+/*
+ * numbers -- Number conversion throughput on the coordinates corpus, through
+ * the SAX stream parser and RedJson_Parse.  strtod_baseline converts the same
+ * tokens with strtod alone, as a reference for what the old parser paid per
+ * number.
+ */
+static void _BenchNumbers(unsigned numPoints)
+{
+    size_t length;
+    char *text, *p;
+    double start, elapsed, sum = 0;
+    RedJsonStreamParser parser;
+    RedJsonObject obj;
+
+    text = _GenCoordinatesDocument(numPoints, &length);
+
+    parser = RedJsonStreamParser_New(_SumNumbers, &sum);
+    start = _Now();
+    RedJsonStreamParser_Feed(parser, text, length);
+    if (RedJsonStreamParser_Finish(parser) != RED_JSON_OK)
+        fprintf(stderr, "numbers: parse failed\n");
+    elapsed = _Now() - start;
+    RedJsonStreamParser_Free(parser);
+    _Report("numbers", "stream", length / elapsed / 1e6, "MB/s");
+    _Report("numbers", "stream_rate", 2.0 * numPoints / elapsed / 1e6, "Mnum/s");
+
+    start = _Now();
+    obj = RedJson_Parse(text);
+    elapsed = _Now() - start;
+    if (!obj)
+        fprintf(stderr, "numbers: parse failed\n");
+    _Report("numbers", "parse", length / elapsed / 1e6, "MB/s");
+
+    start = _Now();
+    for (p = text; *p; p++)
+    {
+        if (*p == '-' || (*p >= '0' && *p <= '9'))
+            sum += strtod(p, &p);
+    }
+    elapsed = _Now() - start;
+    _Report("numbers", "strtod_baseline", 2.0 * numPoints / elapsed / 1e6, "Mnum/s");
+    free(text);
+}
+
+/*
+ * serialize_numbers -- Serialize the coordinates corpus with the JSON writer.
+ * printf_baseline formats the same doubles with snprintf("%.17g"), the
+ * cheapest printf format that round-trips.
+ */
+static void _BenchSerializeNumbers(unsigned numPoints)
+{
+    size_t length, outLength = 0;
+    char *text, *out, *p;
+    char buf[32];
+    double start, elapsed, value;
+    RedJsonObject obj;
+    unsigned count = 0;
+
+    text = _GenCoordinatesDocument(numPoints, &length);
+    obj = RedJson_Parse(text);
+
+    start = _Now();
+    out = RedJsonObject_ToJsonString(obj);
+    elapsed = _Now() - start;
+    _Report("serialize_numbers", "writer", strlen(out) / elapsed / 1e6, "MB/s");
+    _Report("serialize_numbers", "writer_rate", 2.0 * numPoints / elapsed / 1e6, "Mnum/s");
+    free(out);
+
+    start = _Now();
+    for (p = text; *p; p++)
+    {
+        if (*p == '-' || (*p >= '0' && *p <= '9'))
+        {
+            value = strtod(p, &p);
+            outLength += snprintf(buf, sizeof(buf), "%.17g", value);
+            count++;
+        }
+    }
+    elapsed = _Now() - start;
+    _Report("serialize_numbers", "printf_baseline", count / elapsed / 1e6, "Mnum/s");
+    free(text);
+}
+
+/*
+ * serialize -- Serialize a parsed records corpus in pretty and compact form,
+ * and into a preallocated fixed buffer (no allocation at all).
+ */
+static void _BenchSerialize(unsigned numRecords)
+{
+    size_t length, outLength;
+    char *text, *out;
+    double start, elapsed;
+    RedJsonObject obj;
+
+    text = _GenRecordsDocument(numRecords, &length);
+    obj = RedJson_Parse(text);
+
+    start = _Now();
+    out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_PRETTY);
+    elapsed = _Now() - start;
+    _Report("serialize", "pretty", strlen(out) / elapsed / 1e6, "MB/s");
+    free(out);
+
+    start = _Now();
+    out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+    elapsed = _Now() - start;
+    outLength = strlen(out);
+    _Report("serialize", "compact", outLength / elapsed / 1e6, "MB/s");
+
+    start = _Now();
+    RedJsonObject_WriteJson(obj, RED_JSON_FORMAT_COMPACT, out, outLength + 1);
+    elapsed = _Now() - start;
+    _Report("serialize", "fixed_buffer", outLength / elapsed / 1e6, "MB/s");
+    free(out);
+    free(text);
+}
+
+/*
+ * write_stream -- Emit <numRecords> records through a compact RedJsonWriter
+ * into /dev/null.  At ~110 bytes per record, 20M records is about 2GB of
+ * output; peak RSS should not depend on the size.
+ */
+static void _BenchWriteStream(unsigned numRecords)
+{
+    RedJsonWriter w;
+    double start, elapsed;
+    char name[32];
+    unsigned i;
+    int fd;
+
+    fd = open("/dev/null", O_WRONLY);
+    w = RedJsonWriter_NewFd(fd, RED_JSON_FORMAT_COMPACT);
+    start = _Now();
+    RedJsonWriter_BeginObject(w);
+    RedJsonWriter_Key(w, "records");
+    RedJsonWriter_BeginArray(w);
+    for (i = 0; i < numRecords; i++)
+    {
+        snprintf(name, sizeof(name), "user %u", i);
+        RedJsonWriter_BeginObject(w);
+        RedJsonWriter_Key(w, "id");
+        RedJsonWriter_Uint64(w, i);
+        RedJsonWriter_Key(w, "name");
+        RedJsonWriter_String(w, name);
+        RedJsonWriter_Key(w, "score");
+        RedJsonWriter_Number(w, (i % 1000) + (i % 100) / 100.0);
+        RedJsonWriter_Key(w, "active");
+        RedJsonWriter_Boolean(w, i & 1);
+        RedJsonWriter_Key(w, "tags");
+        RedJsonWriter_BeginArray(w);
+        RedJsonWriter_String(w, "red");
+        RedJsonWriter_String(w, "green");
+        RedJsonWriter_EndArray(w);
+        RedJsonWriter_Key(w, "parent");
+        RedJsonWriter_Null(w);
+        RedJsonWriter_EndObject(w);
+    }
+    RedJsonWriter_EndArray(w);
+    RedJsonWriter_EndObject(w);
+    if (RedJsonWriter_Finish(w) != RED_JSON_OK)
+        fprintf(stderr, "write_stream: write failed\n");
+    elapsed = _Now() - start;
+
+    _Report("write_stream", "output", RedJsonWriter_BytesWritten(w) / 1e6, "MB");
+    _Report("write_stream", "throughput", RedJsonWriter_BytesWritten(w) / elapsed / 1e6, "MB/s");
+    _Report("write_stream", "peak_rss", _PeakRssKb() / 1024.0, "MB");
+    RedJsonWriter_Free(w);
+    close(fd);
+}
+
+/*
+ * _BuildRecordsDom -- The records corpus built directly as a DOM.
+ */
+static RedJsonValue _BuildRecordsDom(unsigned numRecords)
+{
+    RedJsonObject root = RedJsonObject_New();
+    RedJsonArray records = RedJsonArray_New();
+    char name[32];
+    unsigned i;
+    for (i = 0; i < numRecords; i++)
+    {
+        RedJsonObject record = RedJsonObject_New();
+        RedJsonArray tags = RedJsonArray_New();
+        snprintf(name, sizeof(name), "user %u", i);
+        RedJsonObject_SetUint64(record, "id", i);
+        RedJsonObject_SetString(record, "name", name);
+        RedJsonObject_SetNumber(record, "score", (i % 1000) + (i % 100) / 100.0);
+        RedJsonObject_SetBoolean(record, "active", i & 1);
+        RedJsonArray_AppendString(tags, "red");
+        RedJsonArray_AppendString(tags, "green");
+        RedJsonObject_SetArray(record, "tags", tags);
+        RedJsonObject_SetNull(record, "parent");
+        RedJsonArray_AppendObject(records, record);
+    }
+    RedJsonObject_SetArray(root, "records", records);
+    return RedJsonValue_FromObject(root);
+}
+
+/*
+ * write_dom_fd / write_dom_string -- Serialize the same DOM to /dev/null
+ * through the bounded writer buffer, or via a single heap string followed by
+ * write().  The difference in peak RSS is the cost of the intermediate
+ * string.
+ */
+static void _BenchWriteDom(unsigned numRecords, bool viaString)
+{
+    const char *bench = viaString ? "write_dom_string" : "write_dom_fd";
+    RedJsonValue dom = _BuildRecordsDom(numRecords);
+    long domRss = _PeakRssKb();
+    double start, elapsed;
+    size_t length = 0;
+    char *out;
+    int fd;
+
+    fd = open("/dev/null", O_WRONLY);
+    if (viaString)
+    {
+        start = _Now();
+        out = RedJsonValue_ToFormattedJsonString(dom, RED_JSON_FORMAT_COMPACT);
+        length = strlen(out);
+        if (write(fd, out, length) != (ssize_t)length)
+            fprintf(stderr, "%s: write failed\n", bench);
+        free(out);
+    }
+    else
+    {
+        length = RedJsonValue_WriteJson(dom, RED_JSON_FORMAT_COMPACT, NULL, 0);
+        start = _Now();
+        if (RedJsonValue_WriteToFd(dom, RED_JSON_FORMAT_COMPACT, fd) != RED_JSON_OK)
+            fprintf(stderr, "%s: write failed\n", bench);
+    }
+    elapsed = _Now() - start;
+    close(fd);
+
+    _Report(bench, "throughput", length / elapsed / 1e6, "MB/s");
+    _Report(bench, "rss_over_dom", (_PeakRssKb() - domRss) / 1024.0, "MB");
+}
+
+static void _BenchWriteDomFd(unsigned numRecords)
+{
+    _BenchWriteDom(numRecords, false);
+}
+
+static void _BenchWriteDomString(unsigned numRecords)
+{
+    _BenchWriteDom(numRecords, true);
+}
+
+/*
+ * _GenTextDocument -- Build {"text":[...]} holding <numStrings> strings of
+ * roughly 120 bytes.  The ASCII corpus is plain prose with an escaped quote
+ * or newline in every few strings; the multilingual corpus mixes accented
+ * Latin, Cyrillic, Greek, CJK and emoji.
+ */
+static char * _GenTextDocument(unsigned numStrings, bool multilingual, size_t *pLength)
+{
+    static const char *ascii[] =
+    {
+        "The quick brown fox jumps over the lazy dog while the cat watches from the windowsill. ",
+        "Shipping manifest for order 1138: three crates, one \\\"fragile\\\" label, no returns. ",
+        "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor.\\n",
+        "Status: all systems nominal; next check-in scheduled after the maintenance window. ",
+    };
+    static const char *words[] =
+    {
+        "naïve café déjà vu ", "Привет, как дела? ", "Καλημέρα κόσμε ", "日本語のテキスト、",
+        "中文字符串测试。", "한국어 문장 ", "emoji \xF0\x9F\x98\x80\xF0\x9F\x9A\x80 ", "Ünïcödé façade ",
+    };
+    size_t capacity = (size_t)numStrings * 160 + 32;
+    char *text = malloc(capacity);
+    char *p = text;
+    unsigned i, j;
+
+    p += sprintf(p, "{\"text\":[");
+    for (i = 0; i < numStrings; i++)
+    {
+        *p++ = i ? ',' : ' ';
+        *p++ = '"';
+        if (multilingual)
+        {
+            for (j = 0; j < 5; j++)
+                p += sprintf(p, "%s", words[(i * 7 + j * 3) % 8]);
+        }
+        else
+        {
+            p += sprintf(p, "%s", ascii[i % 4]);
+            p += sprintf(p, "%s", ascii[(i + 1) % 4] + 40);
+        }
+        *p++ = '"';
+    }
+    p += sprintf(p, "]}");
+    *pLength = p - text;
+    return text;
+}
+
+static bool _CountStringBytes(const RedJsonEvent_t *event, void *userData)
+{
+    if (event->type == RED_JSON_EVENT_STRING)
+        *(size_t *)userData += strlen(event->sz);
+    return true;
+}
+
+/*
+ * strings_* -- String-heavy parsing and serialization.  memcpy_baseline copies
+ * the same number of bytes, the floor for a scanner that must touch every
+ * byte.
+ */
+static void _BenchStrings(unsigned numStrings, bool multilingual)
+{
+    const char *name = multilingual ? "strings_multi" : "strings_ascii";
+    size_t length, decoded = 0, outLength;
+    char *text, *out, *copy;
+    double start, elapsed;
+    RedJsonStreamParser parser;
+    RedJsonObject obj;
+
+    text = _GenTextDocument(numStrings, multilingual, &length);
+
+    parser = RedJsonStreamParser_New(_CountStringBytes, &decoded);
+    start = _Now();
+    RedJsonStreamParser_Feed(parser, text, length);
+    if (RedJsonStreamParser_Finish(parser) != RED_JSON_OK)
+        fprintf(stderr, "%s: stream parse failed\n", name);
+    elapsed = _Now() - start;
+    RedJsonStreamParser_Free(parser);
+    _Report(name, "stream", length / elapsed / 1e6, "MB/s");
+
+    start = _Now();
+    obj = RedJson_Parse(text);
+    elapsed = _Now() - start;
+    if (!obj)
+        fprintf(stderr, "%s: parse failed\n", name);
+    _Report(name, "parse", length / elapsed / 1e6, "MB/s");
+
+    start = _Now();
+    out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+    elapsed = _Now() - start;
+    outLength = strlen(out);
+    _Report(name, "write", outLength / elapsed / 1e6, "MB/s");
+
+    /* Fault the destination in first so only the copy is timed */
+    copy = malloc(length);
+    memset(copy, 0, length);
+    start = _Now();
+    memcpy(copy, text, length);
+    elapsed = _Now() - start;
+    if (copy[length - 1] != '}')
+        fprintf(stderr, "%s: copy failed\n", name);
+    _Report(name, "memcpy_baseline", length / elapsed / 1e6, "MB/s");
+
+    free(copy);
+    free(out);
+    free(text);
+}
+
+static void _BenchStringsAscii(unsigned numStrings)
+{
+    _BenchStrings(numStrings, false);
+}
+
+static void _BenchStringsMultilingual(unsigned numStrings)
+{
+    _BenchStrings(numStrings, true);
+}
+
+/*
+ * objects -- Memory per record and field access latency for the records
+ * corpus (6-field API payloads), plus lookups in a 64-field object, which is
+ * past the linear-search threshold.
+ */
+static void _BenchObjects(unsigned numRecords)
+{
+    static const char *fields[] = {"id", "name", "score", "active", "tags", "parent"};
+    long baseRss = _PeakRssKb();
+    RedJsonValue dom = _BuildRecordsDom(numRecords);
+    long domRss = _PeakRssKb();
+    RedJsonArray records = RedJsonObject_GetArray(RedJsonValue_GetObject(dom), "records");
+    RedJsonObject wide = RedJsonObject_New();
+    char keys[64][16];
+    unsigned i, j, found = 0;
+    unsigned numLookups = 0;
+    double start, elapsed;
+
+    _Report("objects", "bytes_per_record", (domRss - baseRss) * 1024.0 / numRecords, "B");
+
+    start = _Now();
+    for (i = 0; i < numRecords; i++)
+    {
+        RedJsonObject record = RedJsonArray_GetEntryObject(records, i);
+        for (j = 0; j < 6; j++)
+            found += RedJsonObject_Get(record, fields[j]) != NULL;
+        numLookups += 6;
+    }
+    elapsed = _Now() - start;
+    _Report("objects", "get_small", elapsed / numLookups * 1e9, "ns");
+
+    for (i = 0; i < 64; i++)
+    {
+        snprintf(keys[i], sizeof(keys[i]), "field_%u", i);
+        RedJsonObject_SetUint64(wide, keys[i], i);
+    }
+    numLookups = 0;
+    start = _Now();
+    for (i = 0; i < numRecords; i++)
+    {
+        found += RedJsonObject_Get(wide, keys[i % 64]) != NULL;
+        numLookups++;
+    }
+    elapsed = _Now() - start;
+    _Report("objects", "get_wide", elapsed / numLookups * 1e9, "ns");
+    if (found != 7 * numRecords)
+        fprintf(stderr, "objects: lookup failed\n");
+}
+
+/*
+ * duplicate_keys -- Parse the records corpus under each duplicate key
+ * policy; FIRST_WINS and ERROR look each key up before adding it instead of
+ * as part of adding it.  Then walk every member of every record in order,
+ * by index and through a keys array.
+ */
+static void _BenchDuplicateKeys(unsigned numRecords)
+{
+    static const struct
+    {
+        const char *metric;
+        RedJsonDuplicateKeyEnum policy;
+    } policies[] = {
+        {"parse_last_wins", RED_JSON_DUPLICATE_KEY_LAST_WINS},
+        {"parse_first_wins", RED_JSON_DUPLICATE_KEY_FIRST_WINS},
+        {"parse_error", RED_JSON_DUPLICATE_KEY_ERROR},
+    };
+    RedJsonParseOptions_t options;
+    RedJsonObject obj, record;
+    RedJsonArray records;
+    double start, elapsed;
+    size_t length, checksum = 0;
+    unsigned i, j, n, numMembers = 0;
+    char **keys;
+    char *text;
+
+    text = _GenRecordsDocument(numRecords, &length);
+    memset(&options, 0, sizeof(options));
+    for (i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+    {
+        options.duplicateKeys = policies[i].policy;
+        start = _Now();
+        obj = RedJson_ParseWithOptions(text, length, &options, NULL);
+        elapsed = _Now() - start;
+        _Report("duplicate_keys", policies[i].metric, length / elapsed / 1e6, "MB/s");
+        RedJsonObject_Release(obj);
+    }
+
+    obj = RedJson_ParseWithOptions(text, length, NULL, NULL);
+    records = RedJsonObject_GetArray(obj, "records");
+    start = _Now();
+    for (i = 0; i < numRecords; i++)
+    {
+        record = RedJsonArray_GetEntryObject(records, i);
+        n = RedJsonObject_NumItems(record);
+        for (j = 0; j < n; j++)
+            checksum += (size_t)RedJsonObject_GetKeyAt(record, j)[0] + (size_t)RedJsonObject_GetValueAt(record, j);
+        numMembers += n;
+    }
+    elapsed = _Now() - start;
+    _Report("duplicate_keys", "iterate_index", elapsed / numMembers * 1e9, "ns/member");
+
+    start = _Now();
+    for (i = 0; i < numRecords; i++)
+    {
+        record = RedJsonArray_GetEntryObject(records, i);
+        keys = RedJsonObject_NewKeysArray(record);
+        for (j = 0; keys[j]; j++)
+            checksum += (size_t)keys[j][0] + (size_t)RedJsonObject_Get(record, keys[j]);
+        RedJsonObject_FreeKeysArray(keys);
+    }
+    elapsed = _Now() - start;
+    _Report("duplicate_keys", "iterate_keys", elapsed / numMembers * 1e9, "ns/member");
+    if (!checksum)
+        fprintf(stderr, "duplicate_keys: nothing iterated\n");
+    RedJsonObject_Release(obj);
+    free(text);
+}
+
+/*
+ * keys -- Parse the records corpus into one DOM with a caller-supplied key
+ * table, then look up every field of every record by string and by
+ * pre-interned key handle.
+ */
+typedef struct
+{
+    long baseRss;
+    unsigned numRecords;
+    RedJsonKey handles[6];
+} _KeysBench;
+
+static const char *_recordFields[] = {"id", "name", "score", "active", "tags", "parent"};
+
+static bool _KeysMeasure(RedJsonValue value, const char *szKey, void *userData)
+{
+    _KeysBench *bench = userData;
+    RedJsonArray records = RedJsonObject_GetArray(RedJsonValue_GetObject(value), "records");
+    unsigned i, j, found = 0;
+    double start, elapsed;
+
+    _Report("keys", "bytes_per_record", (_PeakRssKb() - bench->baseRss) * 1024.0 / bench->numRecords, "B");
+
+    start = _Now();
+    for (i = 0; i < bench->numRecords; i++)
+    {
+        RedJsonObject record = RedJsonArray_GetEntryObject(records, i);
+        for (j = 0; j < 6; j++)
+            found += RedJsonObject_Get(record, _recordFields[j]) != NULL;
+    }
+    elapsed = _Now() - start;
+    _Report("keys", "get_string", elapsed / (6.0 * bench->numRecords) * 1e9, "ns");
+
+    start = _Now();
+    for (i = 0; i < bench->numRecords; i++)
+    {
+        RedJsonObject record = RedJsonArray_GetEntryObject(records, i);
+        for (j = 0; j < 6; j++)
+            found += RedJsonObject_GetByKey(record, bench->handles[j]) != NULL;
+    }
+    elapsed = _Now() - start;
+    _Report("keys", "get_by_key", elapsed / (6.0 * bench->numRecords) * 1e9, "ns");
+
+    if (found != 12 * bench->numRecords)
+        fprintf(stderr, "keys: lookup failed\n");
+    return true;
+}
+
+static void _BenchKeys(unsigned numRecords)
+{
+    size_t length;
+    char *text = _GenRecordsDocument(numRecords, &length);
+    RedJsonKeyTable keys = RedJsonKeyTable_New();
+    RedJsonStreamParser parser;
+    _KeysBench bench;
+    unsigned j;
+
+    bench.numRecords = numRecords;
+    for (j = 0; j < 6; j++)
+        bench.handles[j] = RedJsonKeyTable_Intern(keys, _recordFields[j]);
+    bench.baseRss = _PeakRssKb();
+
+    parser = RedJsonStreamParser_NewDom(0, _KeysMeasure, &bench);
+    RedJsonStreamParser_SetKeyTable(parser, keys);
+    RedJsonStreamParser_Feed(parser, text, length);
+    if (RedJsonStreamParser_Finish(parser) != RED_JSON_OK)
+        fprintf(stderr, "keys: parse failed\n");
+    RedJsonStreamParser_Free(parser);
+    _Report("keys", "distinct_keys", RedJsonKeyTable_NumKeys(keys), "");
+    RedJsonKeyTable_Free(keys);
+    free(text);
+}
+
+/*
+ * lazy -- Pull 3 fields out of a ~1MB document: two from a small object that
+ * follows the records array, and one from the last record.  The cursor skips
+ * the records with a bracket scan; RedJson_Parse builds the whole DOM first.
+ */
+static bool _SumLazyFields(RedJsonValue value, const char *szKey, void *userData)
+{
+    RedJsonObject obj = RedJsonValue_GetObject(value);
+    RedJsonObject meta = RedJsonObject_GetObject(obj, "meta");
+    RedJsonArray array = RedJsonObject_GetArray(obj, "records");
+    *(int64_t *)userData += RedJsonObject_GetInt64(meta, "version") + RedJsonObject_GetInt64(meta, "count")
+        + RedJsonObject_GetInt64(RedJsonArray_GetEntryObject(array, RedJsonArray_NumItems(array) - 1), "id");
+    return true;
+}
+
+static void _BenchLazy(unsigned numPasses)
+{
+    enum { RECORDS = 10000 };
+    size_t length;
+    char *records = _GenRecordsDocument(RECORDS, &length);
+    char *text = malloc(length + 128);
+    int64_t sum = 0, expected;
+    unsigned pass;
+    double start, elapsed;
+
+    /* Replace the closing "}" with a trailing "meta" member */
+    memcpy(text, records, length - 1);
+    length -= 1;
+    length += sprintf(&text[length], ",\"meta\":{\"version\":3,\"count\":%u}}", RECORDS);
+    expected = (int64_t)numPasses * (3 + RECORDS + RECORDS - 1);
+    _Report("lazy", "document", length / 1e6, "MB");
+
+    start = _Now();
+    for (pass = 0; pass < numPasses; pass++)
+    {
+        RedJsonCursor_t doc, meta, field, array, record;
+        int64_t version = 0, count = 0, id = 0;
+        RedJsonCursor_Init(&doc, text, length);
+        RedJsonCursor_Find(&doc, "meta", &meta);
+        RedJsonCursor_Find(&meta, "version", &field);
+        RedJsonCursor_GetInt64(&field, &version);
+        RedJsonCursor_Find(&meta, "count", &field);
+        RedJsonCursor_GetInt64(&field, &count);
+        RedJsonCursor_Find(&doc, "records", &array);
+        RedJsonCursor_Index(&array, RECORDS - 1, &record);
+        RedJsonCursor_Find(&record, "id", &field);
+        RedJsonCursor_GetInt64(&field, &id);
+        sum += version + count + id;
+    }
+    elapsed = _Now() - start;
+    _Report("lazy", "cursor", elapsed / numPasses * 1e6, "us");
+    _Report("lazy", "cursor", length * numPasses / elapsed / 1e6, "MB/s");
+
+    start = _Now();
+    for (pass = 0; pass < numPasses; pass++)
+    {
+        RedJsonObject obj = RedJson_Parse(text);
+        RedJsonObject meta = RedJsonObject_GetObject(obj, "meta");
+        RedJsonArray array = RedJsonObject_GetArray(obj, "records");
+        sum += RedJsonObject_GetInt64(meta, "version") + RedJsonObject_GetInt64(meta, "count")
+            + RedJsonObject_GetInt64(RedJsonArray_GetEntryObject(array, RECORDS - 1), "id");
+    }
+    elapsed = _Now() - start;
+    _Report("lazy", "parse", elapsed / numPasses * 1e6, "us");
+
+    start = _Now();
+    for (pass = 0; pass < numPasses; pass++)
+    {
+        RedJsonStreamParser parser = RedJsonStreamParser_NewDom(0, _SumLazyFields, &sum);
+        RedJsonStreamParser_Feed(parser, text, length);
+        RedJsonStreamParser_Finish(parser);
+        RedJsonStreamParser_Free(parser);
+    }
+    elapsed = _Now() - start;
+    _Report("lazy", "stream_dom", elapsed / numPasses * 1e6, "us");
+    if (sum != 3 * expected)
+        fprintf(stderr, "lazy: extraction failed\n");
+
+    free(text);
+    free(records);
+}
+
+/*
+ * tape, tape_dom -- Memory per record and full-document traversal time of the
+ * records corpus as a tape and as a RedJsonValue tree.  Both walks visit every
+ * value and sum the numbers.  DOM objects have no iterator, so the DOM walk
+ * goes through RedJsonObject_NewKeysArray.
+ */
+static double _WalkDom(RedJsonValue value)
+{
+    double sum = 0;
+    unsigned i, n;
+    char **keys;
+    if (RedJsonValue_IsNumber(value))
+        return RedJsonValue_GetNumber(value);
+    if (RedJsonValue_IsArray(value))
+    {
+        RedJsonArray array = RedJsonValue_GetArray(value);
+        bool packed = RedJsonArray_GetStorage(array) != RED_JSON_ARRAY_STORAGE_VALUES;
+        n = RedJsonArray_NumItems(array);
+        for (i = 0; i < n; i++)
+        {
+            if (!packed)
+                sum += _WalkDom(RedJsonArray_GetEntry(array, i));
+            else if (RedJsonArray_IsEntryNumber(array, i))
+                sum += RedJsonArray_GetEntryNumber(array, i);
+        }
+    }
+    else if (RedJsonValue_IsObject(value))
+    {
+        RedJsonObject obj = RedJsonValue_GetObject(value);
+        keys = RedJsonObject_NewKeysArray(obj);
+        n = RedJsonObject_NumItems(obj);
+        for (i = 0; i < n; i++)
+            sum += _WalkDom(RedJsonObject_Get(obj, keys[i]));
+        RedJsonObject_FreeKeysArray(keys);
+    }
+    return sum;
+}
+
+static double _WalkTape(const RedJsonTapeRef_t *pRef)
+{
+    RedJsonTapeRef_t child;
+    double sum = 0;
+    bool more;
+    switch (RedJsonTapeRef_GetType(pRef))
+    {
+        case RED_JSON_VALUE_TYPE_NUMBER:
+            return RedJsonTapeRef_GetNumber(pRef);
+        case RED_JSON_VALUE_TYPE_OBJECT:
+        case RED_JSON_VALUE_TYPE_ARRAY:
+            for (more = RedJsonTapeRef_First(pRef, &child); more; more = RedJsonTapeRef_Next(&child))
+                sum += _WalkTape(&child);
+            return sum;
+        default:
+            return 0;
+    }
+}
+
+static void _BenchTapeOrDom(unsigned numRecords, bool useTape)
+{
+    const char *name = useTape ? "tape" : "tape_dom";
+    size_t length;
+    char *text = _GenRecordsDocument(numRecords, &length);
+    long baseRss = _PeakRssKb();
+    RedJsonValue dom = NULL;
+    RedJsonTape tape = NULL;
+    RedJsonTapeRef_t root;
+    double start, elapsed, sum, expected = 0;
+    unsigned i;
+
+    for (i = 0; i < numRecords; i++)
+        expected += i + (i % 1000) + (i % 100) / 100.0;
+
+    start = _Now();
+    if (useTape)
+        tape = RedJsonTape_Parse(text, length, NULL);
+    else
+        dom = RedJsonValue_FromObject(RedJson_Parse(text));
+    elapsed = _Now() - start;
+    _Report(name, "parse", length / elapsed / 1e6, "MB/s");
+    _Report(name, "peak_rss", (_PeakRssKb() - baseRss) * 1024.0 / numRecords, "B/record");
+    if (useTape)
+        _Report(name, "allocated", RedJsonTape_MemoryUsage(tape) / (double)numRecords, "B/record");
+
+    start = _Now();
+    root = RedJsonTape_Root(tape);
+    sum = useTape ? _WalkTape(&root) : _WalkDom(dom);
+    elapsed = _Now() - start;
+    _Report(name, "walk", elapsed / numRecords * 1e9, "ns/record");
+    if (sum < expected - 1e-3 * numRecords || sum > expected + 1e-3 * numRecords)
+        fprintf(stderr, "%s: walk failed\n", name);
+
+    RedJsonTape_Free(tape);
+    free(text);
+}
+
+/*
+ * cbor -- Encode and decode the records corpus as compact JSON text and as
+ * CBOR.  Times are per record so the two encodings compare directly.
+ */
+static void _BenchCbor(unsigned numRecords)
+{
+    size_t length, textLength, cborLength;
+    char *text, *json, *cbor;
+    double start, elapsed;
+    RedJsonObject obj;
+    RedJsonValue val;
+
+    text = _GenRecordsDocument(numRecords, &length);
+    obj = RedJson_Parse(text);
+
+    start = _Now();
+    json = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+    elapsed = _Now() - start;
+    textLength = strlen(json);
+    _Report("cbor", "json_encode", elapsed / numRecords * 1e9, "ns/record");
+
+    start = _Now();
+    cbor = RedJsonValue_ToCbor(RedJsonValue_FromObject(obj), &cborLength);
+    elapsed = _Now() - start;
+    _Report("cbor", "cbor_encode", elapsed / numRecords * 1e9, "ns/record");
+
+    start = _Now();
+    obj = RedJson_Parse(json);
+    elapsed = _Now() - start;
+    _Report("cbor", "json_decode", elapsed / numRecords * 1e9, "ns/record");
+
+    start = _Now();
+    val = RedJson_ParseCbor(cbor, cborLength, NULL);
+    elapsed = _Now() - start;
+    _Report("cbor", "cbor_decode", elapsed / numRecords * 1e9, "ns/record");
+    if (!obj || !val)
+        fprintf(stderr, "cbor: decoding failed\n");
+
+    _Report("cbor", "json_size", textLength / (double)numRecords, "B/record");
+    _Report("cbor", "cbor_size", cborLength / (double)numRecords, "B/record");
+    free(cbor);
+    free(json);
+    free(text);
+}
+
+/*
+ * binding -- Pull every field of a realistic order message into a C struct,
+ * once through a DOM mode stream parser followed by key lookups, and once
+ * through a RedJsonBinding.  The binding's serializer is timed as well.
+ */
+typedef struct
+{
+    char *id;
+    char *region;
+    int32_t tier;
+} _BenchAccount;
+
+typedef struct
+{
+    int64_t id;
+    char *clientOrderId;
+    char *symbol;
+    char *side;
+    char *type;
+    char *timeInForce;
+    int64_t quantity;
+    double price;
+    int64_t filled;
+    char *status;
+    _BenchAccount account;
+    int64_t createdAt;
+    bool reduceOnly;
+} _BenchOrder;
+
+static const RedJsonField_t _benchAccountFields[] = {
+    RED_JSON_FIELD(_BenchAccount, id, RED_JSON_FIELD_STRING),
+    RED_JSON_FIELD(_BenchAccount, region, RED_JSON_FIELD_STRING),
+    RED_JSON_FIELD(_BenchAccount, tier, RED_JSON_FIELD_INT32),
+    RED_JSON_FIELDS_END
+};
+
+static const RedJsonField_t _benchOrderFields[] = {
+    RED_JSON_FIELD(_BenchOrder, id, RED_JSON_FIELD_INT64),
+    RED_JSON_FIELD(_BenchOrder, clientOrderId, RED_JSON_FIELD_STRING),
+    RED_JSON_FIELD(_BenchOrder, symbol, RED_JSON_FIELD_STRING),
+    RED_JSON_FIELD(_BenchOrder, side, RED_JSON_FIELD_STRING),
+    RED_JSON_FIELD(_BenchOrder, type, RED_JSON_FIELD_STRING),
+    RED_JSON_FIELD(_BenchOrder, timeInForce, RED_JSON_FIELD_STRING),
+    RED_JSON_FIELD(_BenchOrder, quantity, RED_JSON_FIELD_INT64),
+    RED_JSON_FIELD(_BenchOrder, price, RED_JSON_FIELD_DOUBLE),
+    RED_JSON_FIELD(_BenchOrder, filled, RED_JSON_FIELD_INT64),
+    RED_JSON_FIELD(_BenchOrder, status, RED_JSON_FIELD_STRING),
+    RED_JSON_FIELD_OBJECT(_BenchOrder, account, _benchAccountFields),
+    RED_JSON_FIELD(_BenchOrder, createdAt, RED_JSON_FIELD_INT64),
+    RED_JSON_FIELD(_BenchOrder, reduceOnly, RED_JSON_FIELD_BOOLEAN),
+    RED_JSON_FIELDS_END
+};
+
+static int _GenOrder(char *dest, size_t maxLength, unsigned i)
+{
+    static const char *symbols[] = {"AAPL", "MSFT", "NVDA", "AMZN", "GOOGL"};
+    return snprintf(dest, maxLength,
+            "{\"id\":%u,\"clientOrderId\":\"c-%08u\",\"symbol\":\"%s\",\"side\":\"%s\","
+            "\"type\":\"limit\",\"timeInForce\":\"GTC\",\"quantity\":%u,\"price\":%u.%02u,"
+            "\"filled\":0,\"status\":\"new\",\"account\":{\"id\":\"acct-%u\","
+            "\"region\":\"us-east-1\",\"tier\":%u},\"createdAt\":1700000000%06u,"
+            "\"tags\":[\"algo\",\"twap\"],\"reduceOnly\":%s}",
+            i, i, symbols[i % 5], (i & 1) ? "sell" : "buy", 1 + i % 500, 100 + i % 400, i % 100,
+            i % 997, i % 4, i % 1000000, (i % 7) ? "false" : "true");
+}
+
+static void _BenchOrder_Free(_BenchOrder *order)
+{
+    free(order->clientOrderId);
+    free(order->symbol);
+    free(order->side);
+    free(order->type);
+    free(order->timeInForce);
+    free(order->status);
+    free(order->account.id);
+    free(order->account.region);
+}
+
+/* The DOM frees its strings with the tree, so they are copied out */
+static char * _CopyString(RedJsonObject obj, const char *szKey)
+{
+    return RedJsonValue_GetString(RedJsonObject_Get(obj, szKey));
+}
+
+static bool _LookupOrder(RedJsonValue value, const char *szKey, void *userData)
+{
+    _BenchOrder *order = userData;
+    RedJsonObject obj = RedJsonValue_GetObject(value);
+    RedJsonObject account = RedJsonObject_GetObject(obj, "account");
+
+    order->id = RedJsonObject_GetInt64(obj, "id");
+    order->clientOrderId = _CopyString(obj, "clientOrderId");
+    order->symbol = _CopyString(obj, "symbol");
+    order->side = _CopyString(obj, "side");
+    order->type = _CopyString(obj, "type");
+    order->timeInForce = _CopyString(obj, "timeInForce");
+    order->quantity = RedJsonObject_GetInt64(obj, "quantity");
+    order->price = RedJsonObject_GetNumber(obj, "price");
+    order->filled = RedJsonObject_GetInt64(obj, "filled");
+    order->status = _CopyString(obj, "status");
+    order->account.id = _CopyString(account, "id");
+    order->account.region = _CopyString(account, "region");
+    order->account.tier = (int32_t)RedJsonObject_GetInt64(account, "tier");
+    order->createdAt = RedJsonObject_GetInt64(obj, "createdAt");
+    order->reduceOnly = RedJsonObject_GetBoolean(obj, "reduceOnly");
+    return true;
+}
+
+static void _BenchBinding(unsigned numMessages)
+{
+    enum { MESSAGE_SIZE = 512 };
+    char *messages = malloc((size_t)numMessages * MESSAGE_SIZE);
+    size_t *lengths = malloc(numMessages * sizeof(size_t));
+    RedJsonBinding binding = RedJsonBinding_New(_benchOrderFields);
+    RedJsonStreamParser parser;
+    _BenchOrder order;
+    double start, elapsed, checkDom = 0, checkBinding = 0;
+    size_t bytes = 0;
+    unsigned i;
+    char *out;
+
+    for (i = 0; i < numMessages; i++)
+    {
+        lengths[i] = _GenOrder(&messages[(size_t)i * MESSAGE_SIZE], MESSAGE_SIZE, i);
+        bytes += lengths[i];
+    }
+    _Report("binding", "message_size", bytes / (double)numMessages, "B");
+
+    start = _Now();
+    for (i = 0; i < numMessages; i++)
+    {
+        memset(&order, 0, sizeof(order));
+        parser = RedJsonStreamParser_NewDom(0, _LookupOrder, &order);
+        RedJsonStreamParser_Feed(parser, &messages[(size_t)i * MESSAGE_SIZE], lengths[i]);
+        RedJsonStreamParser_Finish(parser);
+        RedJsonStreamParser_Free(parser);
+        checkDom += order.price + order.account.tier;
+        _BenchOrder_Free(&order);
+    }
+    elapsed = _Now() - start;
+    _Report("binding", "dom_lookup", elapsed / numMessages * 1e9, "ns/message");
+
+    start = _Now();
+    for (i = 0; i < numMessages; i++)
+    {
+        memset(&order, 0, sizeof(order));
+        RedJsonBinding_Parse(binding, &messages[(size_t)i * MESSAGE_SIZE], lengths[i], &order, NULL);
+        checkBinding += order.price + order.account.tier;
+        RedJsonBinding_FreeMembers(binding, &order);
+    }
+    elapsed = _Now() - start;
+    _Report("binding", "binding_parse", elapsed / numMessages * 1e9, "ns/message");
+    if (checkDom != checkBinding)
+        fprintf(stderr, "binding: results differ\n");
+
+    memset(&order, 0, sizeof(order));
+    RedJsonBinding_Parse(binding, messages, lengths[0], &order, NULL);
+    start = _Now();
+    for (i = 0; i < numMessages; i++)
+    {
+        order.id = i;
+        out = RedJsonBinding_ToJsonString(binding, &order);
+        free(out);
+    }
+    elapsed = _Now() - start;
+    _Report("binding", "binding_write", elapsed / numMessages * 1e9, "ns/message");
+    RedJsonBinding_FreeMembers(binding, &order);
+
+    RedJsonBinding_Free(binding);
+    free(lengths);
+    free(messages);
+}
+
+/*
+ * _BenchDocument -- An RPC style message loop: parse each order message,
+ * read a few fields and drop it, once with a fresh tree per message and
+ * once through a reused RedJsonDocument.
+ */
+static void _BenchDocument(unsigned numMessages)
+{
+    enum { MESSAGE_SIZE = 512, WARMUP = 16 };
+    char *messages = malloc((size_t)numMessages * MESSAGE_SIZE);
+    size_t *lengths = malloc(numMessages * sizeof(size_t));
+    RedJsonDocument doc = RedJsonDocument_New();
+    RedJsonObject obj;
+    double start, elapsed, checkFresh = 0, checkDoc = 0;
+    unsigned long allocations;
+    size_t bytes = 0;
+    unsigned i;
+
+    for (i = 0; i < numMessages; i++)
+    {
+        lengths[i] = _GenOrder(&messages[(size_t)i * MESSAGE_SIZE], MESSAGE_SIZE, i);
+        bytes += lengths[i];
+    }
+    _Report("document", "message_size", bytes / (double)numMessages, "B");
+
+    allocations = _allocations;
+    start = _Now();
+    for (i = 0; i < numMessages; i++)
+    {
+        obj = RedJson_ParseWithOptions(&messages[(size_t)i * MESSAGE_SIZE], lengths[i], NULL, NULL);
+        checkFresh += RedJsonObject_GetNumber(obj, "price") + RedJsonObject_GetInt64(RedJsonObject_GetObject(obj, "account"), "tier");
+        RedJsonObject_Release(obj);
+    }
+    elapsed = _Now() - start;
+    _Report("document", "fresh_parse", elapsed / numMessages * 1e9, "ns/message");
+    _Report("document", "fresh_rate", numMessages / elapsed / 1e3, "K messages/s");
+    if (_HAVE_ALLOCATION_COUNT)
+        _Report("document", "fresh_allocs", (_allocations - allocations) / (double)numMessages, "allocs/message");
+
+    /* The first messages size the document's pools */
+    for (i = 0; i < WARMUP && i < numMessages; i++)
+        RedJsonDocument_Parse(doc, &messages[(size_t)i * MESSAGE_SIZE], lengths[i], NULL, NULL);
+    allocations = _allocations;
+    start = _Now();
+    for (i = 0; i < numMessages; i++)
+    {
+        obj = RedJsonDocument_Parse(doc, &messages[(size_t)i * MESSAGE_SIZE], lengths[i], NULL, NULL);
+        checkDoc += RedJsonObject_GetNumber(obj, "price") + RedJsonObject_GetInt64(RedJsonObject_GetObject(obj, "account"), "tier");
+    }
+    elapsed = _Now() - start;
+    _Report("document", "reused_parse", elapsed / numMessages * 1e9, "ns/message");
+    _Report("document", "reused_rate", numMessages / elapsed / 1e3, "K messages/s");
+    if (_HAVE_ALLOCATION_COUNT)
+        _Report("document", "reused_allocs", (_allocations - allocations) / (double)numMessages, "allocs/message");
+    if (checkFresh != checkDoc)
+        fprintf(stderr, "document: results differ\n");
+
+    RedJsonDocument_Free(doc);
+    free(lengths);
+    free(messages);
+}
+
+/*
+ * _GenConfig -- Build a service configuration of roughly <targetSize> bytes
+ * of JSON: a few small sections, a large "features" map and a "routes"
+ * array.
+ */
+static RedJsonObject _GenConfig(size_t targetSize)
+{
+    RedJsonObject config = RedJsonObject_New();
+    RedJsonObject db = RedJsonObject_New();
+    RedJsonObject pool = RedJsonObject_New();
+    RedJsonObject features = RedJsonObject_New();
+    RedJsonArray routes = RedJsonArray_New();
+    RedJsonObject route, headers, feature;
+    char key[32], buf[64];
+    size_t size;
+    unsigned i;
+
+    RedJsonObject_SetString(config, "service", "checkout");
+    RedJsonObject_SetInt64(config, "version", 42);
+    RedJsonObject_SetString(db, "host", "db.internal.example.com");
+    RedJsonObject_SetInt64(db, "port", 5432);
+    RedJsonObject_SetInt64(pool, "size", 8);
+    RedJsonObject_SetInt64(pool, "idleTimeoutMs", 30000);
+    RedJsonObject_SetObject(db, "pool", pool);
+    RedJsonObject_SetObject(config, "db", db);
+    RedJsonObject_SetObject(config, "features", features);
+    RedJsonObject_SetArray(config, "routes", routes);
+    for (i = 0, size = 0; size < targetSize; i++)
+    {
+        snprintf(key, sizeof(key), "feature_%05u", i);
+        feature = RedJsonObject_New();
+        RedJsonObject_SetBoolean(feature, "enabled", i % 3 != 0);
+        RedJsonObject_SetNumber(feature, "rollout", (i % 100) / 100.0);
+        RedJsonObject_SetObject(features, key, feature);
+
+        route = RedJsonObject_New();
+        snprintf(buf, sizeof(buf), "/api/v1/resource_%u/items", i);
+        RedJsonObject_SetString(route, "path", buf);
+        snprintf(buf, sizeof(buf), "http://upstream-%u.internal:8080", i % 17);
+        RedJsonObject_SetString(route, "upstream", buf);
+        RedJsonObject_SetInt64(route, "timeoutMs", 1000 + i);
+        headers = RedJsonObject_New();
+        RedJsonObject_SetString(headers, "X-Route", key);
+        RedJsonObject_SetString(headers, "Cache-Control", "no-store");
+        RedJsonObject_SetObject(route, "headers", headers);
+        RedJsonArray_AppendObject(routes, route);
+        size += 220;
+    }
+    return config;
+}
+
+static RedJsonValue _DeepCopy(RedJsonValue value);
+
+/*
+ * _DeepCopyObject -- What a caller without RedJsonObject_Clone has to do to
+ * get a private copy to modify: copy every member recursively.
+ */
+static RedJsonObject _DeepCopyObject(RedJsonObject obj)
+{
+    RedJsonObject copy = RedJsonObject_New();
+    char **keys = RedJsonObject_NewKeysArray(obj);
+    unsigned i, numKeys = RedJsonObject_NumItems(obj);
+    for (i = 0; i < numKeys; i++)
+        RedJsonObject_Set(copy, keys[i], _DeepCopy(RedJsonObject_Get(obj, keys[i])));
+    RedJsonObject_FreeKeysArray(keys);
+    return copy;
+}
+
+static RedJsonValue _DeepCopy(RedJsonValue value)
+{
+    RedJsonArray array, copy;
+    unsigned i, numItems;
+    char *sz;
+    if (RedJsonValue_IsObject(value))
+        return RedJsonValue_FromObject(_DeepCopyObject(RedJsonValue_GetObject(value)));
+    if (RedJsonValue_IsArray(value))
+    {
+        array = RedJsonValue_GetArray(value);
+        copy = RedJsonArray_New();
+        numItems = RedJsonArray_NumItems(array);
+        for (i = 0; i < numItems; i++)
+        {
+            switch (RedJsonArray_GetStorage(array))
+            {
+                case RED_JSON_ARRAY_STORAGE_VALUES:
+                    RedJsonArray_Append(copy, _DeepCopy(RedJsonArray_GetEntry(array, i)));
+                    break;
+                case RED_JSON_ARRAY_STORAGE_DOUBLES:
+                    RedJsonArray_AppendNumber(copy, RedJsonArray_GetEntryNumber(array, i));
+                    break;
+                case RED_JSON_ARRAY_STORAGE_INT64S:
+                    RedJsonArray_AppendInt64(copy, RedJsonArray_GetEntryInt64(array, i));
+                    break;
+                case RED_JSON_ARRAY_STORAGE_BOOLEANS:
+                    RedJsonArray_AppendBoolean(copy, RedJsonArray_GetEntryBoolean(array, i));
+                    break;
+            }
+        }
+        return RedJsonValue_FromArray(copy);
+    }
+    if (RedJsonValue_IsString(value))
+    {
+        sz = RedJsonValue_GetString(value);
+        value = RedJsonValue_FromString(sz);
+        free(sz);
+        return value;
+    }
+    if (RedJsonValue_IsBoolean(value))
+        return RedJsonValue_FromBoolean(RedJsonValue_GetBoolean(value));
+    if (RedJsonValue_IsNull(value))
+        return RedJsonValue_Null();
+    switch (RedJsonValue_GetNumberType(value))
+    {
+        case RED_JSON_NUMBER_INT64:
+            return RedJsonValue_FromInt64(RedJsonValue_GetInt64(value));
+        case RED_JSON_NUMBER_UINT64:
+            return RedJsonValue_FromUint64(RedJsonValue_GetUint64(value));
+        default:
+            return RedJsonValue_FromNumber(RedJsonValue_GetNumber(value));
+    }
+}
+
+/*
+ * _CustomizeRequest -- The per-request changes: one nested setting, one
+ * element of a large array, and a new top-level member.
+ */
+static void _CustomizeRequest(RedJsonObject config, unsigned request, bool copyOnWrite)
+{
+    RedJsonObject pool, route;
+    RedJsonArray routes;
+    if (copyOnWrite)
+    {
+        pool = RedJsonObject_GetMutableObject(RedJsonObject_GetMutableObject(config, "db"), "pool");
+        routes = RedJsonObject_GetMutableArray(config, "routes");
+        route = RedJsonArray_GetMutableEntryObject(routes, request % RedJsonArray_NumItems(routes));
+    }
+    else
+    {
+        pool = RedJsonObject_GetObject(RedJsonObject_GetObject(config, "db"), "pool");
+        routes = RedJsonObject_GetArray(config, "routes");
+        route = RedJsonArray_GetEntryObject(routes, request % RedJsonArray_NumItems(routes));
+    }
+    RedJsonObject_Put(pool, "size", RedJsonValue_FromInt64(request % 64));
+    RedJsonObject_Put(route, "timeoutMs", RedJsonValue_FromInt64(250));
+    RedJsonObject_Put(config, "requestId", RedJsonValue_FromInt64(request));
+}
+
+static void _BenchClone(unsigned numRequests)
+{
+    RedJsonObject base = _GenConfig(200 * 1000);
+    RedJsonObject config;
+    char *text, *deepOut, *cloneOut;
+    double start, elapsed;
+    unsigned i;
+
+    text = RedJsonObject_ToFormattedJsonString(base, RED_JSON_FORMAT_COMPACT);
+    _Report("clone", "config", strlen(text) / 1e3, "KB");
+    free(text);
+
+    start = _Now();
+    for (i = 0; i < numRequests; i++)
+    {
+        config = _DeepCopyObject(base);
+        _CustomizeRequest(config, i, false);
+        RedJsonObject_Release(config);
+    }
+    elapsed = _Now() - start;
+    _Report("clone", "deep_copy", elapsed / numRequests * 1e6, "us/request");
+
+    start = _Now();
+    for (i = 0; i < numRequests; i++)
+    {
+        config = RedJsonObject_Clone(base);
+        _CustomizeRequest(config, i, true);
+        RedJsonObject_Release(config);
+    }
+    elapsed = _Now() - start;
+    _Report("clone", "copy_on_write", elapsed / numRequests * 1e6, "us/request");
+
+    /* Both strategies produce the same document and leave the base intact */
+    config = _DeepCopyObject(base);
+    _CustomizeRequest(config, 7, false);
+    deepOut = RedJsonObject_ToFormattedJsonString(config, RED_JSON_FORMAT_COMPACT);
+    RedJsonObject_Release(config);
+    config = RedJsonObject_Clone(base);
+    _CustomizeRequest(config, 7, true);
+    cloneOut = RedJsonObject_ToFormattedJsonString(config, RED_JSON_FORMAT_COMPACT);
+    RedJsonObject_Release(config);
+    if (strcmp(deepOut, cloneOut) || RedJsonObject_HasKey(base, "requestId")
+            || RedJsonObject_GetInt64(RedJsonObject_GetObject(RedJsonObject_GetObject(base, "db"), "pool"), "size") != 8)
+        fprintf(stderr, "clone: results differ\n");
+    free(deepOut);
+    free(cloneOut);
+    RedJsonObject_Release(base);
+}
+
+/*
+ * _GenOrderBook -- Write document <i> of the "paths" corpus: a small header
+ * and a "data" object holding eight priced items.
+ */
+static int _GenOrderBook(char *dest, size_t maxLength, unsigned i)
+{
+    int n = snprintf(dest, maxLength,
+            "{\"id\":%u,\"meta\":{\"source\":\"feed-%u\",\"seq\":%u},\"data\":{\"currency\":\"USD\",\"items\":[",
+            i, i % 7, i * 3);
+    unsigned j;
+    for (j = 0; j < 8; j++)
+        n += snprintf(&dest[n], maxLength - n, "%s{\"sku\":\"SKU-%u-%u\",\"price\":%u.%02u,\"qty\":%u}",
+                j ? "," : "", i, j, (i + j) % 500, j * 7 % 100, j + 1);
+    n += snprintf(&dest[n], maxLength - n, "],\"total\":%u}}", i % 1000);
+    return n;
+}
+
+static bool _SumPrice(RedJsonValue value, void *userData)
+{
+    *(double *)userData += RedJsonValue_GetNumber(value);
+    return true;
+}
+
+static bool _SumTapePrice(const RedJsonTapeRef_t *pRef, void *userData)
+{
+    *(double *)userData += RedJsonTapeRef_GetNumber(pRef);
+    return true;
+}
+
+static void _BenchPaths(unsigned numEvaluations)
+{
+    enum { NUM_DOCS = 1000, DOC_SIZE = 1024 };
+    const char *szPath = "/data/items/*/price";
+    RedJsonObject docs[NUM_DOCS];
+    RedJsonTape tapes[NUM_DOCS];
+    RedJsonPath path;
+    RedJsonArray items;
+    RedJsonTapeRef_t root, data, item, price;
+    char text[DOC_SIZE];
+    double start, elapsed, sumChained = 0, sumCompiled = 0, sumOnce = 0, sumTape = 0, sumTapeChained = 0;
+    unsigned i, j, numItems;
+    bool more;
+    int length;
+
+    for (i = 0; i < NUM_DOCS; i++)
+    {
+        length = _GenOrderBook(text, sizeof(text), i);
+        docs[i] = RedJson_Parse(text);
+        tapes[i] = RedJsonTape_Parse(text, length, NULL);
+    }
+
+    start = _Now();
+    for (i = 0; i < numEvaluations; i++)
+    {
+        items = RedJsonObject_GetArray(RedJsonObject_GetObject(docs[i % NUM_DOCS], "data"), "items");
+        numItems = RedJsonArray_NumItems(items);
+        for (j = 0; j < numItems; j++)
+            sumChained += RedJsonObject_GetNumber(RedJsonArray_GetEntryObject(items, j), "price");
+    }
+    elapsed = _Now() - start;
+    _Report("paths", "dom_chained", elapsed / numEvaluations * 1e9, "ns/doc");
+
+    start = _Now();
+    for (i = 0; i < numEvaluations; i++)
+    {
+        path = RedJsonPath_Compile(szPath, NULL);
+        RedJsonPath_EvalObject(path, docs[i % NUM_DOCS], _SumPrice, &sumOnce);
+        RedJsonPath_Free(path);
+    }
+    elapsed = _Now() - start;
+    _Report("paths", "dom_compile_each", elapsed / numEvaluations * 1e9, "ns/doc");
+
+    path = RedJsonPath_Compile(szPath, NULL);
+    start = _Now();
+    for (i = 0; i < numEvaluations; i++)
+        RedJsonPath_EvalObject(path, docs[i % NUM_DOCS], _SumPrice, &sumCompiled);
+    elapsed = _Now() - start;
+    _Report("paths", "dom_compiled", elapsed / numEvaluations * 1e9, "ns/doc");
+
+    start = _Now();
+    for (i = 0; i < numEvaluations; i++)
+    {
+        root = RedJsonTape_Root(tapes[i % NUM_DOCS]);
+        RedJsonTapeRef_Find(&root, "data", &data);
+        RedJsonTapeRef_Find(&data, "items", &data);
+        for (more = RedJsonTapeRef_First(&data, &item); more; more = RedJsonTapeRef_Next(&item))
+        {
+            RedJsonTapeRef_Find(&item, "price", &price);
+            sumTapeChained += RedJsonTapeRef_GetNumber(&price);
+        }
+    }
+    elapsed = _Now() - start;
+    _Report("paths", "tape_chained", elapsed / numEvaluations * 1e9, "ns/doc");
+
+    start = _Now();
+    for (i = 0; i < numEvaluations; i++)
+    {
+        root = RedJsonTape_Root(tapes[i % NUM_DOCS]);
+        RedJsonPath_EvalTape(path, &root, _SumTapePrice, &sumTape);
+    }
+    elapsed = _Now() - start;
+    _Report("paths", "tape_compiled", elapsed / numEvaluations * 1e9, "ns/doc");
+    RedJsonPath_Free(path);
+
+    if (sumChained != sumCompiled || sumChained != sumOnce || sumChained != sumTape || sumChained != sumTapeChained)
+        fprintf(stderr, "paths: results differ\n");
+    for (i = 0; i < NUM_DOCS; i++)
+    {
+        RedJsonObject_Release(docs[i]);
+        RedJsonTape_Free(tapes[i]);
+    }
+}
+
+/*
+ * _CurrentRssKb -- Resident set size right now, from /proc (Linux only).
+ * Returns 0 where unavailable.
+ */
+static long _CurrentRssKb(void)
+{
+    long pages = 0, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (!fp)
+        return 0;
+    if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+    fclose(fp);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+typedef enum
+{
+    _PARSE_FILE_READ,
+    _PARSE_FILE_MMAP,
+    _PARSE_FILE_VIEWS,
+} _ParseFileModeEnum;
+
+/*
+ * _BenchParseFile -- Load a "records" document from disk.  The file is
+ * written record by record so that generating it does not count towards
+ * the peak RSS, and is read back from the page cache.
+ */
+static void _BenchParseFile(unsigned numRecords, _ParseFileModeEnum mode)
+{
+    static const char *names[] = {"parse_file_read", "parse_file_mmap", "parse_file_views"};
+    char path[] = "/tmp/bench_json_fileXXXXXX";
+    char record[256];
+    RedJsonParseOptions_t options;
+    RedJsonObject obj = NULL;
+    struct stat st;
+    double start, elapsed;
+    char *text;
+    unsigned i;
+    FILE *fp;
+    int fd;
+
+    fd = mkstemp(path);
+    fp = fdopen(fd, "w");
+    fputs("{\"records\":[", fp);
+    for (i = 0; i < numRecords; i++)
+    {
+        _GenRecord(record, sizeof(record), i);
+        fputs(record, fp);
+    }
+    fputs("]}", fp);
+    fclose(fp);
+    stat(path, &st);
+
+    memset(&options, 0, sizeof(options));
+    options.stringViews = mode == _PARSE_FILE_VIEWS;
+    start = _Now();
+    if (mode == _PARSE_FILE_READ)
+    {
+        fd = open(path, O_RDONLY);
+        text = malloc(st.st_size);
+        if (read(fd, text, st.st_size) == st.st_size)
+            obj = RedJson_ParseWithOptions(text, st.st_size, NULL, NULL);
+        close(fd);
+        free(text);
+    }
+    else
+    {
+        obj = RedJson_ParseFileWithOptions(path, &options, NULL);
+    }
+    elapsed = _Now() - start;
+    if (!obj || RedJsonArray_NumItems(RedJsonObject_GetArray(obj, "records")) != numRecords)
+        fprintf(stderr, "%s: parse failed\n", names[mode]);
+
+    _Report(names[mode], "file", st.st_size / 1e6, "MB");
+    _Report(names[mode], "load_time", elapsed * 1e3, "ms");
+    _Report(names[mode], "throughput", st.st_size / elapsed / 1e6, "MB/s");
+    _Report(names[mode], "peak_rss", _PeakRssKb() / 1024.0, "MB");
+    _Report(names[mode], "loaded_rss", _CurrentRssKb() / 1024.0, "MB");
+    RedJsonObject_Release(obj);
+    unlink(path);
+}
+
+static void _BenchParseFileRead(unsigned numRecords)
+{
+    _BenchParseFile(numRecords, _PARSE_FILE_READ);
+}
+
+static void _BenchParseFileMmap(unsigned numRecords)
+{
+    _BenchParseFile(numRecords, _PARSE_FILE_MMAP);
+}
+
+static void _BenchParseFileViews(unsigned numRecords)
+{
+    _BenchParseFile(numRecords, _PARSE_FILE_VIEWS);
+}
+
+/*
+ * _BenchParallelArray -- Parse a top-level array of records from a file with
+ * 1, 2, 4, ... 32 threads.  The file is written record by record and read
+ * back from the page cache.
+ */
+static void _BenchParallelArray(unsigned numRecords)
+{
+    char path[] = "/tmp/bench_json_arrayXXXXXX";
+    char record[256];
+    RedJsonParallelOptions_t options;
+    RedJsonArray array;
+    double start, elapsed, single = 0;
+    struct stat st;
+    char metric[32];
+    unsigned i, numThreads;
+    FILE *fp;
+
+    fp = fdopen(mkstemp(path), "w");
+    fputc('[', fp);
+    for (i = 0; i < numRecords; i++)
+    {
+        _GenRecord(record, sizeof(record), i);
+        fputs(record, fp);
+    }
+    fputc(']', fp);
+    fclose(fp);
+    stat(path, &st);
+    _Report("parallel_array", "file", st.st_size / 1e6, "MB");
+    _Report("parallel_array", "cpus", sysconf(_SC_NPROCESSORS_ONLN), "");
+
+    memset(&options, 0, sizeof(options));
+    for (numThreads = 1; numThreads <= 32; numThreads *= 2)
+    {
+        options.numThreads = numThreads;
+        start = _Now();
+        array = RedJson_ParseArrayFileParallel(path, &options, NULL);
+        elapsed = _Now() - start;
+        if (!array || RedJsonArray_NumItems(array) != numRecords)
+            fprintf(stderr, "parallel_array: parse failed\n");
+        RedJsonArray_Release(array);
+        if (numThreads == 1)
+            single = elapsed;
+        snprintf(metric, sizeof(metric), "threads_%u", numThreads);
+        _Report("parallel_array", metric, st.st_size / elapsed / 1e6, "MB/s");
+        snprintf(metric, sizeof(metric), "speedup_%u", numThreads);
+        _Report("parallel_array", metric, single / elapsed, "x");
+    }
+    unlink(path);
+}
+
+/*
+ * _EditRecord -- Change the score of record <i> in place, reaching it
+ * through the GetMutable* functions so that cached hashes stay valid.
+ */
+static void _EditRecord(RedJsonObject doc, unsigned i, double score)
+{
+    RedJsonArray records = RedJsonObject_GetMutableArray(doc, "records");
+    RedJsonObject record = RedJsonArray_GetMutableEntryObject(records, i);
+    RedJsonObject_Put(record, "score", RedJsonValue_FromNumber(score));
+}
+
+/*
+ * _BenchDiff -- Diff two copies of a large document that differ in a
+ * handful of places, then apply the patch to a third copy.  A full deep
+ * comparison of two equal copies is the cost of walking everything.
+ */
+static void _BenchDiff(unsigned numRecords)
+{
+    RedJsonObject from, to, replica;
+    RedJsonArray patch;
+    RedJsonValue wrapped;
+    RedJsonErrorEnum err;
+    double start, elapsed;
+    size_t length;
+    char *text;
+    unsigned i;
+
+    text = _GenRecordsDocument(numRecords, &length);
+    _Report("diff", "document", length / 1e6, "MB");
+    from = RedJson_Parse(text);
+    to = RedJson_Parse(text);
+    replica = RedJson_Parse(text);
+    free(text);
+
+    for (i = 0; i < 4; i++)
+        _EditRecord(to, (unsigned)((uint64_t)numRecords * (2 * i + 1) / 8), 1000 + i);
+    RedJsonObject_Unset(RedJsonArray_GetMutableEntryObject(RedJsonObject_GetMutableArray(to, "records"), numRecords / 2),
+            "parent");
+    RedJsonObject_Put(to, "version", RedJsonValue_FromInt64(2));
+
+    start = _Now();
+    if (!RedJsonObject_Equals(from, replica))
+        fprintf(stderr, "diff: copies compare unequal\n");
+    elapsed = _Now() - start;
+    _Report("diff", "full_compare", elapsed * 1e3, "ms");
+
+    start = _Now();
+    patch = RedJson_Diff(from, to);
+    elapsed = _Now() - start;
+    _Report("diff", "first_diff", elapsed * 1e3, "ms");
+    _Report("diff", "operations", RedJsonArray_NumItems(patch), "");
+    wrapped = RedJsonValue_FromArray(RedJsonArray_Retain(patch));
+    text = RedJsonValue_ToFormattedJsonString(wrapped, RED_JSON_FORMAT_COMPACT);
+    _Report("diff", "patch", strlen(text), "bytes");
+    free(text);
+    RedJsonValue_Release(wrapped);
+
+    start = _Now();
+    err = RedJson_ApplyPatch(replica, patch, NULL);
+    elapsed = _Now() - start;
+    _Report("diff", "apply", elapsed * 1e3, "ms");
+    if (err || !RedJsonObject_Equals(replica, to))
+        fprintf(stderr, "diff: patched document differs\n");
+    RedJsonArray_Release(patch);
+
+    /* With hashes cached, unchanged records cost a hash comparison each and
+     * an edit only rehashes its own path */
+    start = _Now();
+    patch = RedJson_Diff(from, to);
+    elapsed = _Now() - start;
+    _Report("diff", "repeat_diff", elapsed * 1e3, "ms");
+    RedJsonArray_Release(patch);
+
+    _EditRecord(to, numRecords / 3, 2000);
+    start = _Now();
+    patch = RedJson_Diff(from, to);
+    elapsed = _Now() - start;
+    _Report("diff", "diff_after_edit", elapsed * 1e3, "ms");
+    if (RedJsonArray_NumItems(patch) != 7)
+        fprintf(stderr, "diff: expected 7 operations, got %u\n", RedJsonArray_NumItems(patch));
+    RedJsonArray_Release(patch);
+
+    RedJsonObject_Release(from);
+    RedJsonObject_Release(to);
+    RedJsonObject_Release(replica);
+}
+
+/*
+ * reformat -- Push <corpusMb> megabytes of JSON through RedJson_Validate,
+ * RedJson_Minify and RedJson_Prettify, and through parse plus serialize for
+ * comparison.  The corpus is a pretty printed records document of about
+ * 64MB processed repeatedly, so that the DOM of the baseline fits in memory.
+ */
+static void _BenchReformat(unsigned corpusMb)
+{
+    const unsigned numRecords = 500000;
+    RedJsonObject obj;
+    RedJsonErrorEnum err;
+    double start, elapsed[5] = {0};
+    size_t compactLength, prettyLength, total = 0, n;
+    char *compact, *pretty, *out, *text;
+
+    compact = _GenRecordsDocument(numRecords, &compactLength);
+    pretty = RedJson_Prettify(compact, compactLength, NULL);
+    prettyLength = strlen(pretty);
+    out = malloc(prettyLength + 1);
+    _Report("reformat", "document", prettyLength / 1e6, "MB");
+
+    while (total < (size_t)corpusMb * 1000000)
+    {
+        start = _Now();
+        err = RedJson_Validate(pretty, prettyLength, NULL, NULL);
+        elapsed[0] += _Now() - start;
+
+        start = _Now();
+        err |= RedJson_Validate(compact, compactLength, NULL, NULL);
+        elapsed[1] += _Now() - start;
+
+        start = _Now();
+        err |= RedJson_Minify(pretty, prettyLength, out, &n, NULL);
+        elapsed[2] += _Now() - start;
+        if (err || n != compactLength)
+            fprintf(stderr, "reformat: minify failed\n");
+
+        start = _Now();
+        text = RedJson_Prettify(compact, compactLength, NULL);
+        elapsed[3] += _Now() - start;
+        free(text);
+
+        start = _Now();
+        obj = RedJson_ParseWithOptions(pretty, prettyLength, NULL, NULL);
+        text = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+        RedJsonObject_Release(obj);
+        free(text);
+        elapsed[4] += _Now() - start;
+
+        total += prettyLength;
+    }
+    _Report("reformat", "corpus", total / 1e6, "MB");
+    _Report("reformat", "validate", total / elapsed[0] / 1e6, "MB/s");
+    _Report("reformat", "validate_compact", total / 1e6 * compactLength / prettyLength / elapsed[1], "MB/s");
+    _Report("reformat", "minify", total / elapsed[2] / 1e6, "MB/s");
+    _Report("reformat", "prettify", total / 1e6 * compactLength / prettyLength / elapsed[3], "MB/s");
+    _Report("reformat", "parse_serialize", total / elapsed[4] / 1e6, "MB/s");
+    _Report("reformat", "peak_rss", _PeakRssKb() / 1024.0, "MB");
+    free(out);
+    free(pretty);
+    free(compact);
+}
+
+/*
+ * _GenDoublesDocument -- {"values": [...]} holding <numValues> doubles with
+ * three decimals, written without printf so that 100M of them take seconds.
+ */
+static char * _GenDoublesDocument(unsigned numValues, size_t *pLength)
+{
+    size_t capacity = 64 + (size_t)numValues * 16;
+    char *text = malloc(capacity);
+    char *p = text, digits[16];
+    unsigned seed = 2463534242u, i, n, whole, frac;
+
+    p += sprintf(p, "{\"values\":[");
+    for (i = 0; i < numValues; i++)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        if (i)
+            *p++ = ',';
+        if (seed & 1)
+            *p++ = '-';
+        whole = (seed >> 1) % 100000;
+        frac = 1 + (seed >> 17) % 999;
+        n = 0;
+        do
+        {
+            digits[n++] = '0' + whole % 10;
+            whole /= 10;
+        } while (whole);
+        while (n)
+            *p++ = digits[--n];
+        *p++ = '.';
+        *p++ = '0' + frac / 100;
+        *p++ = '0' + frac / 10 % 10;
+        *p++ = '0' + frac % 10;
+    }
+    p += sprintf(p, "]}");
+    *pLength = p - text;
+    return text;
+}
+
+/*
+ * packed_array -- Parse an array of <numValues> doubles, which the parser
+ * packs into one contiguous buffer, and report its memory per number and
+ * the cost of summing it through RedJsonArray_GetDoubles and element by
+ * element.  The values_* metrics hold up to 10M of the same numbers as one
+ * value each, as arrays were stored before packing, summed through
+ * RedJsonArray_GetEntry.
+ */
+static void _BenchPackedArray(unsigned numValues)
+{
+    unsigned numBaseline = numValues < 10000000 ? numValues : 10000000;
+    RedJsonObject obj;
+    RedJsonArray arr, values;
+    const double *doubles;
+    double start, elapsed, sum, expected;
+    size_t length;
+    long baseRss;
+    char *text;
+    unsigned i;
+
+    text = _GenDoublesDocument(numValues, &length);
+    baseRss = _CurrentRssKb();
+    start = _Now();
+    obj = RedJson_ParseWithOptions(text, length, NULL, NULL);
+    elapsed = _Now() - start;
+    _Report("packed_array", "parse", length / elapsed / 1e6, "MB/s");
+    _Report("packed_array", "parse_rate", numValues / elapsed / 1e6, "Mnum/s");
+    _Report("packed_array", "bytes_per_number", (_CurrentRssKb() - baseRss) * 1024.0 / numValues, "B");
+    free(text);
+
+    arr = RedJsonObject_GetArray(obj, "values");
+    doubles = RedJsonArray_GetDoubles(arr);
+    if (!doubles || RedJsonArray_NumItems(arr) != numValues)
+    {
+        fprintf(stderr, "packed_array: array was not packed\n");
+        RedJsonObject_Release(obj);
+        return;
+    }
+
+    start = _Now();
+    for (i = 0, expected = 0; i < numValues; i++)
+        expected += doubles[i];
+    elapsed = _Now() - start;
+    _Report("packed_array", "sum_bulk", elapsed / numValues * 1e9, "ns");
+
+    start = _Now();
+    for (i = 0, sum = 0; i < numValues; i++)
+        sum += RedJsonArray_GetEntryNumber(arr, i);
+    elapsed = _Now() - start;
+    _Report("packed_array", "sum_entry", elapsed / numValues * 1e9, "ns");
+    if (sum != expected)
+        fprintf(stderr, "packed_array: sums differ\n");
+
+    baseRss = _CurrentRssKb();
+    values = RedJsonArray_New();
+    for (i = 0; i < numBaseline; i++)
+        RedJsonArray_Append(values, RedJsonValue_FromNumber(doubles[i]));
+    _Report("packed_array", "values_bytes_per_number", (_CurrentRssKb() - baseRss) * 1024.0 / numBaseline, "B");
+
+    start = _Now();
+    for (i = 0, sum = 0; i < numBaseline; i++)
+        sum += RedJsonValue_GetNumber(RedJsonArray_GetEntry(values, i));
+    elapsed = _Now() - start;
+    _Report("packed_array", "values_sum", elapsed / numBaseline * 1e9, "ns");
+    if (RedJsonArray_GetStorage(values) != RED_JSON_ARRAY_STORAGE_VALUES)
+        fprintf(stderr, "packed_array: baseline was packed\n");
+
+    RedJsonArray_Release(values);
+    RedJsonObject_Release(obj);
+}
+
+/*
+ * Standard corpus -- Synthetic stand-ins for the documents of the usual JSON
+ * benchmark corpus, generated so that the suite runs offline.  Each is run
+ * through the same four passes by _BenchCorpus.
+ */
+
+/*
+ * _GenTwitterDocument -- twitter.json-style corpus: search results whose
+ * statuses carry nested user and entity objects, 64-bit ids in both number
+ * and string form, and Japanese text written as \u escapes.
+ */
+static char * _GenTwitterDocument(unsigned numStatuses, size_t *pLength)
+{
+    static const char *texts[] =
+    {
+        "@aym0566x \\n\\n\\u540d\\u524d:\\u524d\\u7530\\u3042\\u3086\\u307f\\n\\u7b2c\\u4e00\\u5370\\u8c61:"
+                "\\u306a\\u3093\\u304b\\u6016\\u3063\\uff01\\n\\u4eca\\u306e\\u5370\\u8c61:\\u3068\\u308a\\u3042"
+                "\\u3048\\u305a\\u30ad\\u30e2\\u3044\\u3002\\u565b\\u307f\\u5408\\u308f\\u306a\\u3044",
+        "RT @KATANA77: \\u3048\\u3063\\u305d\\u3093\\u306a\\u3063\\u2026\\uff01\\uff1f http://t.co/Fk3Q6GDWEF",
+        "Just landed in Paris \\u2708\\ufe0f caf\\u00e9 au lait and croissants, see you all at the conference! #travel",
+        "\\u3010\\u60c5\\u5831\\u3011\\u660e\\u65e5\\u306e\\u30e9\\u30a4\\u30d6\\u306f18\\u6642\\u958b\\u6f14"
+                "\\u3067\\u3059\\u3002\\u304a\\u697d\\u3057\\u307f\\u306b\\uff01 http://t.co/abc123XYZ #live",
+    };
+    static const char *names[] =
+    {
+        "AYUMI", "\\u524d\\u7530\\u3042\\u3086\\u307f", "Jean-Luc", "\\u304b\\u3068\\u3061\\u3083\\u3093 \\u2764\\ufe0e",
+    };
+    size_t capacity = 256 + (size_t)numStatuses * 4096;
+    char *text = malloc(capacity);
+    char *p = text;
+    unsigned long long id;
+    unsigned i, userId;
+
+    p += sprintf(p, "{\"statuses\":[");
+    for (i = 0; i < numStatuses; i++)
+    {
+        id = 505874924095815681ULL + i * 7919ULL;
+        userId = 1186275104u + i * 131u;
+        p += sprintf(p, "%s{\"metadata\":{\"result_type\":\"recent\",\"iso_language_code\":\"%s\"},"
+                "\"created_at\":\"Sun Aug 31 00:%02u:%02u +0000 2014\",\"id\":%llu,\"id_str\":\"%llu\","
+                "\"text\":\"%s\",\"source\":\"<a href=\\\"http://twitter.com/download/iphone\\\" "
+                "rel=\\\"nofollow\\\">Twitter for iPhone</a>\",\"truncated\":false,"
+                "\"in_reply_to_status_id\":null,\"in_reply_to_status_id_str\":null,"
+                "\"in_reply_to_user_id\":%s,\"in_reply_to_screen_name\":%s,",
+                i ? "," : "", (i % 4 == 2) ? "en" : "ja", i % 60, (i * 7) % 60, id, id, texts[i % 4],
+                (i % 4 == 0) ? "866260188" : "null", (i % 4 == 0) ? "\"aym0566x\"" : "null");
+        p += sprintf(p, "\"user\":{\"id\":%u,\"id_str\":\"%u\",\"name\":\"%s\",\"screen_name\":\"user%u\","
+                "\"location\":\"%s\",\"description\":\"%s\",\"url\":null,"
+                "\"entities\":{\"description\":{\"urls\":[]}},\"protected\":false,\"followers_count\":%u,"
+                "\"friends_count\":%u,\"listed_count\":%u,\"created_at\":\"Fri Feb 01 07:12:%02u +0000 2013\","
+                "\"favourites_count\":%u,\"utc_offset\":%s,\"time_zone\":%s,\"geo_enabled\":%s,"
+                "\"verified\":false,\"statuses_count\":%u,\"lang\":\"ja\",\"contributors_enabled\":false,"
+                "\"profile_background_color\":\"C0DEED\",\"profile_image_url\":"
+                "\"http://pbs.twimg.com/profile_images/%u/4hHRWvpj_normal.jpeg\",\"profile_link_color\":\"0084B4\","
+                "\"default_profile\":%s,\"following\":false,\"notifications\":false},",
+                userId, userId, names[i % 4], i, (i & 1) ? "\\u5927\\u962a" : "",
+                texts[(i + 1) % 4], i * 37 % 5000, i * 13 % 3000, i % 17, i % 60, i * 3 % 900,
+                (i & 1) ? "32400" : "null", (i & 1) ? "\"Tokyo\"" : "null", (i % 3) ? "false" : "true",
+                i * 101 % 90000, 497760886 + i, (i & 1) ? "true" : "false");
+        p += sprintf(p, "\"geo\":null,\"coordinates\":null,\"place\":null,\"contributors\":null,"
+                "\"retweet_count\":%u,\"favorite_count\":%u,\"entities\":{\"hashtags\":[%s],\"symbols\":[],"
+                "\"urls\":[%s],\"user_mentions\":[%s]},\"favorited\":false,\"retweeted\":false,\"lang\":\"%s\"}",
+                i % 7, i % 5,
+                (i % 4 >= 2) ? "{\"text\":\"travel\",\"indices\":[84,91]}" : "",
+                (i % 4 == 1) ? "{\"url\":\"http://t.co/Fk3Q6GDWEF\",\"expanded_url\":\"http://example.com/a\","
+                        "\"display_url\":\"example.com/a\",\"indices\":[32,54]}" : "",
+                (i % 4 < 2) ? "{\"screen_name\":\"aym0566x\",\"name\":\"\\u524d\\u7530\\u3042\\u3086\\u307f\","
+                        "\"id\":866260188,\"id_str\":\"866260188\",\"indices\":[0,9]}" : "",
+                (i % 4 == 2) ? "en" : "ja");
+    }
+    p += sprintf(p, "],\"search_metadata\":{\"completed_in\":0.087,\"max_id\":505874924095815681,"
+            "\"max_id_str\":\"505874924095815681\",\"next_results\":\"?max_id=505874847260352512&q=%%E4%%B8%%80"
+            "&count=100&include_entities=1\",\"query\":\"%%E4%%B8%%80\",\"count\":%u,\"since_id\":0}}", numStatuses);
+    *pLength = p - text;
+    return text;
+}
+
+/*
+ * _GenCatalogDocument -- citm_catalog.json-style corpus: maps keyed by
+ * numeric ids and a long array of performances with small price and seat
+ * arrays, mostly integers, pretty printed.
+ */
+static char * _GenCatalogDocument(unsigned numPerformances, size_t *pLength)
+{
+    static const char *areas[] = {"Arri\\u00e8re-sc\\u00e8ne central", "1er balcon central", "2\\u00e8me bac cour",
+            "Parterre", "Galerie", "Loge"};
+    size_t capacity = 1024 + (size_t)numPerformances * 1024;
+    char *text = malloc(capacity);
+    char *p = text;
+    RedJsonObject obj;
+    unsigned i, j;
+
+    p += sprintf(p, "{\"areaNames\":{");
+    for (i = 0; i < 17; i++)
+        p += sprintf(p, "%s\"%u\":\"%s\"", i ? "," : "", 205705993 + i * 2, areas[i % 6]);
+    p += sprintf(p, "},\"audienceSubCategoryNames\":{\"337100890\":\"Abonn\\u00e9\"},\"blockNames\":{},\"events\":{");
+    for (i = 0; i < numPerformances / 2; i++)
+        p += sprintf(p, "%s\"%u\":{\"description\":null,\"id\":%u,\"logo\":%s,\"name\":\"Concert %u\","
+                "\"subTopicIds\":[337184269,337184283],\"subjectCode\":null,\"subtitle\":null,"
+                "\"topicIds\":[324846099,107888604]}", i ? "," : "", 138586341 + i * 4, 138586341 + i * 4,
+                (i % 3) ? "null" : "\"/images/UE0AAAAACEKo6QAAAAZDSVRN\"", i);
+    p += sprintf(p, "},\"performances\":[");
+    for (i = 0; i < numPerformances; i++)
+    {
+        p += sprintf(p, "%s{\"eventId\":%u,\"id\":%u,\"logo\":null,\"name\":null,\"prices\":[",
+                i ? "," : "", 138586341 + (i / 2) * 4, 339887544 + i * 3);
+        for (j = 0; j < 2 + i % 4; j++)
+            p += sprintf(p, "%s{\"amount\":%u,\"audienceSubCategoryId\":337100890,\"seatCategoryId\":%u}",
+                    j ? "," : "", 90250 - j * 23750, 338937295 + j * 2);
+        p += sprintf(p, "],\"seatCategories\":[");
+        for (j = 0; j < 2 + i % 4; j++)
+            p += sprintf(p, "%s{\"areas\":[{\"areaId\":%u,\"blockIds\":[]},{\"areaId\":%u,\"blockIds\":[]}],"
+                    "\"seatCategoryId\":%u}", j ? "," : "", 205705999 + j * 2, 205705993 + j * 2, 338937295 + j * 2);
+        p += sprintf(p, "],\"seatMapImage\":null,\"start\":%llu,\"venueCode\":\"PLEYEL_PLEYEL\"}",
+                1372701600000ULL + i * 86400000ULL);
+    }
+    p += sprintf(p, "],\"venueNames\":{\"PLEYEL_PLEYEL\":\"Salle Pleyel\"}}");
+
+    obj = RedJson_Parse(text);
+    free(text);
+    text = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_PRETTY);
+    RedJsonObject_Release(obj);
+    *pLength = strlen(text);
+    return text;
+}
+
+/*
+ * _GenNumericDocument -- An array of integers and doubles of varied
+ * magnitude, half of each.
+ */
+static char * _GenNumericDocument(unsigned numValues, size_t *pLength)
+{
+    size_t capacity = 64 + (size_t)numValues * 32;
+    char *text = malloc(capacity);
+    char *p = text;
+    unsigned seed = 2463534242u, i;
+
+    p += sprintf(p, "{\"values\":[");
+    for (i = 0; i < numValues; i++)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        if (i & 1)
+            p += sprintf(p, "%s%.*g", i ? "," : "", 3 + (int)(seed % 14), (seed >> 4) * 1e-6 * ((seed & 8) ? -1 : 1));
+        else
+            p += sprintf(p, "%s%lld", i ? "," : "", (long long)seed * ((seed & 8) ? -1 : 1) >> (seed % 24));
+    }
+    p += sprintf(p, "]}");
+    *pLength = p - text;
+    return text;
+}
+
+/*
+ * _GenDeepDocument -- Blocks of objects and arrays nested <depth> levels
+ * deep, each holding a couple of scalars at every level.
+ */
+static char * _GenDeepDocument(unsigned numBlocks, unsigned depth, size_t *pLength)
+{
+    size_t capacity = 64 + (size_t)numBlocks * (depth * 16 + 8);
+    char *text = malloc(capacity);
+    char *p = text;
+    unsigned i, j;
+
+    p += sprintf(p, "{\"blocks\":[");
+    for (i = 0; i < numBlocks; i++)
+    {
+        *p++ = i ? ',' : ' ';
+        for (j = 0; j < depth / 2; j++)
+            p += sprintf(p, "{\"n\":%u,\"a\":[true,", j);
+        *p++ = '0';
+        for (j = 0; j < depth / 2; j++)
+            p += sprintf(p, "]}");
+    }
+    p += sprintf(p, "]}");
+    *pLength = p - text;
+    return text;
+}
+
+typedef struct
+{
+    unsigned long nodes;
+    size_t stringBytes;
+    double sum;
+} _TraverseStats;
+
+/*
+ * _Traverse -- Visit every value of a DOM through the public accessors, the
+ * way a consumer reading every field would; strings are copied out.
+ */
+static void _Traverse(RedJsonValue value, _TraverseStats *stats)
+{
+    RedJsonObject obj;
+    RedJsonArray array;
+    unsigned i, n;
+    char *sz;
+
+    stats->nodes++;
+    if (RedJsonValue_IsObject(value))
+    {
+        obj = RedJsonValue_GetObject(value);
+        n = RedJsonObject_NumItems(obj);
+        for (i = 0; i < n; i++)
+        {
+            stats->stringBytes += strlen(RedJsonObject_GetKeyAt(obj, i));
+            _Traverse(RedJsonObject_GetValueAt(obj, i), stats);
+        }
+    }
+    else if (RedJsonValue_IsArray(value))
+    {
+        array = RedJsonValue_GetArray(value);
+        n = RedJsonArray_NumItems(array);
+        if (RedJsonArray_GetStorage(array) == RED_JSON_ARRAY_STORAGE_VALUES)
+        {
+            for (i = 0; i < n; i++)
+                _Traverse(RedJsonArray_GetEntry(array, i), stats);
+        }
+        else
+        {
+            /* Packed elements are read through the typed getters */
+            stats->nodes += n;
+            for (i = 0; i < n; i++)
+            {
+                if (RedJsonArray_IsEntryNumber(array, i))
+                    stats->sum += RedJsonArray_GetEntryNumber(array, i);
+            }
+        }
+    }
+    else if (RedJsonValue_IsString(value))
+    {
+        sz = RedJsonValue_GetString(value);
+        stats->stringBytes += strlen(sz);
+        free(sz);
+    }
+    else if (RedJsonValue_IsNumber(value))
+        stats->sum += RedJsonValue_GetNumber(value);
+}
+
+/*
+ * _BenchCorpus -- Run one document of the corpus through <passes> of each
+ * of parse, traverse, serialize and round trip (parse then serialize the
+ * serialized text), reporting throughput over the input size, allocations
+ * per parse and the peak RSS of the process.
+ */
+static void _BenchCorpus(const char *name, char *text, size_t length, unsigned passes)
+{
+    RedJsonObject obj, copy;
+    RedJsonValue root;
+    _TraverseStats stats;
+    unsigned long allocations;
+    double start, elapsed;
+    size_t outLength;
+    char *out, *again;
+    unsigned i;
+
+    if (!passes)
+        passes = 1;
+    _Report(name, "size", length / 1e3, "KB");
+
+    allocations = _allocations;
+    start = _Now();
+    for (i = 0; i < passes; i++)
+    {
+        obj = RedJson_ParseWithOptions(text, length, NULL, NULL);
+        if (!obj)
+            fprintf(stderr, "%s: parse failed\n", name);
+        RedJsonObject_Release(obj);
+    }
+    elapsed = _Now() - start;
+    _Report(name, "parse", length * passes / elapsed / 1e6, "MB/s");
+    if (_HAVE_ALLOCATION_COUNT)
+        _Report(name, "parse_allocs", (_allocations - allocations) / (double)passes, "allocs/doc");
+
+    obj = RedJson_ParseWithOptions(text, length, NULL, NULL);
+    root = RedJsonValue_FromObject(obj);
+    memset(&stats, 0, sizeof(stats));
+    start = _Now();
+    for (i = 0; i < passes; i++)
+        _Traverse(root, &stats);
+    elapsed = _Now() - start;
+    _Report(name, "traverse", length * passes / elapsed / 1e6, "MB/s");
+    _Report(name, "nodes", stats.nodes / passes, "");
+
+    start = _Now();
+    for (i = 0; i < passes; i++)
+    {
+        out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+        free(out);
+    }
+    elapsed = _Now() - start;
+    _Report(name, "serialize", length * passes / elapsed / 1e6, "MB/s");
+
+    out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+    outLength = strlen(out);
+    start = _Now();
+    for (i = 0; i < passes; i++)
+    {
+        copy = RedJson_ParseWithOptions(out, outLength, NULL, NULL);
+        again = RedJsonObject_ToFormattedJsonString(copy, RED_JSON_FORMAT_COMPACT);
+        if (i == 0 && strcmp(out, again))
+            fprintf(stderr, "%s: round trip changed the document\n", name);
+        free(again);
+        RedJsonObject_Release(copy);
+    }
+    elapsed = _Now() - start;
+    _Report(name, "roundtrip", length * passes / elapsed / 1e6, "MB/s");
+    free(out);
+    RedJsonValue_Release(root);
+
+    _Report(name, "peak_rss", _PeakRssKb() / 1024.0, "MB");
+    free(text);
+}
+
+static void _BenchCorpusTwitter(unsigned passes)
+{
+    size_t length;
+    char *text = _GenTwitterDocument(320, &length);
+    _BenchCorpus("corpus_twitter", text, length, passes);
+}
+
+static void _BenchCorpusCatalog(unsigned passes)
+{
+    size_t length;
+    char *text = _GenCatalogDocument(1100, &length);
+    _BenchCorpus("corpus_citm", text, length, passes);
+}
+
+static void _BenchCorpusCanada(unsigned passes)
+{
+    size_t length;
+    char *text = _GenCoordinatesDocument(56000, &length);
+    _BenchCorpus("corpus_canada", text, length, passes);
+}
+
+static void _BenchCorpusNumeric(unsigned passes)
+{
+    size_t length;
+    char *text = _GenNumericDocument(100000, &length);
+    _BenchCorpus("corpus_numeric", text, length, passes);
+}
+
+static void _BenchCorpusDeep(unsigned passes)
+{
+    size_t length;
+    char *text = _GenDeepDocument(200, RED_JSON_DEFAULT_MAX_DEPTH - 2, &length);
+    _BenchCorpus("corpus_deep", text, length, passes);
+}
+
+typedef struct
+{
+    RedJsonArray records;
+    bool keep;
+} _NdjsonCorpus;
+
+static bool _CollectRecord(RedJsonValue record, void *userData)
+{
+    _NdjsonCorpus *corpus = userData;
+    if (corpus->keep)
+        RedJsonArray_Append(corpus->records, RedJsonValue_Retain(record));
+    return true;
+}
+
+static bool _CountOutput(const char *data, size_t length, void *userData)
+{
+    *(size_t *)userData += length;
+    return true;
+}
+
+/*
+ * corpus_ndjson -- The records corpus as NDJSON: read with
+ * RedJson_ReadNdjsonFile on one thread, traversed record by record and
+ * written back as NDJSON by a compact writer.
+ */
+static void _BenchCorpusNdjson(unsigned passes)
+{
+    const char *name = "corpus_ndjson";
+    char path[] = "/tmp/bench_json_corpusXXXXXX";
+    RedJsonNdjsonOptions_t options;
+    RedJsonArray copy;
+    RedJsonWriter writer;
+    RedJsonValue root;
+    _NdjsonCorpus corpus;
+    _TraverseStats stats;
+    unsigned long allocations;
+    double start, elapsed;
+    size_t length = 0, outLength;
+    char line[256];
+    unsigned i, j, numRecords = 20000;
+    FILE *fp;
+
+    if (!passes)
+        passes = 1;
+    fp = fdopen(mkstemp(path), "w");
+    for (i = 0; i < numRecords; i++)
+    {
+        /* _GenRecord prefixes every record after the first with a comma */
+        length += _GenRecord(line, sizeof(line), i + 1);
+        fprintf(fp, "%s\n", &line[1]);
+    }
+    fclose(fp);
+    _Report(name, "size", length / 1e3, "KB");
+
+    memset(&options, 0, sizeof(options));
+    options.numThreads = 1;
+    options.ordered = true;
+    corpus.keep = false;
+    allocations = _allocations;
+    start = _Now();
+    for (i = 0; i < passes; i++)
+    {
+        if (RedJson_ReadNdjsonFile(path, &options, _CollectRecord, &corpus, NULL) != RED_JSON_OK)
+            fprintf(stderr, "%s: parse failed\n", name);
+    }
+    elapsed = _Now() - start;
+    _Report(name, "parse", length * passes / elapsed / 1e6, "MB/s");
+    if (_HAVE_ALLOCATION_COUNT)
+        _Report(name, "parse_allocs", (_allocations - allocations) / (double)passes / numRecords, "allocs/record");
+
+    corpus.records = RedJsonArray_New();
+    corpus.keep = true;
+    RedJson_ReadNdjsonFile(path, &options, _CollectRecord, &corpus, NULL);
+    root = RedJsonValue_FromArray(corpus.records);
+    memset(&stats, 0, sizeof(stats));
+    start = _Now();
+    for (i = 0; i < passes; i++)
+        _Traverse(root, &stats);
+    elapsed = _Now() - start;
+    _Report(name, "traverse", length * passes / elapsed / 1e6, "MB/s");
+    _Report(name, "nodes", stats.nodes / passes, "");
+
+    start = _Now();
+    for (i = 0; i < passes; i++)
+    {
+        outLength = 0;
+        writer = RedJsonWriter_NewCallback(_CountOutput, &outLength, RED_JSON_FORMAT_COMPACT);
+        for (j = 0; j < numRecords; j++)
+            RedJsonWriter_Value(writer, RedJsonArray_GetEntry(corpus.records, j));
+        if (RedJsonWriter_Finish(writer) != RED_JSON_OK || !outLength)
+            fprintf(stderr, "%s: serialize failed\n", name);
+        RedJsonWriter_Free(writer);
+    }
+    elapsed = _Now() - start;
+    _Report(name, "serialize", length * passes / elapsed / 1e6, "MB/s");
+
+    /* Round trip: write the records out as NDJSON and read them back */
+    start = _Now();
+    for (i = 0; i < passes; i++)
+    {
+        fp = fopen(path, "w");
+        writer = RedJsonWriter_NewFile(fp, RED_JSON_FORMAT_COMPACT);
+        for (j = 0; j < numRecords; j++)
+            RedJsonWriter_Value(writer, RedJsonArray_GetEntry(corpus.records, j));
+        RedJsonWriter_Finish(writer);
+        RedJsonWriter_Free(writer);
+        fclose(fp);
+        corpus.records = copy = RedJsonArray_New();
+        RedJson_ReadNdjsonFile(path, &options, _CollectRecord, &corpus, NULL);
+        if (RedJsonArray_NumItems(copy) != numRecords)
+            fprintf(stderr, "%s: round trip lost records\n", name);
+        RedJsonArray_Release(copy);
+        corpus.records = RedJsonValue_GetArray(root);
+    }
+    elapsed = _Now() - start;
+    _Report(name, "roundtrip", length * passes / elapsed / 1e6, "MB/s");
+    RedJsonValue_Release(root);
+    unlink(path);
+
+    _Report(name, "peak_rss", _PeakRssKb() / 1024.0, "MB");
+}
+
+static void _BenchTape(unsigned numRecords)
+{
+    _BenchTapeOrDom(numRecords, true);
+}
+
+static void _BenchTapeDom(unsigned numRecords)
+{
+    _BenchTapeOrDom(numRecords, false);
+}
+
+typedef struct
+{
+    const char *name;
+    void (*fnRun)(unsigned size);
+} _Benchmark;
+
+static const _Benchmark _benchmarks[] =
+{
+    {"stream_memory", _BenchStreamMemory},
+    {"parse_memory", _BenchParseMemory},
+    {"ndjson_threads", _BenchNdjsonThreads},
+    {"numbers", _BenchNumbers},
+    {"serialize_numbers", _BenchSerializeNumbers},
+    {"serialize", _BenchSerialize},
+    {"write_stream", _BenchWriteStream},
+    {"write_dom_fd", _BenchWriteDomFd},
+    {"write_dom_string", _BenchWriteDomString},
+    {"strings_ascii", _BenchStringsAscii},
+    {"strings_multilingual", _BenchStringsMultilingual},
+    {"objects", _BenchObjects},
+    {"keys", _BenchKeys},
+    {"lazy", _BenchLazy},
+    {"tape", _BenchTape},
+    {"tape_dom", _BenchTapeDom},
+    {"cbor", _BenchCbor},
+    {"binding", _BenchBinding},
+    {"clone", _BenchClone},
+    {"document", _BenchDocument},
+    {"parallel_array", _BenchParallelArray},
+    {"diff", _BenchDiff},
+    {"duplicate_keys", _BenchDuplicateKeys},
+    {"reformat", _BenchReformat},
+    {"packed_array", _BenchPackedArray},
+    {"corpus_twitter", _BenchCorpusTwitter},
+    {"corpus_citm", _BenchCorpusCatalog},
+    {"corpus_canada", _BenchCorpusCanada},
+    {"corpus_numeric", _BenchCorpusNumeric},
+    {"corpus_deep", _BenchCorpusDeep},
+    {"corpus_ndjson", _BenchCorpusNdjson},
+    {"paths", _BenchPaths},
+    {"parse_file_read", _BenchParseFileRead},
+    {"parse_file_mmap", _BenchParseFileMmap},
+    {"parse_file_views", _BenchParseFileViews},
+};
+
+int main(int argc, const char *argv[])
+{
+    unsigned i;
+    unsigned size = 100000;
+
+    if (argc > 1 && !strcmp(argv[1], "--ndjson"))
+    {
+        _ndjson = true;
+        argv++;
+        argc--;
+    }
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s [--ndjson] <benchmark> [size]\nBenchmarks:", argv[0]);
+        for (i = 0; i < sizeof(_benchmarks) / sizeof(_benchmarks[0]); i++)
+            fprintf(stderr, " %s", _benchmarks[i].name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+    if (argc > 2)
+        size = (unsigned)strtoul(argv[2], NULL, 10);
+
+    for (i = 0; i < sizeof(_benchmarks) / sizeof(_benchmarks[0]); i++)
+    {
+        if (!strcmp(argv[1], _benchmarks[i].name))
+        {
+            _benchmarks[i].fnRun(size);
+            return 0;
+        }
+    }
+    fprintf(stderr, "Unknown benchmark '%s'\n", argv[1]);
+    return 1;
+}
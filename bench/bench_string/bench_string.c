@@ -0,0 +1,235 @@
+/*
+ *  bench_string.c -- Benchmarks for the "RedString" module.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ *
+ *  Usage: bench_string [--ndjson] <benchmark> [size]
+ *
+ *  Output follows bench_json: one line per metric, or one JSON object per
+ *  line ({"bench", "metric", "value", "unit"}) with --ndjson.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "red_string.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double _Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool _ndjson;
+
+static void _Report(const char *bench, const char *metric, double value, const char *unit)
+{
+    if (_ndjson)
+        printf("{\"bench\":\"%s\",\"metric\":\"%s\",\"value\":%.6g,\"unit\":\"%s\"}\n",
+                bench, metric, value, unit);
+    else
+        printf("%-20s %-16s %14.2f %s\n", bench, metric, value, unit);
+}
+
+/*
+ * Allocation counting, as in bench_json: with glibc the allocator is wrapped
+ * so that _allocations counts malloc, calloc and realloc calls.
+ */
+#ifdef __GLIBC__
+#define _HAVE_ALLOCATION_COUNT 1
+
+static unsigned long _allocations;
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    _allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    _allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    _allocations++;
+    return __libc_realloc(ptr, size);
+}
+#else
+#define _HAVE_ALLOCATION_COUNT 0
+static unsigned long _allocations;
+#endif
+
+/* Pieces of 1 to 24 characters, as a tokenizer or log formatter appends */
+static const char *_pieces[] =
+{
+    "a", "\"id\":", "12345", ", ", "\"name\":\"", "widget", "\"}", "\n",
+    "{", "\"tags\":[", "red", "green", "blue", "]", "0.125", "true",
+    "2026-10-18T00:00:00Z", "INFO ", "request handled in ", "ms",
+};
+#define _NUM_PIECES (sizeof(_pieces) / sizeof(_pieces[0]))
+
+/*
+ * _LegacyString -- RedString as it was before it tracked capacity: every
+ * append reallocs to the exact new length and measures the piece twice.
+ */
+typedef struct
+{
+    char *data;
+    unsigned length;
+} _LegacyString;
+
+static void _Legacy_AppendChars(_LegacyString *s, const char *pAppend)
+{
+    unsigned sumLength;
+    sumLength = s->length + strlen(pAppend);
+    s->data = realloc(s->data, sumLength + 1);
+    memcpy(&s->data[s->length], pAppend, strlen(pAppend));
+    s->data[sumLength] = 0;
+    s->length = sumLength;
+}
+
+typedef enum
+{
+    _APPEND_LEGACY,
+    _APPEND_CHARS,
+    _APPEND_LENGTH,
+    _APPEND_RESERVED,
+    _APPEND_NUM_MODES
+} _AppendModeEnum;
+
+/*
+ * append -- Build a string of <targetMb> megabytes from small pieces.
+ * legacy appends with the exact-size realloc of the old RedString_AppendChars;
+ * chars and length use RedString_AppendChars and RedString_AppendLength on
+ * the geometrically growing buffer; reserved calls RedString_Reserve first.
+ */
+static void _BenchAppend(unsigned targetMb)
+{
+    static const char *names[_APPEND_NUM_MODES] = {"legacy", "chars", "length", "reserved"};
+    unsigned lengths[_NUM_PIECES];
+    unsigned target = targetMb * 1000000u;
+    unsigned i, numAppends, mode, expected = 0;
+    unsigned long allocations;
+    _LegacyString legacy;
+    RedString s;
+    double start, elapsed;
+    char metric[32];
+
+    for (i = 0; i < _NUM_PIECES; i++)
+        lengths[i] = strlen(_pieces[i]);
+
+    for (mode = 0; mode < _APPEND_NUM_MODES; mode++)
+    {
+        numAppends = 0;
+        legacy.data = malloc(1);
+        legacy.data[0] = 0;
+        legacy.length = 0;
+        s = RedString_New(NULL);
+        allocations = _allocations;
+        start = _Now();
+        switch (mode)
+        {
+            case _APPEND_LEGACY:
+                for (i = 0; legacy.length < target; i++, numAppends++)
+                    _Legacy_AppendChars(&legacy, _pieces[i % _NUM_PIECES]);
+                break;
+            case _APPEND_CHARS:
+                for (i = 0; RedString_Length(s) < target; i++, numAppends++)
+                    RedString_AppendChars(s, _pieces[i % _NUM_PIECES]);
+                break;
+            case _APPEND_RESERVED:
+                RedString_Reserve(s, target + 32);
+                /* fall through */
+            case _APPEND_LENGTH:
+                for (i = 0; RedString_Length(s) < target; i++, numAppends++)
+                    RedString_AppendLength(s, _pieces[i % _NUM_PIECES], lengths[i % _NUM_PIECES]);
+                break;
+        }
+        elapsed = _Now() - start;
+        allocations = _allocations - allocations;
+
+        _Report("append", names[mode], targetMb / elapsed, "MB/s");
+        snprintf(metric, sizeof(metric), "%s_per_append", names[mode]);
+        _Report("append", metric, elapsed / numAppends * 1e9, "ns");
+        if (_HAVE_ALLOCATION_COUNT)
+        {
+            snprintf(metric, sizeof(metric), "%s_reallocs", names[mode]);
+            _Report("append", metric, allocations, "");
+        }
+        if (mode == _APPEND_LEGACY)
+            expected = legacy.length;
+        else if (RedString_Length(s) != expected || memcmp(RedString_GetChars(s), _pieces[0], lengths[0]))
+            fprintf(stderr, "append: %s built a different string\n", names[mode]);
+        RedString_Free(s);
+        free(legacy.data);
+    }
+}
+
+typedef struct
+{
+    const char *name;
+    void (*fnRun)(unsigned size);
+} _Benchmark;
+
+static const _Benchmark _benchmarks[] =
+{
+    {"append", _BenchAppend},
+};
+
+int main(int argc, const char *argv[])
+{
+    unsigned i;
+    unsigned size = 100;
+
+    if (argc > 1 && !strcmp(argv[1], "--ndjson"))
+    {
+        _ndjson = true;
+        argv++;
+        argc--;
+    }
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s [--ndjson] <benchmark> [size]\nBenchmarks:", argv[0]);
+        for (i = 0; i < sizeof(_benchmarks) / sizeof(_benchmarks[0]); i++)
+            fprintf(stderr, " %s", _benchmarks[i].name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+    if (argc > 2)
+        size = (unsigned)strtoul(argv[2], NULL, 10);
+
+    for (i = 0; i < sizeof(_benchmarks) / sizeof(_benchmarks[0]); i++)
+    {
+        if (!strcmp(argv[1], _benchmarks[i].name))
+        {
+            _benchmarks[i].fnRun(size);
+            return 0;
+        }
+    }
+    fprintf(stderr, "Unknown benchmark '%s'\n", argv[1]);
+    return 1;
+}
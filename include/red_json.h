@@ -23,6 +23,9 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 typedef enum
 {
@@ -35,21 +38,42 @@ typedef enum
     RED_JSON_VALUE_TYPE_NULL,
 } RedJsonValueTypeEnum;
 
+/*
+ * RedJsonNumberTypeEnum - How a number value is stored.  Integers written
+ *      without a fraction or exponent are kept exactly if they fit in 64
+ *      bits; everything else is a double.
+ */
+typedef enum
+{
+    RED_JSON_NUMBER_DOUBLE,
+    RED_JSON_NUMBER_INT64,
+    RED_JSON_NUMBER_UINT64,
+} RedJsonNumberTypeEnum;
+
 typedef struct RedJsonObject_t * RedJsonObject;
 
 typedef struct RedJsonArray_t * RedJsonArray;
 
 typedef struct RedJsonValue_t * RedJsonValue;
 
+typedef struct RedJsonKey_t * RedJsonKey;
+
+typedef struct RedJsonKeyTable_t * RedJsonKeyTable;
+
 RedJsonValue RedJsonValue_FromString(const char * sz); /* String is copied */
 RedJsonValue RedJsonValue_FromNumber(double val);
+RedJsonValue RedJsonValue_FromInt64(int64_t val);
+RedJsonValue RedJsonValue_FromUint64(uint64_t val);
 RedJsonValue RedJsonValue_FromObject(RedJsonObject jsonObj);
 RedJsonValue RedJsonValue_FromArray(RedJsonArray jsonArray);
 RedJsonValue RedJsonValue_FromBoolean(bool val);
 RedJsonValue RedJsonValue_Null();
 
 char * RedJsonValue_GetString(RedJsonValue jsonVal); /* String is copied */
-double RedJsonValue_GetNumber(RedJsonValue jsonVal);
+double RedJsonValue_GetNumber(RedJsonValue jsonVal); /* Integers are converted */
+int64_t RedJsonValue_GetInt64(RedJsonValue jsonVal); /* Saturates; doubles are truncated */
+uint64_t RedJsonValue_GetUint64(RedJsonValue jsonVal); /* Saturates; doubles are truncated */
+RedJsonNumberTypeEnum RedJsonValue_GetNumberType(RedJsonValue jsonVal);
 RedJsonObject RedJsonValue_GetObject(RedJsonValue jsonVal);
 RedJsonArray RedJsonValue_GetArray(RedJsonValue jsonVal);
 bool RedJsonValue_GetBoolean(RedJsonValue jsonVal);
@@ -67,6 +91,8 @@ void RedJsonObject_Set(RedJsonObject jsonObj, const char * szKey, RedJsonValue j
 void RedJsonObject_SetNull(RedJsonObject jsonObj, const char * szKey);
 void RedJsonObject_SetString(RedJsonObject jsonObj, const char * szKey, const char *szVal);
 void RedJsonObject_SetNumber(RedJsonObject jsonObj, const char * szKey, double val);
+void RedJsonObject_SetInt64(RedJsonObject jsonObj, const char * szKey, int64_t val);
+void RedJsonObject_SetUint64(RedJsonObject jsonObj, const char * szKey, uint64_t val);
 void RedJsonObject_SetObject(RedJsonObject jsonObj, const char * szKey, RedJsonObject jsonVal);
 void RedJsonObject_SetArray(RedJsonObject jsonObj, const char * szKey, RedJsonArray jsonArray);
 void RedJsonObject_SetBoolean(RedJsonObject jsonObj, const char * szKey, bool val);
@@ -75,6 +101,8 @@ RedJsonValue RedJsonObject_Get(RedJsonObject jsonObj, const char * szKey);
 RedJsonValueTypeEnum RedJsonObject_GetType(RedJsonObject jsonObj, const char * szKey);
 char * RedJsonObject_GetString(RedJsonObject jsonObj, const char * szKey);
 double RedJsonObject_GetNumber(RedJsonObject jsonObj, const char * szKey);
+int64_t RedJsonObject_GetInt64(RedJsonObject jsonObj, const char * szKey);
+uint64_t RedJsonObject_GetUint64(RedJsonObject jsonObj, const char * szKey);
 RedJsonObject RedJsonObject_GetObject(RedJsonObject jsonObj, const char * szKey);
 RedJsonArray RedJsonObject_GetArray(RedJsonObject jsonObj, const char * szKey);
 bool RedJsonObject_GetBoolean(RedJsonObject jsonObj, const char * szKey);
@@ -90,9 +118,151 @@ void RedJsonObject_Unset(RedJsonObject jsonObj, const char * szKey);
 bool RedJsonObject_HasKey(RedJsonObject jsonObj, const char * szKey);
 
 unsigned RedJsonObject_NumItems(RedJsonObject jsonObj);
+
+/*
+ * RedJsonObject_NewKeysArray - Copy the keys, in insertion order, into a
+ *      NULL-terminated array.  Free it with RedJsonObject_FreeKeysArray.
+ */
 char ** RedJsonObject_NewKeysArray(RedJsonObject jsonObj);
 void RedJsonObject_FreeKeysArray(char **keysArray);
 
+/*
+ * RedJsonObject_GetKeyAt, RedJsonObject_GetValueAt - Member <idx>, from 0 to
+ *      RedJsonObject_NumItems - 1, in insertion order.  Iterates over an
+ *      object without copying its keys; removing a member shifts the ones
+ *      after it down by one.
+ */
+const char * RedJsonObject_GetKeyAt(RedJsonObject jsonObj, unsigned idx);
+RedJsonValue RedJsonObject_GetValueAt(RedJsonObject jsonObj, unsigned idx);
+
+/*
+ *  MEMORY MANAGEMENT
+ *
+ *      Values, objects and arrays are reference counted.  Every function that
+ *      creates one (RedJsonValue_From*, *_New, *_Clone, the parsers) returns
+ *      a single reference owned by the caller.  Storing a value or container
+ *      in another container (Set*, Put, Append*, SetEntry*, and
+ *      RedJsonValue_FromObject / _FromArray) transfers that reference; the
+ *      caller must not release it afterwards.  Every Get* function returns a
+ *      borrowed handle that is valid as long as its parent is; call *_Retain
+ *      to keep it longer.
+ *
+ *      Releasing the last reference frees the item and releases everything
+ *      it contains:
+ *
+ *          RedJsonObject doc = RedJson_Parse(text);
+ *          ...
+ *          RedJsonObject_Release(doc);
+ *
+ *      Reference counts are not atomic; a tree must not be shared between
+ *      threads while any of them retains, releases or modifies it.
+ */
+RedJsonValue RedJsonValue_Retain(RedJsonValue jsonVal);
+void RedJsonValue_Release(RedJsonValue jsonVal); /* NULL is ignored */
+RedJsonObject RedJsonObject_Retain(RedJsonObject jsonObj);
+void RedJsonObject_Release(RedJsonObject jsonObj); /* NULL is ignored */
+RedJsonArray RedJsonArray_Retain(RedJsonArray jsonArray);
+void RedJsonArray_Release(RedJsonArray jsonArray); /* NULL is ignored */
+
+/*
+ * RedJsonObject_Clone, RedJsonArray_Clone - Copy a container in O(members),
+ *      sharing every value with the original.
+ *
+ *      The clone and the original may then be modified independently,
+ *      provided nested containers are reached through the GetMutable*
+ *      functions below.  These copy a nested container on first write if it
+ *      is still shared, so a per-request copy of a large configuration only
+ *      pays for the path down to what it changes:
+ *
+ *          RedJsonObject req = RedJsonObject_Clone(baseConfig);
+ *          RedJsonObject db = RedJsonObject_GetMutableObject(req, "db");
+ *          RedJsonObject_Put(db, "timeout", RedJsonValue_FromInt64(5));
+ *          ...
+ *          RedJsonObject_Release(req);
+ *
+ *      Containers returned by the plain Get* functions may be shared;
+ *      modifying one in place changes every copy.
+ */
+RedJsonObject RedJsonObject_Clone(RedJsonObject jsonObj);
+RedJsonArray RedJsonArray_Clone(RedJsonArray jsonArray);
+
+RedJsonObject RedJsonObject_GetMutableObject(RedJsonObject jsonObj, const char * szKey);
+RedJsonArray RedJsonObject_GetMutableArray(RedJsonObject jsonObj, const char * szKey);
+RedJsonObject RedJsonArray_GetMutableEntryObject(RedJsonArray jsonArray, unsigned idx);
+RedJsonArray RedJsonArray_GetMutableEntryArray(RedJsonArray jsonArray, unsigned idx);
+
+/*
+ * RedJsonObject_Put - Insert or replace the value stored under <szKey>,
+ *      releasing any replaced value.  Unlike RedJsonObject_Set this never
+ *      asserts on duplicate keys.
+ */
+void RedJsonObject_Put(RedJsonObject jsonObj, const char * szKey, RedJsonValue jsonVal);
+
+/*
+ *  KEY INTERNING
+ *
+ *      A RedJsonKeyTable stores each distinct object key once.  Objects built
+ *      by the parsers share their keys instead of copying them per member:
+ *      a million records with the same 20 keys hold 20 key strings.
+ *
+ *      Each parser interns into a table of its own unless one is supplied
+ *      (RedJson_ParseWithKeyTable, RedJsonStreamParser_SetKeyTable).  A
+ *      long-lived table lets hot lookups use a RedJsonKey handle obtained
+ *      once up front:
+ *
+ *          RedJsonKeyTable keys = RedJsonKeyTable_New();
+ *          RedJsonKey idKey = RedJsonKeyTable_Intern(keys, "id");
+ *          ...
+ *          obj = RedJson_ParseWithKeyTable(text, keys);
+ *          val = RedJsonObject_GetByKey(obj, idKey);
+ *
+ *      Keys are reference counted: objects keep their keys alive after the
+ *      table is freed.  A table, like the values built from it, must not be
+ *      used from several threads at once.
+ */
+
+/*
+ * RedJsonKeyTable_New - Create an empty key table.
+ */
+RedJsonKeyTable RedJsonKeyTable_New();
+
+/*
+ * RedJsonKeyTable_Free - Free <table>.  Keys still referenced by objects
+ *      remain valid; RedJsonKey handles obtained from <table> do not.
+ */
+void RedJsonKeyTable_Free(RedJsonKeyTable table);
+
+/*
+ * RedJsonKeyTable_Intern - Get the key handle for <szKey>, adding it to
+ *      <table> if needed.  The handle is valid for the lifetime of <table>.
+ */
+RedJsonKey RedJsonKeyTable_Intern(RedJsonKeyTable table, const char *szKey);
+
+/*
+ * RedJsonKeyTable_NumKeys - Get the number of distinct keys in <table>.
+ */
+unsigned RedJsonKeyTable_NumKeys(RedJsonKeyTable table);
+
+/*
+ * RedJsonKey_GetChars - Get the null-terminated text of <key>.
+ */
+const char * RedJsonKey_GetChars(RedJsonKey key);
+
+/*
+ * RedJsonObject_GetByKey - Like RedJsonObject_Get, but with a key handle.
+ *      Keys interned in the same table as the object's keys compare by
+ *      pointer; keys from any other table still match by content.
+ *
+ *      Returns NULL if there is no such member.
+ */
+RedJsonValue RedJsonObject_GetByKey(RedJsonObject jsonObj, RedJsonKey key);
+
+/*
+ * RedJsonObject_SetByKey - Like RedJsonObject_Set, but shares <key> instead
+ *      of copying a string.
+ */
+void RedJsonObject_SetByKey(RedJsonObject jsonObj, RedJsonKey key, RedJsonValue jsonVal);
+
 RedJsonArray RedJsonArray_New();
 
 unsigned RedJsonArray_NumItems(RedJsonArray hArray);
@@ -100,6 +270,8 @@ unsigned RedJsonArray_NumItems(RedJsonArray hArray);
 void RedJsonArray_Append(RedJsonArray jsonArray, RedJsonValue val);
 void RedJsonArray_AppendString(RedJsonArray jsonArray, char * val);
 void RedJsonArray_AppendNumber(RedJsonArray jsonArray, double val);
+void RedJsonArray_AppendInt64(RedJsonArray jsonArray, int64_t val);
+void RedJsonArray_AppendUint64(RedJsonArray jsonArray, uint64_t val);
 void RedJsonArray_AppendObject(RedJsonArray jsonArray, RedJsonObject val);
 void RedJsonArray_AppendArray(RedJsonArray jsonArray, RedJsonArray val);
 void RedJsonArray_AppendBoolean(RedJsonArray jsonArray, bool val);
@@ -113,9 +285,18 @@ void RedJsonArray_SetEntryArray(RedJsonArray jsonArray, unsigned idx, RedJsonArr
 void RedJsonArray_SetEntryBoolean(RedJsonArray jsonArray, unsigned idx, bool val);
 void RedJsonArray_SetEntryNull(RedJsonArray jsonArray, unsigned idx);
 
+/*
+ * RedJsonArray_GetEntry - Get element <idx> of <jsonArray>, borrowed.
+ *
+ *      Returns NULL if <jsonArray> is packed (see RedJsonArrayStorageEnum),
+ *      since its elements are not stored as values.  The typed getters and
+ *      RedJsonArray_IsEntry* below work on any array.
+ */
 RedJsonValue RedJsonArray_GetEntry(RedJsonArray jsonArray, unsigned idx);
 char * RedJsonArray_GetEntryString(RedJsonArray jsonArray, unsigned idx);
 double RedJsonArray_GetEntryNumber(RedJsonArray jsonArray, unsigned idx);
+int64_t RedJsonArray_GetEntryInt64(RedJsonArray jsonArray, unsigned idx);
+uint64_t RedJsonArray_GetEntryUint64(RedJsonArray jsonArray, unsigned idx);
 RedJsonObject RedJsonArray_GetEntryObject(RedJsonArray jsonArray, unsigned idx);
 RedJsonArray RedJsonArray_GetEntryArray(RedJsonArray jsonArray, unsigned idx);
 bool RedJsonArray_GetEntryBoolean(RedJsonArray jsonArray, unsigned idx);
@@ -127,12 +308,1381 @@ bool RedJsonArray_IsEntryArray(RedJsonArray jsonArray, unsigned idx);
 bool RedJsonArray_IsEntryBoolean(RedJsonArray jsonArray, unsigned idx);
 bool RedJsonArray_IsEntryNull(RedJsonArray jsonArray, unsigned idx);
 
-char * RedJsonValue_ToJsonString(RedJsonValue jsonVal);
-char * RedJsonObject_ToJsonString(RedJsonObject jsonObj);
+/*
+ * RedJsonArrayStorageEnum - How the elements of an array are stored.
+ *
+ *      Arrays of nothing but numbers, or nothing but booleans, are kept
+ *      packed in one contiguous buffer of doubles, int64s or bools instead
+ *      of as one RedJsonValue per element.  RedJson_Parse packs such arrays
+ *      as it reads them, as do RedJsonArray_AppendNumber, _AppendInt64 and
+ *      _AppendBoolean on an empty or already packed array.  Integers go into
+ *      an array of doubles, and turn an array of int64s into one, while they
+ *      convert exactly (up to 2^53 in magnitude); they then read back as
+ *      RED_JSON_NUMBER_DOUBLE.
+ *
+ *      The typed getters, setters and appenders, serialization, Clone,
+ *      Equals, RedJson_Diff and path evaluation work on the packed buffer,
+ *      and reading never modifies the array.  RedJsonArray_GetEntry, which
+ *      hands out a value, returns NULL for a packed array.  The first call
+ *      that replaces or inserts element values (RedJsonArray_Append,
+ *      RedJsonArray_SetEntry, GetMutableEntry*, patch add and remove,
+ *      appending a value of another type...) unpacks the array into
+ *      RED_JSON_ARRAY_STORAGE_VALUES for good.
+ */
+typedef enum
+{
+    RED_JSON_ARRAY_STORAGE_VALUES,
+    RED_JSON_ARRAY_STORAGE_DOUBLES,
+    RED_JSON_ARRAY_STORAGE_INT64S,
+    RED_JSON_ARRAY_STORAGE_BOOLEANS,
+} RedJsonArrayStorageEnum;
+
+RedJsonArrayStorageEnum RedJsonArray_GetStorage(RedJsonArray jsonArray);
+
+/*
+ * RedJsonArray_GetDoubles, RedJsonArray_GetInt64s, RedJsonArray_GetBooleans -
+ *      The contiguous elements of a packed array, RedJsonArray_NumItems of
+ *      them, or NULL if the array is not packed with that type.  The buffer
+ *      is valid until the array is next modified or unpacked.
+ */
+const double * RedJsonArray_GetDoubles(RedJsonArray jsonArray);
+const int64_t * RedJsonArray_GetInt64s(RedJsonArray jsonArray);
+const bool * RedJsonArray_GetBooleans(RedJsonArray jsonArray);
+
+/*
+ * RedJsonArray_AppendDoubles - Append <count> numbers at once; packed if
+ *      the array is empty or already holds doubles.
+ */
+void RedJsonArray_AppendDoubles(RedJsonArray jsonArray, const double *values, unsigned count);
+
+/*
+ * RedJsonFormatEnum - Output layout used by the JSON writer.
+ *
+ *      RED_JSON_FORMAT_COMPACT emits no insignificant whitespace.
+ *
+ *      RED_JSON_FORMAT_PRETTY puts every member and element on its own line,
+ *      indented by two spaces per nesting level.
+ *
+ *      RED_JSON_FORMAT_CBOR emits binary CBOR instead of text (see CBOR
+ *      below).  It is accepted wherever output comes with a length: writers,
+ *      RedJsonValue_WriteJson and RedJsonValue_ToCbor.
+ */
+typedef enum
+{
+    RED_JSON_FORMAT_COMPACT,
+    RED_JSON_FORMAT_PRETTY,
+    RED_JSON_FORMAT_CBOR,
+} RedJsonFormatEnum;
+
+char * RedJsonValue_ToJsonString(RedJsonValue jsonVal); /* Pretty printed */
+char * RedJsonObject_ToJsonString(RedJsonObject jsonObj); /* Pretty printed */
+
+/*
+ * RedJsonValue_ToFormattedJsonString - Serialize <jsonVal>.
+ *
+ *      Output is appended to a single geometrically growing buffer; no
+ *      allocation is made per token.
+ *
+ *      Returns a newly allocated null-terminated string that the caller must
+ *      free, or NULL if memory allocation failed.
+ */
+char * RedJsonValue_ToFormattedJsonString(RedJsonValue jsonVal, RedJsonFormatEnum format);
+char * RedJsonObject_ToFormattedJsonString(RedJsonObject jsonObj, RedJsonFormatEnum format);
+
+/*
+ * RedJsonValue_WriteJson - Serialize <jsonVal> into caller-supplied storage
+ *      without allocating.
+ *
+ *      <buf> receives at most <bufSize> - 1 bytes of output followed by a
+ *          null terminator.  It may be NULL if <bufSize> is 0.
+ *
+ *      Returns the length of the complete output, like snprintf.  A return
+ *      value >= <bufSize> means the output was truncated.
+ */
+size_t RedJsonValue_WriteJson(RedJsonValue jsonVal, RedJsonFormatEnum format, char *buf, size_t bufSize);
+size_t RedJsonObject_WriteJson(RedJsonObject jsonObj, RedJsonFormatEnum format, char *buf, size_t bufSize);
 
-/* TODO: Error reporting */
+/*
+ * RedJson_Parse - Parse <text>, which must hold a single JSON object, into a
+ *      new RedJsonObject.
+ *
+ *      String values are null-terminated C strings, so a \u0000 escape in
+ *      one fails with RED_JSON_ERROR_BAD_ESCAPE rather than cutting the
+ *      string short.  Keys carry their length and may hold it.
+ *
+ *      Returns NULL on failure.  RedJson_ParseWithOptions reports why.
+ */
 RedJsonObject RedJson_Parse(const char *text);
 
+/*
+ * RedJson_ParseWithKeyTable - Like RedJson_Parse, but interns object keys in
+ *      <keys> so that they are shared with other documents parsed with the
+ *      same table and match RedJsonKey handles by pointer.
+ */
+RedJsonObject RedJson_ParseWithKeyTable(const char *text, RedJsonKeyTable keys);
+
+/*
+ * RedJsonErrorEnum - Result codes reported by the JSON parsers.
+ */
+typedef enum
+{
+    RED_JSON_OK = 0,
+    RED_JSON_ERROR_UNEXPECTED_CHAR,
+    RED_JSON_ERROR_UNEXPECTED_END,
+    RED_JSON_ERROR_BAD_NUMBER,          /* malformed, or beyond the range of a double */
+    RED_JSON_ERROR_BAD_STRING,
+    RED_JSON_ERROR_BAD_ESCAPE,
+    RED_JSON_ERROR_ABORTED,
+    RED_JSON_ERROR_OUT_OF_MEMORY,
+    RED_JSON_ERROR_IO,
+    RED_JSON_ERROR_BAD_UTF8,
+    RED_JSON_ERROR_NOT_FOUND,
+    RED_JSON_ERROR_WRONG_TYPE,
+    RED_JSON_ERROR_DEPTH_EXCEEDED,
+    RED_JSON_ERROR_BAD_CBOR,
+    RED_JSON_ERROR_BAD_PATH,
+    RED_JSON_ERROR_TEST_FAILED,
+    RED_JSON_ERROR_DUPLICATE_KEY,
+} RedJsonErrorEnum;
+
+/*
+ * RedJsonError_t - Describes where and why parsing failed.
+ *
+ *      <offset> is the 0-based byte offset of the offending input byte.
+ *      <line> and <column> are 1-based and count bytes, not characters.
+ */
+typedef struct RedJsonError_t
+{
+    RedJsonErrorEnum code;
+    size_t offset;
+    unsigned line;
+    unsigned column;
+} RedJsonError_t;
+
+/*
+ * RedJsonError_ToString - Get a short human readable description of <code>.
+ */
+const char * RedJsonError_ToString(RedJsonErrorEnum code);
+
+/*
+ * RED_JSON_DEFAULT_MAX_DEPTH - Nesting limit used when none is given.
+ */
+#define RED_JSON_DEFAULT_MAX_DEPTH 512
+
+/*
+ * RedJsonDuplicateKeyEnum - What parsing does when an object repeats a key.
+ *      Either way the member keeps the position of the key's first
+ *      occurrence.
+ *
+ *      RED_JSON_DUPLICATE_KEY_LAST_WINS keeps the last value.
+ *
+ *      RED_JSON_DUPLICATE_KEY_FIRST_WINS keeps the first value.  Later ones
+ *      are still checked, then dropped.
+ *
+ *      RED_JSON_DUPLICATE_KEY_ERROR fails with RED_JSON_ERROR_DUPLICATE_KEY
+ *      at the repeated key.
+ */
+typedef enum
+{
+    RED_JSON_DUPLICATE_KEY_LAST_WINS,
+    RED_JSON_DUPLICATE_KEY_FIRST_WINS,
+    RED_JSON_DUPLICATE_KEY_ERROR,
+} RedJsonDuplicateKeyEnum;
+
+typedef struct RedJsonParseOptions_t
+{
+    /*
+     * Deepest allowed nesting of objects and arrays, counting the top-level
+     * object as 1.  0 selects RED_JSON_DEFAULT_MAX_DEPTH.
+     */
+    unsigned maxDepth;
+
+    /* Table to intern object keys in, or NULL for a private table. */
+    RedJsonKeyTable keys;
+
+    /*
+     * RedJson_ParseFile* only: leave string values inside the file mapping
+     * instead of copying each one to the heap (see RedJson_ParseFile).
+     */
+    bool stringViews;
+
+    /* Handling of repeated keys.  Not checked by RedJson_Validate. */
+    RedJsonDuplicateKeyEnum duplicateKeys;
+} RedJsonParseOptions_t;
+
+/*
+ * RedJson_ParseWithOptions - Parse the <length> bytes at <text>, which must
+ *      hold a single JSON object.
+ *
+ *      The parser keeps its own stack, so deeply nested input fails cleanly
+ *      with RED_JSON_ERROR_DEPTH_EXCEEDED instead of exhausting the C stack.
+ *
+ *      <pOptions> may be NULL to use defaults.
+ *
+ *      Returns the new object, or NULL on failure.  If <pError> is non-NULL
+ *      it then receives the reason and position.  Nothing parsed before the
+ *      failure is leaked.
+ */
+RedJsonObject RedJson_ParseWithOptions(
+        const char *text,
+        size_t length,
+        const RedJsonParseOptions_t *pOptions,
+        RedJsonError_t *pError);
+
+/*
+ * RedJson_ParseFile, RedJson_ParseFileWithOptions - Parse the JSON object in
+ *      the file at <path>.
+ *
+ *      The file is memory mapped and parsed in place, so it is neither read
+ *      into a buffer nor copied, and needs no terminator.  The mapping is
+ *      populated up front and advised for sequential access.
+ *
+ *      By default every string is copied out and the file is unmapped
+ *      before returning.  With <pOptions>->stringViews the mapping is made
+ *      private and writable instead; strings are decoded and
+ *      null-terminated in place (the file itself is never modified) and
+ *      string values point into the mapping, which stays mapped until the
+ *      last of them is released.  This saves one allocation per string, at
+ *      the cost of keeping every page of the file that holds a string
+ *      resident as a private copy.
+ *
+ *      Returns NULL on failure, including RED_JSON_ERROR_IO if the file
+ *      cannot be opened or mapped.
+ */
+RedJsonObject RedJson_ParseFile(const char *path);
+RedJsonObject RedJson_ParseFileWithOptions(
+        const char *path,
+        const RedJsonParseOptions_t *pOptions,
+        RedJsonError_t *pError);
+
+/*
+ *  VALIDATION AND REFORMATTING
+ *
+ *      These functions work straight on the text and build no DOM: one pass
+ *      checks the input against the same grammar and limits as
+ *      RedJson_ParseWithOptions and copies its tokens out as they are
+ *      written.  Strings keep their escapes and numbers their spelling;
+ *      comments are dropped.  Apart from the output, they allocate nothing
+ *      unless <maxDepth> is above RED_JSON_DEFAULT_MAX_DEPTH.
+ */
+
+/*
+ * RedJson_Validate - Check whether RedJson_ParseWithOptions would accept the
+ *      <length> bytes at <text> with <pOptions>, which may be NULL.  Only
+ *      <pOptions>->maxDepth is used.
+ *
+ *      Returns RED_JSON_OK, or the code RedJson_ParseWithOptions would fail
+ *      with, also reported through <pError> if it is non-NULL.
+ */
+RedJsonErrorEnum RedJson_Validate(
+        const char *text,
+        size_t length,
+        const RedJsonParseOptions_t *pOptions,
+        RedJsonError_t *pError);
+
+/*
+ * RedJson_Minify - Validate the <length> bytes at <text> and write them to
+ *      <out> without insignificant whitespace.
+ *
+ *      <out> must have room for <length> + 1 bytes, and may be <text> itself
+ *      to minify in place.  The output is null-terminated and its length is
+ *      stored in *<pOutLength> if that is non-NULL.
+ *
+ *      Returns RED_JSON_OK on success.  On failure the contents of <out> are
+ *      undefined; when minifying in place the line and column in <pError>
+ *      are then counted over the partly rewritten text.
+ */
+RedJsonErrorEnum RedJson_Minify(
+        const char *text,
+        size_t length,
+        char *out,
+        size_t *pOutLength,
+        RedJsonError_t *pError);
+
+/*
+ * RedJson_Prettify - Validate the <length> bytes at <text> and lay them out
+ *      as RED_JSON_FORMAT_PRETTY does.
+ *
+ *      Returns a newly allocated null-terminated string that the caller must
+ *      free, or NULL if the text is invalid.
+ */
+char * RedJson_Prettify(const char *text, size_t length, RedJsonError_t *pError);
+
+/*
+ *  REUSABLE DOCUMENTS
+ *
+ *      A RedJsonDocument parses one message after another into the same
+ *      storage.  Each parse first recycles the previous tree: its values,
+ *      objects and arrays go to free lists with their member, index and
+ *      item storage intact, string text lives in large chunks that are
+ *      rewound rather than freed, and keys stay interned in the document's
+ *      key table.  Once the document has seen its largest message, parsing
+ *      a message of the same shape performs no allocations at all:
+ *
+ *          RedJsonDocument doc = RedJsonDocument_New();
+ *          while (_NextMessage(&text, &length))
+ *          {
+ *              RedJsonObject msg = RedJsonDocument_Parse(doc, text, length, NULL, &error);
+ *              ...
+ *          }
+ *          RedJsonDocument_Free(doc);
+ *
+ *      The parsed object is owned by the document and is valid until the
+ *      next RedJsonDocument_Parse, _Reset or _Free.  Anything retained with
+ *      *_Retain before then is left alone and stays valid until it is
+ *      released as usual; only what nobody else holds is recycled.  Strings
+ *      that are retained keep their whole chunk alive.
+ *
+ *      A document keeps the storage of the largest message it has parsed
+ *      until it is freed.  Strings with escapes and keys beyond the key
+ *      table's limit are still allocated individually.
+ */
+typedef struct RedJsonDocument_t * RedJsonDocument;
+
+RedJsonDocument RedJsonDocument_New(void);
+void RedJsonDocument_Free(RedJsonDocument doc); /* NULL is ignored */
+
+/*
+ * RedJsonDocument_Parse - Recycle the document's previous object, then
+ *      parse the <length> bytes at <text> as RedJson_ParseWithOptions does.
+ *
+ *      Keys are interned in <pOptions>->keys if given, otherwise in the
+ *      document's own table.  <pOptions>->stringViews is ignored.
+ *
+ *      Returns the document's new object (borrowed, see above), or NULL on
+ *      failure.
+ */
+RedJsonObject RedJsonDocument_Parse(
+        RedJsonDocument doc,
+        const char *text,
+        size_t length,
+        const RedJsonParseOptions_t *pOptions,
+        RedJsonError_t *pError);
+
+/*
+ * RedJsonDocument_Reset - Recycle the document's object without parsing a
+ *      new one, e.g. to drop a large message early.
+ */
+void RedJsonDocument_Reset(RedJsonDocument doc);
+
+/*
+ * RedJsonDocument_GetRoot - Get the object parsed last, or NULL.
+ */
+RedJsonObject RedJsonDocument_GetRoot(RedJsonDocument doc);
+
+/*
+ *  ON-DEMAND ACCESS
+ *
+ *      A RedJsonCursor_t points at one value inside a JSON text held in
+ *      memory, without parsing anything up front.  Navigating from a cursor
+ *      (RedJsonCursor_Find, _Index, _First/_Next) parses only the keys and
+ *      punctuation along the way; sibling values that are passed over are
+ *      skipped with a fast scan that only matches brackets and string
+ *      quotes.  Scalars are parsed and validated when they are extracted.
+ *
+ *      This makes pulling a few fields out of a large document cost
+ *      roughly a memchr over the bytes before them, instead of a full
+ *      parse.  The price is that errors in skipped parts of the document go
+ *      unnoticed.
+ *
+ *      Cursors are small values that live on the stack and need no
+ *      cleanup.  They stay valid as long as the text they point into.
+ *
+ *      Example:
+ *
+ *          RedJsonCursor_t doc, route, service;
+ *          char *name;
+ *          RedJsonCursor_Init(&doc, body, bodyLength);
+ *          if (!RedJsonCursor_Find(&doc, "route", &route)
+ *                  && !RedJsonCursor_Find(&route, "service", &service)
+ *                  && !RedJsonCursor_GetString(&service, &name))
+ *          {
+ *              ...
+ *              free(name);
+ *          }
+ *
+ *      Functions returning RedJsonErrorEnum report RED_JSON_ERROR_NOT_FOUND
+ *      for a missing member or index, RED_JSON_ERROR_WRONG_TYPE when the
+ *      value is not of the requested type, and the usual parse errors for
+ *      malformed input.
+ */
+typedef struct RedJsonCursor_t
+{
+    const char *_pos;       /* first byte of the value */
+    const char *_end;       /* end of the text */
+    const char *_key;       /* opening quote of the member's key, or NULL */
+} RedJsonCursor_t;
+
+/*
+ * RedJsonCursor_Init - Point <pCursor> at the top-level value of the
+ *      <length> byte JSON <text>.  <text> need not be null-terminated.
+ */
+RedJsonErrorEnum RedJsonCursor_Init(RedJsonCursor_t *pCursor, const char *text, size_t length);
+
+/*
+ * RedJsonCursor_GetType - Get the type of the value at <pCursor>, judged by
+ *      its first byte.
+ */
+RedJsonValueTypeEnum RedJsonCursor_GetType(const RedJsonCursor_t *pCursor);
+
+/*
+ * RedJsonCursor_Find - Point <pMember> at the value of member <szKey> of the
+ *      object at <pCursor>.  If the key appears more than once, the first
+ *      occurrence wins.
+ */
+RedJsonErrorEnum RedJsonCursor_Find(const RedJsonCursor_t *pCursor, const char *szKey, RedJsonCursor_t *pMember);
+
+/*
+ * RedJsonCursor_Index - Point <pElement> at element <idx> of the array at
+ *      <pCursor>.  Each call scans from the start of the array; use
+ *      RedJsonCursor_First/_Next to walk all elements.
+ */
+RedJsonErrorEnum RedJsonCursor_Index(const RedJsonCursor_t *pCursor, unsigned idx, RedJsonCursor_t *pElement);
+
+/*
+ * RedJsonCursor_First - Point <pChild> at the first element of the array, or
+ *      the first member value of the object, at <pCursor>.
+ *
+ *      Returns RED_JSON_ERROR_NOT_FOUND if the container is empty.
+ */
+RedJsonErrorEnum RedJsonCursor_First(const RedJsonCursor_t *pCursor, RedJsonCursor_t *pChild);
+
+/*
+ * RedJsonCursor_Next - Advance <pChild> to its next sibling.
+ *
+ *      Returns RED_JSON_ERROR_NOT_FOUND after the last one.
+ */
+RedJsonErrorEnum RedJsonCursor_Next(RedJsonCursor_t *pChild);
+
+/*
+ * RedJsonCursor_GetKey - Get the key of the object member at <pCursor> as a
+ *      newly allocated string that the caller must free.  Fails with
+ *      RED_JSON_ERROR_BAD_ESCAPE if the key holds a \u0000 escape.
+ */
+RedJsonErrorEnum RedJsonCursor_GetKey(const RedJsonCursor_t *pCursor, char **pszKey);
+
+/*
+ * RedJsonCursor_GetString - Get the string at <pCursor>, unescaped, as a
+ *      newly allocated string that the caller must free.  Fails with
+ *      RED_JSON_ERROR_BAD_ESCAPE if the string holds a \u0000 escape, which
+ *      a C string cannot carry.
+ */
+RedJsonErrorEnum RedJsonCursor_GetString(const RedJsonCursor_t *pCursor, char **psz);
+
+/*
+ * RedJsonCursor_GetNumber, _GetInt64, _GetUint64 - Get the number at
+ *      <pCursor>.  The integer versions return RED_JSON_ERROR_WRONG_TYPE
+ *      unless the number is an integer that fits the requested type exactly.
+ */
+RedJsonErrorEnum RedJsonCursor_GetNumber(const RedJsonCursor_t *pCursor, double *pVal);
+RedJsonErrorEnum RedJsonCursor_GetInt64(const RedJsonCursor_t *pCursor, int64_t *pVal);
+RedJsonErrorEnum RedJsonCursor_GetUint64(const RedJsonCursor_t *pCursor, uint64_t *pVal);
+
+/*
+ * RedJsonCursor_GetBoolean - Get the boolean at <pCursor>.
+ */
+RedJsonErrorEnum RedJsonCursor_GetBoolean(const RedJsonCursor_t *pCursor, bool *pVal);
+
+/*
+ * RedJsonCursor_IsNull - Determine if the value at <pCursor> is null.
+ */
+bool RedJsonCursor_IsNull(const RedJsonCursor_t *pCursor);
+
+/*
+ * RedJsonCursor_GetRaw - Get the span of text making up the value at
+ *      <pCursor>, without validating it.
+ */
+RedJsonErrorEnum RedJsonCursor_GetRaw(const RedJsonCursor_t *pCursor, const char **pStart, size_t *pLength);
+
+/*
+ * RedJsonCursor_GetValue - Fully parse and validate the value at <pCursor>
+ *      into a new RedJsonValue.
+ */
+RedJsonErrorEnum RedJsonCursor_GetValue(const RedJsonCursor_t *pCursor, RedJsonValue *pVal);
+
+/*
+ *  TAPE DOCUMENTS
+ *
+ *      RedJsonTape is a read-only parsed document stored as one flat array
+ *      of 64-bit words instead of a tree of separately allocated values.
+ *      Values appear on the tape in document order:
+ *
+ *          - '{' and '[' words hold the member count and the position just
+ *            past the matching '}' or ']' word, so a whole container is
+ *            skipped in one step.
+ *          - numbers are a tag word followed by the int64, uint64 or double
+ *            itself.
+ *          - strings and keys hold an offset into a single side buffer of
+ *            null-terminated strings.
+ *          - true, false and null are a single word.
+ *
+ *      Walking a document therefore reads memory sequentially, and the whole
+ *      document costs two allocations.  Values are reached through
+ *      RedJsonTapeRef_t, a small stack value that stays valid as long as the
+ *      tape.  Member lookup is a linear scan of the object, so keep a
+ *      RedJsonValue DOM for objects that are searched by key many times.
+ *
+ *      Example:
+ *
+ *          RedJsonTape tape = RedJsonTape_Parse(text, length, &error);
+ *          RedJsonTapeRef_t root = RedJsonTape_Root(tape), item;
+ *          bool more;
+ *          for (more = RedJsonTapeRef_First(&root, &item); more; more = RedJsonTapeRef_Next(&item))
+ *              total += RedJsonTapeRef_GetNumber(&item);
+ *          RedJsonTape_Free(tape);
+ */
+typedef struct RedJsonTape_t * RedJsonTape;
+
+typedef struct RedJsonTapeRef_t
+{
+    RedJsonTape _tape;
+    uint32_t _idx;          /* tape word of the value */
+    uint32_t _key;          /* tape word of the member's key, or 0 */
+} RedJsonTapeRef_t;
+
+/*
+ * RedJsonTape_Parse - Parse the single JSON value in <text> into a tape.
+ *
+ *      Accepts the same input as RedJsonStreamParser except that exactly one
+ *      top-level value is allowed.
+ *
+ *      Returns NULL on failure, with details in *<pError> if it is not NULL.
+ */
+RedJsonTape RedJsonTape_Parse(const char *text, size_t length, RedJsonError_t *pError);
+
+/*
+ * RedJsonTape_Free - Free <tape>.  Does nothing if <tape> is NULL.
+ */
+void RedJsonTape_Free(RedJsonTape tape);
+
+/*
+ * RedJsonTape_MemoryUsage - Get the number of bytes allocated for <tape>.
+ */
+size_t RedJsonTape_MemoryUsage(RedJsonTape tape);
+
+/*
+ * RedJsonTape_Root - Get a reference to the top-level value of <tape>.
+ */
+RedJsonTapeRef_t RedJsonTape_Root(RedJsonTape tape);
+
+/*
+ * RedJsonTapeRef_GetType - Get the type of the value at <pRef>.
+ */
+RedJsonValueTypeEnum RedJsonTapeRef_GetType(const RedJsonTapeRef_t *pRef);
+
+/*
+ * RedJsonTapeRef_NumItems - Get the number of members or elements of the
+ *      object or array at <pRef>.
+ */
+unsigned RedJsonTapeRef_NumItems(const RedJsonTapeRef_t *pRef);
+
+/*
+ * RedJsonTapeRef_First, RedJsonTapeRef_Next - Iterate over the members or
+ *      elements of the object or array at <pRef>, in document order.
+ *
+ *      Both return false, leaving <pChild> unchanged, when there are no more
+ *      children.
+ */
+bool RedJsonTapeRef_First(const RedJsonTapeRef_t *pRef, RedJsonTapeRef_t *pChild);
+bool RedJsonTapeRef_Next(RedJsonTapeRef_t *pChild);
+
+/*
+ * RedJsonTapeRef_Find - Point <pMember> at the value of member <szKey> of the
+ *      object at <pRef>.  If the key occurs more than once, the last
+ *      occurrence wins, as in RedJson_Parse.
+ *
+ *      Returns false if there is no such member.
+ */
+bool RedJsonTapeRef_Find(const RedJsonTapeRef_t *pRef, const char *szKey, RedJsonTapeRef_t *pMember);
+
+/*
+ * RedJsonTapeRef_Index - Point <pElement> at element <idx> of the array at
+ *      <pRef>.  Earlier elements are stepped over, so this is O(idx).
+ *
+ *      Returns false if <idx> is out of range.
+ */
+bool RedJsonTapeRef_Index(const RedJsonTapeRef_t *pRef, unsigned idx, RedJsonTapeRef_t *pElement);
+
+/*
+ * RedJsonTapeRef_GetKey - Get the key of the object member at <pRef>, or NULL
+ *      if <pRef> is not an object member.  The string belongs to the tape.
+ */
+const char * RedJsonTapeRef_GetKey(const RedJsonTapeRef_t *pRef);
+
+/*
+ * RedJsonTapeRef_GetString - Get the string at <pRef>.  The string belongs to
+ *      the tape.  RedJsonTapeRef_GetStringLength gets its length in bytes,
+ *      which may include embedded nulls.
+ */
+const char * RedJsonTapeRef_GetString(const RedJsonTapeRef_t *pRef);
+size_t RedJsonTapeRef_GetStringLength(const RedJsonTapeRef_t *pRef);
+
+/*
+ * Scalar accessors.  Numbers convert like the RedJsonValue accessors.
+ */
+double RedJsonTapeRef_GetNumber(const RedJsonTapeRef_t *pRef);
+int64_t RedJsonTapeRef_GetInt64(const RedJsonTapeRef_t *pRef);
+uint64_t RedJsonTapeRef_GetUint64(const RedJsonTapeRef_t *pRef);
+RedJsonNumberTypeEnum RedJsonTapeRef_GetNumberType(const RedJsonTapeRef_t *pRef);
+bool RedJsonTapeRef_GetBoolean(const RedJsonTapeRef_t *pRef);
+bool RedJsonTapeRef_IsNull(const RedJsonTapeRef_t *pRef);
+
+/*
+ *  PATH QUERIES
+ *
+ *      A RedJsonPath is a query compiled once and evaluated against any
+ *      number of documents, DOM or tape.  Compiling splits the path into
+ *      steps and hashes every member name up front, so evaluation does no
+ *      string parsing and no rehashing.
+ *
+ *      Two notations are accepted:
+ *
+ *          JSON Pointer (RFC 6901), e.g. "/data/items/0/price".  "~0" and
+ *          "~1" stand for '~' and '/'.  A numeric segment selects an array
+ *          element or an object member, whichever the value is.  As an
+ *          extension a segment of exactly "*" selects every member or
+ *          element.  The empty path selects the root.
+ *
+ *          JSONPath (RFC 9535), restricted to singular selectors:
+ *          "$.data.items[*].price", "$['a b'][-1]", "$.items[1:10:2]".
+ *          Supported are .name, .*, ['name'] and ["name"] with JSON
+ *          escapes, [*], [index] (negative counts from the end) and
+ *          [start:end:step] slices.  Unions, filters and the ".."
+ *          descendant operator fail to compile with RED_JSON_ERROR_BAD_PATH.
+ *
+ *      Example, on the document {"items": [{"id": 7}, {"id": 9}, {"name": "x"}]}:
+ *
+ *          RedJsonPath ids = RedJsonPath_Compile("$.items[*].id", NULL);
+ *          n = RedJsonPath_EvalObject(ids, doc, _PrintId, NULL);
+ *          RedJsonPath_Free(ids);
+ *
+ *      calls _PrintId with 7, then 9, and returns 2.  A path is immutable
+ *      once compiled and may be used by several threads at once.
+ */
+typedef struct RedJsonPath_t * RedJsonPath;
+
+/*
+ * RedJsonPathCallback, RedJsonPathTapeCallback - Receive one match, in
+ *      document order (slices with a negative step go backwards).  The value
+ *      is borrowed from the document; an element of a packed array (see
+ *      RedJsonArrayStorageEnum) is a temporary that is only valid until the
+ *      callback returns.  Return false to stop evaluating.
+ */
+typedef bool (*RedJsonPathCallback)(RedJsonValue value, void *userData);
+typedef bool (*RedJsonPathTapeCallback)(const RedJsonTapeRef_t *pRef, void *userData);
+
+/*
+ * RedJsonPath_Compile - Compile <szPath>.
+ *
+ *      Returns NULL if <szPath> is not a valid path, with the offending
+ *      offset in *<pError> if it is not NULL.
+ */
+RedJsonPath RedJsonPath_Compile(const char *szPath, RedJsonError_t *pError);
+
+/*
+ * RedJsonPath_Free - Free <path>.  Does nothing if <path> is NULL.
+ */
+void RedJsonPath_Free(RedJsonPath path);
+
+/*
+ * RedJsonPath_Eval, RedJsonPath_EvalObject, RedJsonPath_EvalTape - Call
+ *      <fnOnMatch> (which may be NULL) for every value that <path> selects
+ *      under <root>.
+ *
+ *      Returns the number of matches delivered, including the one whose
+ *      callback stopped evaluation.
+ */
+unsigned RedJsonPath_Eval(RedJsonPath path, RedJsonValue root, RedJsonPathCallback fnOnMatch, void *userData);
+unsigned RedJsonPath_EvalObject(RedJsonPath path, RedJsonObject root, RedJsonPathCallback fnOnMatch, void *userData);
+unsigned RedJsonPath_EvalTape(
+        RedJsonPath path,
+        const RedJsonTapeRef_t *pRoot,
+        RedJsonPathTapeCallback fnOnMatch,
+        void *userData);
+
+/*
+ * RedJsonPath_GetFirst - Get the first value that <path> selects under
+ *      <root>, or NULL if there is none.  The value is borrowed.  An empty
+ *      path, which selects <root> itself, returns NULL, as does a first
+ *      match inside a packed array (see RedJsonArray_GetEntry); use
+ *      RedJsonPath_EvalObject to read those.
+ */
+RedJsonValue RedJsonPath_GetFirst(RedJsonPath path, RedJsonObject root);
+
+/*
+ * RedJsonPath_GetFirstTape - Point <pMatch> at the first value that <path>
+ *      selects under <pRoot>.
+ *
+ *      Returns false if there is none.
+ */
+bool RedJsonPath_GetFirstTape(RedJsonPath path, const RedJsonTapeRef_t *pRoot, RedJsonTapeRef_t *pMatch);
+
+/*
+ *  STREAMING (PUSH) PARSER
+ *
+ *      RedJsonStreamParser accepts a JSON document in arbitrarily sized chunks
+ *      as they arrive (from a socket, pipe, etc), so the whole document never
+ *      needs to be buffered.  All lexer and grammar state is carried across
+ *      chunk boundaries, including partial strings, numbers, escape sequences,
+ *      multi-byte UTF-8 characters and literals.  String contents must be
+ *      valid UTF-8; anything else fails with RED_JSON_ERROR_BAD_UTF8.
+ *
+ *      The input may contain any number of whitespace-separated top-level
+ *      values.
+ *
+ *      Results are delivered in one of two ways:
+ *
+ *          - SAX mode (RedJsonStreamParser_New): a callback is invoked for
+ *            every structural event.
+ *
+ *          - DOM mode (RedJsonStreamParser_NewDom): values found at a chosen
+ *            nesting depth are built as RedJsonValue subtrees and handed to a
+ *            callback as soon as they are complete.  Only the subtree under
+ *            construction is held in memory, so streaming the elements of a
+ *            huge top-level array (depth 1) runs in constant memory.
+ *
+ *      Example:
+ *
+ *          parser = RedJsonStreamParser_NewDom(1, OnRecord, NULL);
+ *          while ((n = read(fd, buf, sizeof(buf))) > 0)
+ *          {
+ *              if (RedJsonStreamParser_Feed(parser, buf, n) != RED_JSON_OK)
+ *                  break;
+ *          }
+ *          err = RedJsonStreamParser_Finish(parser);
+ *          RedJsonStreamParser_Free(parser);
+ */
+typedef struct RedJsonStreamParser_t * RedJsonStreamParser;
+
+typedef enum
+{
+    RED_JSON_EVENT_BEGIN_OBJECT,
+    RED_JSON_EVENT_END_OBJECT,
+    RED_JSON_EVENT_BEGIN_ARRAY,
+    RED_JSON_EVENT_END_ARRAY,
+    RED_JSON_EVENT_KEY,
+    RED_JSON_EVENT_STRING,
+    RED_JSON_EVENT_NUMBER,
+    RED_JSON_EVENT_BOOLEAN,
+    RED_JSON_EVENT_NULL,
+} RedJsonEventEnum;
+
+/*
+ * RedJsonEvent_t - A single SAX event.
+ *
+ *      <depth> is the number of containers enclosing the event.  A
+ *          BEGIN/END pair has the depth of the container itself; KEY events
+ *          and member values have that depth plus one.
+ *
+ *      <sz> and <length> hold the decoded, null-terminated text for KEY and
+ *          STRING events.  The buffer is only valid during the callback.
+ *
+ *      <number> and <boolean> hold the payload of NUMBER and BOOLEAN events.
+ *          <number> is always the nearest double.  If <numberType> is
+ *          RED_JSON_NUMBER_INT64 or RED_JSON_NUMBER_UINT64, <int64> or
+ *          <uint64> also holds the exact integer.
+ */
+typedef struct RedJsonEvent_t
+{
+    RedJsonEventEnum type;
+    unsigned depth;
+    const char *sz;
+    size_t length;
+    double number;
+    RedJsonNumberTypeEnum numberType;
+    int64_t int64;
+    uint64_t uint64;
+    bool boolean;
+} RedJsonEvent_t;
+
+/*
+ * RedJsonEventCallback - SAX callback.  Return false to stop parsing, in
+ *      which case the current Feed call reports RED_JSON_ERROR_ABORTED.
+ */
+typedef bool (*RedJsonEventCallback)(const RedJsonEvent_t *event, void *userData);
+
+/*
+ * RedJsonSubtreeCallback - DOM mode callback.
+ *
+ *      <value> is the completed subtree.  It is owned by the parser and is
+ *          released as soon as the callback returns; call
+ *          RedJsonValue_Retain to keep it.
+ *
+ *      <szKey> is the member name if the subtree's parent is an object, or
+ *          NULL otherwise.
+ *
+ *      Return false to stop parsing.
+ */
+typedef bool (*RedJsonSubtreeCallback)(RedJsonValue value, const char *szKey, void *userData);
+
+/*
+ * RedJsonStreamParser_New - Create a SAX mode stream parser.
+ *
+ *      Returns a newly allocated parser, or NULL if memory allocation failed.
+ */
+RedJsonStreamParser RedJsonStreamParser_New(
+        RedJsonEventCallback fnOnEvent,
+        void *userData);
+
+/*
+ * RedJsonStreamParser_NewDom - Create a DOM mode stream parser.
+ *
+ *      <depth> selects which values are delivered.  0 delivers each
+ *          top-level value, 1 delivers each element/member of the top-level
+ *          containers, and so on.  Containers above <depth> are never built.
+ *
+ *      As with RedJson_Parse, a \u0000 escape in a string value fails with
+ *      RED_JSON_ERROR_BAD_ESCAPE.
+ *
+ *      Returns a newly allocated parser, or NULL if memory allocation failed.
+ */
+RedJsonStreamParser RedJsonStreamParser_NewDom(
+        unsigned depth,
+        RedJsonSubtreeCallback fnOnValue,
+        void *userData);
+
+/*
+ * RedJsonStreamParser_SetKeyTable - In DOM mode, intern object keys in <keys>
+ *      instead of the parser's own table.  <keys> must outlive the parser.
+ *      Pass NULL to go back to a private table.
+ *
+ *      The private table is kept across RedJsonStreamParser_Reset, so every
+ *      document parsed with one parser shares keys.  It stops growing at a
+ *      few thousand distinct keys; keys beyond that are stored per member.
+ */
+void RedJsonStreamParser_SetKeyTable(RedJsonStreamParser parser, RedJsonKeyTable keys);
+
+/*
+ * RedJsonStreamParser_SetFormat - Select the input encoding.  Pass
+ *      RED_JSON_FORMAT_CBOR to read a sequence of CBOR data items instead of
+ *      JSON text; either text format selects JSON, the default.  Call before
+ *      the first Feed or right after RedJsonStreamParser_Reset.
+ *
+ *      CBOR input produces the same events and subtrees as the equivalent
+ *      JSON.  Errors report the byte offset with <line> fixed at 1.
+ *
+ *      Returns RED_JSON_ERROR_OUT_OF_MEMORY if the decoder could not be
+ *      allocated.
+ */
+RedJsonErrorEnum RedJsonStreamParser_SetFormat(RedJsonStreamParser parser, RedJsonFormatEnum format);
+
+/*
+ * RedJsonStreamParser_Feed - Push the next <length> bytes of input.
+ *
+ *      <chunk> need not be null-terminated and may split tokens anywhere.
+ *
+ *      Returns RED_JSON_OK on success.  Once an error has been returned, all
+ *      later calls return the same error until RedJsonStreamParser_Reset.
+ */
+RedJsonErrorEnum RedJsonStreamParser_Feed(
+        RedJsonStreamParser parser,
+        const char *chunk,
+        size_t length);
+
+/*
+ * RedJsonStreamParser_Finish - Signal end of input.
+ *
+ *      Completes a trailing top-level number if necessary.  Returns
+ *      RED_JSON_ERROR_UNEXPECTED_END if the input stopped in the middle of a
+ *      value.
+ */
+RedJsonErrorEnum RedJsonStreamParser_Finish(RedJsonStreamParser parser);
+
+/*
+ * RedJsonStreamParser_GetError - Get details about the most recent error.
+ */
+RedJsonError_t RedJsonStreamParser_GetError(RedJsonStreamParser parser);
+
+/*
+ * RedJsonStreamParser_Reset - Discard all state so the parser can be reused
+ *      for a new stream.  Internal buffers are kept.
+ */
+void RedJsonStreamParser_Reset(RedJsonStreamParser parser);
+
+/*
+ * RedJsonStreamParser_Free - Free <parser> and any partially built subtree.
+ *
+ *      Does nothing if <parser> is NULL.
+ */
+void RedJsonStreamParser_Free(RedJsonStreamParser parser);
+
+/*
+ *  STREAMING WRITER
+ *
+ *      RedJsonWriter produces JSON incrementally through Begin/Key/value/End
+ *      calls, or from DOM subtrees, and writes it out through a bounded
+ *      buffer (64KB) to a file descriptor, FILE* or callback.  The complete
+ *      document is never held in memory.  Large string payloads written to a
+ *      file descriptor are combined with buffered output in a single writev.
+ *
+ *      Consecutive top-level values are separated by a newline, so a
+ *      compact writer emits NDJSON.
+ *
+ *      Calling a method that would produce invalid JSON (a key outside an
+ *      object, a member without a key, an unbalanced End) is a programming
+ *      error and asserts.
+ *
+ *      I/O errors are sticky: once a write fails every later call returns
+ *      RED_JSON_ERROR_IO.
+ *
+ *      Example:
+ *
+ *          w = RedJsonWriter_NewFd(STDOUT_FILENO, RED_JSON_FORMAT_COMPACT);
+ *          RedJsonWriter_BeginObject(w);
+ *          RedJsonWriter_Key(w, "id");
+ *          RedJsonWriter_Int64(w, 42);
+ *          RedJsonWriter_EndObject(w);
+ *          err = RedJsonWriter_Finish(w);
+ *          RedJsonWriter_Free(w);
+ */
+typedef struct RedJsonWriter_t * RedJsonWriter;
+
+/*
+ * RedJsonWriteCallback - Receives the next <length> bytes of output.  Return
+ *      false to report an I/O error.
+ */
+typedef bool (*RedJsonWriteCallback)(const char *data, size_t length, void *userData);
+
+/*
+ * RedJsonWriter_NewFd, RedJsonWriter_NewFile, RedJsonWriter_NewCallback -
+ *      Create a streaming writer.  The destination is not closed by
+ *      RedJsonWriter_Free.
+ *
+ *      Returns a newly allocated writer, or NULL if memory allocation failed.
+ */
+RedJsonWriter RedJsonWriter_NewFd(int fd, RedJsonFormatEnum format);
+RedJsonWriter RedJsonWriter_NewFile(FILE *fp, RedJsonFormatEnum format);
+RedJsonWriter RedJsonWriter_NewCallback(
+        RedJsonWriteCallback fnWrite,
+        void *userData,
+        RedJsonFormatEnum format);
+
+RedJsonErrorEnum RedJsonWriter_BeginObject(RedJsonWriter writer);
+RedJsonErrorEnum RedJsonWriter_EndObject(RedJsonWriter writer);
+RedJsonErrorEnum RedJsonWriter_BeginArray(RedJsonWriter writer);
+RedJsonErrorEnum RedJsonWriter_EndArray(RedJsonWriter writer);
+RedJsonErrorEnum RedJsonWriter_Key(RedJsonWriter writer, const char *szKey);
+RedJsonErrorEnum RedJsonWriter_String(RedJsonWriter writer, const char *sz);
+RedJsonErrorEnum RedJsonWriter_Number(RedJsonWriter writer, double val);
+RedJsonErrorEnum RedJsonWriter_Int64(RedJsonWriter writer, int64_t val);
+RedJsonErrorEnum RedJsonWriter_Uint64(RedJsonWriter writer, uint64_t val);
+RedJsonErrorEnum RedJsonWriter_Boolean(RedJsonWriter writer, bool val);
+RedJsonErrorEnum RedJsonWriter_Null(RedJsonWriter writer);
+
+/*
+ * RedJsonWriter_Value - Write a whole DOM subtree as the next value.
+ */
+RedJsonErrorEnum RedJsonWriter_Value(RedJsonWriter writer, RedJsonValue jsonVal);
+
+/*
+ * RedJsonWriter_Flush - Push buffered output to the destination (and
+ *      fflush a FILE* destination).
+ */
+RedJsonErrorEnum RedJsonWriter_Flush(RedJsonWriter writer);
+
+/*
+ * RedJsonWriter_Finish - Flush, then check that every container was closed.
+ *
+ *      Returns RED_JSON_ERROR_UNEXPECTED_END if a container or key is still
+ *      open.
+ */
+RedJsonErrorEnum RedJsonWriter_Finish(RedJsonWriter writer);
+
+/*
+ * RedJsonWriter_BytesWritten - Total bytes produced so far, including any
+ *      still buffered.
+ */
+size_t RedJsonWriter_BytesWritten(RedJsonWriter writer);
+
+/*
+ * RedJsonWriter_Free - Free <writer>.  Output that has not been flushed is
+ *      discarded.  Does nothing if <writer> is NULL.
+ */
+void RedJsonWriter_Free(RedJsonWriter writer);
+
+/*
+ * RedJsonValue_WriteToFd, RedJsonValue_WriteToFile,
+ * RedJsonValue_WriteToCallback - Serialize a DOM value straight to a
+ *      destination through a bounded buffer.
+ */
+RedJsonErrorEnum RedJsonValue_WriteToFd(RedJsonValue jsonVal, RedJsonFormatEnum format, int fd);
+RedJsonErrorEnum RedJsonValue_WriteToFile(RedJsonValue jsonVal, RedJsonFormatEnum format, FILE *fp);
+RedJsonErrorEnum RedJsonValue_WriteToCallback(
+        RedJsonValue jsonVal,
+        RedJsonFormatEnum format,
+        RedJsonWriteCallback fnWrite,
+        void *userData);
+
+/*
+ *  CBOR
+ *
+ *      CBOR (RFC 8949) carries the JSON data model in a compact binary form
+ *      that is cheaper to produce and to decode than text: numbers keep
+ *      their binary representation and strings are length-prefixed, so
+ *      nothing is escaped or scanned for.
+ *
+ *      Writers created with RED_JSON_FORMAT_CBOR stream CBOR through the same
+ *      Begin/Key/value/End calls as text.  Containers opened with Begin use
+ *      indefinite length encoding, since their size is not known up front;
+ *      DOM values are written with definite lengths.  Consecutive top-level
+ *      values form a CBOR sequence (RFC 8742).  Integers keep their exact
+ *      int64/uint64 value and doubles use the shortest of the half, single
+ *      and double precision encodings that represents them exactly.
+ *
+ *      Stream parsers switched to RED_JSON_FORMAT_CBOR with
+ *      RedJsonStreamParser_SetFormat decode chunked CBOR input.  When
+ *      decoding:
+ *
+ *          - integers become int64 or uint64 numbers, except negative values
+ *            below INT64_MIN which become doubles.
+ *          - half, single and double precision floats become doubles.
+ *          - definite and indefinite length text strings, arrays and maps
+ *            are accepted.  Map keys must be text strings.
+ *          - undefined becomes null.  Tags are ignored and the tagged item
+ *            is decoded.
+ *          - byte strings, other simple values and non-text map keys fail
+ *            with RED_JSON_ERROR_BAD_CBOR.
+ */
+
+/*
+ * RedJsonValue_ToCbor - Encode <jsonVal> as a single CBOR data item.
+ *
+ *      Returns a newly allocated buffer that the caller must free, with its
+ *      size in *<pLength>, or NULL if memory allocation failed.
+ */
+char * RedJsonValue_ToCbor(RedJsonValue jsonVal, size_t *pLength);
+
+/*
+ * RedJson_ParseCbor - Decode the single CBOR data item in the <length> bytes
+ *      at <data>.
+ *
+ *      Returns a new value, or NULL on failure, with details in *<pError> if
+ *      it is not NULL.  Bytes following the item are an error, as is nesting
+ *      deeper than RED_JSON_DEFAULT_MAX_DEPTH, or a NUL byte in a text string
+ *      value (RED_JSON_ERROR_BAD_STRING; see RedJson_Parse).
+ */
+RedJsonValue RedJson_ParseCbor(const char *data, size_t length, RedJsonError_t *pError);
+
+/*
+ *  STRUCT BINDINGS
+ *
+ *      A binding maps the members of a JSON object onto the members of a C
+ *      struct, so fixed-schema messages are parsed straight into native
+ *      structs, and written back out, without building a DOM or looking each
+ *      key up by name.  The layout is declared once as a table of
+ *      RedJsonField_t built with the RED_JSON_FIELD macros.
+ *      RedJsonBinding_New compiles the table into a perfect hash over its
+ *      keys; parsing then runs the stream parser in SAX mode and dispatches
+ *      every key through the hash to the member it fills.
+ *
+ *      Example:
+ *
+ *          typedef struct { char *code; int32_t lane; } Venue;
+ *          typedef struct { int64_t id; double price; Venue venue; } Order;
+ *
+ *          static const RedJsonField_t _venueFields[] = {
+ *              RED_JSON_FIELD(Venue, code, RED_JSON_FIELD_STRING),
+ *              RED_JSON_FIELD(Venue, lane, RED_JSON_FIELD_INT32),
+ *              RED_JSON_FIELDS_END
+ *          };
+ *          static const RedJsonField_t _orderFields[] = {
+ *              RED_JSON_FIELD(Order, id, RED_JSON_FIELD_INT64),
+ *              RED_JSON_FIELD_NAMED(Order, price, "px", RED_JSON_FIELD_DOUBLE),
+ *              RED_JSON_FIELD_OBJECT(Order, venue, _venueFields),
+ *              RED_JSON_FIELDS_END
+ *          };
+ *
+ *          binding = RedJsonBinding_New(_orderFields);
+ *          Order order = {0};
+ *          err = RedJsonBinding_Parse(binding, text, length, &order, NULL);
+ *          ...
+ *          RedJsonBinding_FreeMembers(binding, &order);
+ *
+ *      Parsing follows these rules:
+ *
+ *          - members missing from the input are left unchanged, so a struct
+ *            can be filled with defaults first.  A repeated key takes its
+ *            last value.
+ *          - keys that are not in the table are skipped, along with their
+ *            values, which are still fully validated.
+ *          - integer members need an integer that fits the type exactly;
+ *            DOUBLE members accept any number.
+ *          - null leaves a member unchanged, except that a STRING member
+ *            becomes NULL.
+ *          - a value of the wrong type fails with RED_JSON_ERROR_WRONG_TYPE.
+ *
+ *      STRING members are char pointers owned by the struct.  They must be
+ *      NULL or hold a malloc'd string before parsing, and are freed when
+ *      replaced, so one struct can be reused for many messages.
+ */
+typedef enum
+{
+    RED_JSON_FIELD_INT32,       /* int32_t */
+    RED_JSON_FIELD_INT64,       /* int64_t */
+    RED_JSON_FIELD_UINT64,      /* uint64_t */
+    RED_JSON_FIELD_DOUBLE,      /* double */
+    RED_JSON_FIELD_BOOLEAN,     /* bool */
+    RED_JSON_FIELD_STRING,      /* char *, malloc'd */
+    RED_JSON_FIELD_OBJECT,      /* embedded struct described by <nested> */
+} RedJsonFieldTypeEnum;
+
+/*
+ * RedJsonField_t - Describes one struct member.  Use the macros below rather
+ *      than filling this in by hand.
+ */
+typedef struct RedJsonField_t
+{
+    const char *szKey;
+    RedJsonFieldTypeEnum type;
+    size_t offset;
+    const struct RedJsonField_t *nested;
+} RedJsonField_t;
+
+/*
+ * RED_JSON_FIELD - Bind <member> of <structType> to the key of the same name.
+ * RED_JSON_FIELD_NAMED - Bind <member> to the key <szKey>.
+ * RED_JSON_FIELD_OBJECT - Bind the embedded struct <member> to a nested
+ *      object whose layout is the field table <nestedFields>.
+ * RED_JSON_FIELDS_END - Terminates a field table.
+ */
+#define RED_JSON_FIELD(structType, member, type) \
+    { #member, type, offsetof(structType, member), NULL }
+#define RED_JSON_FIELD_NAMED(structType, member, szKey, type) \
+    { szKey, type, offsetof(structType, member), NULL }
+#define RED_JSON_FIELD_OBJECT(structType, member, nestedFields) \
+    { #member, RED_JSON_FIELD_OBJECT, offsetof(structType, member), nestedFields }
+#define RED_JSON_FIELDS_END \
+    { NULL, RED_JSON_FIELD_INT32, 0, NULL }
+
+typedef struct RedJsonBinding_t * RedJsonBinding;
+
+/*
+ * RedJsonBinding_New - Compile the field table <fields>, and those of any
+ *      nested objects.  The tables must outlive the binding.  Keys must be
+ *      unique within each table.
+ *
+ *      A binding is read-only once created and may be used from several
+ *      threads at once.
+ *
+ *      Returns a new binding, or NULL if memory allocation failed.
+ */
+RedJsonBinding RedJsonBinding_New(const RedJsonField_t *fields);
+
+/*
+ * RedJsonBinding_Free - Free <binding>.  Does nothing if <binding> is NULL.
+ */
+void RedJsonBinding_Free(RedJsonBinding binding);
+
+/*
+ * RedJsonBinding_Parse - Parse the JSON object in the <length> bytes at
+ *      <text> into the struct at <pStruct>.
+ *
+ *      Fails with RED_JSON_ERROR_WRONG_TYPE if the text is not a single
+ *      object.  On failure some members may already have been filled in;
+ *      strings stored so far are still owned by the struct.  <pError> may be
+ *      NULL.
+ */
+RedJsonErrorEnum RedJsonBinding_Parse(
+        RedJsonBinding binding,
+        const char *text,
+        size_t length,
+        void *pStruct,
+        RedJsonError_t *pError);
+
+/*
+ * RedJsonBinding_Write - Write the struct at <pStruct> to <writer> as an
+ *      object with the members in table order.  NULL strings are written as
+ *      null.
+ */
+RedJsonErrorEnum RedJsonBinding_Write(RedJsonBinding binding, const void *pStruct, RedJsonWriter writer);
+
+/*
+ * RedJsonBinding_ToJsonString - Serialize the struct at <pStruct> as compact
+ *      JSON.
+ *
+ *      Returns a newly allocated string that the caller must free, or NULL if
+ *      memory allocation failed.
+ */
+char * RedJsonBinding_ToJsonString(RedJsonBinding binding, const void *pStruct);
+
+/*
+ * RedJsonBinding_FreeMembers - Free the STRING members of the struct at
+ *      <pStruct>, including those of nested objects, and set them to NULL.
+ */
+void RedJsonBinding_FreeMembers(RedJsonBinding binding, void *pStruct);
+
+/*
+ *  NDJSON (JSON LINES) READER
+ *
+ *      RedJson_ReadNdjsonFile parses a file containing one JSON value per
+ *      line and hands every record to a callback.  The file is memory mapped
+ *      and split into line-aligned chunks which are parsed concurrently on a
+ *      pool of worker threads.  Each worker keeps its own parser and record
+ *      buffer, so workers share nothing except the chunk cursor.
+ */
+
+/*
+ * RedJsonRecordCallback - Receives one parsed record.
+ *
+ *      <record> is owned by the reader and is released when the callback
+ *          returns; call RedJsonValue_Retain to keep it.
+ *
+ *      Return false to stop reading; RedJson_ReadNdjsonFile then returns
+ *      RED_JSON_ERROR_ABORTED.
+ */
+typedef bool (*RedJsonRecordCallback)(RedJsonValue record, void *userData);
+
+typedef struct RedJsonNdjsonOptions_t
+{
+    /* Number of worker threads.  0 uses one per online CPU. */
+    unsigned numThreads;
+
+    /*
+     * If true, records are delivered one at a time in file order.  If false,
+     * the callback is invoked concurrently from all workers, in no
+     * particular order, and must be thread-safe.
+     */
+    bool ordered;
+
+    /* Approximate bytes per work unit.  0 selects a default (1MB). */
+    size_t chunkSize;
+} RedJsonNdjsonOptions_t;
+
+/*
+ * RedJson_ReadNdjsonFile - Parse every record of the NDJSON file at <path>.
+ *
+ *      <options> may be NULL to use defaults (all CPUs, ordered).
+ *
+ *      <pError> may be NULL.  If non-NULL it receives the position of the
+ *          first failure, with <offset>, <line> and <column> relative to the
+ *          start of the file.
+ *
+ *      Returns RED_JSON_OK if every record was parsed and delivered.
+ */
+RedJsonErrorEnum RedJson_ReadNdjsonFile(
+        const char *path,
+        const RedJsonNdjsonOptions_t *options,
+        RedJsonRecordCallback fnOnRecord,
+        void *userData,
+        RedJsonError_t *pError);
+
+/*
+ *  PARALLEL ARRAY PARSING
+ *
+ *      RedJson_ParseArrayParallel parses a document whose top level is one
+ *      large array, such as an export of many records, on several threads.
+ *
+ *      The text is handed out in runs of whole elements of about
+ *      <chunkSize> bytes.  The end of each run is found by a quick scan that
+ *      only tracks strings, comments and bracket nesting.  Workers parse
+ *      runs concurrently, each into its own heap allocations and with its
+ *      own key table, and the elements are then moved into a single array
+ *      in document order.  The result is the same as parsing sequentially;
+ *      only the elements' keys are interned once per thread instead of once
+ *      per document.
+ */
+typedef struct RedJsonParallelOptions_t
+{
+    /* Number of worker threads.  0 uses one per online CPU. */
+    unsigned numThreads;
+
+    /* Approximate bytes per work unit.  0 selects a default (1MB). */
+    size_t chunkSize;
+
+    /* Nesting limit, counting the array as 1.  0 selects the default. */
+    unsigned maxDepth;
+} RedJsonParallelOptions_t;
+
+/*
+ * RedJson_ParseArrayParallel - Parse the <length> bytes at <text>, which
+ *      must hold a single JSON array.
+ *
+ *      <options> may be NULL to use defaults (all CPUs).
+ *
+ *      Returns the new array, or NULL on failure.  If <pError> is non-NULL
+ *      it then receives the first error in document order.
+ */
+RedJsonArray RedJson_ParseArrayParallel(
+        const char *text,
+        size_t length,
+        const RedJsonParallelOptions_t *options,
+        RedJsonError_t *pError);
+
+/*
+ * RedJson_ParseArrayFileParallel - RedJson_ParseArrayParallel on the
+ *      memory mapped file at <path> (see RedJson_ParseFile).
+ */
+RedJsonArray RedJson_ParseArrayFileParallel(
+        const char *path,
+        const RedJsonParallelOptions_t *options,
+        RedJsonError_t *pError);
+
+/*
+ *  DIFF AND PATCH
+ *
+ *      RedJson_Diff describes the changes between two documents as an
+ *      RFC 6902 JSON Patch, and RedJson_ApplyPatch applies such a patch, so
+ *      that a copy of a large document can be kept in sync by shipping only
+ *      what changed:
+ *
+ *          RedJsonArray patch = RedJson_Diff(lastSent, current);
+ *          ... send it, and on the receiving side ...
+ *          err = RedJson_ApplyPatch(replica, patch, &failedOp);
+ *
+ *      Each object and array caches a 64-bit hash of its contents once it
+ *      has been computed, so the diff skips unchanged subtrees in O(1): at
+ *      once if both sides are the same container (as after
+ *      RedJsonObject_Clone), otherwise by comparing hashes.  The first diff
+ *      of a freshly parsed document pays for hashing it.  Because it stores
+ *      the hashes, a diff counts as modifying both trees for the purposes of
+ *      thread safety (see MEMORY MANAGEMENT).
+ *
+ *      Modifying a container drops its hash.  Containers reached through
+ *      plain Get* functions do not tell their parents, so use the
+ *      GetMutable* functions to change a tree that will be diffed again.
+ *
+ *      Numbers are compared by value (1 equals 1.0) and objects regardless
+ *      of member order.
+ */
+
+/*
+ * RedJsonValue_Equals, RedJsonObject_Equals - Determine if two values or
+ *      objects hold the same JSON data.
+ */
+bool RedJsonValue_Equals(RedJsonValue a, RedJsonValue b);
+bool RedJsonObject_Equals(RedJsonObject a, RedJsonObject b);
+
+/*
+ * RedJson_Diff - Build the JSON Patch that turns <from> into <to>.
+ *
+ *      The patch is an array of operation objects ("op", "path" and, for
+ *      "add" and "replace", "value").  Values are shared with <to> rather
+ *      than copied.  Subtrees whose hashes match are taken to be equal.
+ *      Arrays are compared element by element after trimming any common
+ *      prefix and suffix, so an insertion near the front of an array
+ *      becomes a single "add".
+ *
+ *      Returns NULL if an operation's path would pass through a key that
+ *      holds a NUL character, since "path" is stored as a C string.
+ */
+RedJsonArray RedJson_Diff(RedJsonObject from, RedJsonObject to);
+
+/*
+ * RedJson_ApplyPatch - Apply the JSON Patch <patch> to <doc> in place.
+ *
+ *      Supports every RFC 6902 operation: add, remove, replace, move, copy
+ *      and test.  Values in the patch are shared with <doc>, not copied.
+ *
+ *      The patch is applied as a whole or not at all.  On failure <doc> is
+ *      unchanged and, if <pFailedOp> is non-NULL, it receives the index of
+ *      the offending operation.  Returns RED_JSON_ERROR_WRONG_TYPE for a
+ *      malformed operation, RED_JSON_ERROR_BAD_PATH for a malformed JSON
+ *      Pointer, RED_JSON_ERROR_NOT_FOUND if a location does not exist and
+ *      RED_JSON_ERROR_TEST_FAILED if a "test" does not match.  The document
+ *      root must remain an object.
+ */
+RedJsonErrorEnum RedJson_ApplyPatch(RedJsonObject doc, RedJsonArray patch, unsigned *pFailedOp);
+
 #ifdef __cplusplus
 }
 #endif
@@ -96,6 +96,26 @@ void RedString_Clear(RedString hOut);
  */
 unsigned RedString_Length(const RedString hRedString);
 
+/*
+ * RedString_Capacity -- Returns the number of characters <hRedString> can
+ *      hold before its buffer has to grow.
+ */
+unsigned RedString_Capacity(ConstRedString hRedString);
+
+/*
+ * RedString_Reserve -- Makes room for at least <length> characters, so that
+ *      appends up to that length do not reallocate.  Never shrinks.
+ *
+ *      Appends grow the buffer geometrically on their own, so this only saves
+ *      the few intermediate copies when the final length is known up front.
+ */
+void RedString_Reserve(RedString hRedString, unsigned length);
+
+/*
+ * RedString_ShrinkToFit -- Releases any capacity beyond the current length.
+ */
+void RedString_ShrinkToFit(RedString hRedString);
+
 /*
  * RedString_Bytes -- Returns the length in bytes of a string.
  */
@@ -244,6 +264,13 @@ void RedString_Append(RedString hOriginal, const RedString hAppend);
  */
 void RedString_AppendChars(RedString hOriginal, const char * pAppend);
 
+/*
+ * RedString_AppendLength -- Adds the <length> chars at <pAppend> to the end
+ *      of <hOriginal>.  <pAppend> need not be null-terminated, and may point
+ *      into <hOriginal> itself.
+ */
+void RedString_AppendLength(RedString hOriginal, const char * pAppend, unsigned length);
+
 /*
  * RedString_AppendPrintf -- Adds <hAppend> to the end of <hOriginal>.
  */
@@ -78,10 +78,33 @@ RedHash RedHash_New(unsigned numItemsHint)
         i++;
     } while ((i < _REDHASH_NUM_SIZE_LEVELS) &&
              (hNew->numBuckets < numItemsHint));
+    hNew->sizeLevel = i - 1;
     hNew->buckets = calloc(hNew->numBuckets, sizeof(RedHashNodeHeader *));
     return hNew;
 }
 
+void RedHash_Free(RedHash hash)
+{
+    RedHashNodeHeader *pNode, *pNext;
+    unsigned i;
+
+    if (!hash)
+        return;
+
+    for (i = 0; i < hash->numBuckets; i++)
+    {
+        pNode = hash->buckets[i];
+        while (pNode)
+        {
+            pNext = pNode->next;
+            free(pNode);
+            pNode = pNext;
+        }
+    }
+    free(hash->buckets);
+    free(hash);
+}
+
 static void _RedHash_AutoResize(RedHash hash)
 {
     RedHash_t oldHash;
@@ -122,6 +145,7 @@ static void _RedHash_AutoResize(RedHash hash)
             pNode = oldHash.buckets[i];
         }
     }
+    free(oldHash.buckets);
 }
 
 void 
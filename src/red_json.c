@@ -1,14 +1,10 @@
 #include "red_json.h"
+#include "red_json_private.h"
 
-#include "red_hash.h"
-#include "red_string.h"
-#include "../under_construction/zarray.h"
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-
-#define REF(hObj) ((hObj)->refcnt++, (hObj))
 
 static char * _StrDup(const char *s)
 {
@@ -18,39 +14,14 @@ static char * _StrDup(const char *s)
     return out;
 }
 
-typedef struct RedJsonValue_t
-{
-    int refcnt;
-    RedJsonValueTypeEnum type;
-    union
-    {
-        char *sz;
-        double dbl;
-        RedJsonObject hObj;
-        RedJsonArray hArray;
-        bool boolean;
-    } val;
-} RedJsonValue_t;
-
-typedef struct RedJsonObject_t
-{
-    int refcnt;
-    RedHash hash;
-} RedJsonObject_t;
-
-typedef struct RedJsonArray_t
-{
-    int refcnt;
-    ZARRAY(RedJsonValue) items;
-} RedJsonArray_t;
-
 RedJsonValue RedJsonValue_FromString(const char * sz)
 {
     RedJsonValue hNew;
     hNew = malloc(sizeof(RedJsonValue_t));
     hNew->type = RED_JSON_VALUE_TYPE_STRING;
+    hNew->meta.backing = NULL;
     hNew->val.sz = _StrDup(sz);
-    hNew->refcnt = 0;
+    hNew->refcnt = 1;
     return hNew;
 }
 
@@ -59,8 +30,31 @@ RedJsonValue RedJsonValue_FromNumber(double val)
     RedJsonValue hNew;
     hNew = malloc(sizeof(RedJsonValue_t));
     hNew->type = RED_JSON_VALUE_TYPE_NUMBER;
+    hNew->meta.numberType = RED_JSON_NUMBER_DOUBLE;
     hNew->val.dbl = val;
-    hNew->refcnt = 0;
+    hNew->refcnt = 1;
+    return hNew;
+}
+
+RedJsonValue RedJsonValue_FromInt64(int64_t val)
+{
+    RedJsonValue hNew;
+    hNew = malloc(sizeof(RedJsonValue_t));
+    hNew->type = RED_JSON_VALUE_TYPE_NUMBER;
+    hNew->meta.numberType = RED_JSON_NUMBER_INT64;
+    hNew->val.i64 = val;
+    hNew->refcnt = 1;
+    return hNew;
+}
+
+RedJsonValue RedJsonValue_FromUint64(uint64_t val)
+{
+    RedJsonValue hNew;
+    hNew = malloc(sizeof(RedJsonValue_t));
+    hNew->type = RED_JSON_VALUE_TYPE_NUMBER;
+    hNew->meta.numberType = RED_JSON_NUMBER_UINT64;
+    hNew->val.u64 = val;
+    hNew->refcnt = 1;
     return hNew;
 }
 
@@ -69,8 +63,8 @@ RedJsonValue RedJsonValue_FromObject(RedJsonObject hObj)
     RedJsonValue hNew;
     hNew = malloc(sizeof(RedJsonValue_t));
     hNew->type = RED_JSON_VALUE_TYPE_OBJECT;
-    hNew->val.hObj = REF(hObj);
-    hNew->refcnt = 0;
+    hNew->val.hObj = hObj;
+    hNew->refcnt = 1;
     return hNew;
 }
 
@@ -79,8 +73,8 @@ RedJsonValue RedJsonValue_FromArray(RedJsonArray hArray)
     RedJsonValue hNew;
     hNew = malloc(sizeof(RedJsonValue_t));
     hNew->type = RED_JSON_VALUE_TYPE_ARRAY;
-    hNew->val.hArray = REF(hArray);
-    hNew->refcnt = 0;
+    hNew->val.hArray = hArray;
+    hNew->refcnt = 1;
     return hNew;
 }
 
@@ -90,7 +84,7 @@ RedJsonValue RedJsonValue_FromBoolean(bool val)
     hNew = malloc(sizeof(RedJsonValue_t));
     hNew->type = RED_JSON_VALUE_TYPE_BOOLEAN;
     hNew->val.boolean = val;
-    hNew->refcnt = 0;
+    hNew->refcnt = 1;
     return hNew;
 }
 
@@ -99,16 +93,119 @@ RedJsonValue RedJsonValue_Null()
     RedJsonValue hNew;
     hNew = malloc(sizeof(RedJsonValue_t));
     hNew->type = RED_JSON_VALUE_TYPE_NULL;
-    hNew->refcnt = 0;
+    hNew->refcnt = 1;
     return hNew;
 }
 
-void _RedJsonValue_Free(RedJsonValue hVal)
+RedJsonValue RedJsonValue_Retain(RedJsonValue hVal)
+{
+    hVal->refcnt++;
+    return hVal;
+}
+
+void RedJsonValue_Release(RedJsonValue hVal)
 {
-    free(hVal->val.sz);
+    if (!hVal || --hVal->refcnt > 0)
+        return;
+    switch (hVal->type)
+    {
+        case RED_JSON_VALUE_TYPE_STRING:
+            if (hVal->meta.backing)
+                _RedJsonBacking_Release(hVal->meta.backing);
+            else
+                free(hVal->val.sz);
+            break;
+        case RED_JSON_VALUE_TYPE_OBJECT:
+            RedJsonObject_Release(hVal->val.hObj);
+            break;
+        case RED_JSON_VALUE_TYPE_ARRAY:
+            RedJsonArray_Release(hVal->val.hArray);
+            break;
+        default:
+            break;
+    }
     free(hVal);
 }
 
+RedJsonObject RedJsonObject_Retain(RedJsonObject hObj)
+{
+    hObj->refcnt++;
+    return hObj;
+}
+
+void RedJsonObject_Release(RedJsonObject hObj)
+{
+    unsigned i;
+    if (!hObj || --hObj->refcnt > 0)
+        return;
+    for (i = 0; i < hObj->numMembers; i++)
+    {
+        _RedJsonKey_Release(hObj->members[i].key);
+        RedJsonValue_Release(hObj->members[i].value);
+    }
+    free(hObj->members);
+    free(hObj->index);
+    free(hObj);
+}
+
+RedJsonArray RedJsonArray_Retain(RedJsonArray hArray)
+{
+    hArray->refcnt++;
+    return hArray;
+}
+
+void RedJsonArray_Release(RedJsonArray hArray)
+{
+    unsigned i, numItems;
+    if (!hArray || --hArray->refcnt > 0)
+        return;
+    numItems = ZARRAY_NUM_ITEMS(hArray->items);
+    for (i = 0; i < numItems; i++)
+        RedJsonValue_Release(ZARRAY_AT(hArray->items, i));
+    ZARRAY_FREE(hArray->items);
+    free(hArray->packed.any);
+    free(hArray);
+}
+
+static double _Number_AsDouble(RedJsonValue hVal)
+{
+    switch (hVal->meta.numberType)
+    {
+        case RED_JSON_NUMBER_INT64:
+            return (double)hVal->val.i64;
+        case RED_JSON_NUMBER_UINT64:
+            return (double)hVal->val.u64;
+        default:
+            return hVal->val.dbl;
+    }
+}
+
+static int64_t _Number_AsInt64(RedJsonValue hVal)
+{
+    switch (hVal->meta.numberType)
+    {
+        case RED_JSON_NUMBER_INT64:
+            return hVal->val.i64;
+        case RED_JSON_NUMBER_UINT64:
+            return (hVal->val.u64 > INT64_MAX) ? INT64_MAX : (int64_t)hVal->val.u64;
+        default:
+            return _RedJson_DoubleToInt64(hVal->val.dbl);
+    }
+}
+
+static uint64_t _Number_AsUint64(RedJsonValue hVal)
+{
+    switch (hVal->meta.numberType)
+    {
+        case RED_JSON_NUMBER_INT64:
+            return (hVal->val.i64 < 0) ? 0 : (uint64_t)hVal->val.i64;
+        case RED_JSON_NUMBER_UINT64:
+            return hVal->val.u64;
+        default:
+            return _RedJson_DoubleToUint64(hVal->val.dbl);
+    }
+}
+
 char * RedJsonValue_GetString(RedJsonValue hVal)
 {
     assert(hVal->type == RED_JSON_VALUE_TYPE_STRING);
@@ -117,17 +214,32 @@ char * RedJsonValue_GetString(RedJsonValue hVal)
 double RedJsonValue_GetNumber(RedJsonValue hVal)
 {
     assert(hVal->type == RED_JSON_VALUE_TYPE_NUMBER);
-    return hVal->val.dbl;
+    return _Number_AsDouble(hVal);
+}
+int64_t RedJsonValue_GetInt64(RedJsonValue hVal)
+{
+    assert(hVal->type == RED_JSON_VALUE_TYPE_NUMBER);
+    return _Number_AsInt64(hVal);
+}
+uint64_t RedJsonValue_GetUint64(RedJsonValue hVal)
+{
+    assert(hVal->type == RED_JSON_VALUE_TYPE_NUMBER);
+    return _Number_AsUint64(hVal);
+}
+RedJsonNumberTypeEnum RedJsonValue_GetNumberType(RedJsonValue hVal)
+{
+    assert(hVal->type == RED_JSON_VALUE_TYPE_NUMBER);
+    return hVal->meta.numberType;
 }
 RedJsonObject RedJsonValue_GetObject(RedJsonValue hVal)
 {
     assert(hVal->type == RED_JSON_VALUE_TYPE_OBJECT);
-    return REF(hVal->val.hObj);
+    return hVal->val.hObj;
 }
 RedJsonArray RedJsonValue_GetArray(RedJsonValue hVal)
 {
     assert(hVal->type == RED_JSON_VALUE_TYPE_ARRAY);
-    return REF(hVal->val.hArray);
+    return hVal->val.hArray;
 }
 bool RedJsonValue_GetBoolean(RedJsonValue hVal)
 {
@@ -160,99 +272,353 @@ bool RedJsonValue_IsNull(RedJsonValue hVal)
     return hVal->type == RED_JSON_VALUE_TYPE_NULL;
 }
 
+/*
+ * _Object_Reindex - Rebuild the position index so that it is at most half
+ *      full.
+ */
+static void _Object_Reindex(RedJsonObject hObj)
+{
+    unsigned size = 16;
+    unsigned i, slot;
+    while (size < 2 * hObj->capacity)
+        size *= 2;
+    free(hObj->index);
+    hObj->index = calloc(size, sizeof(uint32_t));
+    assert(hObj->index);
+    hObj->indexMask = size - 1;
+    for (i = 0; i < hObj->numMembers; i++)
+    {
+        slot = hObj->members[i].hash & hObj->indexMask;
+        while (hObj->index[slot])
+            slot = (slot + 1) & hObj->indexMask;
+        hObj->index[slot] = i + 1;
+    }
+}
+
+static bool _Member_Matches(const _RedJsonMember *member, RedJsonKey key, const char *sz, size_t length, uint32_t hash)
+{
+    return member->key == key
+        || (member->hash == hash && member->key->length == length && !memcmp(member->key->sz, sz, length));
+}
+
+/*
+ * _Object_Find - Find the member with key text <sz>.  <key>, if not NULL, is
+ *      an interned key for the same text that can be matched by pointer.
+ */
+static _RedJsonMember * _Object_Find(RedJsonObject hObj, RedJsonKey key, const char *sz, size_t length, uint32_t hash)
+{
+    _RedJsonMember *member;
+    unsigned i, slot;
+    if (!hObj->index)
+    {
+        for (i = 0; i < hObj->numMembers; i++)
+        {
+            member = &hObj->members[i];
+            if (_Member_Matches(member, key, sz, length, hash))
+                return member;
+        }
+        return NULL;
+    }
+    slot = hash & hObj->indexMask;
+    while (hObj->index[slot])
+    {
+        member = &hObj->members[hObj->index[slot] - 1];
+        if (_Member_Matches(member, key, sz, length, hash))
+            return member;
+        slot = (slot + 1) & hObj->indexMask;
+    }
+    return NULL;
+}
+
+static _RedJsonMember * _Object_FindS(RedJsonObject hObj, const char *szKey)
+{
+    size_t length = strlen(szKey);
+    return _Object_Find(hObj, NULL, szKey, length, _RedJsonKey_Hash(szKey, length));
+}
+
+static _RedJsonMember * _Object_FindKey(RedJsonObject hObj, RedJsonKey key)
+{
+    return _Object_Find(hObj, key, key->sz, key->length, key->hash);
+}
+
+static void _Object_Add(RedJsonObject hObj, RedJsonKey key, RedJsonValue hVal)
+{
+    _RedJsonMember *member;
+    unsigned slot;
+    hObj->hash = 0;
+    if (hObj->numMembers == hObj->capacity)
+    {
+        hObj->capacity = hObj->capacity ? 2 * hObj->capacity : 4;
+        hObj->members = realloc(hObj->members, hObj->capacity * sizeof(_RedJsonMember));
+        assert(hObj->members);
+        if (hObj->capacity > _RED_JSON_OBJECT_INDEX_THRESHOLD)
+            _Object_Reindex(hObj);
+    }
+    member = &hObj->members[hObj->numMembers++];
+    member->key = REF(key);
+    member->hash = key->hash;
+    member->value = hVal;
+    if (hObj->index)
+    {
+        slot = key->hash & hObj->indexMask;
+        while (hObj->index[slot])
+            slot = (slot + 1) & hObj->indexMask;
+        hObj->index[slot] = hObj->numMembers;
+    }
+}
+
+static RedJsonValue _Object_Get(RedJsonObject hObj, const char *szKey)
+{
+    _RedJsonMember *member = _Object_FindS(hObj, szKey);
+    return member ? member->value : NULL;
+}
+
+static RedJsonValue _Object_MustGet(RedJsonObject hObj, const char *szKey)
+{
+    _RedJsonMember *member = _Object_FindS(hObj, szKey);
+    assert(member && "RedJsonObject: key not found");
+    return member->value;
+}
+
+/*
+ * _Object_Insert - Add a member that must not already exist.
+ */
+static void _Object_Insert(RedJsonObject hObj, const char *szKey, RedJsonValue hVal)
+{
+    size_t length = strlen(szKey);
+    uint32_t hash = _RedJsonKey_Hash(szKey, length);
+    assert(!_Object_Find(hObj, NULL, szKey, length, hash) && "RedJsonObject: duplicate key");
+    _Object_Add(hObj, _RedJsonKey_New(szKey, length, hash), hVal);
+}
+
 RedJsonObject RedJsonObject_New()
 {
     RedJsonObject jsonObj;
-    jsonObj = malloc(sizeof(RedJsonObject_t));
-    jsonObj->hash = RedHash_New(0);
+    jsonObj = calloc(1, sizeof(RedJsonObject_t));
     jsonObj->refcnt = 1;
     return jsonObj;
 }
 
+RedJsonObject RedJsonObject_Clone(RedJsonObject hObj)
+{
+    RedJsonObject hNew = RedJsonObject_New();
+    unsigned i;
+    if (!hObj->numMembers)
+        return hNew;
+    hNew->numMembers = hObj->numMembers;
+    hNew->hash = hObj->hash;
+    hNew->capacity = hObj->capacity;
+    hNew->members = malloc(hObj->capacity * sizeof(_RedJsonMember));
+    assert(hNew->members);
+    memcpy(hNew->members, hObj->members, hObj->numMembers * sizeof(_RedJsonMember));
+    for (i = 0; i < hNew->numMembers; i++)
+    {
+        hNew->members[i].key->refcnt++;
+        hNew->members[i].value->refcnt++;
+    }
+    if (hObj->index)
+    {
+        hNew->indexMask = hObj->indexMask;
+        hNew->index = malloc((hObj->indexMask + 1) * sizeof(uint32_t));
+        assert(hNew->index);
+        memcpy(hNew->index, hObj->index, (hObj->indexMask + 1) * sizeof(uint32_t));
+    }
+    return hNew;
+}
+
 void RedJsonObject_Set(RedJsonObject hObj, const char * szKey, RedJsonValue hVal)
 {
-    hVal->refcnt++;
-    RedHash_InsertS(hObj->hash, szKey, hVal);
+    _Object_Insert(hObj, szKey, hVal);
+}
+
+void RedJsonObject_SetByKey(RedJsonObject hObj, RedJsonKey key, RedJsonValue hVal)
+{
+    assert(!_Object_FindKey(hObj, key) && "RedJsonObject: duplicate key");
+    _Object_Add(hObj, key, hVal);
+}
+
+void _RedJsonObject_PutKey(RedJsonObject hObj, RedJsonKey key, RedJsonValue hVal)
+{
+    _RedJsonMember *member = _Object_FindKey(hObj, key);
+    if (member)
+    {
+        hObj->hash = 0;
+        RedJsonValue_Release(member->value);
+        member->value = hVal;
+        return;
+    }
+    _Object_Add(hObj, key, hVal);
+}
+
+void RedJsonObject_Put(RedJsonObject hObj, const char *szKey, RedJsonValue hVal)
+{
+    size_t length = strlen(szKey);
+    uint32_t hash = _RedJsonKey_Hash(szKey, length);
+    _RedJsonMember *member = _Object_Find(hObj, NULL, szKey, length, hash);
+    if (member)
+    {
+        hObj->hash = 0;
+        RedJsonValue_Release(member->value);
+        member->value = hVal;
+        return;
+    }
+    _Object_Add(hObj, _RedJsonKey_New(szKey, length, hash), hVal);
 }
 
 void RedJsonObject_SetNull(RedJsonObject hObj, const char * szKey)
 {
     RedJsonValue newVal = RedJsonValue_Null();
-    RedHash_InsertS(hObj->hash, szKey, newVal);
+    _Object_Insert(hObj, szKey, newVal);
 }
 
 void RedJsonObject_SetString(RedJsonObject hObj, const char * szKey, const char *szVal)
 {
     RedJsonValue newVal = RedJsonValue_FromString(szVal);
-    RedHash_InsertS(hObj->hash, szKey, newVal);
+    _Object_Insert(hObj, szKey, newVal);
 }
 
 void RedJsonObject_SetNumber(RedJsonObject hObj, const char * szKey, double val)
 {
     RedJsonValue newVal = RedJsonValue_FromNumber(val);
-    RedHash_InsertS(hObj->hash, szKey, newVal);
+    _Object_Insert(hObj, szKey, newVal);
+}
+
+void RedJsonObject_SetInt64(RedJsonObject hObj, const char * szKey, int64_t val)
+{
+    RedJsonValue newVal = RedJsonValue_FromInt64(val);
+    _Object_Insert(hObj, szKey, newVal);
+}
+
+void RedJsonObject_SetUint64(RedJsonObject hObj, const char * szKey, uint64_t val)
+{
+    RedJsonValue newVal = RedJsonValue_FromUint64(val);
+    _Object_Insert(hObj, szKey, newVal);
 }
 
 void RedJsonObject_SetObject(RedJsonObject hObj, const char * szKey, RedJsonObject hObjVal)
 {
     RedJsonValue newVal = RedJsonValue_FromObject(hObjVal);
-    RedHash_InsertS(hObj->hash, szKey, newVal);
+    _Object_Insert(hObj, szKey, newVal);
 }
 
 void RedJsonObject_SetArray(RedJsonObject hObj, const char * szKey, RedJsonArray hArray)
 {
     RedJsonValue newVal = RedJsonValue_FromArray(hArray);
-    RedHash_InsertS(hObj->hash, szKey, newVal);
+    _Object_Insert(hObj, szKey, newVal);
 }
 
 void RedJsonObject_SetBoolean(RedJsonObject hObj, const char * szKey, bool val)
 {
-    RedJsonValue newVal = RedJsonValue_FromBoolean(hObj);
-    RedHash_InsertS(hObj->hash, szKey, newVal);
+    RedJsonValue newVal = RedJsonValue_FromBoolean(val);
+    _Object_Insert(hObj, szKey, newVal);
+}
+
+RedJsonValue RedJsonObject_GetByKey(RedJsonObject hObj, RedJsonKey key)
+{
+    _RedJsonMember *member = _Object_FindKey(hObj, key);
+    return member ? member->value : NULL;
 }
 
 RedJsonValue RedJsonObject_Get(RedJsonObject hObj, const char * szKey)
 {
     RedJsonValue jsonVal;
-    jsonVal = RedHash_GetWithDefaultS(hObj->hash, szKey, NULL);
+    jsonVal = _Object_Get(hObj, szKey);
     return jsonVal;
 }
 
 RedJsonValueTypeEnum RedJsonObject_GetType(RedJsonObject hObj, const char * szKey)
 {
     RedJsonValue jsonVal;
-    jsonVal = RedHash_GetWithDefaultS(hObj->hash, szKey, NULL);
+    jsonVal = _Object_Get(hObj, szKey);
     return jsonVal ? jsonVal->type : RED_JSON_VALUE_TYPE_INVALID;
 }
 
 char * RedJsonObject_GetString(RedJsonObject hObj, const char * szKey)
 {
     RedJsonValue jsonVal;
-    jsonVal = RedHash_GetS(hObj->hash, szKey);
+    jsonVal = _Object_MustGet(hObj, szKey);
     return jsonVal->val.sz;
 }
 double RedJsonObject_GetNumber(RedJsonObject hObj, const char * szKey)
 {
     RedJsonValue jsonVal;
-    jsonVal = RedHash_GetS(hObj->hash, szKey);
-    return jsonVal->val.dbl;
+    jsonVal = _Object_MustGet(hObj, szKey);
+    return _Number_AsDouble(jsonVal);
+}
+int64_t RedJsonObject_GetInt64(RedJsonObject hObj, const char * szKey)
+{
+    RedJsonValue jsonVal;
+    jsonVal = _Object_MustGet(hObj, szKey);
+    return _Number_AsInt64(jsonVal);
+}
+uint64_t RedJsonObject_GetUint64(RedJsonObject hObj, const char * szKey)
+{
+    RedJsonValue jsonVal;
+    jsonVal = _Object_MustGet(hObj, szKey);
+    return _Number_AsUint64(jsonVal);
 }
 RedJsonObject RedJsonObject_GetObject(RedJsonObject hObj, const char * szKey)
 {
     RedJsonValue jsonVal;
-    jsonVal = RedHash_GetS(hObj->hash, szKey);
+    jsonVal = _Object_MustGet(hObj, szKey);
     return jsonVal->val.hObj;
 }
 RedJsonArray RedJsonObject_GetArray(RedJsonObject hObj, const char * szKey)
 {
     RedJsonValue jsonVal;
-    jsonVal = RedHash_GetS(hObj->hash, szKey);
+    jsonVal = _Object_MustGet(hObj, szKey);
     return jsonVal->val.hArray;
 }
+/*
+ * _Value_Unshare - Make the container held in *<pSlot> private to the
+ *      container that owns the slot, replacing it with a shallow copy if
+ *      anything else refers to it.
+ */
+static void _Value_Unshare(RedJsonValue *pSlot)
+{
+    RedJsonValue hVal = *pSlot;
+    RedJsonValue hCopy;
+    if (hVal->type == RED_JSON_VALUE_TYPE_OBJECT)
+    {
+        if (hVal->refcnt == 1 && hVal->val.hObj->refcnt == 1)
+            return;
+        hCopy = RedJsonValue_FromObject(RedJsonObject_Clone(hVal->val.hObj));
+    }
+    else
+    {
+        assert(hVal->type == RED_JSON_VALUE_TYPE_ARRAY);
+        if (hVal->refcnt == 1 && hVal->val.hArray->refcnt == 1)
+            return;
+        hCopy = RedJsonValue_FromArray(RedJsonArray_Clone(hVal->val.hArray));
+    }
+    RedJsonValue_Release(hVal);
+    *pSlot = hCopy;
+}
+
+RedJsonObject RedJsonObject_GetMutableObject(RedJsonObject hObj, const char * szKey)
+{
+    _RedJsonMember *member = _Object_FindS(hObj, szKey);
+    assert(member && "RedJsonObject: key not found");
+    assert(member->value->type == RED_JSON_VALUE_TYPE_OBJECT);
+    hObj->hash = 0;
+    _Value_Unshare(&member->value);
+    return member->value->val.hObj;
+}
+
+RedJsonArray RedJsonObject_GetMutableArray(RedJsonObject hObj, const char * szKey)
+{
+    _RedJsonMember *member = _Object_FindS(hObj, szKey);
+    assert(member && "RedJsonObject: key not found");
+    assert(member->value->type == RED_JSON_VALUE_TYPE_ARRAY);
+    hObj->hash = 0;
+    _Value_Unshare(&member->value);
+    return member->value->val.hArray;
+}
+
 bool RedJsonObject_GetBoolean(RedJsonObject hObj, const char * szKey)
 {
     RedJsonValue jsonVal;
-    jsonVal = RedHash_GetS(hObj->hash, szKey);
+    jsonVal = _Object_MustGet(hObj, szKey);
     return jsonVal->val.boolean;
 }
 
@@ -283,44 +649,65 @@ bool RedJsonObject_IsValueNull(RedJsonObject hObj, const char * szKey)
 
 void RedJsonObject_Unset(RedJsonObject hObj, const char * szKey)
 {
-    // TODO
+    _RedJsonMember *member = _Object_FindS(hObj, szKey);
+    unsigned pos;
+    if (!member)
+        return;
+    pos = member - hObj->members;
+    hObj->hash = 0;
+    _RedJsonKey_Release(member->key);
+    RedJsonValue_Release(member->value);
+    hObj->numMembers--;
+    memmove(member, member + 1, (hObj->numMembers - pos) * sizeof(_RedJsonMember));
+    if (hObj->index)
+        _Object_Reindex(hObj);
 }
+
 bool RedJsonObject_HasKey(RedJsonObject hObj, const char * szKey)
 {
-    return RedHash_HasKeyS(hObj->hash, szKey);
+    return _Object_Get(hObj, szKey) != NULL;
 }
 
 unsigned RedJsonObject_NumItems(RedJsonObject jsonObj)
 {
-    return RedHash_NumItems(jsonObj->hash);
+    return jsonObj->numMembers;
+}
+
+const char * RedJsonObject_GetKeyAt(RedJsonObject hObj, unsigned idx)
+{
+    assert(idx < hObj->numMembers && "RedJsonObject: index out of bounds");
+    return hObj->members[idx].key->sz;
+}
+
+RedJsonValue RedJsonObject_GetValueAt(RedJsonObject hObj, unsigned idx)
+{
+    assert(idx < hObj->numMembers && "RedJsonObject: index out of bounds");
+    return hObj->members[idx].value;
 }
 
 char ** RedJsonObject_NewKeysArray(RedJsonObject jsonObj)
 {
     char **out;
-    RedHashIterator_t iter;
-    const char *key;
-    size_t keySize;
-    const void *value;
     unsigned numKeys;
-    unsigned i=0;
-    
+    unsigned i;
+
     numKeys = RedJsonObject_NumItems(jsonObj);
 
-    out = malloc(numKeys*sizeof(char *));
+    out = malloc((numKeys + 1)*sizeof(char *));
 
-    RED_HASH_FOREACH(iter, jsonObj->hash, (const void **)&key, &keySize, &value)
+    for (i = 0; i < numKeys; i++)
     {
-        out[i] = malloc(keySize);
-        strncpy(out[i], key, keySize);
-        i++;
+        out[i] = _StrDup(jsonObj->members[i].key->sz);
     }
+    out[numKeys] = NULL;
     return out;
 }
 
 void RedJsonObject_FreeKeysArray(char **keysArray)
 {
-    /* TODO: Free each key */
+    unsigned i;
+    for (i = 0; keysArray[i]; i++)
+        free(keysArray[i]);
     free(keysArray);
 }
 RedJsonArray RedJsonArray_New()
@@ -329,601 +716,1076 @@ RedJsonArray RedJsonArray_New()
     hNew = malloc(sizeof(RedJsonArray_t));
     hNew->items = ZARRAY_NEW(RedJsonValue, 0);
     hNew->refcnt = 1;
+    hNew->storage = RED_JSON_ARRAY_STORAGE_VALUES;
+    hNew->numPacked = 0;
+    hNew->packedBytes = 0;
+    hNew->packed.any = NULL;
+    hNew->hash = 0;
     return hNew;
 }
 
-unsigned RedJsonArray_NumItems(RedJsonArray hArray)
+/*
+ *  PACKED ARRAYS
+ */
+
+/* Integers up to 2^53 in magnitude convert to double and back exactly */
+#define _PACKED_EXACT_LIMIT 9007199254740992LL
+
+static size_t _Packed_ElementSize(RedJsonArrayStorageEnum storage)
 {
-    return ZARRAY_NUM_ITEMS(hArray->items);
+    return storage == RED_JSON_ARRAY_STORAGE_BOOLEANS ? sizeof(bool) : sizeof(double);
 }
 
-void RedJsonArray_Append(RedJsonArray hArray, RedJsonValue hVal)
+/*
+ * _Packed_Reserve - Make room for <count> more packed elements.
+ */
+static void _Packed_Reserve(RedJsonArray hArray, unsigned count)
 {
-    ZARRAY_APPEND(hArray->items, hVal);
+    size_t size = _Packed_ElementSize(hArray->storage);
+    size_t needed = ((size_t)hArray->numPacked + count) * size;
+    size_t bytes;
+    if (needed <= hArray->packedBytes)
+        return;
+    for (bytes = hArray->packedBytes ? hArray->packedBytes : 8 * size; bytes < needed; bytes *= 2)
+        ;
+    hArray->packed.any = realloc(hArray->packed.any, bytes);
+    assert(hArray->packed.any);
+    hArray->packedBytes = bytes;
 }
-void RedJsonArray_AppendString(RedJsonArray hArray, char * szVal)
+
+/*
+ * _Packed_Start - Switch an array without elements to packed <storage>,
+ *      reusing any packed buffer it kept.
+ */
+static bool _Packed_Start(RedJsonArray hArray, RedJsonArrayStorageEnum storage)
 {
-    RedJsonValue hVal;
-    hVal = RedJsonValue_FromString(szVal);
-    ZARRAY_APPEND(hArray->items, hVal);
+    if (ZARRAY_NUM_ITEMS(hArray->items))
+        return false;
+    hArray->storage = storage;
+    hArray->numPacked = 0;
+    return true;
 }
-void RedJsonArray_AppendNumber(RedJsonArray hArray, double val)
+
+/*
+ * _Packed_IntsToDoubles - Convert a packed array of int64s into one of
+ *      doubles, if every element converts exactly.
+ */
+static bool _Packed_IntsToDoubles(RedJsonArray hArray)
 {
-    RedJsonValue hVal;
-    hVal = RedJsonValue_FromNumber(val);
-    ZARRAY_APPEND(hArray->items, hVal);
+    unsigned i;
+    int64_t v;
+    for (i = 0; i < hArray->numPacked; i++)
+    {
+        if (hArray->packed.int64s[i] > _PACKED_EXACT_LIMIT || hArray->packed.int64s[i] < -_PACKED_EXACT_LIMIT)
+            return false;
+    }
+    for (i = 0; i < hArray->numPacked; i++)
+    {
+        v = hArray->packed.int64s[i];
+        hArray->packed.doubles[i] = (double)v;
+    }
+    hArray->storage = RED_JSON_ARRAY_STORAGE_DOUBLES;
+    return true;
 }
-void RedJsonArray_AppendObject(RedJsonArray hArray, RedJsonObject hObj)
+
+/*
+ * _Array_PackNumber - Append a number to <hArray> as a packed element if
+ *      the array is empty or packed with numbers it fits with.  Otherwise
+ *      leave the array unpacked and return false, for the caller to append
+ *      a value instead.
+ */
+static bool _Array_PackNumber(RedJsonArray hArray, RedJsonNumberTypeEnum type, int64_t i64, double dbl)
 {
-    RedJsonValue hVal;
-    hVal = RedJsonValue_FromObject(hObj);
-    ZARRAY_APPEND(hArray->items, hVal);
+    bool exact = type == RED_JSON_NUMBER_INT64 && i64 <= _PACKED_EXACT_LIMIT && i64 >= -_PACKED_EXACT_LIMIT;
+    bool fits;
+
+    switch (hArray->storage)
+    {
+        case RED_JSON_ARRAY_STORAGE_VALUES:
+            if (type == RED_JSON_NUMBER_UINT64)
+                return false;
+            fits = _Packed_Start(hArray, type == RED_JSON_NUMBER_INT64
+                    ? RED_JSON_ARRAY_STORAGE_INT64S : RED_JSON_ARRAY_STORAGE_DOUBLES);
+            break;
+        case RED_JSON_ARRAY_STORAGE_INT64S:
+            fits = type == RED_JSON_NUMBER_INT64
+                    || (type == RED_JSON_NUMBER_DOUBLE && _Packed_IntsToDoubles(hArray));
+            break;
+        case RED_JSON_ARRAY_STORAGE_DOUBLES:
+            fits = type == RED_JSON_NUMBER_DOUBLE || exact;
+            break;
+        default:
+            fits = false;
+            break;
+    }
+    if (!fits)
+    {
+        _RedJsonArray_Unpack(hArray);
+        return false;
+    }
+    _Packed_Reserve(hArray, 1);
+    if (hArray->storage == RED_JSON_ARRAY_STORAGE_INT64S)
+        hArray->packed.int64s[hArray->numPacked++] = i64;
+    else
+        hArray->packed.doubles[hArray->numPacked++] = type == RED_JSON_NUMBER_INT64 ? (double)i64 : dbl;
+    hArray->hash = 0;
+    return true;
 }
-void RedJsonArray_AppendArray(RedJsonArray jsonArray, RedJsonArray val)
+
+static bool _Array_PackBoolean(RedJsonArray hArray, bool val)
 {
-    RedJsonValue jsonVal;
-    jsonVal = RedJsonValue_FromArray(val);
-    ZARRAY_APPEND(jsonArray->items, jsonVal);
+    if (hArray->storage != RED_JSON_ARRAY_STORAGE_BOOLEANS
+            && (hArray->storage != RED_JSON_ARRAY_STORAGE_VALUES
+                || !_Packed_Start(hArray, RED_JSON_ARRAY_STORAGE_BOOLEANS)))
+    {
+        _RedJsonArray_Unpack(hArray);
+        return false;
+    }
+    _Packed_Reserve(hArray, 1);
+    hArray->packed.booleans[hArray->numPacked++] = val;
+    hArray->hash = 0;
+    return true;
 }
-void RedJsonArray_AppendBoolean(RedJsonArray hArray, bool val)
+
+static void _Array_PackedEntry(RedJsonArray hArray, unsigned idx, RedJsonValue_t *pEntry)
 {
-    RedJsonValue hVal;
-    hVal = RedJsonValue_FromBoolean(val);
-    ZARRAY_APPEND(hArray->items, hVal);
+    assert(idx < hArray->numPacked);
+    pEntry->refcnt = 1;
+    switch (hArray->storage)
+    {
+        case RED_JSON_ARRAY_STORAGE_DOUBLES:
+            pEntry->type = RED_JSON_VALUE_TYPE_NUMBER;
+            pEntry->meta.numberType = RED_JSON_NUMBER_DOUBLE;
+            pEntry->val.dbl = hArray->packed.doubles[idx];
+            break;
+        case RED_JSON_ARRAY_STORAGE_INT64S:
+            pEntry->type = RED_JSON_VALUE_TYPE_NUMBER;
+            pEntry->meta.numberType = RED_JSON_NUMBER_INT64;
+            pEntry->val.i64 = hArray->packed.int64s[idx];
+            break;
+        default:
+            pEntry->type = RED_JSON_VALUE_TYPE_BOOLEAN;
+            pEntry->val.boolean = hArray->packed.booleans[idx];
+            break;
+    }
 }
-void RedJsonArray_AppendNull(RedJsonArray hArray)
+
+void _RedJsonArray_Unpack(RedJsonArray hArray)
 {
+    RedJsonValue_t entry;
     RedJsonValue hVal;
-    hVal = RedJsonValue_Null();
-    ZARRAY_APPEND(hArray->items, hVal);
+    unsigned i;
+
+    if (hArray->storage == RED_JSON_ARRAY_STORAGE_VALUES)
+        return;
+    ZARRAY_RESIZE(hArray->items, hArray->numPacked);
+    for (i = 0; i < hArray->numPacked; i++)
+    {
+        _Array_PackedEntry(hArray, i, &entry);
+        hVal = malloc(sizeof(RedJsonValue_t));
+        assert(hVal);
+        *hVal = entry;
+        ZARRAY_AT(hArray->items, i) = hVal;
+    }
+    hArray->storage = RED_JSON_ARRAY_STORAGE_VALUES;
+    hArray->numPacked = 0;
+    free(hArray->packed.any);
+    hArray->packed.any = NULL;
+    hArray->packedBytes = 0;
 }
-RedJsonValue RedJsonArray_GetEntry(RedJsonArray jsonArray, unsigned idx)
+
+RedJsonValue _RedJsonArray_Entry(RedJsonArray hArray, unsigned idx, RedJsonValue_t *pEntry)
 {
-    return ZARRAY_AT(jsonArray->items, idx);
+    if (hArray->storage == RED_JSON_ARRAY_STORAGE_VALUES)
+        return ZARRAY_AT(hArray->items, idx);
+    _Array_PackedEntry(hArray, idx, pEntry);
+    return pEntry;
 }
-char * RedJsonArray_GetEntryString(RedJsonArray jsonArray, unsigned idx)
+
+RedJsonArrayStorageEnum RedJsonArray_GetStorage(RedJsonArray hArray)
 {
-    RedJsonValue val;
-    val = ZARRAY_AT(jsonArray->items, idx);
-    return val->val.sz;
+    return hArray->storage;
 }
-double RedJsonArray_GetEntryNumber(RedJsonArray jsonArray, unsigned idx)
+
+const double * RedJsonArray_GetDoubles(RedJsonArray hArray)
 {
-    RedJsonValue val;
-    val = ZARRAY_AT(jsonArray->items, idx);
-    return val->val.dbl;
+    return hArray->storage == RED_JSON_ARRAY_STORAGE_DOUBLES ? hArray->packed.doubles : NULL;
 }
-RedJsonObject RedJsonArray_GetEntryObject(RedJsonArray jsonArray, unsigned idx)
+
+const int64_t * RedJsonArray_GetInt64s(RedJsonArray hArray)
 {
-    RedJsonValue val;
-    val = ZARRAY_AT(jsonArray->items, idx);
-    return val->val.hObj;
+    return hArray->storage == RED_JSON_ARRAY_STORAGE_INT64S ? hArray->packed.int64s : NULL;
 }
-RedJsonArray RedJsonArray_GetEntryArray(RedJsonArray jsonArray, unsigned idx)
+
+const bool * RedJsonArray_GetBooleans(RedJsonArray hArray)
 {
-    RedJsonValue val;
-    val = ZARRAY_AT(jsonArray->items, idx);
-    return val->val.hArray;
+    return hArray->storage == RED_JSON_ARRAY_STORAGE_BOOLEANS ? hArray->packed.booleans : NULL;
+}
+
+void RedJsonArray_AppendDoubles(RedJsonArray hArray, const double *values, unsigned count)
+{
+    unsigned i;
+    if (hArray->storage == RED_JSON_ARRAY_STORAGE_DOUBLES
+            || (hArray->storage == RED_JSON_ARRAY_STORAGE_VALUES
+                && _Packed_Start(hArray, RED_JSON_ARRAY_STORAGE_DOUBLES)))
+    {
+        _Packed_Reserve(hArray, count);
+        memcpy(&hArray->packed.doubles[hArray->numPacked], values, (size_t)count * sizeof(double));
+        hArray->numPacked += count;
+        hArray->hash = 0;
+        return;
+    }
+    for (i = 0; i < count; i++)
+        RedJsonArray_AppendNumber(hArray, values[i]);
+}
+
+RedJsonArray RedJsonArray_Clone(RedJsonArray hArray)
+{
+    RedJsonArray hNew;
+    unsigned i, numItems = ZARRAY_NUM_ITEMS(hArray->items);
+    hNew = RedJsonArray_New();
+    hNew->hash = hArray->hash;
+    if (hArray->storage != RED_JSON_ARRAY_STORAGE_VALUES)
+    {
+        hNew->storage = hArray->storage;
+        _Packed_Reserve(hNew, hArray->numPacked);
+        memcpy(hNew->packed.any, hArray->packed.any, hArray->numPacked * _Packed_ElementSize(hArray->storage));
+        hNew->numPacked = hArray->numPacked;
+        return hNew;
+    }
+    ZARRAY_RESIZE(hNew->items, numItems);
+    for (i = 0; i < numItems; i++)
+        ZARRAY_AT(hNew->items, i) = RedJsonValue_Retain(ZARRAY_AT(hArray->items, i));
+    return hNew;
+}
+
+unsigned RedJsonArray_NumItems(RedJsonArray hArray)
+{
+    if (hArray->storage != RED_JSON_ARRAY_STORAGE_VALUES)
+        return hArray->numPacked;
+    return ZARRAY_NUM_ITEMS(hArray->items);
+}
+
+void RedJsonArray_Append(RedJsonArray hArray, RedJsonValue hVal)
+{
+    _RedJsonArray_Unpack(hArray);
+    hArray->hash = 0;
+    ZARRAY_APPEND(hArray->items, hVal);
+}
+void RedJsonArray_AppendString(RedJsonArray hArray, char * szVal)
+{
+    RedJsonValue hVal;
+    hVal = RedJsonValue_FromString(szVal);
+    RedJsonArray_Append(hArray, hVal);
+}
+void RedJsonArray_AppendNumber(RedJsonArray hArray, double val)
+{
+    RedJsonValue hVal;
+    if (_Array_PackNumber(hArray, RED_JSON_NUMBER_DOUBLE, 0, val))
+        return;
+    hVal = RedJsonValue_FromNumber(val);
+    RedJsonArray_Append(hArray, hVal);
+}
+void RedJsonArray_AppendInt64(RedJsonArray hArray, int64_t val)
+{
+    RedJsonValue hVal;
+    if (_Array_PackNumber(hArray, RED_JSON_NUMBER_INT64, val, 0))
+        return;
+    hVal = RedJsonValue_FromInt64(val);
+    RedJsonArray_Append(hArray, hVal);
+}
+void RedJsonArray_AppendUint64(RedJsonArray hArray, uint64_t val)
+{
+    RedJsonValue hVal;
+    hVal = RedJsonValue_FromUint64(val);
+    RedJsonArray_Append(hArray, hVal);
+}
+void RedJsonArray_AppendObject(RedJsonArray hArray, RedJsonObject hObj)
+{
+    RedJsonValue hVal;
+    hVal = RedJsonValue_FromObject(hObj);
+    RedJsonArray_Append(hArray, hVal);
+}
+void RedJsonArray_AppendArray(RedJsonArray jsonArray, RedJsonArray val)
+{
+    RedJsonValue jsonVal;
+    jsonVal = RedJsonValue_FromArray(val);
+    RedJsonArray_Append(jsonArray, jsonVal);
+}
+void RedJsonArray_AppendBoolean(RedJsonArray hArray, bool val)
+{
+    RedJsonValue hVal;
+    if (_Array_PackBoolean(hArray, val))
+        return;
+    hVal = RedJsonValue_FromBoolean(val);
+    RedJsonArray_Append(hArray, hVal);
+}
+void RedJsonArray_AppendNull(RedJsonArray hArray)
+{
+    RedJsonValue hVal;
+    hVal = RedJsonValue_Null();
+    RedJsonArray_Append(hArray, hVal);
+}
+void RedJsonArray_SetEntry(RedJsonArray hArray, unsigned idx, RedJsonValue hVal)
+{
+    _RedJsonArray_Unpack(hArray);
+    hArray->hash = 0;
+    RedJsonValue_Release(ZARRAY_AT(hArray->items, idx));
+    ZARRAY_AT(hArray->items, idx) = hVal;
+}
+void RedJsonArray_SetEntryString(RedJsonArray hArray, unsigned idx, char * szVal)
+{
+    RedJsonArray_SetEntry(hArray, idx, RedJsonValue_FromString(szVal));
+}
+void RedJsonArray_SetEntryNumber(RedJsonArray hArray, unsigned idx, double val)
+{
+    if (hArray->storage == RED_JSON_ARRAY_STORAGE_DOUBLES)
+    {
+        assert(idx < hArray->numPacked);
+        hArray->hash = 0;
+        hArray->packed.doubles[idx] = val;
+        return;
+    }
+    RedJsonArray_SetEntry(hArray, idx, RedJsonValue_FromNumber(val));
+}
+void RedJsonArray_SetEntryObject(RedJsonArray hArray, unsigned idx, RedJsonObject hObj)
+{
+    RedJsonArray_SetEntry(hArray, idx, RedJsonValue_FromObject(hObj));
+}
+void RedJsonArray_SetEntryArray(RedJsonArray hArray, unsigned idx, RedJsonArray val)
+{
+    RedJsonArray_SetEntry(hArray, idx, RedJsonValue_FromArray(val));
+}
+void RedJsonArray_SetEntryBoolean(RedJsonArray hArray, unsigned idx, bool val)
+{
+    if (hArray->storage == RED_JSON_ARRAY_STORAGE_BOOLEANS)
+    {
+        assert(idx < hArray->numPacked);
+        hArray->hash = 0;
+        hArray->packed.booleans[idx] = val;
+        return;
+    }
+    RedJsonArray_SetEntry(hArray, idx, RedJsonValue_FromBoolean(val));
+}
+void RedJsonArray_SetEntryNull(RedJsonArray hArray, unsigned idx)
+{
+    RedJsonArray_SetEntry(hArray, idx, RedJsonValue_Null());
+}
+
+RedJsonValue RedJsonArray_GetEntry(RedJsonArray jsonArray, unsigned idx)
+{
+    if (jsonArray->storage != RED_JSON_ARRAY_STORAGE_VALUES)
+        return NULL;
+    return ZARRAY_AT(jsonArray->items, idx);
+}
+char * RedJsonArray_GetEntryString(RedJsonArray jsonArray, unsigned idx)
+{
+    RedJsonValue_t entry;
+    return _RedJsonArray_Entry(jsonArray, idx, &entry)->val.sz;
+}
+double RedJsonArray_GetEntryNumber(RedJsonArray jsonArray, unsigned idx)
+{
+    RedJsonValue_t entry;
+    return _Number_AsDouble(_RedJsonArray_Entry(jsonArray, idx, &entry));
+}
+int64_t RedJsonArray_GetEntryInt64(RedJsonArray jsonArray, unsigned idx)
+{
+    RedJsonValue_t entry;
+    return _Number_AsInt64(_RedJsonArray_Entry(jsonArray, idx, &entry));
+}
+uint64_t RedJsonArray_GetEntryUint64(RedJsonArray jsonArray, unsigned idx)
+{
+    RedJsonValue_t entry;
+    return _Number_AsUint64(_RedJsonArray_Entry(jsonArray, idx, &entry));
+}
+RedJsonObject RedJsonArray_GetEntryObject(RedJsonArray jsonArray, unsigned idx)
+{
+    RedJsonValue_t entry;
+    return _RedJsonArray_Entry(jsonArray, idx, &entry)->val.hObj;
+}
+RedJsonArray RedJsonArray_GetEntryArray(RedJsonArray jsonArray, unsigned idx)
+{
+    RedJsonValue_t entry;
+    return _RedJsonArray_Entry(jsonArray, idx, &entry)->val.hArray;
+}
+RedJsonObject RedJsonArray_GetMutableEntryObject(RedJsonArray hArray, unsigned idx)
+{
+    _RedJsonArray_Unpack(hArray);
+    hArray->hash = 0;
+    _Value_Unshare(&ZARRAY_AT(hArray->items, idx));
+    assert(ZARRAY_AT(hArray->items, idx)->type == RED_JSON_VALUE_TYPE_OBJECT);
+    return ZARRAY_AT(hArray->items, idx)->val.hObj;
+}
+RedJsonArray RedJsonArray_GetMutableEntryArray(RedJsonArray hArray, unsigned idx)
+{
+    _RedJsonArray_Unpack(hArray);
+    hArray->hash = 0;
+    _Value_Unshare(&ZARRAY_AT(hArray->items, idx));
+    assert(ZARRAY_AT(hArray->items, idx)->type == RED_JSON_VALUE_TYPE_ARRAY);
+    return ZARRAY_AT(hArray->items, idx)->val.hArray;
 }
 bool RedJsonArray_GetEntryBoolean(RedJsonArray jsonArray, unsigned idx)
 {
-    RedJsonValue val;
-    val = ZARRAY_AT(jsonArray->items, idx);
-    return val->val.boolean;
+    RedJsonValue_t entry;
+    return _RedJsonArray_Entry(jsonArray, idx, &entry)->val.boolean;
 }
 bool RedJsonArray_IsEntryString(RedJsonArray hArray, unsigned idx)
 {
-    return (ZARRAY_AT(hArray->items, idx)->type == RED_JSON_VALUE_TYPE_STRING);
+    RedJsonValue_t entry;
+    return (_RedJsonArray_Entry(hArray, idx, &entry)->type == RED_JSON_VALUE_TYPE_STRING);
 }
 bool RedJsonArray_IsEntryNumber(RedJsonArray hArray, unsigned idx)
 {
-    return (ZARRAY_AT(hArray->items, idx)->type == RED_JSON_VALUE_TYPE_NUMBER);
+    RedJsonValue_t entry;
+    return (_RedJsonArray_Entry(hArray, idx, &entry)->type == RED_JSON_VALUE_TYPE_NUMBER);
 }
 bool RedJsonArray_IsEntryObject(RedJsonArray hArray, unsigned idx)
 {
-    return (ZARRAY_AT(hArray->items, idx)->type == RED_JSON_VALUE_TYPE_OBJECT);
+    RedJsonValue_t entry;
+    return (_RedJsonArray_Entry(hArray, idx, &entry)->type == RED_JSON_VALUE_TYPE_OBJECT);
 }
 bool RedJsonArray_IsEntryArray(RedJsonArray hArray, unsigned idx)
 {
-    return (ZARRAY_AT(hArray->items, idx)->type == RED_JSON_VALUE_TYPE_ARRAY);
+    RedJsonValue_t entry;
+    return (_RedJsonArray_Entry(hArray, idx, &entry)->type == RED_JSON_VALUE_TYPE_ARRAY);
 }
 bool RedJsonArray_IsEntryBoolean(RedJsonArray hArray, unsigned idx)
 {
-    return (ZARRAY_AT(hArray->items, idx)->type == RED_JSON_VALUE_TYPE_BOOLEAN);
+    RedJsonValue_t entry;
+    return (_RedJsonArray_Entry(hArray, idx, &entry)->type == RED_JSON_VALUE_TYPE_BOOLEAN);
 }
 bool RedJsonArray_IsEntryNull(RedJsonArray hArray, unsigned idx)
 {
-    return (ZARRAY_AT(hArray->items, idx)->type == RED_JSON_VALUE_TYPE_NULL);
+    RedJsonValue_t entry;
+    return (_RedJsonArray_Entry(hArray, idx, &entry)->type == RED_JSON_VALUE_TYPE_NULL);
 }
 
 
-void _Value_ToJson(RedStringList chain, RedJsonValue hVal)
+/*
+ * Parser: a single pass over the text with an explicit stack of open
+ * containers, so nesting is bounded by maxDepth instead of the C stack.  Each
+ * container is attached to its parent as soon as it is opened, so on failure
+ * destroying the root frees everything parsed so far.
+ */
+RedJsonError_t _RedJson_ErrorAt(const char *text, size_t offset, RedJsonErrorEnum code)
 {
-    switch (hVal->type)
+    RedJsonError_t error;
+    size_t i, lineStart = 0;
+    error.code = code;
+    error.offset = offset;
+    error.line = 1;
+    for (i = 0; i < offset; i++)
     {
-        case RED_JSON_VALUE_TYPE_STRING:
-        {
-            // TODO: escape
-            RedStringList_AppendPrintf(chain, "\"%s\"", hVal->val.sz);
-            break;
-        }
-        case RED_JSON_VALUE_TYPE_NUMBER:
-        {
-            // TODO: formatting?
-            RedStringList_AppendPrintf(chain, "%lf", hVal->val.dbl);
-            break;
-        }
-        case RED_JSON_VALUE_TYPE_BOOLEAN:
-        {
-            RedStringList_AppendPrintf(chain, "%s", hVal->val.boolean ? "true" : "false");
-            break;
-        }
-        case RED_JSON_VALUE_TYPE_OBJECT:
-        {
-            RedHashIterator_t iter;
-            const char *key;
-            size_t keySize;
-            const void *value;
-            int numItems;
-            int i;
-            RedStringList_AppendPrintf(chain, "{\n");
-            numItems = RedHash_NumItems(hVal->val.hObj->hash);
-            i = 0;
-            RED_HASH_FOREACH(iter, hVal->val.hObj->hash, (const void **)&key, &keySize, &value)
-            {
-                RedJsonValue val = (RedJsonValue)value;
-                RedStringList_AppendPrintf(chain, "\"%s\" : ", key);
-                _Value_ToJson(chain, val);
-                if (i < numItems - 1)
-                {
-                    RedStringList_AppendPrintf(chain, ",\n");
-                }
-                else
-                {
-                    RedStringList_AppendPrintf(chain, "\n");
-                }
-                i++;
-            }
-            RedStringList_AppendPrintf(chain, "}\n");
-            break;
-        }
-        case RED_JSON_VALUE_TYPE_ARRAY:
-        {
-            int i, numItems;
-            ZARRAY(RedJsonValue) items;
-            RedStringList_AppendChars(chain, "[");
-            items = (void *)hVal->val.hArray->items;
-            numItems = ZARRAY_NUM_ITEMS(items);
-            for (i = 0; i < numItems; i++)
-            {
-                RedJsonValue hItemVal = ZARRAY_AT(items, i);
-                _Value_ToJson(chain, hItemVal);
-                if (i < numItems - 1)
-                    RedStringList_AppendChars(chain, ", ");
-            }
-            RedStringList_AppendChars(chain, "]");
-            break;
-        }
-        case RED_JSON_VALUE_TYPE_NULL:
+        if (text[i] == '\n')
         {
-            RedStringList_AppendChars(chain, "null");
-            break;
-        }
-        case RED_JSON_VALUE_TYPE_INVALID:
-        {
-            assert("!Unexpected JSON type!");
-            break;
+            error.line++;
+            lineStart = i + 1;
         }
     }
+    error.column = (unsigned)(offset - lineStart) + 1;
+    return error;
 }
 
-char * RedJsonValue_ToJsonString(RedJsonValue hVal)
+const char * _RedJson_SkipSpace(const char *p, const char *end)
 {
-    RedStringList chain = RedStringList_New();
-    char * out;
-    _Value_ToJson(chain, hVal);
-    out = RedStringList_ToNewChars(chain);
-    RedStringList_Free(chain);
-    return out;
+    for (;;)
+    {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+            p++;
+        if (end - p < 2 || p[0] != '/' || p[1] != '*')
+            return p;
+        for (p += 2; end - p >= 2 && (p[0] != '*' || p[1] != '/'); p++)
+            ;
+        if (end - p < 2)
+            return NULL;
+        p += 2;
+    }
 }
 
-char * RedJsonObject_ToJsonString(RedJsonObject jsonObj)
+RedJsonValue _RedJsonValue_TakeString(char *sz)
 {
-    char *out;
-    RedJsonValue val = RedJsonValue_FromObject(jsonObj);
-    out = RedJsonValue_ToJsonString(val);
-    return out;
+    RedJsonValue hNew = malloc(sizeof(RedJsonValue_t));
+    hNew->type = RED_JSON_VALUE_TYPE_STRING;
+    hNew->meta.backing = NULL;
+    hNew->val.sz = sz;
+    hNew->refcnt = 1;
+    return hNew;
 }
 
-typedef enum _JsonTokenEnum
+static RedJsonValue _RedJsonValue_FromView(char *sz, _RedJsonBacking *backing)
 {
-    _JSON_TOKEN_OPEN_CURLY_BRACE,
-    _JSON_TOKEN_CLOSE_CURLY_BRACE,
-    _JSON_TOKEN_OPEN_SQUARE_BRACE,
-    _JSON_TOKEN_CLOSE_SQUARE_BRACE,
-    _JSON_TOKEN_COLON,
-    _JSON_TOKEN_COMMA,
-    _JSON_TOKEN_STRING,
-    _JSON_TOKEN_NUMBER,
-    _JSON_TOKEN_BOOL,
-    _JSON_TOKEN_NULL,
-} _JsonTokenEnum;
+    RedJsonValue hNew = malloc(sizeof(RedJsonValue_t));
+    hNew->type = RED_JSON_VALUE_TYPE_STRING;
+    hNew->meta.backing = backing;
+    hNew->val.sz = sz;
+    hNew->refcnt = 1;
+    backing->refcnt++;
+    return hNew;
+}
 
-typedef struct _JsonToken
+/*
+ * _Parse_IsPlain - Check whether the string body at <s> needs no decoding:
+ *      it is closed before <end>, has no escapes and is valid UTF-8.  Sets
+ *      *<pLength> to its length if so.
+ */
+static bool _Parse_IsPlain(const char *s, const char *end, size_t *pLength)
 {
-    struct _JsonToken *next;
-    _JsonTokenEnum type;
-    union
-    {
-        bool valBool;
-        double valDbl;
-        char *valString;
-    } val;
-} _JsonToken;
+    size_t n = _RedJson_FindEscape(s, end - s);
+    unsigned state = _RED_JSON_UTF8_ACCEPT;
+    *pLength = n;
+    return s + n < end && s[n] == '"' && _RedJson_ValidateUtf8(s, n, &state) == n && state == _RED_JSON_UTF8_ACCEPT;
+}
 
-static _JsonToken * _EmitSimpleToken(_JsonToken *parent, _JsonTokenEnum type)
+/*
+ * _Parse_StringView - Decode the string body at <s> in place and
+ *      null-terminate it.  The decoded text is never longer than the escaped
+ *      text, and the terminator takes the place of the closing quote.
+ */
+static RedJsonErrorEnum _Parse_StringView(char *s, const char *end, const char **pStop)
 {
-    switch (type)
+    RedJsonErrorEnum err;
+    char *decoded;
+    size_t n;
+
+    if (_Parse_IsPlain(s, end, &n))
     {
-        case _JSON_TOKEN_OPEN_CURLY_BRACE:
-        case _JSON_TOKEN_CLOSE_CURLY_BRACE:
-        case _JSON_TOKEN_OPEN_SQUARE_BRACE:
-        case _JSON_TOKEN_CLOSE_SQUARE_BRACE:
-        case _JSON_TOKEN_COLON:
-        case _JSON_TOKEN_COMMA:
-        case _JSON_TOKEN_NULL:
-        {
-            _JsonToken *token = calloc(1, sizeof(_JsonToken));
-            if (token)
-            {
-                token->type = type;
-                if (parent)
-                    parent->next = token;
-            }
-            return token;
-        }
-        default:
-        {
-            assert(!"Bad token type in _EmitSimpleToken");
-            return NULL;
-        }
+        s[n] = 0;
+        *pStop = &s[n];
+        return RED_JSON_OK;
     }
-}
-
-static _JsonToken * _EmitBoolToken(_JsonToken *parent, bool value)
-{
-    _JsonToken *token = calloc(1, sizeof(_JsonToken));
-    if (token)
+    err = _RedJson_DecodeString(s, end, false, &decoded, &n, pStop);
+    if (err)
+        return err;
+    memcpy(s, decoded, n + 1);
+    free(decoded);
+    return RED_JSON_OK;
+}
+
+/*
+ * _Parse_Key - Decode the key body at <s> and intern it in <keys>.  Keys
+ *      that need no decoding are interned straight from the text.  Returns
+ *      a new reference.
+ */
+static RedJsonErrorEnum _Parse_Key(RedJsonKeyTable keys, const char *s, const char *end, RedJsonKey *pKey, const char **pStop)
+{
+    RedJsonErrorEnum err;
+    char *sz;
+    size_t n;
+
+    if (_Parse_IsPlain(s, end, &n))
+    {
+        *pKey = _RedJsonKeyTable_InternN(keys, s, n);
+        *pStop = s + n;
+    }
+    else
     {
-        token->type = _JSON_TOKEN_BOOL;
-        token->val.valBool = value;
-        if (parent)
-            parent->next = token;
+        err = _RedJson_DecodeString(s, end, true, &sz, &n, pStop);
+        if (err)
+            return err;
+        *pKey = _RedJsonKeyTable_InternN(keys, sz, n);
+        free(sz);
     }
-    return token;
+    (*pKey)->refcnt++;
+    return RED_JSON_OK;
 }
 
-static _JsonToken * _EmitNumberToken(_JsonToken *parent, double value)
+/*
+ * _Parse_NewValue - Take a value node from <pool>, or from the heap if
+ *      <pool> is NULL or empty.  Only the reference count and <type> are set.
+ */
+static RedJsonValue _Parse_NewValue(_RedJsonPool *pool, RedJsonValueTypeEnum type)
 {
-    _JsonToken *token = calloc(1, sizeof(_JsonToken));
-    if (token)
+    RedJsonValue hNew;
+    unsigned n;
+    if (pool && (n = ZARRAY_NUM_ITEMS(pool->values)) != 0)
+    {
+        hNew = ZARRAY_AT(pool->values, n - 1);
+        ZARRAY_TRUNCATE(pool->values, n - 1);
+    }
+    else
     {
-        token->type = _JSON_TOKEN_NUMBER;
-        token->val.valDbl = value;
-        if (parent)
-            parent->next = token;
+        hNew = malloc(sizeof(RedJsonValue_t));
+        assert(hNew);
     }
-    return token;
+    hNew->refcnt = 1;
+    hNew->type = type;
+    return hNew;
 }
 
-static _JsonToken * _EmitStringToken(_JsonToken *parent, const char *stringStart, size_t stringLength)
+static RedJsonObject _Parse_NewObject(_RedJsonPool *pool)
 {
-    _JsonToken *token = calloc(1, sizeof(_JsonToken));
-    if (token)
-    {
-        token->type = _JSON_TOKEN_STRING;
-        token->val.valString = calloc(1, stringLength+1);
-        strncpy(token->val.valString, stringStart, stringLength);
-        if (parent)
-            parent->next = token;
-    }
-    return token;
+    RedJsonObject hNew;
+    unsigned n;
+    if (!pool || (n = ZARRAY_NUM_ITEMS(pool->objects)) == 0)
+        return RedJsonObject_New();
+    hNew = ZARRAY_AT(pool->objects, n - 1);
+    ZARRAY_TRUNCATE(pool->objects, n - 1);
+    hNew->refcnt = 1;
+    return hNew;
 }
 
-static RedJsonObject _ParseObject(_JsonToken **head);
-static RedJsonArray _ParseArray(_JsonToken **head);
+static RedJsonArray _Parse_NewArray(_RedJsonPool *pool)
+{
+    RedJsonArray hNew;
+    unsigned n;
+    if (!pool || (n = ZARRAY_NUM_ITEMS(pool->arrays)) == 0)
+        return RedJsonArray_New();
+    hNew = ZARRAY_AT(pool->arrays, n - 1);
+    ZARRAY_TRUNCATE(pool->arrays, n - 1);
+    hNew->refcnt = 1;
+    return hNew;
+}
 
-static RedJsonValue _ParseValue(_JsonToken **head)
+/*
+ * _Pool_Reserve - Find a string chunk of <pool> with <size> bytes free at
+ *      <pool>->used, moving on to the next chunk, or adding one, as needed.
+ */
+static _RedJsonBacking * _Pool_Reserve(_RedJsonPool *pool, size_t size)
 {
-    RedJsonValue val;
-    switch ((*head)->type)
+    _RedJsonBacking *chunk;
+    while (pool->chunk < ZARRAY_NUM_ITEMS(pool->chunks))
     {
-        case _JSON_TOKEN_OPEN_CURLY_BRACE:
-        {
-            RedJsonObject obj;
-            obj = _ParseObject(head);
-            /* TODO: error handling */
-            val = RedJsonValue_FromObject(obj);
-            return val;
-        }
-        case _JSON_TOKEN_OPEN_SQUARE_BRACE:
-        {
-            RedJsonArray array;
-            array = _ParseArray(head);
-            val = RedJsonValue_FromArray(array);
-            return val;
-        }
-        case _JSON_TOKEN_STRING:
-        {
-            char *sz;
-            sz = (*head)->val.valString;
-            val = RedJsonValue_FromString(sz);
-            *head = (*head)->next;
-            return val;
-        }
-        case _JSON_TOKEN_NUMBER:
-        {
-            double dbl;
-            dbl = (*head)->val.valDbl;
-            val = RedJsonValue_FromNumber(dbl);
-            *head = (*head)->next;
-            return val;
-        }
-        case _JSON_TOKEN_BOOL:
-        {
-            bool b;
-            b = (*head)->val.valBool;
-            val = RedJsonValue_FromBoolean(b);
-            *head = (*head)->next;
-            return val;
-        }
-        case _JSON_TOKEN_NULL:
-        {
-            *head = (*head)->next;
-            return RedJsonValue_Null();
-        }
+        chunk = ZARRAY_AT(pool->chunks, pool->chunk);
+        if (chunk->length - pool->used >= size)
+            return chunk;
+        pool->chunk++;
+        pool->used = 0;
+    }
+    chunk = malloc(sizeof(_RedJsonBacking));
+    assert(chunk);
+    chunk->refcnt = 1;
+    chunk->mapped = false;
+    chunk->length = size > _RED_JSON_POOL_CHUNK_SIZE ? size : _RED_JSON_POOL_CHUNK_SIZE;
+    chunk->base = malloc(chunk->length);
+    assert(chunk->base);
+    ZARRAY_APPEND(pool->chunks, chunk);
+    return chunk;
+}
+
+/*
+ * _Parse_PooledString - Decode the string body at <s> into a chunk of
+ *      <pool>.  The value takes a reference to the chunk.
+ */
+static RedJsonErrorEnum _Parse_PooledString(_RedJsonPool *pool, const char *s, const char *end, RedJsonValue *pVal, const char **pStop)
+{
+    _RedJsonBacking *chunk;
+    RedJsonErrorEnum err;
+    const char *quote;
+    bool escaped;
+    char *sz;
+    size_t n;
+
+    err = _RedJson_ScanString(s, end, &escaped, &quote);
+    if (err)
+    {
+        *pStop = quote;
+        return err;
+    }
+    chunk = _Pool_Reserve(pool, quote - s + 1);
+    sz = chunk->base + pool->used;
+    err = _RedJson_UnescapeString(s, quote, escaped, false, sz, &n, pStop);
+    if (err)
+        return err;
+    pool->used += n + 1;
+    chunk->refcnt++;
+    *pVal = _Parse_NewValue(pool, RED_JSON_VALUE_TYPE_STRING);
+    (*pVal)->meta.backing = chunk;
+    (*pVal)->val.sz = sz;
+    *pStop = quote;
+    return RED_JSON_OK;
+}
+
+static RedJsonValue _Parse_NumberValue(_RedJsonPool *pool, const _RedJsonNumber *pNum)
+{
+    RedJsonValue hNew = _Parse_NewValue(pool, RED_JSON_VALUE_TYPE_NUMBER);
+    hNew->meta.numberType = pNum->type;
+    switch (pNum->type)
+    {
+        case RED_JSON_NUMBER_INT64:
+            hNew->val.i64 = pNum->i64;
+            break;
+        case RED_JSON_NUMBER_UINT64:
+            hNew->val.u64 = pNum->u64;
+            break;
         default:
-        {
-            fprintf(stderr, "Value expected, got %d\n", (*head)->type);
-            return NULL;
-        }
+            hNew->val.dbl = pNum->dbl;
+            break;
     }
+    return hNew;
 }
 
-static RedJsonArray _ParseArray(_JsonToken **head)
+/*
+ * _Parse_Attach - Add <val> to the container of <frame>, under <key> for an
+ *      object.  Consumes the caller's reference to <key>.
+ *
+ *      A key already checked to be new (<unique>) is added without another
+ *      lookup.  A member losing to an earlier one of the same key goes to
+ *      <discard> instead, which keeps it alive while it is being filled.
+ */
+static void _Parse_Attach(_RedJsonParseFrame *frame, RedJsonKey key, RedJsonValue val, RedJsonObject discard, bool unique)
 {
-    RedJsonArray array;
-
-    array = RedJsonArray_New();
-
-    if ((*head)->type != _JSON_TOKEN_OPEN_SQUARE_BRACE)
+    frame->empty = false;
+    if (frame->obj)
     {
-        fprintf(stderr, "'[' expected at start of array\n");
-        return NULL;
+        if (discard)
+            _Object_Add(discard, key, val);
+        else if (unique)
+            _Object_Add(frame->obj, key, val);
+        else
+            _RedJsonObject_PutKey(frame->obj, key, val);
+        _RedJsonKey_Release(key);
     }
-    (*head) = (*head)->next;
-
-    while ((*head)->type != _JSON_TOKEN_CLOSE_SQUARE_BRACE)
+    else
     {
-        RedJsonValue val;
-        /* consume value */
-        val = _ParseValue(head);
-        if (!val)
-        {
-            return NULL;
-        }
-        RedJsonArray_Append(array, val);
-
-        if ((*head)->type != _JSON_TOKEN_CLOSE_SQUARE_BRACE)
-        {
-            if ((*head)->type != _JSON_TOKEN_COMMA)
-            {
-                fprintf(stderr, "',' expected between array values %d %d\n", (*head)->type, (*head)->next->type);
-                return NULL;
-            }
-            (*head) = (*head)->next;
-        }
+        RedJsonArray_Append(frame->array, val);
     }
-    (*head) = (*head)->next;
-
-    return array;
 }
 
-static RedJsonObject _ParseObject(_JsonToken **head)
+static void _Parse_ReleaseObject(_RedJsonPool *pool, RedJsonObject hObj)
 {
-    RedJsonObject obj;
-    char *key;
-    obj = RedJsonObject_New();
+    if (pool)
+        _RedJsonPool_RecycleObject(pool, hObj);
+    else
+        RedJsonObject_Release(hObj);
+}
 
-    /* consume { */
-    if ((*head)->type != _JSON_TOKEN_OPEN_CURLY_BRACE)
-    {
-        fprintf(stderr, "'{' expected at start of object\n");
-        return NULL;
-    }
-    (*head) = (*head)->next;
+static char _Parse_Closer(const _RedJsonParseFrame *frame)
+{
+    return frame->obj ? '}' : ']';
+}
 
-    while ((*head)->type != _JSON_TOKEN_CLOSE_CURLY_BRACE)
-    {
-        RedJsonValue val;
-        /* consume KEY */
-        if ((*head)->type != _JSON_TOKEN_STRING)
-        {
-            fprintf(stderr, "'\"' expected at start of string key\n");
-            return NULL;
-        }
-        key = (*head)->val.valString;
-        (*head) = (*head)->next;
+static bool _Parse_IsNumberChar(char c)
+{
+    return (c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-';
+}
 
-        /* consume : */
-        if ((*head)->type != _JSON_TOKEN_COLON)
-        {
-            fprintf(stderr, "':' expected between key and value\n");
-            return NULL;
-        }
-        (*head) = (*head)->next;
+RedJsonObject RedJson_Parse(const char *text)
+{
+    return RedJson_ParseWithOptions(text, strlen(text), NULL, NULL);
+}
 
-        val = _ParseValue(head);
-        if (!val)
-        {
-            return NULL;
-        }
+RedJsonObject RedJson_ParseWithKeyTable(const char *text, RedJsonKeyTable keys)
+{
+    RedJsonParseOptions_t options;
+    memset(&options, 0, sizeof(options));
+    options.keys = keys;
+    return RedJson_ParseWithOptions(text, strlen(text), &options, NULL);
+}
 
-        if ((*head)->type != _JSON_TOKEN_CLOSE_CURLY_BRACE)
-        {
-            if ((*head)->type != _JSON_TOKEN_COMMA)
-            {
-                fprintf(stderr, "',' expected between object properties %d %d\n", (*head)->type, (*head)->next->type);
-                fprintf(stderr, "',' expected between object properties\n");
-                return NULL;
-            }
-            (*head) = (*head)->next;
-        }
-        RedJsonObject_Set(obj, key, val);
-    }
-    (*head) = (*head)->next;
-    return obj;
+RedJsonObject RedJson_ParseWithOptions(
+        const char *text,
+        size_t length,
+        const RedJsonParseOptions_t *pOptions,
+        RedJsonError_t *pError)
+{
+    return _RedJson_ParseText(text, length, pOptions, pError, NULL, NULL);
 }
 
-RedJsonObject RedJson_Parse(const char *text)
+RedJsonObject _RedJson_ParseText(
+        const char *text,
+        size_t length,
+        const RedJsonParseOptions_t *pOptions,
+        RedJsonError_t *pError,
+        _RedJsonBacking *views,
+        _RedJsonPool *pool)
 {
-    _JsonToken *tokens = NULL, *tail = NULL;
-    RedJsonObject out;
-    /* Tokenize */
-    while (*text)
+    const char *p = text;
+    const char *end = text + length;
+    const char *stop;
+    unsigned maxDepth = (pOptions && pOptions->maxDepth) ? pOptions->maxDepth : RED_JSON_DEFAULT_MAX_DEPTH;
+    RedJsonKeyTable keys = pOptions ? pOptions->keys : NULL;
+    RedJsonDuplicateKeyEnum duplicates = pOptions ? pOptions->duplicateKeys : RED_JSON_DUPLICATE_KEY_LAST_WINS;
+    bool ownsKeys = !keys && !pool;
+    bool unique = false;
+    ZARRAY(_RedJsonParseFrame) stack;
+    _RedJsonParseFrame frame, *top;
+    RedJsonObject root = NULL;
+    RedJsonObject discard = NULL, dropInto = NULL;
+    RedJsonKey key = NULL;
+    RedJsonValue val;
+    RedJsonErrorEnum err;
+    _RedJsonNumber num;
+    size_t n;
+    char *sz;
+
+    if (!keys)
+        keys = pool ? pool->keys : _RedJsonKeyTable_NewPrivate();
+    stack = pool ? pool->stack : ZARRAY_NEW(_RedJsonParseFrame, 0);
+
+    p = _RedJson_SkipSpace(p, end);
+    if (!p || p == end)
+        goto fail_end;
+    if (*p != '{')
+        goto fail_char;
+    root = _Parse_NewObject(pool);
+    frame.obj = root;
+    frame.array = NULL;
+    frame.empty = true;
+    ZARRAY_APPEND(stack, frame);
+    p++;
+
+    for (;;)
     {
-        switch (text[0])
+        /* Expect a member or element, or the end of a still empty container */
+        top = &ZARRAY_TAIL(stack);
+        p = _RedJson_SkipSpace(p, end);
+        if (!p || p == end)
+            goto fail_end;
+        if (!top->empty || *p != _Parse_Closer(top))
         {
-            case '{':
-                tail = _EmitSimpleToken(tail, _JSON_TOKEN_OPEN_CURLY_BRACE);
-                text++;
-                break;
-            case '}':
-                tail = _EmitSimpleToken(tail, _JSON_TOKEN_CLOSE_CURLY_BRACE);
-                text++;
-                break;
-            case '[':
-                tail = _EmitSimpleToken(tail, _JSON_TOKEN_OPEN_SQUARE_BRACE);
-                text++;
-                break;
-            case ']':
-                tail = _EmitSimpleToken(tail, _JSON_TOKEN_CLOSE_SQUARE_BRACE);
-                text++;
-                break;
-            case ',':
-                tail = _EmitSimpleToken(tail, _JSON_TOKEN_COMMA);
-                text++;
-                break;
-            case ':':
-                tail = _EmitSimpleToken(tail, _JSON_TOKEN_COLON);
-                text++;
-                break;
-            case 't':
-                if (!strncmp(text, "true", 4))
-                {
-                    tail = _EmitBoolToken(tail, true);
-                    text = &text[4];
-                }
-                else
-                {
-                    goto fail;
-                }
-                break;
-            case 'f':
-                if (!strncmp(text, "false", 5))
-                {
-                    tail = _EmitBoolToken(tail, false);
-                    text = &text[5];
-                }
-                else
-                {
-                    goto fail;
-                }
-                break;
-            case 'n':
-                if (!strncmp(text, "null", 4))
-                {
-                    tail = _EmitSimpleToken(tail, _JSON_TOKEN_NULL);
-                    text = &text[4];
-                }
-                else
-                {
-                    goto fail;
-                }
-                break;
-            case '"':
+            if (top->obj)
             {
-                // consume string
-                const char *stringStart = text + 1;
-                text = stringStart;
-                while (*text && *text != '"')
+                if (*p != '"')
+                    goto fail_char;
+                err = _Parse_Key(keys, p + 1, end, &key, &stop);
+                if (err)
                 {
-                    text++;
-                }
-                tail = _EmitStringToken(tail, stringStart, text - stringStart);
-
-                if (!*text) {
-                    /* unterminated parentheses */
+                    p = stop;
                     goto fail;
                 }
-
-                /* TODO: handle end-of-input */
-                text++;
-                break;
-            }
-            case '/':
-            {
-                if (text[1] == '*')
+                if (duplicates != RED_JSON_DUPLICATE_KEY_LAST_WINS)
                 {
-                    text++;
-                    // consume comment
-                    while (text[0] && text[1] && (text[0] != '*' || text[1] != '/'))
+                    /* The one lookup PutKey would have made, done up front */
+                    unique = !_Object_FindKey(top->obj, key);
+                    if (!unique && duplicates == RED_JSON_DUPLICATE_KEY_ERROR)
                     {
-                        text++;
+                        err = RED_JSON_ERROR_DUPLICATE_KEY;
+                        goto fail;
+                    }
+                    if (!unique)
+                    {
+                        if (!discard)
+                            discard = _Parse_NewObject(pool);
+                        dropInto = discard;
                     }
-
-                    text += 2;
-                }
-                else
-                {
-                    goto fail;
                 }
-                break;
+                p = _RedJson_SkipSpace(stop + 1, end);
+                if (!p || p == end)
+                    goto fail_end;
+                if (*p != ':')
+                    goto fail_char;
+                p = _RedJson_SkipSpace(p + 1, end);
+                if (!p || p == end)
+                    goto fail_end;
             }
 
-            default:
+            switch (*p)
             {
-                if ((text[0] >= '0' && text[0] <= '9') || text[0] == '-')
-                {
-                    double val;
-                    val = strtod(&text[0], (char **)&text);
-                    tail = _EmitNumberToken(tail, val);
-                    // TODO: handle exponentials
-
-                }
-                else if (isspace(text[0]))
-                {
-                    text++;
-                }
-                else
-                {
-                    goto fail;
-                }
-                break;
+                case '{':
+                case '[':
+                    if (ZARRAY_NUM_ITEMS(stack) >= maxDepth)
+                    {
+                        err = RED_JSON_ERROR_DEPTH_EXCEEDED;
+                        goto fail;
+                    }
+                    frame.empty = true;
+                    if (*p == '{')
+                    {
+                        frame.obj = _Parse_NewObject(pool);
+                        frame.array = NULL;
+                        val = _Parse_NewValue(pool, RED_JSON_VALUE_TYPE_OBJECT);
+                        val->val.hObj = frame.obj;
+                    }
+                    else
+                    {
+                        frame.obj = NULL;
+                        frame.array = _Parse_NewArray(pool);
+                        val = _Parse_NewValue(pool, RED_JSON_VALUE_TYPE_ARRAY);
+                        val->val.hArray = frame.array;
+                    }
+                    _Parse_Attach(top, key, val, dropInto, unique);
+                    key = NULL;
+                    dropInto = NULL;
+                    ZARRAY_APPEND(stack, frame);
+                    p++;
+                    continue;
+                case '"':
+                    if (views)
+                        err = _Parse_StringView((char *)p + 1, end, &stop);
+                    else if (pool)
+                        err = _Parse_PooledString(pool, p + 1, end, &val, &stop);
+                    else
+                        err = _RedJson_DecodeString(p + 1, end, false, &sz, &n, &stop);
+                    if (err)
+                    {
+                        p = stop;
+                        goto fail;
+                    }
+                    if (views)
+                        val = _RedJsonValue_FromView((char *)p + 1, views);
+                    else if (!pool)
+                        val = _RedJsonValue_TakeString(sz);
+                    p = stop + 1;
+                    break;
+                case 't':
+                    if (end - p < 4 || memcmp(p, "true", 4))
+                        goto fail_char;
+                    if (top->array && _Array_PackBoolean(top->array, true))
+                        val = NULL;
+                    else
+                    {
+                        val = _Parse_NewValue(pool, RED_JSON_VALUE_TYPE_BOOLEAN);
+                        val->val.boolean = true;
+                    }
+                    p += 4;
+                    break;
+                case 'f':
+                    if (end - p < 5 || memcmp(p, "false", 5))
+                        goto fail_char;
+                    if (top->array && _Array_PackBoolean(top->array, false))
+                        val = NULL;
+                    else
+                    {
+                        val = _Parse_NewValue(pool, RED_JSON_VALUE_TYPE_BOOLEAN);
+                        val->val.boolean = false;
+                    }
+                    p += 5;
+                    break;
+                case 'n':
+                    if (end - p < 4 || memcmp(p, "null", 4))
+                        goto fail_char;
+                    val = _Parse_NewValue(pool, RED_JSON_VALUE_TYPE_NULL);
+                    p += 4;
+                    break;
+                default:
+                    if (*p != '-' && (*p < '0' || *p > '9'))
+                        goto fail_char;
+                    n = _RedJson_ParseNumber(p, end, &num);
+                    if (!n || (p + n < end && _Parse_IsNumberChar(p[n])))
+                    {
+                        err = RED_JSON_ERROR_BAD_NUMBER;
+                        goto fail;
+                    }
+                    if (top->array && _Array_PackNumber(top->array, num.type, num.i64, num.dbl))
+                        val = NULL;
+                    else
+                        val = _Parse_NumberValue(pool, &num);
+                    p += n;
+                    break;
             }
+            /* Numbers and booleans packed straight into an array leave no value */
+            if (val)
+                _Parse_Attach(top, key, val, dropInto, unique);
+            else
+                top->empty = false;
+            key = NULL;
+            dropInto = NULL;
+
+            p = _RedJson_SkipSpace(p, end);
+            if (!p || p == end)
+                goto fail_end;
+            if (*p == ',')
+            {
+                p++;
+                continue;
+            }
+            if (*p != _Parse_Closer(top))
+                goto fail_char;
         }
-        if (tail && !tokens)
+
+        /* *p closes the top container, and possibly its ancestors after it.
+         * The stack is never shrunk, so a pooled stack stops reallocating
+         * once it has reached the deepest nesting seen. */
+        for (;;)
         {
-            /* keep track of first token */
-            tokens = tail;
+            p++;
+            ZARRAY_TRUNCATE(stack, ZARRAY_NUM_ITEMS(stack) - 1);
+            if (!ZARRAY_NUM_ITEMS(stack))
+                goto done;
+            p = _RedJson_SkipSpace(p, end);
+            if (!p || p == end)
+                goto fail_end;
+            if (*p == ',')
+            {
+                p++;
+                break;
+            }
+            if (*p != _Parse_Closer(&ZARRAY_TAIL(stack)))
+                goto fail_char;
         }
     }
 
-    /* Parse into object tree */
-    out = _ParseObject(&tokens);
-    return out;
+done:
+    p = _RedJson_SkipSpace(p, end);
+    if (!p)
+        goto fail_end;
+    if (p != end)
+        goto fail_char;
+    if (!pool)
+        ZARRAY_FREE(stack);
+    if (discard)
+        _Parse_ReleaseObject(pool, discard);
+    if (ownsKeys)
+        RedJsonKeyTable_Free(keys);
+    return root;
+
+fail_end:
+    p = end;
+    err = RED_JSON_ERROR_UNEXPECTED_END;
+    goto fail;
+fail_char:
+    err = RED_JSON_ERROR_UNEXPECTED_CHAR;
 fail:
-    fprintf(stderr, "Failure parsing JSON!");
+    if (key)
+        _RedJsonKey_Release(key);
+    if (discard)
+        _Parse_ReleaseObject(pool, discard);
+    if (pool)
+    {
+        ZARRAY_TRUNCATE(stack, 0);
+        if (root)
+            _RedJsonPool_RecycleObject(pool, root);
+    }
+    else
+    {
+        RedJsonObject_Release(root);
+        ZARRAY_FREE(stack);
+    }
+    if (ownsKeys)
+        RedJsonKeyTable_Free(keys);
+    if (pError)
+        *pError = _RedJson_ErrorAt(text, p - text, err);
     return NULL;
 }
 
+const char * RedJsonError_ToString(RedJsonErrorEnum code)
+{
+    switch (code)
+    {
+        case RED_JSON_OK:
+            return "success";
+        case RED_JSON_ERROR_UNEXPECTED_CHAR:
+            return "unexpected character";
+        case RED_JSON_ERROR_UNEXPECTED_END:
+            return "unexpected end of input";
+        case RED_JSON_ERROR_BAD_NUMBER:
+            return "malformed number";
+        case RED_JSON_ERROR_BAD_STRING:
+            return "control character in string";
+        case RED_JSON_ERROR_BAD_ESCAPE:
+            return "invalid escape sequence";
+        case RED_JSON_ERROR_ABORTED:
+            return "aborted by callback";
+        case RED_JSON_ERROR_OUT_OF_MEMORY:
+            return "out of memory";
+        case RED_JSON_ERROR_IO:
+            return "I/O error";
+        case RED_JSON_ERROR_BAD_UTF8:
+            return "invalid UTF-8 in string";
+        case RED_JSON_ERROR_NOT_FOUND:
+            return "not found";
+        case RED_JSON_ERROR_WRONG_TYPE:
+            return "wrong value type";
+        case RED_JSON_ERROR_DEPTH_EXCEEDED:
+            return "nesting too deep";
+        case RED_JSON_ERROR_BAD_CBOR:
+            return "malformed or unsupported CBOR";
+        case RED_JSON_ERROR_BAD_PATH:
+            return "invalid path expression";
+        case RED_JSON_ERROR_TEST_FAILED:
+            return "patch test failed";
+        case RED_JSON_ERROR_DUPLICATE_KEY:
+            return "duplicate key";
+    }
+    return "unknown error";
+}
@@ -0,0 +1,531 @@
+/*
+ *  red_json_bind.c - Parse JSON objects straight into C structs.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ *
+ *  Each field table is compiled into a _BindTable holding a small perfect
+ *  hash from keys to fields.  The hash normally looks at only the length and
+ *  three bytes of a key (first, middle and last), which is enough to tell the
+ *  keys of most schemas apart; tables where it is not fall back to the full
+ *  key hash.  Either way a lookup is one multiply, one slot load and one
+ *  memcmp to confirm the match.
+ */
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Slots hold a field index plus one, so a table has at most 255 fields */
+#define _BIND_MAX_FIELDS 255
+
+/* Multipliers tried per table size before doubling the table */
+#define _BIND_SEED_ATTEMPTS 64
+
+typedef struct _BindTable _BindTable;
+
+typedef struct
+{
+    const char *key;
+    size_t keyLength;
+    RedJsonFieldTypeEnum type;
+    size_t offset;
+    _BindTable *nested;
+} _BindField;
+
+struct _BindTable
+{
+    _BindField *fields;
+    unsigned numFields;
+    bool fullHash;          /* hash whole keys instead of sampling bytes */
+    uint32_t multiplier;
+    unsigned shift;
+    unsigned char *slots;
+
+    /* Where this table sits in its parent, to get back out of it */
+    _BindTable *parent;
+    size_t parentOffset;
+};
+
+struct RedJsonBinding_t
+{
+    _BindTable *root;
+};
+
+static uint32_t _Bind_KeyBits(const char *s, size_t n, bool fullHash)
+{
+    if (fullHash)
+        return _RedJsonKey_Hash(s, n);
+    if (!n)
+        return 0;
+    return (uint32_t)(n & 0xFF)
+        | (uint32_t)(unsigned char)s[0] << 8
+        | (uint32_t)(unsigned char)s[n / 2] << 16
+        | (uint32_t)(unsigned char)s[n - 1] << 24;
+}
+
+static unsigned _Bind_Slot(const _BindTable *t, const char *s, size_t n)
+{
+    return (unsigned)((_Bind_KeyBits(s, n, t->fullHash) * t->multiplier) >> t->shift);
+}
+
+/*
+ * _BindTable_TryHash - Try to place every field in a table of 2^<bits> slots
+ *      without collisions.
+ */
+static bool _BindTable_TryHash(_BindTable *t, unsigned bits)
+{
+    unsigned attempt, i, slot;
+
+    t->shift = 32 - bits;
+    for (attempt = 0; attempt < _BIND_SEED_ATTEMPTS; attempt++)
+    {
+        t->multiplier = (0x9E3779B1u + attempt * 0x6A09E668u) | 1;
+        memset(t->slots, 0, (size_t)1 << bits);
+        for (i = 0; i < t->numFields; i++)
+        {
+            slot = _Bind_Slot(t, t->fields[i].key, t->fields[i].keyLength);
+            if (t->slots[slot])
+                break;
+            t->slots[slot] = (unsigned char)(i + 1);
+        }
+        if (i == t->numFields)
+            return true;
+    }
+    return false;
+}
+
+static void _BindTable_Free(_BindTable *t)
+{
+    unsigned i;
+    if (!t)
+        return;
+    for (i = 0; i < t->numFields; i++)
+        _BindTable_Free(t->fields[i].nested);
+    free(t->fields);
+    free(t->slots);
+    free(t);
+}
+
+static _BindTable * _BindTable_New(const RedJsonField_t *fields, _BindTable *parent, size_t parentOffset)
+{
+    _BindTable *t = calloc(1, sizeof(*t));
+    unsigned n, i, j, bits;
+
+    if (!t)
+        return NULL;
+    t->parent = parent;
+    t->parentOffset = parentOffset;
+    for (n = 0; fields[n].szKey; n++)
+        ;
+    assert(n <= _BIND_MAX_FIELDS);
+    t->fields = calloc(n ? n : 1, sizeof(*t->fields));
+    if (!t->fields)
+        goto fail;
+    t->numFields = n;
+    for (i = 0; i < n; i++)
+    {
+        _BindField *f = &t->fields[i];
+        f->key = fields[i].szKey;
+        f->keyLength = strlen(f->key);
+        f->type = fields[i].type;
+        f->offset = fields[i].offset;
+        for (j = 0; j < i; j++)
+            assert(f->keyLength != t->fields[j].keyLength || memcmp(f->key, t->fields[j].key, f->keyLength));
+        if (f->type == RED_JSON_FIELD_OBJECT)
+        {
+            assert(fields[i].nested);
+            f->nested = _BindTable_New(fields[i].nested, t, f->offset);
+            if (!f->nested)
+                goto fail;
+        }
+    }
+
+    /* Start at twice the field count and grow; sampled bytes first */
+    for (bits = 1; (1u << bits) < 2 * n; bits++)
+        ;
+    t->slots = malloc((size_t)1 << (bits + 3));
+    if (!t->slots)
+        goto fail;
+    for (t->fullHash = false; ; t->fullHash = true)
+    {
+        for (j = bits; j <= bits + 3; j++)
+        {
+            if (_BindTable_TryHash(t, j))
+                return t;
+        }
+        /* Distinct 32-bit hashes can still collide; that is not expected
+         * for any realistic schema */
+        assert(!t->fullHash);
+    }
+
+fail:
+    _BindTable_Free(t);
+    return NULL;
+}
+
+static const _BindField * _BindTable_Find(const _BindTable *t, const char *s, size_t n)
+{
+    unsigned idx = t->slots[_Bind_Slot(t, s, n)];
+    const _BindField *f;
+    if (!idx)
+        return NULL;
+    f = &t->fields[idx - 1];
+    return (f->keyLength == n && !memcmp(f->key, s, n)) ? f : NULL;
+}
+
+RedJsonBinding RedJsonBinding_New(const RedJsonField_t *fields)
+{
+    RedJsonBinding binding = malloc(sizeof(*binding));
+    if (!binding)
+        return NULL;
+    binding->root = _BindTable_New(fields, NULL, 0);
+    if (!binding->root)
+    {
+        free(binding);
+        return NULL;
+    }
+    return binding;
+}
+
+void RedJsonBinding_Free(RedJsonBinding binding)
+{
+    if (!binding)
+        return;
+    _BindTable_Free(binding->root);
+    free(binding);
+}
+
+/*
+ *  PARSING
+ *
+ *  Bound objects nest exactly like the structs they fill, so the current
+ *  table's parent link replaces a stack: entering a nested object moves the
+ *  base pointer forward by the member offset and leaving it moves it back.
+ *  Values of unknown keys are skipped by ignoring events until the matching
+ *  END event.
+ */
+
+typedef struct
+{
+    const _BindTable *root;
+    const _BindTable *table;    /* object being filled, or NULL */
+    char *base;                 /* struct that <table> describes */
+    const _BindField *field;    /* member the next value goes to */
+    bool skipping;
+    unsigned skipDepth;
+    bool done;
+    RedJsonErrorEnum err;
+} _BindParse;
+
+static bool _Bind_Fail(_BindParse *s, RedJsonErrorEnum err)
+{
+    s->err = err;
+    return false;
+}
+
+static bool _Bind_Number(_BindParse *s, const _BindField *field, const RedJsonEvent_t *e)
+{
+    void *dest = s->base + field->offset;
+    int64_t i64;
+
+    switch (field->type)
+    {
+        case RED_JSON_FIELD_DOUBLE:
+            *(double *)dest = e->number;
+            return true;
+        case RED_JSON_FIELD_UINT64:
+            if (e->numberType == RED_JSON_NUMBER_UINT64)
+                *(uint64_t *)dest = e->uint64;
+            else if (e->numberType == RED_JSON_NUMBER_INT64 && e->int64 >= 0)
+                *(uint64_t *)dest = (uint64_t)e->int64;
+            else
+                break;
+            return true;
+        case RED_JSON_FIELD_INT64:
+        case RED_JSON_FIELD_INT32:
+            if (e->numberType == RED_JSON_NUMBER_INT64)
+                i64 = e->int64;
+            else if (e->numberType == RED_JSON_NUMBER_UINT64 && e->uint64 <= INT64_MAX)
+                i64 = (int64_t)e->uint64;
+            else
+                break;
+            if (field->type == RED_JSON_FIELD_INT64)
+                *(int64_t *)dest = i64;
+            else if (i64 >= INT32_MIN && i64 <= INT32_MAX)
+                *(int32_t *)dest = (int32_t)i64;
+            else
+                break;
+            return true;
+        default:
+            break;
+    }
+    return _Bind_Fail(s, RED_JSON_ERROR_WRONG_TYPE);
+}
+
+static bool _Bind_String(_BindParse *s, const _BindField *field, const RedJsonEvent_t *e)
+{
+    char **dest = (char **)(s->base + field->offset);
+    char *copy;
+
+    if (field->type != RED_JSON_FIELD_STRING)
+        return _Bind_Fail(s, RED_JSON_ERROR_WRONG_TYPE);
+    copy = malloc(e->length + 1);
+    if (!copy)
+        return _Bind_Fail(s, RED_JSON_ERROR_OUT_OF_MEMORY);
+    memcpy(copy, e->sz, e->length + 1);
+    free(*dest);
+    *dest = copy;
+    return true;
+}
+
+static bool _Bind_OnEvent(const RedJsonEvent_t *e, void *userData)
+{
+    _BindParse *s = userData;
+    const _BindField *field = s->field;
+
+    if (s->skipping)
+    {
+        if ((e->type == RED_JSON_EVENT_END_OBJECT || e->type == RED_JSON_EVENT_END_ARRAY)
+                && e->depth == s->skipDepth)
+            s->skipping = false;
+        return true;
+    }
+    if (!s->table)
+    {
+        /* Only a single top-level object is accepted */
+        if (s->done)
+            return _Bind_Fail(s, RED_JSON_ERROR_UNEXPECTED_CHAR);
+        if (e->type != RED_JSON_EVENT_BEGIN_OBJECT)
+            return _Bind_Fail(s, RED_JSON_ERROR_WRONG_TYPE);
+        s->table = s->root;
+        return true;
+    }
+
+    switch (e->type)
+    {
+        case RED_JSON_EVENT_KEY:
+            s->field = _BindTable_Find(s->table, e->sz, e->length);
+            return true;
+        case RED_JSON_EVENT_END_OBJECT:
+            s->base -= s->table->parentOffset;
+            s->table = s->table->parent;
+            s->done = !s->table;
+            return true;
+        default:
+            break;
+    }
+
+    s->field = NULL;
+    if (!field)
+    {
+        if (e->type == RED_JSON_EVENT_BEGIN_OBJECT || e->type == RED_JSON_EVENT_BEGIN_ARRAY)
+        {
+            s->skipping = true;
+            s->skipDepth = e->depth;
+        }
+        return true;
+    }
+    switch (e->type)
+    {
+        case RED_JSON_EVENT_BEGIN_OBJECT:
+            if (field->type != RED_JSON_FIELD_OBJECT)
+                break;
+            s->table = field->nested;
+            s->base += field->offset;
+            return true;
+        case RED_JSON_EVENT_STRING:
+            return _Bind_String(s, field, e);
+        case RED_JSON_EVENT_NUMBER:
+            return _Bind_Number(s, field, e);
+        case RED_JSON_EVENT_BOOLEAN:
+            if (field->type != RED_JSON_FIELD_BOOLEAN)
+                break;
+            *(bool *)(s->base + field->offset) = e->boolean;
+            return true;
+        case RED_JSON_EVENT_NULL:
+            if (field->type == RED_JSON_FIELD_STRING)
+            {
+                free(*(char **)(s->base + field->offset));
+                *(char **)(s->base + field->offset) = NULL;
+            }
+            return true;
+        default:
+            break;
+    }
+    return _Bind_Fail(s, RED_JSON_ERROR_WRONG_TYPE);
+}
+
+RedJsonErrorEnum RedJsonBinding_Parse(
+        RedJsonBinding binding,
+        const char *text,
+        size_t length,
+        void *pStruct,
+        RedJsonError_t *pError)
+{
+    RedJsonStreamParser parser;
+    RedJsonErrorEnum err;
+    RedJsonError_t error;
+    _BindParse s;
+
+    memset(&s, 0, sizeof(s));
+    s.root = binding->root;
+    s.base = pStruct;
+    parser = RedJsonStreamParser_New(_Bind_OnEvent, &s);
+    if (!parser)
+        return RED_JSON_ERROR_OUT_OF_MEMORY;
+    err = RedJsonStreamParser_Feed(parser, text, length);
+    if (!err)
+        err = RedJsonStreamParser_Finish(parser);
+    error = RedJsonStreamParser_GetError(parser);
+    if (!err && !s.done)
+    {
+        /* Empty input; a partial object is caught by Finish */
+        err = RED_JSON_ERROR_UNEXPECTED_END;
+        error = _RedJson_ErrorAt(text, length, err);
+    }
+    else if (err == RED_JSON_ERROR_ABORTED && s.err)
+    {
+        err = s.err;
+    }
+    RedJsonStreamParser_Free(parser);
+    if (err && pError)
+    {
+        *pError = error;
+        pError->code = err;
+    }
+    return err;
+}
+
+/*
+ *  OUTPUT
+ */
+
+static RedJsonErrorEnum _Bind_WriteTable(const _BindTable *t, const char *base, RedJsonWriter w)
+{
+    RedJsonErrorEnum err = RedJsonWriter_BeginObject(w);
+    const _BindField *f;
+    const char *sz;
+    unsigned i;
+
+    for (i = 0; !err && i < t->numFields; i++)
+    {
+        f = &t->fields[i];
+        err = RedJsonWriter_Key(w, f->key);
+        if (err)
+            break;
+        switch (f->type)
+        {
+            case RED_JSON_FIELD_INT32:
+                err = RedJsonWriter_Int64(w, *(const int32_t *)(base + f->offset));
+                break;
+            case RED_JSON_FIELD_INT64:
+                err = RedJsonWriter_Int64(w, *(const int64_t *)(base + f->offset));
+                break;
+            case RED_JSON_FIELD_UINT64:
+                err = RedJsonWriter_Uint64(w, *(const uint64_t *)(base + f->offset));
+                break;
+            case RED_JSON_FIELD_DOUBLE:
+                err = RedJsonWriter_Number(w, *(const double *)(base + f->offset));
+                break;
+            case RED_JSON_FIELD_BOOLEAN:
+                err = RedJsonWriter_Boolean(w, *(const bool *)(base + f->offset));
+                break;
+            case RED_JSON_FIELD_STRING:
+                sz = *(char * const *)(base + f->offset);
+                err = sz ? RedJsonWriter_String(w, sz) : RedJsonWriter_Null(w);
+                break;
+            case RED_JSON_FIELD_OBJECT:
+                err = _Bind_WriteTable(f->nested, base + f->offset, w);
+                break;
+        }
+    }
+    return err ? err : RedJsonWriter_EndObject(w);
+}
+
+RedJsonErrorEnum RedJsonBinding_Write(RedJsonBinding binding, const void *pStruct, RedJsonWriter writer)
+{
+    return _Bind_WriteTable(binding->root, pStruct, writer);
+}
+
+typedef struct
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+} _BindBuffer;
+
+static bool _Bind_Append(const char *data, size_t length, void *userData)
+{
+    _BindBuffer *buf = userData;
+    char *grown;
+    if (buf->length + length + 1 > buf->capacity)
+    {
+        buf->capacity = 2 * (buf->length + length + 1);
+        grown = realloc(buf->data, buf->capacity);
+        if (!grown)
+            return false;
+        buf->data = grown;
+    }
+    memcpy(buf->data + buf->length, data, length);
+    buf->length += length;
+    return true;
+}
+
+char * RedJsonBinding_ToJsonString(RedJsonBinding binding, const void *pStruct)
+{
+    _BindBuffer buf = { NULL, 0, 0 };
+    RedJsonWriter w = RedJsonWriter_NewCallback(_Bind_Append, &buf, RED_JSON_FORMAT_COMPACT);
+    RedJsonErrorEnum err;
+
+    if (!w)
+        return NULL;
+    err = RedJsonBinding_Write(binding, pStruct, w);
+    if (!err)
+        err = RedJsonWriter_Finish(w);
+    RedJsonWriter_Free(w);
+    if (err)
+    {
+        free(buf.data);
+        return NULL;
+    }
+    buf.data[buf.length] = '\0';
+    return buf.data;
+}
+
+static void _Bind_FreeTable(const _BindTable *t, char *base)
+{
+    const _BindField *f;
+    unsigned i;
+    for (i = 0; i < t->numFields; i++)
+    {
+        f = &t->fields[i];
+        if (f->type == RED_JSON_FIELD_STRING)
+        {
+            free(*(char **)(base + f->offset));
+            *(char **)(base + f->offset) = NULL;
+        }
+        else if (f->type == RED_JSON_FIELD_OBJECT)
+        {
+            _Bind_FreeTable(f->nested, base + f->offset);
+        }
+    }
+}
+
+void RedJsonBinding_FreeMembers(RedJsonBinding binding, void *pStruct)
+{
+    _Bind_FreeTable(binding->root, pStruct);
+}
@@ -0,0 +1,822 @@
+/*
+ *  red_json_cbor.c - Resumable CBOR (RFC 8949) decoder producing the same
+ *  events as the JSON stream parser.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ */
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _CBOR_INDEFINITE UINT64_MAX
+
+/*
+ * Decoder states.  An item's head may be split across chunks (_CBOR_ARG), as
+ * may the bytes of a text string (_CBOR_STRING).
+ */
+typedef enum
+{
+    _CBOR_HEAD,
+    _CBOR_ARG,
+    _CBOR_STRING,
+} _CborStateEnum;
+
+/*
+ * An open array or map.  <remaining> counts elements, or map entries, still
+ * to come, or is _CBOR_INDEFINITE until a break byte.  <wantKey> is set when
+ * the next item of a map is a key.
+ */
+typedef struct
+{
+    uint64_t remaining;
+    bool isMap;
+    bool wantKey;
+} _CborFrame;
+
+struct _RedJsonCborDecoder_t
+{
+    _CborStateEnum state;
+    unsigned char initial;
+    unsigned argBytes;
+    uint64_t arg;
+
+    uint64_t stringRemaining;
+    bool chunked;
+    unsigned utf8State;
+    char *token;
+    size_t tokenLength;
+    size_t tokenCapacity;
+
+    ZARRAY(_CborFrame) stack;
+
+    RedJsonEventCallback fnOnEvent;
+    void *userData;
+};
+
+_RedJsonCborDecoder * _RedJsonCborDecoder_New(RedJsonEventCallback fnOnEvent, void *userData)
+{
+    _RedJsonCborDecoder *d = calloc(1, sizeof(_RedJsonCborDecoder));
+    if (!d)
+        return NULL;
+    d->stack = ZARRAY_NEW(_CborFrame, 0);
+    if (!d->stack)
+    {
+        free(d);
+        return NULL;
+    }
+    d->fnOnEvent = fnOnEvent;
+    d->userData = userData;
+    _RedJsonCborDecoder_Reset(d);
+    return d;
+}
+
+void _RedJsonCborDecoder_Reset(_RedJsonCborDecoder *d)
+{
+    ZARRAY_RESIZE(d->stack, 0);
+    d->state = _CBOR_HEAD;
+    d->chunked = false;
+    d->tokenLength = 0;
+    d->utf8State = _RED_JSON_UTF8_ACCEPT;
+}
+
+void _RedJsonCborDecoder_Free(_RedJsonCborDecoder *d)
+{
+    if (!d)
+        return;
+    ZARRAY_FREE(d->stack);
+    free(d->token);
+    free(d);
+}
+
+bool _RedJsonCborDecoder_InItem(_RedJsonCborDecoder *d)
+{
+    return d->state != _CBOR_HEAD || d->chunked || ZARRAY_NUM_ITEMS(d->stack);
+}
+
+static bool _Cbor_Reserve(_RedJsonCborDecoder *d, size_t extra)
+{
+    size_t needed = d->tokenLength + extra + 1;
+    if (needed > d->tokenCapacity)
+    {
+        size_t newCapacity = d->tokenCapacity ? d->tokenCapacity : 64;
+        char *newToken;
+        while (newCapacity < needed)
+            newCapacity *= 2;
+        newToken = realloc(d->token, newCapacity);
+        if (!newToken)
+            return false;
+        d->token = newToken;
+        d->tokenCapacity = newCapacity;
+    }
+    return true;
+}
+
+static RedJsonErrorEnum _Cbor_Emit(_RedJsonCborDecoder *d, RedJsonEvent_t *event)
+{
+    event->depth = ZARRAY_NUM_ITEMS(d->stack);
+    return d->fnOnEvent(event, d->userData) ? RED_JSON_OK : RED_JSON_ERROR_ABORTED;
+}
+
+static RedJsonErrorEnum _Cbor_EmitSimple(_RedJsonCborDecoder *d, RedJsonEventEnum type)
+{
+    RedJsonEvent_t event;
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    return _Cbor_Emit(d, &event);
+}
+
+static bool _Cbor_WantKey(_RedJsonCborDecoder *d)
+{
+    return ZARRAY_NUM_ITEMS(d->stack) && ZARRAY_TAIL(d->stack).wantKey;
+}
+
+static RedJsonErrorEnum _Cbor_Close(_RedJsonCborDecoder *d)
+{
+    bool isMap = ZARRAY_TAIL(d->stack).isMap;
+    ZARRAY_SHRINK_BY_ONE(d->stack);
+    return _Cbor_EmitSimple(d, isMap ? RED_JSON_EVENT_END_OBJECT : RED_JSON_EVENT_END_ARRAY);
+}
+
+/*
+ * _Cbor_AfterItem - Account for a completed data item in the enclosing
+ *      container, closing every definite length container it completes.
+ */
+static RedJsonErrorEnum _Cbor_AfterItem(_RedJsonCborDecoder *d)
+{
+    RedJsonErrorEnum err;
+    _CborFrame *top;
+
+    while (ZARRAY_NUM_ITEMS(d->stack))
+    {
+        top = &ZARRAY_TAIL(d->stack);
+        if (top->isMap)
+        {
+            top->wantKey = !top->wantKey;
+            if (!top->wantKey)
+                return RED_JSON_OK;
+        }
+        if (top->remaining == _CBOR_INDEFINITE || --top->remaining)
+            return RED_JSON_OK;
+        err = _Cbor_Close(d);
+        if (err)
+            return err;
+    }
+    return RED_JSON_OK;
+}
+
+static RedJsonErrorEnum _Cbor_CompleteString(_RedJsonCborDecoder *d)
+{
+    RedJsonEvent_t event;
+    RedJsonErrorEnum err;
+
+    if (d->utf8State != _RED_JSON_UTF8_ACCEPT)
+        return RED_JSON_ERROR_BAD_UTF8;
+    if (!_Cbor_Reserve(d, 0))
+        return RED_JSON_ERROR_OUT_OF_MEMORY;
+    d->token[d->tokenLength] = '\0';
+    memset(&event, 0, sizeof(event));
+    event.type = _Cbor_WantKey(d) ? RED_JSON_EVENT_KEY : RED_JSON_EVENT_STRING;
+    event.sz = d->token;
+    event.length = d->tokenLength;
+    d->state = _CBOR_HEAD;
+    d->chunked = false;
+    err = _Cbor_Emit(d, &event);
+    return err ? err : _Cbor_AfterItem(d);
+}
+
+static RedJsonErrorEnum _Cbor_EmitNumber(_RedJsonCborDecoder *d, RedJsonEvent_t *event)
+{
+    RedJsonErrorEnum err;
+    event->type = RED_JSON_EVENT_NUMBER;
+    err = _Cbor_Emit(d, event);
+    return err ? err : _Cbor_AfterItem(d);
+}
+
+static double _Cbor_HalfToDouble(uint16_t half)
+{
+    unsigned exponent = (half >> 10) & 0x1F;
+    unsigned mantissa = half & 0x3FF;
+    double val;
+    if (exponent == 0)
+        val = ldexp(mantissa, -24);
+    else if (exponent == 31)
+        val = mantissa ? NAN : INFINITY;
+    else
+        val = ldexp(mantissa + 1024, (int)exponent - 25);
+    return (half & 0x8000) ? -val : val;
+}
+
+/*
+ * _Cbor_Item - Act on a data item whose head has been read completely.
+ */
+static RedJsonErrorEnum _Cbor_Item(_RedJsonCborDecoder *d)
+{
+    unsigned major = d->initial >> 5;
+    unsigned info = d->initial & 0x1F;
+    bool indefinite = (info == 31);
+    RedJsonEvent_t event;
+    _CborFrame frame;
+    uint32_t bits32;
+    float flt;
+    RedJsonErrorEnum err;
+
+    d->state = _CBOR_HEAD;
+
+    /* Only definite length text strings may appear inside a chunked string,
+     * and only (possibly tagged) text strings may be used as keys */
+    if (d->chunked && (major != 3 || indefinite))
+        return RED_JSON_ERROR_BAD_CBOR;
+    if (_Cbor_WantKey(d) && major != 3 && major != 6)
+        return RED_JSON_ERROR_BAD_CBOR;
+
+    memset(&event, 0, sizeof(event));
+    switch (major)
+    {
+        case 0:
+            if (d->arg <= INT64_MAX)
+            {
+                event.numberType = RED_JSON_NUMBER_INT64;
+                event.int64 = (int64_t)d->arg;
+            }
+            else
+            {
+                event.numberType = RED_JSON_NUMBER_UINT64;
+                event.uint64 = d->arg;
+            }
+            event.number = (double)d->arg;
+            return _Cbor_EmitNumber(d, &event);
+        case 1:
+            if (d->arg <= INT64_MAX)
+            {
+                event.numberType = RED_JSON_NUMBER_INT64;
+                event.int64 = -1 - (int64_t)d->arg;
+                event.number = (double)event.int64;
+            }
+            else
+            {
+                event.numberType = RED_JSON_NUMBER_DOUBLE;
+                event.number = -1.0 - (double)d->arg;
+            }
+            return _Cbor_EmitNumber(d, &event);
+        case 3:
+            if (indefinite)
+            {
+                d->chunked = true;
+                d->tokenLength = 0;
+                d->utf8State = _RED_JSON_UTF8_ACCEPT;
+                return RED_JSON_OK;
+            }
+            if (!d->chunked)
+            {
+                d->tokenLength = 0;
+                d->utf8State = _RED_JSON_UTF8_ACCEPT;
+            }
+            d->stringRemaining = d->arg;
+            if (!d->stringRemaining)
+                return d->chunked ? RED_JSON_OK : _Cbor_CompleteString(d);
+            d->state = _CBOR_STRING;
+            return RED_JSON_OK;
+        case 4:
+        case 5:
+            frame.remaining = indefinite ? _CBOR_INDEFINITE : d->arg;
+            frame.isMap = (major == 5);
+            frame.wantKey = frame.isMap;
+            err = _Cbor_EmitSimple(d, frame.isMap ? RED_JSON_EVENT_BEGIN_OBJECT : RED_JSON_EVENT_BEGIN_ARRAY);
+            if (err)
+                return err;
+            ZARRAY_APPEND(d->stack, frame);
+            if (frame.remaining)
+                return RED_JSON_OK;
+            err = _Cbor_Close(d);
+            return err ? err : _Cbor_AfterItem(d);
+        case 6:
+            /* Tags carry semantics JSON has no use for; decode the item */
+            return indefinite ? RED_JSON_ERROR_BAD_CBOR : RED_JSON_OK;
+        case 7:
+            switch (info)
+            {
+                case 20:
+                case 21:
+                    event.type = RED_JSON_EVENT_BOOLEAN;
+                    event.boolean = (info == 21);
+                    break;
+                case 22:
+                case 23:
+                    event.type = RED_JSON_EVENT_NULL;
+                    break;
+                case 25:
+                    event.numberType = RED_JSON_NUMBER_DOUBLE;
+                    event.number = _Cbor_HalfToDouble((uint16_t)d->arg);
+                    return _Cbor_EmitNumber(d, &event);
+                case 26:
+                    bits32 = (uint32_t)d->arg;
+                    memcpy(&flt, &bits32, sizeof(flt));
+                    event.numberType = RED_JSON_NUMBER_DOUBLE;
+                    event.number = flt;
+                    return _Cbor_EmitNumber(d, &event);
+                case 27:
+                    event.numberType = RED_JSON_NUMBER_DOUBLE;
+                    memcpy(&event.number, &d->arg, sizeof(event.number));
+                    return _Cbor_EmitNumber(d, &event);
+                default:
+                    return RED_JSON_ERROR_BAD_CBOR;
+            }
+            err = _Cbor_Emit(d, &event);
+            return err ? err : _Cbor_AfterItem(d);
+        default:
+            /* Byte strings have no JSON equivalent */
+            return RED_JSON_ERROR_BAD_CBOR;
+    }
+}
+
+/*
+ * _Cbor_Break - Handle the 0xFF stop code ending an indefinite length item.
+ */
+static RedJsonErrorEnum _Cbor_Break(_RedJsonCborDecoder *d)
+{
+    _CborFrame *top;
+    RedJsonErrorEnum err;
+
+    if (d->chunked)
+        return _Cbor_CompleteString(d);
+    if (!ZARRAY_NUM_ITEMS(d->stack))
+        return RED_JSON_ERROR_BAD_CBOR;
+    top = &ZARRAY_TAIL(d->stack);
+    if (top->remaining != _CBOR_INDEFINITE || (top->isMap && !top->wantKey))
+        return RED_JSON_ERROR_BAD_CBOR;
+    err = _Cbor_Close(d);
+    return err ? err : _Cbor_AfterItem(d);
+}
+
+RedJsonErrorEnum _RedJsonCborDecoder_Feed(
+        _RedJsonCborDecoder *d,
+        const char *chunk,
+        size_t length,
+        size_t *pConsumed)
+{
+    const unsigned char *in = (const unsigned char *)chunk;
+    RedJsonErrorEnum err = RED_JSON_OK;
+    size_t i = 0, n, valid;
+    unsigned info;
+
+    while (i < length && !err)
+    {
+        switch (d->state)
+        {
+            case _CBOR_HEAD:
+            {
+                d->initial = in[i];
+                info = d->initial & 0x1F;
+                if (d->initial == 0xFF)
+                {
+                    err = _Cbor_Break(d);
+                    if (!err)
+                        i++;
+                    break;
+                }
+                if (info < 24 || info == 31)
+                {
+                    d->arg = (info == 31) ? 0 : info;
+                    /* Indefinite lengths are only defined for strings and
+                     * containers */
+                    if (info == 31 && ((d->initial >> 5) < 2 || (d->initial >> 5) > 5))
+                    {
+                        err = RED_JSON_ERROR_BAD_CBOR;
+                        break;
+                    }
+                    err = _Cbor_Item(d);
+                    if (!err)
+                        i++;
+                    break;
+                }
+                if (info > 27)
+                {
+                    err = RED_JSON_ERROR_BAD_CBOR;
+                    break;
+                }
+                d->argBytes = 1u << (info - 24);
+                d->arg = 0;
+                d->state = _CBOR_ARG;
+                i++;
+                break;
+            }
+            case _CBOR_ARG:
+            {
+                while (d->argBytes && i < length)
+                {
+                    d->arg = (d->arg << 8) | in[i++];
+                    d->argBytes--;
+                }
+                if (!d->argBytes)
+                {
+                    err = _Cbor_Item(d);
+                    if (err)
+                        i--;
+                }
+                break;
+            }
+            case _CBOR_STRING:
+            {
+                n = length - i;
+                if (n > d->stringRemaining)
+                    n = (size_t)d->stringRemaining;
+                valid = _RedJson_ValidateUtf8(&chunk[i], n, &d->utf8State);
+                if (valid < n)
+                {
+                    i += valid;
+                    err = RED_JSON_ERROR_BAD_UTF8;
+                    break;
+                }
+                if (!_Cbor_Reserve(d, n))
+                {
+                    err = RED_JSON_ERROR_OUT_OF_MEMORY;
+                    break;
+                }
+                memcpy(d->token + d->tokenLength, &chunk[i], n);
+                d->tokenLength += n;
+                d->stringRemaining -= n;
+                i += n;
+                if (d->stringRemaining)
+                    break;
+                if (d->chunked)
+                {
+                    d->state = _CBOR_HEAD;
+                    err = (d->utf8State == _RED_JSON_UTF8_ACCEPT) ? RED_JSON_OK : RED_JSON_ERROR_BAD_UTF8;
+                }
+                else
+                {
+                    err = _Cbor_CompleteString(d);
+                }
+                /* Report the last byte of the string */
+                if (err)
+                    i--;
+                break;
+            }
+        }
+    }
+    *pConsumed = i;
+    return err;
+}
+
+/*
+ *  DOCUMENT DECODING
+ *
+ *  RedJson_ParseCbor has the whole item in memory, so it builds the DOM
+ *  directly with its own stack, the way RedJson_ParseWithOptions does,
+ *  rather than going through events.  Strings are copied once, straight out
+ *  of the input, and definite length keys are interned without a copy.
+ */
+
+typedef struct
+{
+    RedJsonValue container;
+    uint64_t remaining;
+    RedJsonKey key;         /* key of the pending member, if any */
+} _CborParseFrame;
+
+/*
+ * _Cbor_ReadHead - Read the initial byte and argument of the item at *<pp>.
+ *      Reserved and indefinite argument encodings leave the additional
+ *      information itself in *<pArg>.
+ *
+ *      Returns false if the head runs past <end>.
+ */
+static bool _Cbor_ReadHead(const unsigned char **pp, const unsigned char *end, unsigned *pInitial, uint64_t *pArg)
+{
+    const unsigned char *p = *pp;
+    unsigned info, n;
+    uint64_t arg;
+
+    if (p == end)
+        return false;
+    *pInitial = *p;
+    info = *p++ & 0x1F;
+    arg = info;
+    if (info >= 24 && info <= 27)
+    {
+        n = 1u << (info - 24);
+        if ((size_t)(end - p) < n)
+            return false;
+        arg = 0;
+        while (n--)
+            arg = (arg << 8) | *p++;
+    }
+    *pArg = arg;
+    *pp = p;
+    return true;
+}
+
+/*
+ * _Cbor_ReadText - Read the body of a text string whose head has been read.
+ *
+ *      A definite length string is validated and returned in place.  The
+ *      chunks of an indefinite length one are joined into *<pOwned>, which
+ *      the caller must free.  On failure *<pp> points at the offending byte.
+ */
+static RedJsonErrorEnum _Cbor_ReadText(
+        const unsigned char **pp,
+        const unsigned char *end,
+        bool indefinite,
+        uint64_t arg,
+        const char **pText,
+        size_t *pLength,
+        char **pOwned)
+{
+    const unsigned char *p = *pp, *chunk;
+    unsigned utf8State = _RED_JSON_UTF8_ACCEPT, initial;
+    char *joined = NULL, *grown;
+    size_t length = 0, valid;
+
+    *pOwned = NULL;
+    if (!indefinite)
+    {
+        if ((uint64_t)(end - p) < arg)
+        {
+            *pp = end;
+            return RED_JSON_ERROR_UNEXPECTED_END;
+        }
+        valid = _RedJson_ValidateUtf8((const char *)p, (size_t)arg, &utf8State);
+        if (valid < arg || utf8State != _RED_JSON_UTF8_ACCEPT)
+        {
+            *pp = p + (valid < arg ? valid : arg - 1);
+            return RED_JSON_ERROR_BAD_UTF8;
+        }
+        *pText = (const char *)p;
+        *pLength = (size_t)arg;
+        *pp = p + arg;
+        return RED_JSON_OK;
+    }
+
+    for (;;)
+    {
+        chunk = p;
+        if (!_Cbor_ReadHead(&p, end, &initial, &arg))
+        {
+            free(joined);
+            *pp = end;
+            return RED_JSON_ERROR_UNEXPECTED_END;
+        }
+        if (initial == 0xFF)
+            break;
+        if ((initial >> 5) != 3 || (initial & 0x1F) > 27)
+        {
+            free(joined);
+            *pp = chunk;
+            return RED_JSON_ERROR_BAD_CBOR;
+        }
+        if ((uint64_t)(end - p) < arg)
+        {
+            free(joined);
+            *pp = end;
+            return RED_JSON_ERROR_UNEXPECTED_END;
+        }
+        valid = _RedJson_ValidateUtf8((const char *)p, (size_t)arg, &utf8State);
+        if (valid < arg || utf8State != _RED_JSON_UTF8_ACCEPT)
+        {
+            free(joined);
+            *pp = p + (valid < arg ? valid : arg - 1);
+            return RED_JSON_ERROR_BAD_UTF8;
+        }
+        grown = realloc(joined, length + (size_t)arg + 1);
+        if (!grown)
+        {
+            free(joined);
+            *pp = chunk;
+            return RED_JSON_ERROR_OUT_OF_MEMORY;
+        }
+        joined = grown;
+        memcpy(joined + length, p, (size_t)arg);
+        length += (size_t)arg;
+        p += arg;
+    }
+    if (!joined && !(joined = malloc(1)))
+        return RED_JSON_ERROR_OUT_OF_MEMORY;
+    joined[length] = '\0';
+    *pText = *pOwned = joined;
+    *pLength = length;
+    *pp = p;
+    return RED_JSON_OK;
+}
+
+static double _Cbor_FloatArg(unsigned info, uint64_t arg)
+{
+    uint32_t bits32;
+    float flt;
+    double dbl;
+    if (info == 25)
+        return _Cbor_HalfToDouble((uint16_t)arg);
+    if (info == 26)
+    {
+        bits32 = (uint32_t)arg;
+        memcpy(&flt, &bits32, sizeof(flt));
+        return flt;
+    }
+    memcpy(&dbl, &arg, sizeof(dbl));
+    return dbl;
+}
+
+static RedJsonError_t _Cbor_ErrorAt(size_t offset, RedJsonErrorEnum code)
+{
+    RedJsonError_t error;
+    error.code = code;
+    error.offset = offset;
+    error.line = 1;
+    error.column = (unsigned)offset + 1;
+    return error;
+}
+
+RedJsonValue RedJson_ParseCbor(const char *data, size_t length, RedJsonError_t *pError)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + length;
+    const unsigned char *item = p;
+    RedJsonKeyTable keys = _RedJsonKeyTable_NewPrivate();
+    ZARRAY(_CborParseFrame) stack = ZARRAY_NEW(_CborParseFrame, 0);
+    _CborParseFrame frame, *top = NULL;
+    RedJsonValue root = NULL, val;
+    RedJsonErrorEnum err;
+    unsigned initial, major, info;
+    uint64_t arg;
+    const char *text;
+    char *owned, *sz;
+    size_t n;
+
+    for (;;)
+    {
+        item = p;
+        if (!_Cbor_ReadHead(&p, end, &initial, &arg))
+            goto fail_end;
+        major = initial >> 5;
+        info = initial & 0x1F;
+
+        if (initial == 0xFF)
+        {
+            if (!top || top->remaining != _CBOR_INDEFINITE || top->key)
+                goto fail_cbor;
+            ZARRAY_SHRINK_BY_ONE(stack);
+            top = ZARRAY_NUM_ITEMS(stack) ? &ZARRAY_TAIL(stack) : NULL;
+            goto counted;
+        }
+        if ((info >= 28 && info != 31) || (info == 31 && (major < 2 || major > 5)))
+            goto fail_cbor;
+        if (major == 6)
+            continue;
+
+        if (top && top->container->type == RED_JSON_VALUE_TYPE_OBJECT && !top->key)
+        {
+            if (major != 3)
+                goto fail_cbor;
+            err = _Cbor_ReadText(&p, end, info == 31, arg, &text, &n, &owned);
+            if (err)
+                goto fail;
+            top->key = _RedJsonKeyTable_InternN(keys, text, n);
+            top->key->refcnt++;
+            free(owned);
+            continue;
+        }
+
+        switch (major)
+        {
+            case 0:
+                val = (arg <= INT64_MAX) ? RedJsonValue_FromInt64((int64_t)arg) : RedJsonValue_FromUint64(arg);
+                break;
+            case 1:
+                if (arg <= INT64_MAX)
+                    val = RedJsonValue_FromInt64(-1 - (int64_t)arg);
+                else
+                    val = RedJsonValue_FromNumber(-1.0 - (double)arg);
+                break;
+            case 3:
+                err = _Cbor_ReadText(&p, end, info == 31, arg, &text, &n, &owned);
+                if (err)
+                    goto fail;
+                if (memchr(text, 0, n))
+                {
+                    /* DOM string values are plain C strings */
+                    free(owned);
+                    err = RED_JSON_ERROR_BAD_STRING;
+                    p = item;
+                    goto fail;
+                }
+                if (owned)
+                {
+                    sz = owned;
+                }
+                else
+                {
+                    sz = malloc(n + 1);
+                    assert(sz);
+                    memcpy(sz, text, n);
+                    sz[n] = '\0';
+                }
+                val = _RedJsonValue_TakeString(sz);
+                break;
+            case 4:
+            case 5:
+                if (ZARRAY_NUM_ITEMS(stack) >= RED_JSON_DEFAULT_MAX_DEPTH)
+                {
+                    err = RED_JSON_ERROR_DEPTH_EXCEEDED;
+                    p = item;
+                    goto fail;
+                }
+                if (major == 5)
+                    val = RedJsonValue_FromObject(RedJsonObject_New());
+                else
+                    val = RedJsonValue_FromArray(RedJsonArray_New());
+                break;
+            case 7:
+                if (info == 20 || info == 21)
+                    val = RedJsonValue_FromBoolean(info == 21);
+                else if (info == 22 || info == 23)
+                    val = RedJsonValue_Null();
+                else if (info >= 25 && info <= 27)
+                    val = RedJsonValue_FromNumber(_Cbor_FloatArg(info, arg));
+                else
+                    goto fail_cbor;
+                break;
+            default:
+                /* Byte strings have no JSON equivalent */
+                goto fail_cbor;
+        }
+
+        /* Containers are attached as soon as they open, so everything built
+         * so far is reachable from <root> for cleanup */
+        if (!top)
+            root = val;
+        else if (top->key)
+        {
+            _RedJsonObject_PutKey(top->container->val.hObj, top->key, val);
+            _RedJsonKey_Release(top->key);
+            top->key = NULL;
+        }
+        else
+        {
+            RedJsonArray_Append(top->container->val.hArray, val);
+        }
+        if ((major == 4 || major == 5) && (info == 31 || arg))
+        {
+            frame.container = val;
+            frame.remaining = (info == 31) ? _CBOR_INDEFINITE : arg;
+            frame.key = NULL;
+            ZARRAY_APPEND(stack, frame);
+            top = &ZARRAY_TAIL(stack);
+            continue;
+        }
+
+counted:
+        while (top && top->remaining != _CBOR_INDEFINITE && !--top->remaining)
+        {
+            ZARRAY_SHRINK_BY_ONE(stack);
+            top = ZARRAY_NUM_ITEMS(stack) ? &ZARRAY_TAIL(stack) : NULL;
+        }
+        if (!top)
+            break;
+    }
+
+    if (p != end)
+    {
+        item = p;
+        goto fail_cbor;
+    }
+    ZARRAY_FREE(stack);
+    RedJsonKeyTable_Free(keys);
+    return root;
+
+fail_end:
+    err = RED_JSON_ERROR_UNEXPECTED_END;
+    p = end;
+    goto fail;
+fail_cbor:
+    err = RED_JSON_ERROR_BAD_CBOR;
+    p = item;
+fail:
+    while (ZARRAY_NUM_ITEMS(stack))
+    {
+        if (ZARRAY_TAIL(stack).key)
+            _RedJsonKey_Release(ZARRAY_TAIL(stack).key);
+        ZARRAY_SHRINK_BY_ONE(stack);
+    }
+    ZARRAY_FREE(stack);
+    RedJsonKeyTable_Free(keys);
+    if (root)
+        RedJsonValue_Release(root);
+    if (pError)
+        *pError = _Cbor_ErrorAt((const char *)p - data, err);
+    return NULL;
+}
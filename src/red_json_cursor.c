@@ -0,0 +1,431 @@
+/*
+ *  red_json_cursor.c - On-demand access to JSON text held in memory.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ */
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static bool _IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool _IsDelimiter(char c)
+{
+    return _IsSpace(c) || c == ',' || c == ']' || c == '}' || c == ':';
+}
+
+static const char * _SkipSpace(const char *p, const char *end)
+{
+    while (p < end && _IsSpace(*p))
+        p++;
+    return p;
+}
+
+/*
+ * _SkipString - Return the position just past the closing quote of the
+ *      string whose body starts at <p>, or NULL if it is unterminated.
+ */
+static const char * _SkipString(const char *p, const char *end)
+{
+    /* Most strings are short keys and values: only scan long ones in blocks */
+    const char *shortEnd = (end - p > 16) ? p + 16 : end;
+    while (p < shortEnd)
+    {
+        if (*p == '"')
+            return p + 1;
+        p += (*p == '\\') ? 2 : 1;
+    }
+    while (p < end)
+    {
+        p += _RedJson_FindEscape(p, end - p);
+        if (p >= end)
+            break;
+        if (*p == '"')
+            return p + 1;
+        /* Skip the escaped character; control characters are not checked */
+        p += (*p == '\\') ? 2 : 1;
+    }
+    return NULL;
+}
+
+/*
+ * _SkipValue - Return the position just past the value starting at <p>, or
+ *      NULL if it is unterminated.  Containers are skipped by counting
+ *      brackets outside of strings; nothing else is validated.
+ */
+static const char * _SkipValue(const char *p, const char *end)
+{
+    unsigned depth = 0;
+
+    if (*p == '"')
+        return _SkipString(p + 1, end);
+    if (*p != '{' && *p != '[')
+    {
+        while (p < end && !_IsDelimiter(*p))
+            p++;
+        return p;
+    }
+    for (;;)
+    {
+        p += _RedJson_FindStructural(p, end - p);
+        if (p >= end)
+            return NULL;
+        switch (*p)
+        {
+            case '"':
+                p = _SkipString(p + 1, end);
+                if (!p)
+                    return NULL;
+                break;
+            case '{':
+            case '[':
+                depth++;
+                p++;
+                break;
+            default:
+                p++;
+                if (--depth == 0)
+                    return p;
+                break;
+        }
+    }
+}
+
+static RedJsonValueTypeEnum _TypeOf(char c)
+{
+    switch (c)
+    {
+        case '{': return RED_JSON_VALUE_TYPE_OBJECT;
+        case '[': return RED_JSON_VALUE_TYPE_ARRAY;
+        case '"': return RED_JSON_VALUE_TYPE_STRING;
+        case 't':
+        case 'f': return RED_JSON_VALUE_TYPE_BOOLEAN;
+        case 'n': return RED_JSON_VALUE_TYPE_NULL;
+        default:
+            if (c == '-' || (c >= '0' && c <= '9'))
+                return RED_JSON_VALUE_TYPE_NUMBER;
+            return RED_JSON_VALUE_TYPE_INVALID;
+    }
+}
+
+/*
+ * _Cursor_Member - Parse the key and colon of the object member starting at
+ *      <p>, and point <pChild> at its value.
+ */
+static RedJsonErrorEnum _Cursor_Member(const char *p, const char *end, RedJsonCursor_t *pChild)
+{
+    const char *key = p;
+    if (p >= end)
+        return RED_JSON_ERROR_UNEXPECTED_END;
+    if (*p != '"')
+        return RED_JSON_ERROR_UNEXPECTED_CHAR;
+    p = _SkipString(p + 1, end);
+    if (!p)
+        return RED_JSON_ERROR_UNEXPECTED_END;
+    p = _SkipSpace(p, end);
+    if (p >= end)
+        return RED_JSON_ERROR_UNEXPECTED_END;
+    if (*p != ':')
+        return RED_JSON_ERROR_UNEXPECTED_CHAR;
+    p = _SkipSpace(p + 1, end);
+    if (p >= end)
+        return RED_JSON_ERROR_UNEXPECTED_END;
+    pChild->_pos = p;
+    pChild->_end = end;
+    pChild->_key = key;
+    return RED_JSON_OK;
+}
+
+/*
+ * _Cursor_Element - Point <pChild> at the value starting at <p>, which is
+ *      either an array element or, if <inObject>, a member.
+ */
+static RedJsonErrorEnum _Cursor_Element(const char *p, const char *end, bool inObject, RedJsonCursor_t *pChild)
+{
+    if (inObject)
+        return _Cursor_Member(p, end, pChild);
+    if (p >= end)
+        return RED_JSON_ERROR_UNEXPECTED_END;
+    if (_TypeOf(*p) == RED_JSON_VALUE_TYPE_INVALID)
+        return RED_JSON_ERROR_UNEXPECTED_CHAR;
+    pChild->_pos = p;
+    pChild->_end = end;
+    pChild->_key = NULL;
+    return RED_JSON_OK;
+}
+
+RedJsonErrorEnum RedJsonCursor_Init(RedJsonCursor_t *pCursor, const char *text, size_t length)
+{
+    const char *end = text + length;
+    const char *p = _SkipSpace(text, end);
+    pCursor->_pos = p;
+    pCursor->_end = end;
+    pCursor->_key = NULL;
+    if (p >= end)
+        return RED_JSON_ERROR_UNEXPECTED_END;
+    return (_TypeOf(*p) == RED_JSON_VALUE_TYPE_INVALID) ? RED_JSON_ERROR_UNEXPECTED_CHAR : RED_JSON_OK;
+}
+
+RedJsonValueTypeEnum RedJsonCursor_GetType(const RedJsonCursor_t *pCursor)
+{
+    if (pCursor->_pos >= pCursor->_end)
+        return RED_JSON_VALUE_TYPE_INVALID;
+    return _TypeOf(*pCursor->_pos);
+}
+
+RedJsonErrorEnum RedJsonCursor_First(const RedJsonCursor_t *pCursor, RedJsonCursor_t *pChild)
+{
+    const char *p = pCursor->_pos;
+    const char *end = pCursor->_end;
+    char open;
+
+    if (p >= end || (*p != '{' && *p != '['))
+        return RED_JSON_ERROR_WRONG_TYPE;
+    open = *p;
+    p = _SkipSpace(p + 1, end);
+    if (p >= end)
+        return RED_JSON_ERROR_UNEXPECTED_END;
+    if (*p == open + 2)
+        return RED_JSON_ERROR_NOT_FOUND;
+    return _Cursor_Element(p, end, open == '{', pChild);
+}
+
+RedJsonErrorEnum RedJsonCursor_Next(RedJsonCursor_t *pChild)
+{
+    const char *end = pChild->_end;
+    const char *p = _SkipValue(pChild->_pos, end);
+    bool inObject = pChild->_key != NULL;
+
+    if (!p)
+        return RED_JSON_ERROR_UNEXPECTED_END;
+    p = _SkipSpace(p, end);
+    if (p >= end)
+        return RED_JSON_ERROR_UNEXPECTED_END;
+    if (*p == (inObject ? '}' : ']'))
+        return RED_JSON_ERROR_NOT_FOUND;
+    if (*p != ',')
+        return RED_JSON_ERROR_UNEXPECTED_CHAR;
+    return _Cursor_Element(_SkipSpace(p + 1, end), end, inObject, pChild);
+}
+
+RedJsonErrorEnum RedJsonCursor_Index(const RedJsonCursor_t *pCursor, unsigned idx, RedJsonCursor_t *pElement)
+{
+    RedJsonErrorEnum err;
+    if (pCursor->_pos >= pCursor->_end || *pCursor->_pos != '[')
+        return RED_JSON_ERROR_WRONG_TYPE;
+    err = RedJsonCursor_First(pCursor, pElement);
+    while (!err && idx--)
+        err = RedJsonCursor_Next(pElement);
+    return err;
+}
+
+/*
+ * _Cursor_KeyEquals - Compare the key of member <pMember> with <szKey>.
+ *      <plain> says <szKey> has no characters that JSON must escape, in which
+ *      case an unescaped key can be compared in place.
+ */
+static bool _Cursor_KeyEquals(const RedJsonCursor_t *pMember, const char *szKey, size_t keyLength, bool plain)
+{
+    const char *raw = pMember->_key + 1;
+    const char *end = pMember->_end;
+    char *decoded;
+    size_t decodedLength;
+    const char *stop;
+    bool equal;
+
+    if (plain && (size_t)(end - raw) > keyLength && raw[keyLength] == '"' && !memcmp(raw, szKey, keyLength))
+        return true;
+    /* Only a key with escapes can still match */
+    if (raw[_RedJson_FindEscape(raw, end - raw)] != '\\')
+        return false;
+    if (_RedJson_DecodeString(raw, end, true, &decoded, &decodedLength, &stop))
+        return false;
+    equal = decodedLength == keyLength && !memcmp(decoded, szKey, keyLength);
+    free(decoded);
+    return equal;
+}
+
+RedJsonErrorEnum RedJsonCursor_Find(const RedJsonCursor_t *pCursor, const char *szKey, RedJsonCursor_t *pMember)
+{
+    size_t keyLength = strlen(szKey);
+    bool plain = _RedJson_FindEscape(szKey, keyLength) == keyLength;
+    RedJsonCursor_t member;
+    RedJsonErrorEnum err;
+
+    if (pCursor->_pos >= pCursor->_end || *pCursor->_pos != '{')
+        return RED_JSON_ERROR_WRONG_TYPE;
+    for (err = RedJsonCursor_First(pCursor, &member); !err; err = RedJsonCursor_Next(&member))
+    {
+        if (_Cursor_KeyEquals(&member, szKey, keyLength, plain))
+        {
+            *pMember = member;
+            return RED_JSON_OK;
+        }
+    }
+    return err;
+}
+
+RedJsonErrorEnum RedJsonCursor_GetKey(const RedJsonCursor_t *pCursor, char **pszKey)
+{
+    size_t length;
+    const char *stop;
+    if (!pCursor->_key)
+        return RED_JSON_ERROR_WRONG_TYPE;
+    return _RedJson_DecodeString(pCursor->_key + 1, pCursor->_end, false, pszKey, &length, &stop);
+}
+
+RedJsonErrorEnum RedJsonCursor_GetString(const RedJsonCursor_t *pCursor, char **psz)
+{
+    size_t length;
+    const char *stop;
+    if (RedJsonCursor_GetType(pCursor) != RED_JSON_VALUE_TYPE_STRING)
+        return RED_JSON_ERROR_WRONG_TYPE;
+    return _RedJson_DecodeString(pCursor->_pos + 1, pCursor->_end, false, psz, &length, &stop);
+}
+
+static RedJsonErrorEnum _Cursor_Number(const RedJsonCursor_t *pCursor, _RedJsonNumber *pNum)
+{
+    const char *p = pCursor->_pos;
+    const char *end = pCursor->_end;
+    size_t n;
+    if (RedJsonCursor_GetType(pCursor) != RED_JSON_VALUE_TYPE_NUMBER)
+        return RED_JSON_ERROR_WRONG_TYPE;
+    n = _RedJson_ParseNumber(p, end, pNum);
+    if (!n || (p + n < end && !_IsDelimiter(p[n])))
+        return RED_JSON_ERROR_BAD_NUMBER;
+    return RED_JSON_OK;
+}
+
+RedJsonErrorEnum RedJsonCursor_GetNumber(const RedJsonCursor_t *pCursor, double *pVal)
+{
+    _RedJsonNumber num;
+    RedJsonErrorEnum err = _Cursor_Number(pCursor, &num);
+    if (!err)
+        *pVal = num.dbl;
+    return err;
+}
+
+RedJsonErrorEnum RedJsonCursor_GetInt64(const RedJsonCursor_t *pCursor, int64_t *pVal)
+{
+    _RedJsonNumber num;
+    RedJsonErrorEnum err = _Cursor_Number(pCursor, &num);
+    if (err)
+        return err;
+    if (num.type == RED_JSON_NUMBER_INT64)
+        *pVal = num.i64;
+    else if (num.type == RED_JSON_NUMBER_UINT64 && num.u64 <= INT64_MAX)
+        *pVal = (int64_t)num.u64;
+    else
+        return RED_JSON_ERROR_WRONG_TYPE;
+    return RED_JSON_OK;
+}
+
+RedJsonErrorEnum RedJsonCursor_GetUint64(const RedJsonCursor_t *pCursor, uint64_t *pVal)
+{
+    _RedJsonNumber num;
+    RedJsonErrorEnum err = _Cursor_Number(pCursor, &num);
+    if (err)
+        return err;
+    if (num.type == RED_JSON_NUMBER_UINT64)
+        *pVal = num.u64;
+    else if (num.type == RED_JSON_NUMBER_INT64 && num.i64 >= 0)
+        *pVal = (uint64_t)num.i64;
+    else
+        return RED_JSON_ERROR_WRONG_TYPE;
+    return RED_JSON_OK;
+}
+
+/*
+ * _Cursor_IsLiteral - Check that the value at <pCursor> is exactly <literal>.
+ */
+static bool _Cursor_IsLiteral(const RedJsonCursor_t *pCursor, const char *literal)
+{
+    const char *p = pCursor->_pos;
+    size_t n = strlen(literal);
+    if ((size_t)(pCursor->_end - p) < n || memcmp(p, literal, n))
+        return false;
+    return p + n == pCursor->_end || _IsDelimiter(p[n]);
+}
+
+RedJsonErrorEnum RedJsonCursor_GetBoolean(const RedJsonCursor_t *pCursor, bool *pVal)
+{
+    if (RedJsonCursor_GetType(pCursor) != RED_JSON_VALUE_TYPE_BOOLEAN)
+        return RED_JSON_ERROR_WRONG_TYPE;
+    if (_Cursor_IsLiteral(pCursor, "true"))
+        *pVal = true;
+    else if (_Cursor_IsLiteral(pCursor, "false"))
+        *pVal = false;
+    else
+        return RED_JSON_ERROR_UNEXPECTED_CHAR;
+    return RED_JSON_OK;
+}
+
+bool RedJsonCursor_IsNull(const RedJsonCursor_t *pCursor)
+{
+    return _Cursor_IsLiteral(pCursor, "null");
+}
+
+RedJsonErrorEnum RedJsonCursor_GetRaw(const RedJsonCursor_t *pCursor, const char **pStart, size_t *pLength)
+{
+    const char *valueEnd;
+    if (pCursor->_pos >= pCursor->_end)
+        return RED_JSON_ERROR_UNEXPECTED_END;
+    valueEnd = _SkipValue(pCursor->_pos, pCursor->_end);
+    if (!valueEnd)
+        return RED_JSON_ERROR_UNEXPECTED_END;
+    *pStart = pCursor->_pos;
+    *pLength = valueEnd - pCursor->_pos;
+    return RED_JSON_OK;
+}
+
+static bool _Cursor_TakeValue(RedJsonValue value, const char *szKey, void *userData)
+{
+    *(RedJsonValue *)userData = value;
+    return true;
+}
+
+RedJsonErrorEnum RedJsonCursor_GetValue(const RedJsonCursor_t *pCursor, RedJsonValue *pVal)
+{
+    RedJsonStreamParser parser;
+    RedJsonValue value = NULL;
+    RedJsonErrorEnum err;
+    const char *raw;
+    size_t length;
+
+    err = RedJsonCursor_GetRaw(pCursor, &raw, &length);
+    if (err)
+        return err;
+    parser = RedJsonStreamParser_NewDom(0, _Cursor_TakeValue, &value);
+    if (!parser)
+        return RED_JSON_ERROR_OUT_OF_MEMORY;
+    _RedJsonStreamParser_SetCallbackOwns(parser, true);
+    err = RedJsonStreamParser_Feed(parser, raw, length);
+    if (!err)
+        err = RedJsonStreamParser_Finish(parser);
+    RedJsonStreamParser_Free(parser);
+    if (err || !value)
+    {
+        if (value)
+            RedJsonValue_Release(value);
+        return err ? err : RED_JSON_ERROR_UNEXPECTED_END;
+    }
+    *pVal = value;
+    return RED_JSON_OK;
+}
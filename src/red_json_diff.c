@@ -0,0 +1,802 @@
+/*
+ *  red_json_diff.c - JSON Patch (RFC 6902) diff and apply.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ *
+ *  Container hashes are computed on demand and kept in the container until
+ *  it is modified (see RedJsonObject_t).  Object hashes add up a hash per
+ *  member so that member order does not matter; array hashes chain their
+ *  elements in order.  Numbers hash by value, so 1 and 1.0 agree.
+ *
+ *  A patch is applied to a clone of the document's root.  The GetMutable*
+ *  functions copy each shared container on the way to a change, so the
+ *  original is untouched until every operation has succeeded, at which point
+ *  the root's contents are swapped in.
+ */
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* -------------------------------------------------------------------------
+ * Hashing and equality
+ * ---------------------------------------------------------------------- */
+
+#define _DIFF_GOLDEN 0x9e3779b97f4a7c15ULL
+
+/*
+ * _Diff_Mix - The splitmix64 finalizer.
+ */
+static uint64_t _Diff_Mix(uint64_t h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+uint64_t _RedJson_Hash64(const char *s, size_t n, uint64_t seed)
+{
+    uint64_t h = _Diff_Mix(seed + n * _DIFF_GOLDEN);
+    uint64_t w;
+    while (n >= 8)
+    {
+        memcpy(&w, s, 8);
+        h = _Diff_Mix(h ^ w) + _DIFF_GOLDEN;
+        s += 8;
+        n -= 8;
+    }
+    w = 0;
+    memcpy(&w, s, n);
+    return _Diff_Mix(h ^ w);
+}
+
+typedef enum
+{
+    _DIFF_NUMBER_INT,           /* <bits> holds an int64_t */
+    _DIFF_NUMBER_UINT,          /* <bits> holds a uint64_t above INT64_MAX */
+    _DIFF_NUMBER_DOUBLE,        /* <bits> holds the bits of a non-integral double */
+} _DiffNumberEnum;
+
+/*
+ * _Diff_Number - Reduce a number to a canonical form, so that numbers with
+ *      equal values compare and hash equal however they are stored.
+ */
+static _DiffNumberEnum _Diff_Number(RedJsonValue hVal, uint64_t *pBits)
+{
+    double d;
+    switch (hVal->meta.numberType)
+    {
+        case RED_JSON_NUMBER_INT64:
+            *pBits = (uint64_t)hVal->val.i64;
+            return _DIFF_NUMBER_INT;
+        case RED_JSON_NUMBER_UINT64:
+            *pBits = hVal->val.u64;
+            return hVal->val.u64 <= INT64_MAX ? _DIFF_NUMBER_INT : _DIFF_NUMBER_UINT;
+        default:
+            break;
+    }
+    d = hVal->val.dbl;
+    if (d >= -9223372036854775808.0 && d < 9223372036854775808.0 && d == (double)(int64_t)d)
+    {
+        *pBits = (uint64_t)(int64_t)d;
+        return _DIFF_NUMBER_INT;
+    }
+    if (d >= 9223372036854775808.0 && d < 18446744073709551616.0)
+    {
+        *pBits = (uint64_t)d;
+        return _DIFF_NUMBER_UINT;
+    }
+    memcpy(pBits, &d, sizeof(d));
+    return _DIFF_NUMBER_DOUBLE;
+}
+
+static uint64_t _Diff_Hash(RedJsonValue hVal);
+
+static uint64_t _Diff_HashObject(RedJsonObject hObj)
+{
+    uint64_t h = 0;
+    unsigned i;
+    if (hObj->hash)
+        return hObj->hash;
+    for (i = 0; i < hObj->numMembers; i++)
+        h += _Diff_Mix(hObj->members[i].key->diffHash + _Diff_Mix(_Diff_Hash(hObj->members[i].value)));
+    h = _Diff_Mix(h ^ (RED_JSON_VALUE_TYPE_OBJECT + hObj->numMembers * _DIFF_GOLDEN));
+    hObj->hash = h ? h : 1;
+    return hObj->hash;
+}
+
+static uint64_t _Diff_HashArray(RedJsonArray hArray)
+{
+    RedJsonValue_t entry;
+    unsigned i, numItems = RedJsonArray_NumItems(hArray);
+    uint64_t h = RED_JSON_VALUE_TYPE_ARRAY;
+    if (hArray->hash)
+        return hArray->hash;
+    for (i = 0; i < numItems; i++)
+        h = _Diff_Mix(h ^ _Diff_Hash(_RedJsonArray_Entry(hArray, i, &entry))) + _DIFF_GOLDEN;
+    h = _Diff_Mix(h ^ numItems);
+    hArray->hash = h ? h : 1;
+    return hArray->hash;
+}
+
+static uint64_t _Diff_Hash(RedJsonValue hVal)
+{
+    _DiffNumberEnum kind;
+    uint64_t bits;
+    switch (hVal->type)
+    {
+        case RED_JSON_VALUE_TYPE_STRING:
+            return _RedJson_Hash64(hVal->val.sz, strlen(hVal->val.sz), RED_JSON_VALUE_TYPE_STRING);
+        case RED_JSON_VALUE_TYPE_NUMBER:
+            kind = _Diff_Number(hVal, &bits);
+            return _Diff_Mix(bits ^ _Diff_Mix(RED_JSON_VALUE_TYPE_NUMBER * 16 + kind));
+        case RED_JSON_VALUE_TYPE_OBJECT:
+            return _Diff_HashObject(hVal->val.hObj);
+        case RED_JSON_VALUE_TYPE_ARRAY:
+            return _Diff_HashArray(hVal->val.hArray);
+        case RED_JSON_VALUE_TYPE_BOOLEAN:
+            return _Diff_Mix(RED_JSON_VALUE_TYPE_BOOLEAN * 16 + hVal->val.boolean);
+        default:
+            return _Diff_Mix(hVal->type);
+    }
+}
+
+static bool _Diff_ObjectEquals(RedJsonObject a, RedJsonObject b)
+{
+    RedJsonValue hVal;
+    unsigned i;
+    if (a == b)
+        return true;
+    if (a->numMembers != b->numMembers || (a->hash && b->hash && a->hash != b->hash))
+        return false;
+    for (i = 0; i < a->numMembers; i++)
+    {
+        hVal = RedJsonObject_GetByKey(b, a->members[i].key);
+        if (!hVal || !RedJsonValue_Equals(a->members[i].value, hVal))
+            return false;
+    }
+    return true;
+}
+
+static bool _Diff_ArrayEquals(RedJsonArray a, RedJsonArray b)
+{
+    RedJsonValue_t entryA, entryB;
+    unsigned i, numItems = RedJsonArray_NumItems(a);
+    if (a == b)
+        return true;
+    if (numItems != RedJsonArray_NumItems(b) || (a->hash && b->hash && a->hash != b->hash))
+        return false;
+    for (i = 0; i < numItems; i++)
+    {
+        if (!RedJsonValue_Equals(_RedJsonArray_Entry(a, i, &entryA), _RedJsonArray_Entry(b, i, &entryB)))
+            return false;
+    }
+    return true;
+}
+
+bool RedJsonValue_Equals(RedJsonValue a, RedJsonValue b)
+{
+    uint64_t bitsA, bitsB;
+    if (a == b)
+        return true;
+    if (a->type != b->type)
+        return false;
+    switch (a->type)
+    {
+        case RED_JSON_VALUE_TYPE_STRING:
+            return strcmp(a->val.sz, b->val.sz) == 0;
+        case RED_JSON_VALUE_TYPE_NUMBER:
+            return _Diff_Number(a, &bitsA) == _Diff_Number(b, &bitsB) && bitsA == bitsB;
+        case RED_JSON_VALUE_TYPE_OBJECT:
+            return _Diff_ObjectEquals(a->val.hObj, b->val.hObj);
+        case RED_JSON_VALUE_TYPE_ARRAY:
+            return _Diff_ArrayEquals(a->val.hArray, b->val.hArray);
+        case RED_JSON_VALUE_TYPE_BOOLEAN:
+            return a->val.boolean == b->val.boolean;
+        default:
+            return true;
+    }
+}
+
+bool RedJsonObject_Equals(RedJsonObject a, RedJsonObject b)
+{
+    return _Diff_ObjectEquals(a, b);
+}
+
+/* -------------------------------------------------------------------------
+ * Diff
+ * ---------------------------------------------------------------------- */
+
+typedef struct
+{
+    RedJsonArray patch;
+    ZARRAY(char) path;          /* JSON Pointer to the current location, unterminated */
+    bool failed;                /* An op path held a NUL from a key */
+} _Diff;
+
+/*
+ * _Diff_Same - Quick equality test for lining up array elements:
+ *      containers compare by hash.
+ */
+static bool _Diff_Same(RedJsonValue a, RedJsonValue b)
+{
+    if (a == b)
+        return true;
+    if (a->type != b->type)
+        return false;
+    if (a->type == RED_JSON_VALUE_TYPE_OBJECT || a->type == RED_JSON_VALUE_TYPE_ARRAY)
+        return _Diff_Hash(a) == _Diff_Hash(b);
+    return RedJsonValue_Equals(a, b);
+}
+
+/*
+ * _Diff_PushKey, _Diff_PushIndex - Extend the current path by one token.
+ *      Return the previous length, to be restored with ZARRAY_TRUNCATE.
+ */
+static size_t _Diff_PushKey(_Diff *d, RedJsonKey key)
+{
+    size_t oldLength = ZARRAY_NUM_ITEMS(d->path);
+    size_t i;
+    ZARRAY_APPEND(d->path, '/');
+    for (i = 0; i < key->length; i++)
+    {
+        if (key->sz[i] == '~')
+        {
+            ZARRAY_APPEND(d->path, '~');
+            ZARRAY_APPEND(d->path, '0');
+        }
+        else if (key->sz[i] == '/')
+        {
+            ZARRAY_APPEND(d->path, '~');
+            ZARRAY_APPEND(d->path, '1');
+        }
+        else
+            ZARRAY_APPEND(d->path, key->sz[i]);
+    }
+    return oldLength;
+}
+
+static size_t _Diff_PushIndex(_Diff *d, unsigned idx)
+{
+    size_t oldLength = ZARRAY_NUM_ITEMS(d->path);
+    char buf[_RED_JSON_NUMBER_BUFFER_SIZE];
+    size_t i, length = _RedJson_FormatUint64(idx, buf);
+    ZARRAY_APPEND(d->path, '/');
+    for (i = 0; i < length; i++)
+        ZARRAY_APPEND(d->path, buf[i]);
+    return oldLength;
+}
+
+/*
+ * _Diff_Op - Append an operation on the current path.  <hVal> may be NULL.
+ *      A path through a key holding a NUL cannot be stored as a C string,
+ *      so the whole diff fails instead.
+ */
+static void _Diff_Op(_Diff *d, const char *szOp, RedJsonValue hVal)
+{
+    RedJsonObject hOp;
+    size_t length = ZARRAY_NUM_ITEMS(d->path);
+    if (d->failed || (length && memchr(&ZARRAY_AT(d->path, 0), '\0', length)))
+    {
+        d->failed = true;
+        return;
+    }
+    hOp = RedJsonObject_New();
+    ZARRAY_APPEND(d->path, '\0');
+    RedJsonObject_SetString(hOp, "op", szOp);
+    RedJsonObject_SetString(hOp, "path", &ZARRAY_AT(d->path, 0));
+    if (hVal)
+        RedJsonObject_Set(hOp, "value", RedJsonValue_Retain(hVal));
+    ZARRAY_TRUNCATE(d->path, length);
+    RedJsonArray_AppendObject(d->patch, hOp);
+}
+
+static void _Diff_Object(_Diff *d, RedJsonObject a, RedJsonObject b);
+static void _Diff_Array(_Diff *d, RedJsonArray a, RedJsonArray b);
+
+static void _Diff_Value(_Diff *d, RedJsonValue a, RedJsonValue b)
+{
+    if (a == b)
+        return;
+    if (a->type == RED_JSON_VALUE_TYPE_OBJECT && b->type == RED_JSON_VALUE_TYPE_OBJECT)
+        _Diff_Object(d, a->val.hObj, b->val.hObj);
+    else if (a->type == RED_JSON_VALUE_TYPE_ARRAY && b->type == RED_JSON_VALUE_TYPE_ARRAY)
+        _Diff_Array(d, a->val.hArray, b->val.hArray);
+    else if (!RedJsonValue_Equals(a, b))
+        _Diff_Op(d, "replace", b);
+}
+
+static void _Diff_Object(_Diff *d, RedJsonObject a, RedJsonObject b)
+{
+    RedJsonValue hVal;
+    size_t oldLength;
+    unsigned i;
+    if (a == b || _Diff_HashObject(a) == _Diff_HashObject(b))
+        return;
+    for (i = 0; i < a->numMembers; i++)
+    {
+        hVal = RedJsonObject_GetByKey(b, a->members[i].key);
+        oldLength = _Diff_PushKey(d, a->members[i].key);
+        if (hVal)
+            _Diff_Value(d, a->members[i].value, hVal);
+        else
+            _Diff_Op(d, "remove", NULL);
+        ZARRAY_TRUNCATE(d->path, oldLength);
+    }
+    for (i = 0; i < b->numMembers; i++)
+    {
+        if (RedJsonObject_GetByKey(a, b->members[i].key))
+            continue;
+        oldLength = _Diff_PushKey(d, b->members[i].key);
+        _Diff_Op(d, "add", b->members[i].value);
+        ZARRAY_TRUNCATE(d->path, oldLength);
+    }
+}
+
+/*
+ * _Diff_Entry - A reference to element <idx> of <hArray>, made into a value
+ *      of its own if the element is packed, for ops that keep it.
+ */
+static RedJsonValue _Diff_Entry(RedJsonArray hArray, unsigned idx)
+{
+    RedJsonValue_t entry;
+    RedJsonValue hVal = _RedJsonArray_Entry(hArray, idx, &entry);
+    if (hVal != &entry)
+        return RedJsonValue_Retain(hVal);
+    hVal = malloc(sizeof(RedJsonValue_t));
+    assert(hVal);
+    *hVal = entry;
+    return hVal;
+}
+
+static void _Diff_Array(_Diff *d, RedJsonArray a, RedJsonArray b)
+{
+    RedJsonValue_t entryA, entryB;
+    RedJsonValue hA, hB;
+    unsigned endA = RedJsonArray_NumItems(a);
+    unsigned endB = RedJsonArray_NumItems(b);
+    unsigned start = 0, i;
+    size_t oldLength;
+    if (a == b || _Diff_HashArray(a) == _Diff_HashArray(b))
+        return;
+
+    /* Trim the common prefix and suffix */
+    while (start < endA && start < endB
+            && _Diff_Same(_RedJsonArray_Entry(a, start, &entryA), _RedJsonArray_Entry(b, start, &entryB)))
+        start++;
+    while (endA > start && endB > start
+            && _Diff_Same(_RedJsonArray_Entry(a, endA - 1, &entryA), _RedJsonArray_Entry(b, endB - 1, &entryB)))
+    {
+        endA--;
+        endB--;
+    }
+
+    /* Pair up what is left, then remove or add the surplus */
+    for (i = start; i < endA && i < endB; i++)
+    {
+        oldLength = _Diff_PushIndex(d, i);
+        hA = _Diff_Entry(a, i);
+        hB = _Diff_Entry(b, i);
+        _Diff_Value(d, hA, hB);
+        RedJsonValue_Release(hA);
+        RedJsonValue_Release(hB);
+        ZARRAY_TRUNCATE(d->path, oldLength);
+    }
+    oldLength = _Diff_PushIndex(d, i);
+    for (; endA > i; endA--)
+        _Diff_Op(d, "remove", NULL);
+    ZARRAY_TRUNCATE(d->path, oldLength);
+    for (; i < endB; i++)
+    {
+        oldLength = _Diff_PushIndex(d, i);
+        hB = _Diff_Entry(b, i);
+        _Diff_Op(d, "add", hB);
+        RedJsonValue_Release(hB);
+        ZARRAY_TRUNCATE(d->path, oldLength);
+    }
+}
+
+RedJsonArray RedJson_Diff(RedJsonObject from, RedJsonObject to)
+{
+    _Diff d;
+    d.patch = RedJsonArray_New();
+    d.path = ZARRAY_NEW(char, 0);
+    assert(d.path);
+    d.failed = false;
+    _Diff_Object(&d, from, to);
+    ZARRAY_FREE(d.path);
+    if (d.failed)
+    {
+        RedJsonArray_Release(d.patch);
+        return NULL;
+    }
+    return d.patch;
+}
+
+/* -------------------------------------------------------------------------
+ * Patch
+ * ---------------------------------------------------------------------- */
+
+/*
+ * _PatchPointer - A parsed JSON Pointer: <numTokens> unescaped,
+ *      null-terminated tokens back to back in <buf>.
+ */
+typedef struct
+{
+    char *buf;
+    unsigned numTokens;
+} _PatchPointer;
+
+static RedJsonErrorEnum _Patch_ParsePointer(const char *sz, _PatchPointer *ptr)
+{
+    char *out;
+    ptr->numTokens = 0;
+    ptr->buf = malloc(strlen(sz) + 1);
+    assert(ptr->buf);
+    if (*sz && *sz != '/')
+        return RED_JSON_ERROR_BAD_PATH;
+    out = ptr->buf;
+    while (*sz)
+    {
+        if (*sz == '/')
+        {
+            if (ptr->numTokens++)
+                *out++ = '\0';
+        }
+        else if (*sz == '~')
+        {
+            sz++;
+            if (*sz != '0' && *sz != '1')
+                return RED_JSON_ERROR_BAD_PATH;
+            *out++ = (*sz == '0') ? '~' : '/';
+        }
+        else
+            *out++ = *sz;
+        sz++;
+    }
+    *out = '\0';
+    return RED_JSON_OK;
+}
+
+/*
+ * _Patch_Index - Parse an array index token, which must not exceed <max>.
+ */
+static bool _Patch_Index(const char *tok, unsigned max, unsigned *pIdx)
+{
+    uint64_t idx = 0;
+    if (!*tok || (tok[0] == '0' && tok[1]))
+        return false;
+    for (; *tok; tok++)
+    {
+        if (*tok < '0' || *tok > '9')
+            return false;
+        idx = idx * 10 + (*tok - '0');
+        if (idx > max)
+            return false;
+    }
+    *pIdx = (unsigned)idx;
+    return true;
+}
+
+/*
+ * _PatchTarget - The container holding a location, and the location's
+ *      token within it.  Exactly one of <obj> and <array> is set.
+ */
+typedef struct
+{
+    RedJsonObject obj;
+    RedJsonArray array;
+    const char *token;
+} _PatchTarget;
+
+/*
+ * _Patch_Resolve - Find the parent of the (non-root) location <ptr>.  If
+ *      <mutable>, containers on the way are made private to <root>.
+ */
+static RedJsonErrorEnum _Patch_Resolve(RedJsonObject root, const _PatchPointer *ptr, bool mutable, _PatchTarget *t)
+{
+    RedJsonValue_t entry;
+    RedJsonValue hVal;
+    unsigned i, idx = 0;
+    t->obj = root;
+    t->array = NULL;
+    t->token = ptr->buf;
+    for (i = 1; i < ptr->numTokens; i++)
+    {
+        if (t->obj)
+            hVal = RedJsonObject_Get(t->obj, t->token);
+        else if (_Patch_Index(t->token, RedJsonArray_NumItems(t->array), &idx) && idx < RedJsonArray_NumItems(t->array))
+            hVal = _RedJsonArray_Entry(t->array, idx, &entry);
+        else
+            hVal = NULL;
+        if (!hVal)
+            return RED_JSON_ERROR_NOT_FOUND;
+        if (hVal->type == RED_JSON_VALUE_TYPE_OBJECT)
+        {
+            if (!mutable)
+                t->obj = hVal->val.hObj;
+            else if (t->obj)
+                t->obj = RedJsonObject_GetMutableObject(t->obj, t->token);
+            else
+                t->obj = RedJsonArray_GetMutableEntryObject(t->array, idx);
+            t->array = NULL;
+        }
+        else if (hVal->type == RED_JSON_VALUE_TYPE_ARRAY)
+        {
+            if (!mutable)
+                t->array = hVal->val.hArray;
+            else if (t->obj)
+                t->array = RedJsonObject_GetMutableArray(t->obj, t->token);
+            else
+                t->array = RedJsonArray_GetMutableEntryArray(t->array, idx);
+            t->obj = NULL;
+        }
+        else
+            return RED_JSON_ERROR_NOT_FOUND;
+        t->token += strlen(t->token) + 1;
+    }
+    return RED_JSON_OK;
+}
+
+/*
+ * _Patch_Get - Look up the value at <szPath>.  On success *<pVal> is a new
+ *      reference.
+ */
+static RedJsonErrorEnum _Patch_Get(RedJsonObject root, const char *szPath, RedJsonValue *pVal)
+{
+    _PatchPointer ptr;
+    _PatchTarget t;
+    RedJsonValue hVal = NULL;
+    RedJsonErrorEnum err;
+    unsigned idx;
+
+    err = _Patch_ParsePointer(szPath, &ptr);
+    if (!err && !ptr.numTokens)
+        hVal = RedJsonValue_FromObject(RedJsonObject_Clone(root));
+    else if (!err && !(err = _Patch_Resolve(root, &ptr, false, &t)))
+    {
+        if (t.obj && (hVal = RedJsonObject_Get(t.obj, t.token)))
+            RedJsonValue_Retain(hVal);
+        else if (!t.obj && _Patch_Index(t.token, RedJsonArray_NumItems(t.array), &idx) && idx < RedJsonArray_NumItems(t.array))
+            hVal = _Diff_Entry(t.array, idx);
+        if (!hVal)
+            err = RED_JSON_ERROR_NOT_FOUND;
+    }
+    free(ptr.buf);
+    *pVal = hVal;
+    return err;
+}
+
+/*
+ * _Patch_ReplaceRoot - Make *<pRoot> a copy of the object <hVal>.
+ */
+static RedJsonErrorEnum _Patch_ReplaceRoot(RedJsonObject *pRoot, RedJsonValue hVal)
+{
+    if (hVal->type != RED_JSON_VALUE_TYPE_OBJECT)
+        return RED_JSON_ERROR_WRONG_TYPE;
+    RedJsonObject_Release(*pRoot);
+    *pRoot = RedJsonObject_Clone(hVal->val.hObj);
+    return RED_JSON_OK;
+}
+
+/*
+ * _Patch_Add - Add, or with <replace> replace, the value at <szPath>.
+ *      Takes ownership of <hVal> either way.
+ */
+static RedJsonErrorEnum _Patch_Add(RedJsonObject *pRoot, const char *szPath, RedJsonValue hVal, bool replace)
+{
+    _PatchPointer ptr;
+    _PatchTarget t;
+    RedJsonValue *slot;
+    RedJsonErrorEnum err;
+    unsigned idx, numItems;
+
+    err = _Patch_ParsePointer(szPath, &ptr);
+    if (!err && !ptr.numTokens)
+        err = _Patch_ReplaceRoot(pRoot, hVal);
+    else if (!err && !(err = _Patch_Resolve(*pRoot, &ptr, true, &t)))
+    {
+        if (t.obj)
+        {
+            if (replace && !RedJsonObject_HasKey(t.obj, t.token))
+                err = RED_JSON_ERROR_NOT_FOUND;
+            else
+            {
+                RedJsonObject_Put(t.obj, t.token, hVal);
+                hVal = NULL;
+            }
+        }
+        else
+        {
+            numItems = RedJsonArray_NumItems(t.array);
+            if (!replace && strcmp(t.token, "-") == 0)
+            {
+                RedJsonArray_Append(t.array, hVal);
+                hVal = NULL;
+            }
+            else if (!_Patch_Index(t.token, numItems, &idx) || (replace && idx == numItems))
+                err = RED_JSON_ERROR_NOT_FOUND;
+            else if (replace)
+            {
+                RedJsonArray_SetEntry(t.array, idx, hVal);
+                hVal = NULL;
+            }
+            else
+            {
+                _RedJsonArray_Unpack(t.array);
+                t.array->hash = 0;
+                ZARRAY_GROW_BY_ONE(t.array->items);
+                slot = &ZARRAY_AT(t.array->items, idx);
+                memmove(slot + 1, slot, (numItems - idx) * sizeof(RedJsonValue));
+                *slot = hVal;
+                hVal = NULL;
+            }
+        }
+    }
+    RedJsonValue_Release(hVal);
+    free(ptr.buf);
+    return err;
+}
+
+/*
+ * _Patch_Remove - Remove the value at <szPath>, handing it to *<pVal> if
+ *      that is not NULL.
+ */
+static RedJsonErrorEnum _Patch_Remove(RedJsonObject root, const char *szPath, RedJsonValue *pVal)
+{
+    _PatchPointer ptr;
+    _PatchTarget t;
+    RedJsonValue hVal = NULL, *slot;
+    RedJsonErrorEnum err;
+    unsigned idx, numItems;
+
+    err = _Patch_ParsePointer(szPath, &ptr);
+    if (!err && !ptr.numTokens)
+        err = RED_JSON_ERROR_WRONG_TYPE;
+    else if (!err && !(err = _Patch_Resolve(root, &ptr, true, &t)))
+    {
+        if (t.obj)
+        {
+            hVal = RedJsonObject_Get(t.obj, t.token);
+            if (hVal)
+            {
+                RedJsonValue_Retain(hVal);
+                RedJsonObject_Unset(t.obj, t.token);
+            }
+        }
+        else
+        {
+            numItems = RedJsonArray_NumItems(t.array);
+            if (_Patch_Index(t.token, numItems, &idx) && idx < numItems)
+            {
+                _RedJsonArray_Unpack(t.array);
+                t.array->hash = 0;
+                slot = &ZARRAY_AT(t.array->items, idx);
+                hVal = *slot;
+                memmove(slot, slot + 1, (numItems - idx - 1) * sizeof(RedJsonValue));
+                ZARRAY_TRUNCATE(t.array->items, numItems - 1);
+            }
+        }
+        if (!hVal)
+            err = RED_JSON_ERROR_NOT_FOUND;
+    }
+    free(ptr.buf);
+    if (pVal)
+        *pVal = hVal;
+    else
+        RedJsonValue_Release(hVal);
+    return err;
+}
+
+static const char * _Patch_GetString(RedJsonObject hOp, const char *szKey)
+{
+    RedJsonValue hVal = RedJsonObject_Get(hOp, szKey);
+    return hVal && hVal->type == RED_JSON_VALUE_TYPE_STRING ? hVal->val.sz : NULL;
+}
+
+static RedJsonErrorEnum _Patch_Apply(RedJsonObject *pRoot, RedJsonValue hOpVal)
+{
+    const char *szOp, *szPath, *szFrom;
+    RedJsonValue hVal, hFound;
+    RedJsonErrorEnum err;
+    size_t fromLength;
+    bool equal;
+
+    if (hOpVal->type != RED_JSON_VALUE_TYPE_OBJECT)
+        return RED_JSON_ERROR_WRONG_TYPE;
+    szOp = _Patch_GetString(hOpVal->val.hObj, "op");
+    szPath = _Patch_GetString(hOpVal->val.hObj, "path");
+    szFrom = _Patch_GetString(hOpVal->val.hObj, "from");
+    hVal = RedJsonObject_Get(hOpVal->val.hObj, "value");
+    if (!szOp || !szPath)
+        return RED_JSON_ERROR_WRONG_TYPE;
+
+    if (strcmp(szOp, "add") == 0 || strcmp(szOp, "replace") == 0)
+    {
+        if (!hVal)
+            return RED_JSON_ERROR_WRONG_TYPE;
+        return _Patch_Add(pRoot, szPath, RedJsonValue_Retain(hVal), szOp[0] == 'r');
+    }
+    if (strcmp(szOp, "remove") == 0)
+        return _Patch_Remove(*pRoot, szPath, NULL);
+    if (strcmp(szOp, "test") == 0)
+    {
+        if (!hVal)
+            return RED_JSON_ERROR_WRONG_TYPE;
+        err = _Patch_Get(*pRoot, szPath, &hFound);
+        if (err)
+            return err;
+        equal = RedJsonValue_Equals(hFound, hVal);
+        RedJsonValue_Release(hFound);
+        return equal ? RED_JSON_OK : RED_JSON_ERROR_TEST_FAILED;
+    }
+    if (!szFrom)
+        return RED_JSON_ERROR_WRONG_TYPE;
+    if (strcmp(szOp, "copy") == 0)
+    {
+        err = _Patch_Get(*pRoot, szFrom, &hFound);
+        return err ? err : _Patch_Add(pRoot, szPath, hFound, false);
+    }
+    if (strcmp(szOp, "move") == 0)
+    {
+        /* A location cannot be moved into one of its own children */
+        fromLength = strlen(szFrom);
+        if (strncmp(szFrom, szPath, fromLength) == 0 && szPath[fromLength] == '/')
+            return RED_JSON_ERROR_BAD_PATH;
+        if (strcmp(szFrom, szPath) == 0)
+        {
+            err = _Patch_Get(*pRoot, szFrom, &hFound);
+            RedJsonValue_Release(hFound);
+            return err;
+        }
+        err = _Patch_Remove(*pRoot, szFrom, &hFound);
+        return err ? err : _Patch_Add(pRoot, szPath, hFound, false);
+    }
+    return RED_JSON_ERROR_WRONG_TYPE;
+}
+
+RedJsonErrorEnum RedJson_ApplyPatch(RedJsonObject doc, RedJsonArray patch, unsigned *pFailedOp)
+{
+    RedJsonObject work = RedJsonObject_Clone(doc);
+    RedJsonObject_t old;
+    RedJsonErrorEnum err = RED_JSON_OK;
+    unsigned i, numOps = RedJsonArray_NumItems(patch);
+
+    for (i = 0; i < numOps; i++)
+    {
+        err = _Patch_Apply(&work, RedJsonArray_GetEntry(patch, i));
+        if (err)
+        {
+            if (pFailedOp)
+                *pFailedOp = i;
+            RedJsonObject_Release(work);
+            return err;
+        }
+    }
+
+    /* Give <doc> the patched contents and let <work> release the old ones */
+    old = *doc;
+    *doc = *work;
+    *work = old;
+    work->refcnt = doc->refcnt;
+    doc->refcnt = old.refcnt;
+    RedJsonObject_Release(work);
+    return RED_JSON_OK;
+}
@@ -0,0 +1,191 @@
+/*
+ *  red_json_document.c - Reusable documents that recycle their storage from
+ *  one parse to the next.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ */
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct RedJsonDocument_t
+{
+    _RedJsonPool pool;
+    RedJsonObject root;
+} RedJsonDocument_t;
+
+static void _Pool_RecycleArray(_RedJsonPool *pool, RedJsonArray hArray);
+
+static void _Pool_RecycleValue(_RedJsonPool *pool, RedJsonValue hVal)
+{
+    if (--hVal->refcnt > 0)
+        return;
+    switch (hVal->type)
+    {
+        case RED_JSON_VALUE_TYPE_STRING:
+            if (hVal->meta.backing)
+                _RedJsonBacking_Release(hVal->meta.backing);
+            else
+                free(hVal->val.sz);
+            break;
+        case RED_JSON_VALUE_TYPE_OBJECT:
+            _RedJsonPool_RecycleObject(pool, hVal->val.hObj);
+            break;
+        case RED_JSON_VALUE_TYPE_ARRAY:
+            _Pool_RecycleArray(pool, hVal->val.hArray);
+            break;
+        default:
+            break;
+    }
+    ZARRAY_APPEND(pool->values, hVal);
+}
+
+void _RedJsonPool_RecycleObject(_RedJsonPool *pool, RedJsonObject hObj)
+{
+    unsigned i;
+    if (--hObj->refcnt > 0)
+        return;
+    for (i = 0; i < hObj->numMembers; i++)
+    {
+        _RedJsonKey_Release(hObj->members[i].key);
+        _Pool_RecycleValue(pool, hObj->members[i].value);
+    }
+    hObj->numMembers = 0;
+    hObj->hash = 0;
+    if (hObj->index)
+        memset(hObj->index, 0, (hObj->indexMask + 1) * sizeof(uint32_t));
+    ZARRAY_APPEND(pool->objects, hObj);
+}
+
+static void _Pool_RecycleArray(_RedJsonPool *pool, RedJsonArray hArray)
+{
+    unsigned i, numItems;
+    if (--hArray->refcnt > 0)
+        return;
+    numItems = ZARRAY_NUM_ITEMS(hArray->items);
+    for (i = 0; i < numItems; i++)
+        _Pool_RecycleValue(pool, ZARRAY_AT(hArray->items, i));
+    ZARRAY_TRUNCATE(hArray->items, 0);
+    /* Keep any packed buffer for the next array to pack into */
+    hArray->storage = RED_JSON_ARRAY_STORAGE_VALUES;
+    hArray->numPacked = 0;
+    hArray->hash = 0;
+    ZARRAY_APPEND(pool->arrays, hArray);
+}
+
+/*
+ * _Pool_RewindChunks - Make every string chunk that no retained string
+ *      points into available again, and let go of the others.
+ */
+static void _Pool_RewindChunks(_RedJsonPool *pool)
+{
+    unsigned i, numKept = 0;
+    _RedJsonBacking *chunk;
+    for (i = 0; i < ZARRAY_NUM_ITEMS(pool->chunks); i++)
+    {
+        chunk = ZARRAY_AT(pool->chunks, i);
+        if (chunk->refcnt == 1)
+        {
+            ZARRAY_AT(pool->chunks, numKept) = chunk;
+            numKept++;
+        }
+        else
+            _RedJsonBacking_Release(chunk);
+    }
+    ZARRAY_TRUNCATE(pool->chunks, numKept);
+    pool->chunk = 0;
+    pool->used = 0;
+}
+
+RedJsonDocument RedJsonDocument_New(void)
+{
+    RedJsonDocument doc = calloc(1, sizeof(RedJsonDocument_t));
+    assert(doc);
+    doc->pool.values = ZARRAY_NEW(RedJsonValue, 0);
+    doc->pool.objects = ZARRAY_NEW(RedJsonObject, 0);
+    doc->pool.arrays = ZARRAY_NEW(RedJsonArray, 0);
+    doc->pool.chunks = ZARRAY_NEW(_RedJsonBacking *, 0);
+    doc->pool.stack = ZARRAY_NEW(_RedJsonParseFrame, 0);
+    doc->pool.keys = _RedJsonKeyTable_NewPrivate();
+    return doc;
+}
+
+void RedJsonDocument_Free(RedJsonDocument doc)
+{
+    _RedJsonPool *pool;
+    RedJsonObject hObj;
+    RedJsonArray hArray;
+    unsigned i;
+
+    if (!doc)
+        return;
+    RedJsonDocument_Reset(doc);
+    pool = &doc->pool;
+    for (i = 0; i < ZARRAY_NUM_ITEMS(pool->values); i++)
+        free(ZARRAY_AT(pool->values, i));
+    for (i = 0; i < ZARRAY_NUM_ITEMS(pool->objects); i++)
+    {
+        hObj = ZARRAY_AT(pool->objects, i);
+        free(hObj->members);
+        free(hObj->index);
+        free(hObj);
+    }
+    for (i = 0; i < ZARRAY_NUM_ITEMS(pool->arrays); i++)
+    {
+        hArray = ZARRAY_AT(pool->arrays, i);
+        ZARRAY_FREE(hArray->items);
+        free(hArray->packed.any);
+        free(hArray);
+    }
+    for (i = 0; i < ZARRAY_NUM_ITEMS(pool->chunks); i++)
+        _RedJsonBacking_Release(ZARRAY_AT(pool->chunks, i));
+    ZARRAY_FREE(pool->values);
+    ZARRAY_FREE(pool->objects);
+    ZARRAY_FREE(pool->arrays);
+    ZARRAY_FREE(pool->chunks);
+    ZARRAY_FREE(pool->stack);
+    RedJsonKeyTable_Free(pool->keys);
+    free(doc);
+}
+
+RedJsonObject RedJsonDocument_Parse(
+        RedJsonDocument doc,
+        const char *text,
+        size_t length,
+        const RedJsonParseOptions_t *pOptions,
+        RedJsonError_t *pError)
+{
+    RedJsonDocument_Reset(doc);
+    doc->root = _RedJson_ParseText(text, length, pOptions, pError, NULL, &doc->pool);
+    return doc->root;
+}
+
+void RedJsonDocument_Reset(RedJsonDocument doc)
+{
+    if (doc->root)
+    {
+        _RedJsonPool_RecycleObject(&doc->pool, doc->root);
+        doc->root = NULL;
+    }
+    _Pool_RewindChunks(&doc->pool);
+}
+
+RedJsonObject RedJsonDocument_GetRoot(RedJsonDocument doc)
+{
+    return doc->root;
+}
@@ -0,0 +1,152 @@
+/*
+ *  red_json_file.c - Parsing JSON files through a memory mapping.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ */
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE     /* MAP_POPULATE */
+
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef MAP_POPULATE
+#define _RED_JSON_MAP_FLAGS (MAP_PRIVATE | MAP_POPULATE)
+#else
+#define _RED_JSON_MAP_FLAGS MAP_PRIVATE
+#endif
+
+void _RedJsonBacking_Release(_RedJsonBacking *backing)
+{
+    if (--backing->refcnt > 0)
+        return;
+    if (backing->mapped)
+        munmap(backing->base, backing->length);
+    else
+        free(backing->base);
+    free(backing);
+}
+
+/*
+ * _File_Map - Map the file at <path>, populated and advised for sequential
+ *      access.  An empty file gives a NULL mapping of size 0.  Returns false
+ *      with <pError> filled in if the file cannot be opened or mapped.
+ */
+static bool _File_Map(const char *path, bool writable, char **pMap, size_t *pSize, RedJsonError_t *pError)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        goto fail;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        goto fail;
+    }
+    *pMap = NULL;
+    *pSize = (size_t)st.st_size;
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return true;
+    }
+    map = mmap(NULL, (size_t)st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, _RED_JSON_MAP_FLAGS, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        goto fail;
+    posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+    *pMap = map;
+    return true;
+
+fail:
+    if (pError)
+        *pError = _RedJson_ErrorAt("", 0, RED_JSON_ERROR_IO);
+    return false;
+}
+
+RedJsonObject RedJson_ParseFile(const char *path)
+{
+    return RedJson_ParseFileWithOptions(path, NULL, NULL);
+}
+
+RedJsonObject RedJson_ParseFileWithOptions(
+        const char *path,
+        const RedJsonParseOptions_t *pOptions,
+        RedJsonError_t *pError)
+{
+    bool views = pOptions && pOptions->stringViews;
+    _RedJsonBacking *mapping;
+    RedJsonObject obj;
+    size_t size;
+    char *map;
+
+    if (!_File_Map(path, views, &map, &size, pError))
+        return NULL;
+    if (!size)
+        return _RedJson_ParseText("", 0, pOptions, pError, NULL, NULL);
+
+    if (!views)
+    {
+        obj = _RedJson_ParseText(map, size, pOptions, pError, NULL, NULL);
+        munmap(map, size);
+        return obj;
+    }
+
+    /* The parse holds one reference, so strings freed on failure cannot
+     * unmap the text under the parser */
+    mapping = malloc(sizeof(_RedJsonBacking));
+    if (!mapping)
+    {
+        munmap(map, size);
+        if (pError)
+            *pError = _RedJson_ErrorAt("", 0, RED_JSON_ERROR_OUT_OF_MEMORY);
+        return NULL;
+    }
+    mapping->refcnt = 1;
+    mapping->mapped = true;
+    mapping->base = map;
+    mapping->length = size;
+    obj = _RedJson_ParseText(map, size, pOptions, pError, mapping, NULL);
+    posix_madvise(map, size, POSIX_MADV_NORMAL);
+    _RedJsonBacking_Release(mapping);
+    return obj;
+}
+
+RedJsonArray RedJson_ParseArrayFileParallel(
+        const char *path,
+        const RedJsonParallelOptions_t *options,
+        RedJsonError_t *pError)
+{
+    RedJsonArray array;
+    size_t size;
+    char *map;
+
+    if (!_File_Map(path, false, &map, &size, pError))
+        return NULL;
+    if (!size)
+        return RedJson_ParseArrayParallel("", 0, options, pError);
+    array = RedJson_ParseArrayParallel(map, size, options, pError);
+    munmap(map, size);
+    return array;
+}
@@ -0,0 +1,152 @@
+/*
+ *  red_json_key.c - Interned object keys.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ */
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _KEY_TABLE_INITIAL_SLOTS 64
+
+uint32_t _RedJsonKey_Hash(const char *sz, size_t length)
+{
+    /* 32-bit FNV-1a */
+    const unsigned char *p = (const unsigned char *)sz;
+    const unsigned char *end = p + length;
+    uint32_t hash = 2166136261u;
+    while (p < end)
+    {
+        hash ^= *p++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+RedJsonKey _RedJsonKey_New(const char *sz, size_t length, uint32_t hash)
+{
+    RedJsonKey key = malloc(sizeof(RedJsonKey_t) + length + 1);
+    assert(key);
+    key->refcnt = 0;
+    key->hash = hash;
+    key->diffHash = _RedJson_Hash64(sz, length, 0);
+    key->length = length;
+    memcpy(key->sz, sz, length);
+    key->sz[length] = '\0';
+    return key;
+}
+
+void _RedJsonKey_Release(RedJsonKey key)
+{
+    if (--key->refcnt <= 0)
+        free(key);
+}
+
+const char * RedJsonKey_GetChars(RedJsonKey key)
+{
+    return key->sz;
+}
+
+RedJsonKeyTable RedJsonKeyTable_New()
+{
+    RedJsonKeyTable table = calloc(1, sizeof(RedJsonKeyTable_t));
+    assert(table);
+    table->slots = calloc(_KEY_TABLE_INITIAL_SLOTS, sizeof(RedJsonKey));
+    assert(table->slots);
+    table->mask = _KEY_TABLE_INITIAL_SLOTS - 1;
+    return table;
+}
+
+RedJsonKeyTable _RedJsonKeyTable_NewPrivate(void)
+{
+    RedJsonKeyTable table = RedJsonKeyTable_New();
+    table->maxKeys = _RED_JSON_KEY_TABLE_PRIVATE_MAX_KEYS;
+    return table;
+}
+
+void RedJsonKeyTable_Free(RedJsonKeyTable table)
+{
+    unsigned i;
+    if (!table)
+        return;
+    for (i = 0; i <= table->mask; i++)
+    {
+        if (table->slots[i])
+            _RedJsonKey_Release(table->slots[i]);
+    }
+    free(table->slots);
+    free(table);
+}
+
+unsigned RedJsonKeyTable_NumKeys(RedJsonKeyTable table)
+{
+    return table->numKeys;
+}
+
+/*
+ * _KeyTable_Grow - Double the number of slots.
+ */
+static void _KeyTable_Grow(RedJsonKeyTable table)
+{
+    unsigned newMask = 2 * table->mask + 1;
+    RedJsonKey *newSlots = calloc(newMask + 1, sizeof(RedJsonKey));
+    unsigned i, slot;
+    assert(newSlots);
+    for (i = 0; i <= table->mask; i++)
+    {
+        if (!table->slots[i])
+            continue;
+        slot = table->slots[i]->hash & newMask;
+        while (newSlots[slot])
+            slot = (slot + 1) & newMask;
+        newSlots[slot] = table->slots[i];
+    }
+    free(table->slots);
+    table->slots = newSlots;
+    table->mask = newMask;
+}
+
+RedJsonKey _RedJsonKeyTable_InternN(RedJsonKeyTable table, const char *sz, size_t length)
+{
+    uint32_t hash = _RedJsonKey_Hash(sz, length);
+    unsigned slot = hash & table->mask;
+    RedJsonKey key;
+
+    while ((key = table->slots[slot]) != NULL)
+    {
+        if (key->hash == hash && key->length == length && !memcmp(key->sz, sz, length))
+            return key;
+        slot = (slot + 1) & table->mask;
+    }
+
+    key = _RedJsonKey_New(sz, length, hash);
+    if (table->maxKeys && table->numKeys >= table->maxKeys)
+        return key;
+
+    key->refcnt = 1;
+    table->slots[slot] = key;
+    table->numKeys++;
+    if (2 * table->numKeys > table->mask)
+        _KeyTable_Grow(table);
+    return key;
+}
+
+RedJsonKey RedJsonKeyTable_Intern(RedJsonKeyTable table, const char *szKey)
+{
+    return _RedJsonKeyTable_InternN(table, szKey, strlen(szKey));
+}
@@ -0,0 +1,339 @@
+/*
+ *  red_json_ndjson.c - Parallel reader for newline-delimited JSON files.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define _NDJSON_DEFAULT_CHUNK_SIZE (1024 * 1024)
+#define _NDJSON_MAX_THREADS 256
+
+/*
+ * State shared by all workers.  <mutex> protects everything below it.
+ */
+typedef struct
+{
+    const char *base;
+    size_t size;
+    size_t chunkSize;
+    bool ordered;
+    RedJsonRecordCallback fnOnRecord;
+    void *userData;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t turn;
+    size_t cursor;
+    unsigned nextChunk;
+    unsigned nextToDeliver;
+    bool stop;
+    RedJsonErrorEnum err;
+    size_t errOffset;
+} _NdjsonShared;
+
+/*
+ * Per-worker state.  The parser and record buffer are reused for every chunk
+ * the worker processes.
+ */
+typedef struct
+{
+    _NdjsonShared *shared;
+    RedJsonStreamParser parser;
+    ZARRAY(RedJsonValue) records;
+    bool aborted;
+} _NdjsonWorker;
+
+static bool _Ndjson_Collect(RedJsonValue value, const char *szKey, void *userData)
+{
+    _NdjsonWorker *worker = userData;
+    ZARRAY_APPEND(worker->records, value);
+    return true;
+}
+
+static bool _Ndjson_Deliver(RedJsonValue value, const char *szKey, void *userData)
+{
+    _NdjsonWorker *worker = userData;
+    if (!worker->shared->fnOnRecord(value, worker->shared->userData))
+    {
+        worker->aborted = true;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * _Ndjson_Fail - Record the first failure (by file offset) and stop all
+ *      workers.  Caller must hold the mutex.
+ */
+static void _Ndjson_Fail(_NdjsonShared *shared, RedJsonErrorEnum err, size_t offset)
+{
+    if (!shared->err || offset < shared->errOffset)
+    {
+        shared->err = err;
+        shared->errOffset = offset;
+    }
+    shared->stop = true;
+    pthread_cond_broadcast(&shared->turn);
+}
+
+/*
+ * _Ndjson_NextChunk - Claim the next line-aligned range of the file.  Returns
+ *      false when the file is exhausted or reading has been stopped.
+ */
+static bool _Ndjson_NextChunk(_NdjsonShared *shared, size_t *pStart, size_t *pEnd, unsigned *pIndex)
+{
+    size_t start, end;
+    const char *nl;
+    bool haveChunk = false;
+
+    pthread_mutex_lock(&shared->mutex);
+    if (!shared->stop && shared->cursor < shared->size)
+    {
+        start = shared->cursor;
+        end = start + shared->chunkSize;
+        if (end >= shared->size)
+        {
+            end = shared->size;
+        }
+        else
+        {
+            nl = memchr(shared->base + end, '\n', shared->size - end);
+            end = nl ? (size_t)(nl - shared->base) + 1 : shared->size;
+        }
+        shared->cursor = end;
+        *pStart = start;
+        *pEnd = end;
+        *pIndex = shared->nextChunk++;
+        haveChunk = true;
+    }
+    pthread_mutex_unlock(&shared->mutex);
+    return haveChunk;
+}
+
+static void _Ndjson_DiscardRecords(_NdjsonWorker *worker)
+{
+    unsigned i;
+    for (i = 0; i < ZARRAY_NUM_ITEMS(worker->records); i++)
+        RedJsonValue_Release(ZARRAY_AT(worker->records, i));
+    ZARRAY_RESIZE(worker->records, 0);
+}
+
+static void * _Ndjson_WorkerMain(void *arg)
+{
+    _NdjsonWorker *worker = arg;
+    _NdjsonShared *shared = worker->shared;
+    size_t start, end;
+    unsigned index, i;
+    RedJsonErrorEnum err;
+    bool deliver;
+
+    while (_Ndjson_NextChunk(shared, &start, &end, &index))
+    {
+        RedJsonStreamParser_Reset(worker->parser);
+        err = RedJsonStreamParser_Feed(worker->parser, shared->base + start, end - start);
+        if (!err)
+            err = RedJsonStreamParser_Finish(worker->parser);
+        if (err && !(err == RED_JSON_ERROR_ABORTED && !worker->aborted))
+        {
+            RedJsonError_t error = RedJsonStreamParser_GetError(worker->parser);
+            pthread_mutex_lock(&shared->mutex);
+            _Ndjson_Fail(shared, err, start + error.offset);
+            pthread_mutex_unlock(&shared->mutex);
+            _Ndjson_DiscardRecords(worker);
+            break;
+        }
+
+        if (!shared->ordered)
+            continue;
+
+        /* Wait until every earlier chunk has been delivered */
+        pthread_mutex_lock(&shared->mutex);
+        while (!shared->stop && shared->nextToDeliver != index)
+            pthread_cond_wait(&shared->turn, &shared->mutex);
+        deliver = !shared->stop;
+        pthread_mutex_unlock(&shared->mutex);
+
+        for (i = 0; deliver && i < ZARRAY_NUM_ITEMS(worker->records); i++)
+        {
+            if (!shared->fnOnRecord(ZARRAY_AT(worker->records, i), shared->userData))
+            {
+                pthread_mutex_lock(&shared->mutex);
+                _Ndjson_Fail(shared, RED_JSON_ERROR_ABORTED, start);
+                pthread_mutex_unlock(&shared->mutex);
+                deliver = false;
+            }
+        }
+        _Ndjson_DiscardRecords(worker);
+
+        pthread_mutex_lock(&shared->mutex);
+        shared->nextToDeliver++;
+        pthread_cond_broadcast(&shared->turn);
+        pthread_mutex_unlock(&shared->mutex);
+    }
+    return NULL;
+}
+
+static RedJsonErrorEnum _Ndjson_IoError(RedJsonError_t *pError)
+{
+    if (pError)
+        pError->code = RED_JSON_ERROR_IO;
+    return RED_JSON_ERROR_IO;
+}
+
+unsigned _RedJson_NumCpus(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (unsigned)n : 1;
+}
+
+/*
+ * _Ndjson_FillPosition - Convert a file offset into line/column.
+ */
+static void _Ndjson_FillPosition(const char *base, size_t offset, RedJsonError_t *pError)
+{
+    const char *p = base;
+    const char *end = base + offset;
+    const char *lineStart = base;
+    unsigned line = 1;
+    while ((p = memchr(p, '\n', end - p)) != NULL)
+    {
+        line++;
+        p++;
+        lineStart = p;
+    }
+    pError->offset = offset;
+    pError->line = line;
+    pError->column = (unsigned)(end - lineStart) + 1;
+}
+
+RedJsonErrorEnum RedJson_ReadNdjsonFile(
+        const char *path,
+        const RedJsonNdjsonOptions_t *options,
+        RedJsonRecordCallback fnOnRecord,
+        void *userData,
+        RedJsonError_t *pError)
+{
+    _NdjsonShared shared;
+    _NdjsonWorker *workers;
+    pthread_t *threads;
+    unsigned numThreads, numStarted, i;
+    struct stat st;
+    void *map = NULL;
+    int fd;
+
+    if (pError)
+        memset(pError, 0, sizeof(*pError));
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return _Ndjson_IoError(pError);
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return _Ndjson_IoError(pError);
+    }
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return RED_JSON_OK;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return _Ndjson_IoError(pError);
+    posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    memset(&shared, 0, sizeof(shared));
+    shared.base = map;
+    shared.size = (size_t)st.st_size;
+    shared.chunkSize = (options && options->chunkSize) ? options->chunkSize : _NDJSON_DEFAULT_CHUNK_SIZE;
+    shared.ordered = options ? options->ordered : true;
+    shared.fnOnRecord = fnOnRecord;
+    shared.userData = userData;
+    pthread_mutex_init(&shared.mutex, NULL);
+    pthread_cond_init(&shared.turn, NULL);
+
+    numThreads = (options && options->numThreads) ? options->numThreads : _RedJson_NumCpus();
+    if (numThreads > _NDJSON_MAX_THREADS)
+        numThreads = _NDJSON_MAX_THREADS;
+
+    workers = calloc(numThreads, sizeof(_NdjsonWorker));
+    threads = calloc(numThreads, sizeof(pthread_t));
+    for (i = 0; workers && threads && i < numThreads; i++)
+    {
+        workers[i].shared = &shared;
+        workers[i].records = ZARRAY_NEW(RedJsonValue, 0);
+        if (shared.ordered)
+        {
+            workers[i].parser = RedJsonStreamParser_NewDom(0, _Ndjson_Collect, &workers[i]);
+            if (workers[i].parser)
+                _RedJsonStreamParser_SetCallbackOwns(workers[i].parser, true);
+        }
+        else
+        {
+            workers[i].parser = RedJsonStreamParser_NewDom(0, _Ndjson_Deliver, &workers[i]);
+        }
+        if (!workers[i].parser)
+            shared.err = RED_JSON_ERROR_OUT_OF_MEMORY;
+    }
+    if (!workers || !threads)
+        shared.err = RED_JSON_ERROR_OUT_OF_MEMORY;
+
+    if (!shared.err)
+    {
+        /* The calling thread acts as worker 0 */
+        for (numStarted = 1; numStarted < numThreads; numStarted++)
+        {
+            if (pthread_create(&threads[numStarted], NULL, _Ndjson_WorkerMain, &workers[numStarted]))
+                break;
+        }
+        _Ndjson_WorkerMain(&workers[0]);
+        for (i = 1; i < numStarted; i++)
+            pthread_join(threads[i], NULL);
+    }
+
+    for (i = 0; workers && i < numThreads; i++)
+    {
+        RedJsonStreamParser_Free(workers[i].parser);
+        if (workers[i].records)
+        {
+            _Ndjson_DiscardRecords(&workers[i]);
+            ZARRAY_FREE(workers[i].records);
+        }
+    }
+    free(workers);
+    free(threads);
+
+    if (shared.err && pError)
+    {
+        pError->code = shared.err;
+        _Ndjson_FillPosition(shared.base, shared.errOffset, pError);
+    }
+
+    pthread_mutex_destroy(&shared.mutex);
+    pthread_cond_destroy(&shared.turn);
+    munmap(map, shared.size);
+    return shared.err;
+}
@@ -0,0 +1,396 @@
+/*
+ *  red_json_parallel.c - Parsing large top-level JSON arrays on several
+ *  threads.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _PARALLEL_DEFAULT_CHUNK_SIZE (1024 * 1024)
+#define _PARALLEL_MAX_THREADS 256
+
+/*
+ * Each chunk of elements is parsed as the member of a one-key object, so
+ * that the ordinary parser can be used unchanged on a copy of the chunk.
+ */
+#define _PARALLEL_PREFIX "{\"\":["
+#define _PARALLEL_PREFIX_LENGTH 5
+#define _PARALLEL_SUFFIX "]}"
+#define _PARALLEL_SUFFIX_LENGTH 2
+
+/*
+ * State shared by all workers.  <mutex> protects everything below it.
+ */
+typedef struct
+{
+    const char *text;
+    size_t length;
+    size_t chunkSize;
+    unsigned maxDepth;
+
+    pthread_mutex_t mutex;
+    size_t cursor;              /* just past the '[' or ',' before the next chunk */
+    bool scanned;               /* the closing ']' has been reached */
+    ZARRAY(RedJsonArray) results;   /* per chunk, in document order */
+    bool stop;
+    RedJsonErrorEnum err;
+    size_t errOffset;
+} _ParallelShared;
+
+/*
+ * Per-worker state, reused for every chunk the worker processes.
+ */
+typedef struct
+{
+    _ParallelShared *shared;
+    RedJsonKeyTable keys;
+    ZARRAY(char) buffer;
+} _ParallelWorker;
+
+/*
+ * _Parallel_Fail - Record the first failure (by offset) and stop all
+ *      workers.  Caller must hold the mutex.
+ */
+static void _Parallel_Fail(_ParallelShared *shared, RedJsonErrorEnum err, size_t offset)
+{
+    if (!shared->err || offset < shared->errOffset)
+    {
+        shared->err = err;
+        shared->errOffset = offset;
+    }
+    shared->stop = true;
+}
+
+/*
+ * _Parallel_FindBoundary - Find the end of the run of elements starting at
+ *      <p>: the first ',' between elements at or after <target>, or the
+ *      first unmatched closing bracket, or <end>.
+ *
+ *      Only strings, comments and bracket nesting are tracked; the elements
+ *      themselves are validated when they are parsed.
+ */
+static const char * _Parallel_FindBoundary(const char *p, const char *end, const char *target)
+{
+    unsigned depth = 0;
+    while (p < end)
+    {
+        switch (*p)
+        {
+            case '"':
+                for (p++; ; p++)
+                {
+                    p += _RedJson_FindEscape(p, end - p);
+                    if (p >= end)
+                        return end;
+                    if (*p == '"')
+                        break;
+                    if (*p == '\\' && ++p == end)
+                        return end;
+                }
+                break;
+            case '/':
+                if (end - p >= 2 && p[1] == '*')
+                {
+                    for (p += 2; end - p >= 2 && (p[0] != '*' || p[1] != '/'); p++)
+                        ;
+                    if (end - p < 2)
+                        return end;
+                    p++;
+                }
+                break;
+            case '{':
+            case '[':
+                depth++;
+                break;
+            case '}':
+            case ']':
+                if (!depth)
+                    return p;
+                depth--;
+                break;
+            case ',':
+                if (!depth && p >= target)
+                    return p;
+                break;
+            default:
+                break;
+        }
+        p++;
+    }
+    return end;
+}
+
+/*
+ * _Parallel_NextChunk - Claim the next run of elements, [*pStart, *pEnd).
+ *      *pEnd is the ',' or closing bracket that follows it, or the end of
+ *      the text.  *<pIsOnly> is set if the run is the whole array.  Returns
+ *      false when the array is exhausted or parsing has been stopped.
+ */
+static bool _Parallel_NextChunk(_ParallelShared *shared, size_t *pStart, size_t *pEnd, unsigned *pIndex, bool *pIsOnly)
+{
+    const char *text = shared->text;
+    const char *boundary;
+    size_t start;
+    bool haveChunk = false;
+
+    pthread_mutex_lock(&shared->mutex);
+    if (!shared->stop && !shared->scanned)
+    {
+        start = shared->cursor;
+        boundary = _Parallel_FindBoundary(
+                text + start,
+                text + shared->length,
+                text + start + (shared->length - start < shared->chunkSize ? shared->length - start : shared->chunkSize));
+        shared->cursor = boundary - text + 1;
+        shared->scanned = boundary == text + shared->length || *boundary != ',';
+        *pStart = start;
+        *pEnd = boundary - text;
+        *pIndex = ZARRAY_NUM_ITEMS(shared->results);
+        *pIsOnly = *pIndex == 0 && shared->scanned;
+        ZARRAY_APPEND(shared->results, NULL);
+        haveChunk = true;
+    }
+    pthread_mutex_unlock(&shared->mutex);
+    return haveChunk;
+}
+
+/*
+ * _Parallel_ParseChunk - Parse the elements in [<start>, <end>) of the text.
+ *      Returns the array of elements, or NULL with *<pErr> and *<pOffset>
+ *      set.
+ */
+static RedJsonArray _Parallel_ParseChunk(
+        _ParallelWorker *worker,
+        size_t start,
+        size_t end,
+        bool isOnly,
+        RedJsonErrorEnum *pErr,
+        size_t *pOffset)
+{
+    _ParallelShared *shared = worker->shared;
+    const char *text = shared->text;
+    const char *p = _RedJson_SkipSpace(text + start, text + end);
+    RedJsonParseOptions_t options;
+    RedJsonError_t error;
+    RedJsonObject wrapper;
+    RedJsonArray elements;
+    size_t length = end - start;
+    char *buffer;
+
+    /* Only the single chunk of an empty array may hold no element */
+    if (p == text + end && !isOnly)
+    {
+        *pErr = (end == shared->length) ? RED_JSON_ERROR_UNEXPECTED_END : RED_JSON_ERROR_UNEXPECTED_CHAR;
+        *pOffset = end;
+        return NULL;
+    }
+
+    ZARRAY_RESIZE(worker->buffer, _PARALLEL_PREFIX_LENGTH + length + _PARALLEL_SUFFIX_LENGTH);
+    buffer = &ZARRAY_AT(worker->buffer, 0);
+    memcpy(buffer, _PARALLEL_PREFIX, _PARALLEL_PREFIX_LENGTH);
+    memcpy(buffer + _PARALLEL_PREFIX_LENGTH, text + start, length);
+    memcpy(buffer + _PARALLEL_PREFIX_LENGTH + length, _PARALLEL_SUFFIX, _PARALLEL_SUFFIX_LENGTH);
+
+    memset(&options, 0, sizeof(options));
+    options.maxDepth = shared->maxDepth + 1;
+    options.keys = worker->keys;
+    wrapper = RedJson_ParseWithOptions(buffer, ZARRAY_NUM_ITEMS(worker->buffer), &options, &error);
+    if (!wrapper)
+    {
+        *pErr = error.code;
+        *pOffset = start + (error.offset - _PARALLEL_PREFIX_LENGTH);
+        if (*pOffset >= end)
+        {
+            /* Failed at the suffix: the run ended early */
+            *pOffset = end;
+            if (end == shared->length)
+                *pErr = RED_JSON_ERROR_UNEXPECTED_END;
+        }
+        return NULL;
+    }
+    elements = RedJsonArray_Retain(RedJsonObject_GetArray(wrapper, ""));
+    RedJsonObject_Release(wrapper);
+    return elements;
+}
+
+static void * _Parallel_WorkerMain(void *arg)
+{
+    _ParallelWorker *worker = arg;
+    _ParallelShared *shared = worker->shared;
+    RedJsonArray elements;
+    RedJsonErrorEnum err = RED_JSON_OK;
+    size_t start, end, offset = 0;
+    unsigned index;
+    bool isOnly;
+
+    while (_Parallel_NextChunk(shared, &start, &end, &index, &isOnly))
+    {
+        elements = _Parallel_ParseChunk(worker, start, end, isOnly, &err, &offset);
+        pthread_mutex_lock(&shared->mutex);
+        if (elements)
+            ZARRAY_AT(shared->results, index) = elements;
+        else
+            _Parallel_Fail(shared, err, offset);
+        pthread_mutex_unlock(&shared->mutex);
+    }
+    return NULL;
+}
+
+/*
+ * _Parallel_Stitch - Move the elements of every chunk, in order, into one
+ *      array.
+ */
+static RedJsonArray _Parallel_Stitch(_ParallelShared *shared)
+{
+    RedJsonArray out = RedJsonArray_New();
+    RedJsonArray chunk;
+    unsigned i, n, total = 0;
+    bool doubles = true;
+
+    /* Chunks of one big array of numbers stay packed */
+    for (i = 0; i < ZARRAY_NUM_ITEMS(shared->results); i++)
+    {
+        chunk = ZARRAY_AT(shared->results, i);
+        if (RedJsonArray_GetStorage(chunk) != RED_JSON_ARRAY_STORAGE_DOUBLES)
+            doubles = false;
+    }
+    if (doubles)
+    {
+        for (i = 0; i < ZARRAY_NUM_ITEMS(shared->results); i++)
+        {
+            chunk = ZARRAY_AT(shared->results, i);
+            RedJsonArray_AppendDoubles(out, RedJsonArray_GetDoubles(chunk), RedJsonArray_NumItems(chunk));
+            RedJsonArray_Release(chunk);
+        }
+        ZARRAY_TRUNCATE(shared->results, 0);
+        return out;
+    }
+
+    for (i = 0; i < ZARRAY_NUM_ITEMS(shared->results); i++)
+    {
+        chunk = ZARRAY_AT(shared->results, i);
+        _RedJsonArray_Unpack(chunk);
+        total += RedJsonArray_NumItems(chunk);
+    }
+    ZARRAY_RESIZE(out->items, total);
+    total = 0;
+    for (i = 0; i < ZARRAY_NUM_ITEMS(shared->results); i++)
+    {
+        chunk = ZARRAY_AT(shared->results, i);
+        n = RedJsonArray_NumItems(chunk);
+        if (n)
+            memcpy(&ZARRAY_AT(out->items, total), &ZARRAY_AT(chunk->items, 0), n * sizeof(RedJsonValue));
+        total += n;
+        ZARRAY_TRUNCATE(chunk->items, 0);
+        RedJsonArray_Release(chunk);
+    }
+    ZARRAY_TRUNCATE(shared->results, 0);
+    return out;
+}
+
+RedJsonArray RedJson_ParseArrayParallel(
+        const char *text,
+        size_t length,
+        const RedJsonParallelOptions_t *options,
+        RedJsonError_t *pError)
+{
+    const char *end = text + length;
+    const char *p = _RedJson_SkipSpace(text, end);
+    _ParallelShared shared;
+    _ParallelWorker *workers;
+    pthread_t *threads;
+    RedJsonArray out = NULL;
+    unsigned numThreads, numStarted, i;
+
+    if (!p || p == end || *p != '[')
+    {
+        if (pError)
+            *pError = _RedJson_ErrorAt(text, (p && p != end) ? (size_t)(p - text) : length,
+                    (p && p != end) ? RED_JSON_ERROR_UNEXPECTED_CHAR : RED_JSON_ERROR_UNEXPECTED_END);
+        return NULL;
+    }
+
+    memset(&shared, 0, sizeof(shared));
+    shared.text = text;
+    shared.length = length;
+    shared.chunkSize = (options && options->chunkSize) ? options->chunkSize : _PARALLEL_DEFAULT_CHUNK_SIZE;
+    shared.maxDepth = (options && options->maxDepth) ? options->maxDepth : RED_JSON_DEFAULT_MAX_DEPTH;
+    shared.cursor = p - text + 1;
+    shared.results = ZARRAY_NEW(RedJsonArray, 0);
+    pthread_mutex_init(&shared.mutex, NULL);
+
+    numThreads = (options && options->numThreads) ? options->numThreads : _RedJson_NumCpus();
+    if (numThreads > _PARALLEL_MAX_THREADS)
+        numThreads = _PARALLEL_MAX_THREADS;
+
+    workers = calloc(numThreads, sizeof(_ParallelWorker));
+    threads = calloc(numThreads, sizeof(pthread_t));
+    assert(workers && threads);
+    for (i = 0; i < numThreads; i++)
+    {
+        workers[i].shared = &shared;
+        workers[i].keys = _RedJsonKeyTable_NewPrivate();
+        workers[i].buffer = ZARRAY_NEW(char, 0);
+    }
+
+    /* The calling thread acts as worker 0 */
+    for (numStarted = 1; numStarted < numThreads; numStarted++)
+    {
+        if (pthread_create(&threads[numStarted], NULL, _Parallel_WorkerMain, &workers[numStarted]))
+            break;
+    }
+    _Parallel_WorkerMain(&workers[0]);
+    for (i = 1; i < numStarted; i++)
+        pthread_join(threads[i], NULL);
+
+    /* The text after the last chunk must close the array and end */
+    if (!shared.err)
+    {
+        p = text + shared.cursor - 1;
+        if (p == end)
+            _Parallel_Fail(&shared, RED_JSON_ERROR_UNEXPECTED_END, length);
+        else if (*p != ']')
+            _Parallel_Fail(&shared, RED_JSON_ERROR_UNEXPECTED_CHAR, p - text);
+        else if ((p = _RedJson_SkipSpace(p + 1, end)) != end)
+            _Parallel_Fail(&shared, p ? RED_JSON_ERROR_UNEXPECTED_CHAR : RED_JSON_ERROR_UNEXPECTED_END,
+                    p ? (size_t)(p - text) : length);
+    }
+
+    if (!shared.err)
+        out = _Parallel_Stitch(&shared);
+    else if (pError)
+        *pError = _RedJson_ErrorAt(text, shared.errOffset, shared.err);
+
+    for (i = 0; i < ZARRAY_NUM_ITEMS(shared.results); i++)
+        RedJsonArray_Release(ZARRAY_AT(shared.results, i));
+    ZARRAY_FREE(shared.results);
+    for (i = 0; i < numThreads; i++)
+    {
+        RedJsonKeyTable_Free(workers[i].keys);
+        ZARRAY_FREE(workers[i].buffer);
+    }
+    free(workers);
+    free(threads);
+    pthread_mutex_destroy(&shared.mutex);
+    return out;
+}
@@ -0,0 +1,745 @@
+/*
+ *  red_json_path.c - Compiled JSON Pointer / JSONPath queries.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ *
+ *  Both notations compile to the same list of steps.  Member names become
+ *  RedJsonKey handles, so a DOM lookup compares a precomputed hash and never
+ *  rehashes the name.  Evaluation only recurses at wildcards and slices, and
+ *  never deeper than the number of steps.
+ */
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum
+{
+    _PATH_STEP_KEY,         /* object member; also an array index if <index> >= 0 */
+    _PATH_STEP_INDEX,       /* array element, negative counts from the end */
+    _PATH_STEP_WILDCARD,
+    _PATH_STEP_SLICE,
+} _PathStepEnum;
+
+typedef struct
+{
+    _PathStepEnum type;
+    bool hasStart;
+    bool hasEnd;
+    RedJsonKey key;
+    int64_t index;          /* KEY: index for a numeric pointer segment, or -1 */
+    int64_t start;
+    int64_t end;
+    int64_t step;
+} _PathStep;
+
+struct RedJsonPath_t
+{
+    unsigned numSteps;
+    _PathStep steps[];
+};
+
+/*
+ * _RED_JSON_PATH_MAX_INDEX - Largest index accepted by JSONPath, 2^53 - 1.
+ */
+#define _RED_JSON_PATH_MAX_INDEX INT64_C(9007199254740991)
+
+/*
+ * Compiling
+ */
+typedef struct
+{
+    const char *text;
+    const char *p;
+    const char *end;
+    ZARRAY(_PathStep) steps;
+    ZARRAY(char) name;
+} _PathCompiler;
+
+static void _Path_AddKey(_PathCompiler *c, const char *sz, size_t length, int64_t index)
+{
+    _PathStep step;
+    memset(&step, 0, sizeof(step));
+    step.type = _PATH_STEP_KEY;
+    step.key = _RedJsonKey_New(sz, length, _RedJsonKey_Hash(sz, length));
+    step.key->refcnt++;
+    step.index = index;
+    ZARRAY_APPEND(c->steps, step);
+}
+
+static void _Path_AddStep(_PathCompiler *c, _PathStepEnum type)
+{
+    _PathStep step;
+    memset(&step, 0, sizeof(step));
+    step.type = type;
+    step.index = -1;
+    ZARRAY_APPEND(c->steps, step);
+}
+
+static bool _Path_IsDigit(char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+/*
+ * _Path_ArrayIndex - Interpret a pointer segment as an array index:
+ *      0|[1-9][0-9]*, or -1 if it is not one.
+ */
+static int64_t _Path_ArrayIndex(const char *sz, size_t length)
+{
+    int64_t index = 0;
+    size_t i;
+    if (!length || length > 15 || (sz[0] == '0' && length > 1))
+        return -1;
+    for (i = 0; i < length; i++)
+    {
+        if (!_Path_IsDigit(sz[i]))
+            return -1;
+        index = index * 10 + (sz[i] - '0');
+    }
+    return index;
+}
+
+/*
+ * _Path_CompilePointer - Parse RFC 6901 reference tokens.  <c->p> is at the
+ *      first '/'.
+ */
+static bool _Path_CompilePointer(_PathCompiler *c)
+{
+    while (c->p < c->end)
+    {
+        const char *start;
+        if (*c->p != '/')
+            return false;
+        start = ++c->p;
+        ZARRAY_RESIZE(c->name, 0);
+        while (c->p < c->end && *c->p != '/')
+        {
+            if (*c->p == '~')
+            {
+                if (c->p + 1 == c->end || (c->p[1] != '0' && c->p[1] != '1'))
+                    return false;
+                ZARRAY_APPEND(c->name, c->p[1] == '0' ? '~' : '/');
+                c->p += 2;
+                continue;
+            }
+            ZARRAY_APPEND(c->name, *c->p);
+            c->p++;
+        }
+        if (c->p - start == 1 && *start == '*')
+            _Path_AddStep(c, _PATH_STEP_WILDCARD);
+        else
+            _Path_AddKey(c, c->name->item, ZARRAY_NUM_ITEMS(c->name),
+                    _Path_ArrayIndex(c->name->item, ZARRAY_NUM_ITEMS(c->name)));
+    }
+    return true;
+}
+
+static void _Path_SkipBlank(_PathCompiler *c)
+{
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\n' || *c->p == '\r'))
+        c->p++;
+}
+
+static int _Path_HexDigit(char ch)
+{
+    if (ch >= '0' && ch <= '9')
+        return ch - '0';
+    if (ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    return -1;
+}
+
+static bool _Path_Hex4(_PathCompiler *c, uint32_t *pValue)
+{
+    int i, digit;
+    *pValue = 0;
+    if (c->end - c->p < 4)
+        return false;
+    for (i = 0; i < 4; i++)
+    {
+        digit = _Path_HexDigit(c->p[i]);
+        if (digit < 0)
+            return false;
+        *pValue = (*pValue << 4) | digit;
+    }
+    c->p += 4;
+    return true;
+}
+
+/*
+ * _Path_CompileQuoted - Decode a JSONPath string literal into <c->name>.
+ *      <c->p> is just past the opening <quote>; on success it is just past
+ *      the closing one.
+ */
+static bool _Path_CompileQuoted(_PathCompiler *c, char quote)
+{
+    char utf8[4];
+    uint32_t cp, low;
+    size_t n, i;
+
+    ZARRAY_RESIZE(c->name, 0);
+    for (;;)
+    {
+        if (c->p == c->end || (unsigned char)*c->p < 0x20)
+            return false;
+        if (*c->p == quote)
+        {
+            c->p++;
+            return true;
+        }
+        if (*c->p != '\\')
+        {
+            ZARRAY_APPEND(c->name, *c->p);
+            c->p++;
+            continue;
+        }
+        if (++c->p == c->end)
+            return false;
+        switch (*c->p++)
+        {
+            case 'b': ZARRAY_APPEND(c->name, '\b'); continue;
+            case 'f': ZARRAY_APPEND(c->name, '\f'); continue;
+            case 'n': ZARRAY_APPEND(c->name, '\n'); continue;
+            case 'r': ZARRAY_APPEND(c->name, '\r'); continue;
+            case 't': ZARRAY_APPEND(c->name, '\t'); continue;
+            case '/': ZARRAY_APPEND(c->name, '/'); continue;
+            case '\\': ZARRAY_APPEND(c->name, '\\'); continue;
+            case '\'':
+            case '"':
+                if (c->p[-1] != quote)
+                    return false;
+                ZARRAY_APPEND(c->name, quote);
+                continue;
+            case 'u':
+                if (!_Path_Hex4(c, &cp))
+                    return false;
+                if (cp >= 0xDC00 && cp <= 0xDFFF)
+                    return false;
+                if (cp >= 0xD800 && cp <= 0xDBFF)
+                {
+                    if (c->end - c->p < 2 || c->p[0] != '\\' || c->p[1] != 'u')
+                        return false;
+                    c->p += 2;
+                    if (!_Path_Hex4(c, &low) || low < 0xDC00 || low > 0xDFFF)
+                        return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                n = _RedJson_EncodeUtf8(cp, utf8);
+                for (i = 0; i < n; i++)
+                    ZARRAY_APPEND(c->name, utf8[i]);
+                continue;
+            default:
+                c->p--;
+                return false;
+        }
+    }
+}
+
+/*
+ * _Path_CompileInt - Parse an RFC 9535 integer: -?(0|[1-9][0-9]*) within
+ *      +/-(2^53 - 1).
+ */
+static bool _Path_CompileInt(_PathCompiler *c, int64_t *pValue)
+{
+    bool negative = false;
+    int64_t value = 0;
+
+    if (c->p < c->end && *c->p == '-')
+    {
+        negative = true;
+        c->p++;
+    }
+    if (c->p == c->end || !_Path_IsDigit(*c->p) || (*c->p == '0' && negative))
+        return false;
+    if (*c->p == '0')
+    {
+        c->p++;
+        *pValue = 0;
+        return c->p == c->end || !_Path_IsDigit(*c->p);
+    }
+    while (c->p < c->end && _Path_IsDigit(*c->p))
+    {
+        value = value * 10 + (*c->p++ - '0');
+        if (value > _RED_JSON_PATH_MAX_INDEX)
+            return false;
+    }
+    *pValue = negative ? -value : value;
+    return true;
+}
+
+/*
+ * _Path_CompileSelector - Parse the inside of [...].  <c->p> is just past
+ *      the '['.
+ */
+static bool _Path_CompileSelector(_PathCompiler *c)
+{
+    _PathStep step;
+    int64_t value;
+    int part;
+
+    _Path_SkipBlank(c);
+    if (c->p == c->end)
+        return false;
+    if (*c->p == '*')
+    {
+        c->p++;
+        _Path_AddStep(c, _PATH_STEP_WILDCARD);
+    }
+    else if (*c->p == '\'' || *c->p == '"')
+    {
+        c->p++;
+        if (!_Path_CompileQuoted(c, c->p[-1]))
+            return false;
+        _Path_AddKey(c, ZARRAY_NUM_ITEMS(c->name) ? c->name->item : "", ZARRAY_NUM_ITEMS(c->name), -1);
+    }
+    else
+    {
+        /* index, or slice [start]:[end][:[step]] */
+        memset(&step, 0, sizeof(step));
+        step.type = _PATH_STEP_INDEX;
+        step.step = 1;
+        for (part = 0; part < 3; part++)
+        {
+            _Path_SkipBlank(c);
+            if (c->p < c->end && (*c->p == '-' || _Path_IsDigit(*c->p)))
+            {
+                if (!_Path_CompileInt(c, &value))
+                    return false;
+                if (part == 0)
+                {
+                    step.hasStart = true;
+                    step.start = step.index = value;
+                }
+                else if (part == 1)
+                {
+                    step.hasEnd = true;
+                    step.end = value;
+                }
+                else
+                {
+                    step.step = value;
+                }
+                _Path_SkipBlank(c);
+            }
+            else if (part == 0 && (c->p == c->end || *c->p != ':'))
+            {
+                return false;
+            }
+            if (part == 2 || c->p == c->end || *c->p != ':')
+                break;
+            c->p++;
+            step.type = _PATH_STEP_SLICE;
+        }
+        ZARRAY_APPEND(c->steps, step);
+    }
+    _Path_SkipBlank(c);
+    if (c->p == c->end || *c->p != ']')
+        return false;
+    c->p++;
+    return true;
+}
+
+static bool _Path_IsNameFirst(char ch)
+{
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_' || (unsigned char)ch >= 0x80;
+}
+
+/*
+ * _Path_CompileJsonPath - Parse the segments after '$'.
+ */
+static bool _Path_CompileJsonPath(_PathCompiler *c)
+{
+    const char *start;
+    while (c->p < c->end)
+    {
+        if (*c->p == '[')
+        {
+            c->p++;
+            if (!_Path_CompileSelector(c))
+                return false;
+            continue;
+        }
+        if (*c->p != '.')
+            return false;
+        c->p++;
+        if (c->p < c->end && *c->p == '*')
+        {
+            c->p++;
+            _Path_AddStep(c, _PATH_STEP_WILDCARD);
+            continue;
+        }
+        if (c->p == c->end || !_Path_IsNameFirst(*c->p))
+            return false;
+        start = c->p;
+        while (c->p < c->end && (_Path_IsNameFirst(*c->p) || _Path_IsDigit(*c->p)))
+            c->p++;
+        _Path_AddKey(c, start, c->p - start, -1);
+    }
+    return true;
+}
+
+static void _Path_FreeSteps(_PathStep *steps, unsigned numSteps)
+{
+    unsigned i;
+    for (i = 0; i < numSteps; i++)
+    {
+        if (steps[i].key)
+            _RedJsonKey_Release(steps[i].key);
+    }
+}
+
+RedJsonPath RedJsonPath_Compile(const char *szPath, RedJsonError_t *pError)
+{
+    _PathCompiler c;
+    RedJsonPath path = NULL;
+    unsigned numSteps;
+    bool ok;
+
+    c.text = szPath;
+    c.p = szPath;
+    c.end = szPath + strlen(szPath);
+    c.steps = ZARRAY_NEW(_PathStep, 0);
+    c.name = ZARRAY_NEW(char, 0);
+    if (c.p < c.end && *c.p == '$')
+    {
+        c.p++;
+        ok = _Path_CompileJsonPath(&c);
+    }
+    else
+    {
+        ok = _Path_CompilePointer(&c);
+    }
+
+    numSteps = ZARRAY_NUM_ITEMS(c.steps);
+    if (ok)
+    {
+        path = malloc(sizeof(struct RedJsonPath_t) + numSteps * sizeof(_PathStep));
+        assert(path);
+        path->numSteps = numSteps;
+        if (numSteps)
+            memcpy(path->steps, c.steps->item, numSteps * sizeof(_PathStep));
+    }
+    else
+    {
+        _Path_FreeSteps(c.steps->item, numSteps);
+        if (pError)
+            *pError = _RedJson_ErrorAt(szPath, c.p - szPath, RED_JSON_ERROR_BAD_PATH);
+    }
+    ZARRAY_FREE(c.steps);
+    ZARRAY_FREE(c.name);
+    return path;
+}
+
+void RedJsonPath_Free(RedJsonPath path)
+{
+    if (!path)
+        return;
+    _Path_FreeSteps(path->steps, path->numSteps);
+    free(path);
+}
+
+/*
+ * _Path_Slice - Normalize slice <s> for an array of <length> elements as RFC
+ *      9535 does.  The selected indexes are <*pFirst>, stepping by <s->step>
+ *      while strictly before <*pLimit>.  Returns false if nothing is
+ *      selected.
+ */
+static bool _Path_Slice(const _PathStep *s, int64_t length, int64_t *pFirst, int64_t *pLimit)
+{
+    int64_t start, end;
+    if (s->step == 0)
+        return false;
+    if (s->step > 0)
+    {
+        start = s->hasStart ? s->start : 0;
+        end = s->hasEnd ? s->end : length;
+        start = start < 0 ? start + length : start;
+        end = end < 0 ? end + length : end;
+        *pFirst = start < 0 ? 0 : (start > length ? length : start);
+        *pLimit = end < 0 ? 0 : (end > length ? length : end);
+        return *pFirst < *pLimit;
+    }
+    start = s->hasStart ? s->start : length - 1;
+    end = s->hasEnd ? s->end : -length - 1;
+    start = start < 0 ? start + length : start;
+    end = end < 0 ? end + length : end;
+    *pFirst = start < -1 ? -1 : (start > length - 1 ? length - 1 : start);
+    *pLimit = end < -1 ? -1 : (end > length - 1 ? length - 1 : end);
+    return *pFirst > *pLimit;
+}
+
+static bool _Path_InSlice(int64_t i, int64_t limit, int64_t step)
+{
+    return step > 0 ? i < limit : i > limit;
+}
+
+/*
+ * DOM evaluation
+ */
+typedef struct
+{
+    RedJsonPath path;
+    RedJsonPathCallback fnOnMatch;
+    void *userData;
+    unsigned numMatches;
+    bool keepMatch;             /* the match is handed out after evaluation */
+} _PathDomEval;
+
+/*
+ * Element <idx> of <hArray>, selected by step <stepIdx>.  A packed element is
+ * read into <pEntry> without touching the array, unless it is the match and
+ * has to outlive the evaluation; then there is no value to hand out, and the
+ * result is NULL.
+ */
+static RedJsonValue _Path_DomEntry(const _PathDomEval *e, unsigned stepIdx, RedJsonArray hArray, int64_t idx, RedJsonValue_t *pEntry)
+{
+    if (e->keepMatch && stepIdx + 1 == e->path->numSteps)
+        return RedJsonArray_GetEntry(hArray, (unsigned)idx);
+    return _RedJsonArray_Entry(hArray, (unsigned)idx, pEntry);
+}
+
+/* Returns false once a callback has asked to stop. */
+static bool _Path_EvalDom(_PathDomEval *e, unsigned stepIdx, RedJsonValue val)
+{
+    const _PathStep *s;
+    RedJsonObject obj;
+    RedJsonValue_t entry;
+    int64_t length, i, limit;
+    unsigned m;
+
+    for (; stepIdx < e->path->numSteps; stepIdx++)
+    {
+        s = &e->path->steps[stepIdx];
+        length = val->type == RED_JSON_VALUE_TYPE_ARRAY ? RedJsonArray_NumItems(val->val.hArray) : 0;
+        switch (s->type)
+        {
+            case _PATH_STEP_KEY:
+                if (val->type == RED_JSON_VALUE_TYPE_OBJECT)
+                {
+                    val = RedJsonObject_GetByKey(val->val.hObj, s->key);
+                    if (!val)
+                        return true;
+                    continue;
+                }
+                if (s->index < 0 || s->index >= length)
+                    return true;
+                val = _Path_DomEntry(e, stepIdx, val->val.hArray, s->index, &entry);
+                continue;
+            case _PATH_STEP_INDEX:
+                i = s->index < 0 ? s->index + length : s->index;
+                if (i < 0 || i >= length)
+                    return true;
+                val = _Path_DomEntry(e, stepIdx, val->val.hArray, i, &entry);
+                continue;
+            case _PATH_STEP_WILDCARD:
+                if (val->type == RED_JSON_VALUE_TYPE_OBJECT)
+                {
+                    obj = val->val.hObj;
+                    for (m = 0; m < obj->numMembers; m++)
+                    {
+                        if (!_Path_EvalDom(e, stepIdx + 1, obj->members[m].value))
+                            return false;
+                    }
+                    return true;
+                }
+                for (i = 0; i < length; i++)
+                {
+                    if (!_Path_EvalDom(e, stepIdx + 1, _Path_DomEntry(e, stepIdx, val->val.hArray, i, &entry)))
+                        return false;
+                }
+                return true;
+            case _PATH_STEP_SLICE:
+                if (!_Path_Slice(s, length, &i, &limit))
+                    return true;
+                for (; _Path_InSlice(i, limit, s->step); i += s->step)
+                {
+                    if (!_Path_EvalDom(e, stepIdx + 1, _Path_DomEntry(e, stepIdx, val->val.hArray, i, &entry)))
+                        return false;
+                }
+                return true;
+        }
+    }
+    if (!val)
+        return false;
+    e->numMatches++;
+    return !e->fnOnMatch || e->fnOnMatch(val, e->userData);
+}
+
+static unsigned _Path_Eval(RedJsonPath path, RedJsonValue root, bool keepMatch, RedJsonPathCallback fnOnMatch, void *userData)
+{
+    _PathDomEval e;
+    e.path = path;
+    e.fnOnMatch = fnOnMatch;
+    e.userData = userData;
+    e.numMatches = 0;
+    e.keepMatch = keepMatch;
+    _Path_EvalDom(&e, 0, root);
+    return e.numMatches;
+}
+
+static void _Path_ObjectRoot(RedJsonObject root, RedJsonValue_t *pRootVal)
+{
+    pRootVal->refcnt = 1;
+    pRootVal->type = RED_JSON_VALUE_TYPE_OBJECT;
+    pRootVal->val.hObj = root;
+}
+
+unsigned RedJsonPath_Eval(RedJsonPath path, RedJsonValue root, RedJsonPathCallback fnOnMatch, void *userData)
+{
+    return _Path_Eval(path, root, false, fnOnMatch, userData);
+}
+
+unsigned RedJsonPath_EvalObject(RedJsonPath path, RedJsonObject root, RedJsonPathCallback fnOnMatch, void *userData)
+{
+    RedJsonValue_t rootVal;
+    _Path_ObjectRoot(root, &rootVal);
+    return _Path_Eval(path, &rootVal, false, fnOnMatch, userData);
+}
+
+static bool _Path_TakeFirst(RedJsonValue value, void *userData)
+{
+    *(RedJsonValue *)userData = value;
+    return false;
+}
+
+RedJsonValue RedJsonPath_GetFirst(RedJsonPath path, RedJsonObject root)
+{
+    RedJsonValue_t rootVal;
+    RedJsonValue match = NULL;
+    if (!path->numSteps)
+        return NULL;
+    _Path_ObjectRoot(root, &rootVal);
+    _Path_Eval(path, &rootVal, true, _Path_TakeFirst, &match);
+    return match;
+}
+
+/*
+ * Tape evaluation
+ */
+typedef struct
+{
+    RedJsonPath path;
+    RedJsonPathTapeCallback fnOnMatch;
+    void *userData;
+    unsigned numMatches;
+} _PathTapeEval;
+
+static bool _Path_EvalTape(_PathTapeEval *e, unsigned stepIdx, RedJsonTapeRef_t ref)
+{
+    const _PathStep *s;
+    RedJsonValueTypeEnum type;
+    RedJsonTapeRef_t child, *children;
+    int64_t length, i, limit, pos;
+    bool more, keepGoing;
+
+    for (; stepIdx < e->path->numSteps; stepIdx++)
+    {
+        s = &e->path->steps[stepIdx];
+        if (s->type == _PATH_STEP_KEY)
+        {
+            /* Both lookups check the container type themselves */
+            if (!_RedJsonTapeRef_FindN(&ref, s->key->sz, s->key->length, &child)
+                    && (s->index < 0 || !RedJsonTapeRef_Index(&ref, (unsigned)s->index, &child)))
+                return true;
+            ref = child;
+            continue;
+        }
+        type = RedJsonTapeRef_GetType(&ref);
+        if (type != RED_JSON_VALUE_TYPE_OBJECT && type != RED_JSON_VALUE_TYPE_ARRAY)
+            return true;
+        switch (s->type)
+        {
+            case _PATH_STEP_KEY:
+                break;
+            case _PATH_STEP_INDEX:
+                if (type != RED_JSON_VALUE_TYPE_ARRAY)
+                    return true;
+                i = s->index;
+                if (i < 0)
+                    i += RedJsonTapeRef_NumItems(&ref);
+                if (i < 0 || !RedJsonTapeRef_Index(&ref, (unsigned)i, &child))
+                    return true;
+                ref = child;
+                continue;
+            case _PATH_STEP_WILDCARD:
+                for (more = RedJsonTapeRef_First(&ref, &child); more; more = RedJsonTapeRef_Next(&child))
+                {
+                    if (!_Path_EvalTape(e, stepIdx + 1, child))
+                        return false;
+                }
+                return true;
+            case _PATH_STEP_SLICE:
+                if (type != RED_JSON_VALUE_TYPE_ARRAY)
+                    return true;
+                length = RedJsonTapeRef_NumItems(&ref);
+                if (!_Path_Slice(s, length, &i, &limit))
+                    return true;
+                if (s->step > 0)
+                {
+                    /* Elements can only be reached front to back */
+                    for (pos = 0, more = RedJsonTapeRef_First(&ref, &child);
+                            more && pos < limit;
+                            pos++, more = RedJsonTapeRef_Next(&child))
+                    {
+                        if (pos >= i && (pos - i) % s->step == 0 && !_Path_EvalTape(e, stepIdx + 1, child))
+                            return false;
+                    }
+                    return true;
+                }
+                /* Negative steps go backwards, so collect the elements first */
+                children = malloc(length * sizeof(RedJsonTapeRef_t));
+                assert(children);
+                for (pos = 0, more = RedJsonTapeRef_First(&ref, &child); more; more = RedJsonTapeRef_Next(&child))
+                    children[pos++] = child;
+                for (keepGoing = true; keepGoing && _Path_InSlice(i, limit, s->step); i += s->step)
+                    keepGoing = _Path_EvalTape(e, stepIdx + 1, children[i]);
+                free(children);
+                return keepGoing;
+        }
+    }
+    e->numMatches++;
+    return !e->fnOnMatch || e->fnOnMatch(&ref, e->userData);
+}
+
+unsigned RedJsonPath_EvalTape(
+        RedJsonPath path,
+        const RedJsonTapeRef_t *pRoot,
+        RedJsonPathTapeCallback fnOnMatch,
+        void *userData)
+{
+    _PathTapeEval e;
+    e.path = path;
+    e.fnOnMatch = fnOnMatch;
+    e.userData = userData;
+    e.numMatches = 0;
+    _Path_EvalTape(&e, 0, *pRoot);
+    return e.numMatches;
+}
+
+static bool _Path_TakeFirstTape(const RedJsonTapeRef_t *pRef, void *userData)
+{
+    *(RedJsonTapeRef_t *)userData = *pRef;
+    return false;
+}
+
+bool RedJsonPath_GetFirstTape(RedJsonPath path, const RedJsonTapeRef_t *pRoot, RedJsonTapeRef_t *pMatch)
+{
+    return RedJsonPath_EvalTape(path, pRoot, _Path_TakeFirstTape, pMatch) > 0;
+}
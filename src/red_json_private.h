@@ -0,0 +1,507 @@
+/*
+ *  red_json_private.h - Internal definitions shared by the red_json*.c
+ *  translation units.  Not part of the public interface.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ */
+#ifndef RED_JSON_PRIVATE_INCLUDED
+#define RED_JSON_PRIVATE_INCLUDED
+
+#include "red_json.h"
+#include "../under_construction/zarray.h"
+
+#include <stdint.h>
+
+#define REF(hObj) ((hObj)->refcnt++, (hObj))
+
+/*
+ * _RedJsonBacking - Storage shared by the string values that point into
+ *      it: a file mapping (see RedJsonParseOptions_t.stringViews) or a
+ *      string chunk of a RedJsonDocument.  Unmapped or freed when the last
+ *      reference is released.
+ */
+typedef struct _RedJsonBacking_t
+{
+    int refcnt;
+    bool mapped;                /* munmap <base> rather than free it */
+    char *base;
+    size_t length;
+} _RedJsonBacking;
+
+void _RedJsonBacking_Release(_RedJsonBacking *backing);
+
+typedef struct RedJsonValue_t
+{
+    int refcnt;
+    RedJsonValueTypeEnum type;
+    union
+    {
+        RedJsonNumberTypeEnum numberType;   /* numbers */
+        _RedJsonBacking *backing;           /* strings: storage holding <sz>, or NULL if owned */
+    } meta;
+    union
+    {
+        char *sz;
+        double dbl;
+        int64_t i64;
+        uint64_t u64;
+        RedJsonObject hObj;
+        RedJsonArray hArray;
+        bool boolean;
+    } val;
+} RedJsonValue_t;
+
+/*
+ * RedJsonKey_t - An immutable, reference counted object key.  Interned keys
+ *      are shared by every object that uses them.  <diffHash> is the
+ *      _RedJson_Hash64 of the text, for the subtree hashes of RedJson_Diff.
+ */
+typedef struct RedJsonKey_t
+{
+    int refcnt;
+    uint32_t hash;
+    uint64_t diffHash;
+    size_t length;
+    char sz[];
+} RedJsonKey_t;
+
+/*
+ * RedJsonKeyTable_t - Open addressing set of interned keys.  The table holds
+ *      one reference to each key.  <maxKeys> (0 = unlimited) bounds the
+ *      tables that parsers create for themselves.
+ */
+typedef struct RedJsonKeyTable_t
+{
+    RedJsonKey *slots;
+    unsigned mask;
+    unsigned numKeys;
+    unsigned maxKeys;
+} RedJsonKeyTable_t;
+
+/*
+ * _RED_JSON_KEY_TABLE_PRIVATE_MAX_KEYS - Growth limit for parser-owned key
+ *      tables, so that documents with unbounded key sets (ids used as keys)
+ *      cannot grow a long-lived parser without limit.
+ */
+#define _RED_JSON_KEY_TABLE_PRIVATE_MAX_KEYS 4096
+
+/*
+ * _RedJsonMember - One key/value pair of an object.  <hash> repeats
+ *      <key>->hash so that most mismatches are rejected without touching the
+ *      key.
+ */
+typedef struct
+{
+    RedJsonKey key;
+    uint32_t hash;
+    RedJsonValue value;
+} _RedJsonMember;
+
+/*
+ * _RED_JSON_OBJECT_INDEX_THRESHOLD - Objects with up to this many members
+ *      are searched linearly.  Larger objects also keep <index>, an open
+ *      addressing table of member positions (+1, 0 = empty).
+ */
+#define _RED_JSON_OBJECT_INDEX_THRESHOLD 16
+
+/*
+ * RedJsonObject_t, RedJsonArray_t - <hash> caches the subtree hash used by
+ *      RedJson_Diff and RedJsonValue_Equals, 0 until computed.  Every
+ *      function that modifies a container, or hands out one of its children
+ *      for modification (GetMutable*), resets it.
+ */
+typedef struct RedJsonObject_t
+{
+    int refcnt;
+    unsigned numMembers;
+    unsigned capacity;
+    unsigned indexMask;
+    _RedJsonMember *members;    /* insertion order */
+    uint32_t *index;
+    uint64_t hash;
+} RedJsonObject_t;
+
+/*
+ * RedJsonArray_t - Unless <storage> is RED_JSON_ARRAY_STORAGE_VALUES the
+ *      elements are not in <items>, which is then empty, but packed as
+ *      <numPacked> scalars in <packed>.  Readers go through
+ *      _RedJsonArray_Entry; functions that need element values to keep or
+ *      modify call _RedJsonArray_Unpack first.  <packed> may stay allocated, with
+ *      nothing in it, for an array that has been unpacked or recycled.
+ */
+typedef struct RedJsonArray_t
+{
+    int refcnt;
+    ZARRAY(RedJsonValue) items;
+    RedJsonArrayStorageEnum storage;
+    unsigned numPacked;
+    size_t packedBytes;         /* allocated size of <packed> */
+    union
+    {
+        double *doubles;
+        int64_t *int64s;
+        bool *booleans;
+        void *any;
+    } packed;
+    uint64_t hash;
+} RedJsonArray_t;
+
+/*
+ * _RedJsonArray_Unpack - Turn the packed elements of <hArray>, if any, into
+ *      values in <items>.
+ */
+void _RedJsonArray_Unpack(RedJsonArray hArray);
+
+/*
+ * _RedJsonArray_Entry - Element <idx> of <hArray> for reading.  A packed
+ *      element is filled into <pEntry>, as a value that lives only as long as
+ *      <pEntry> and must not be retained or released.
+ */
+RedJsonValue _RedJsonArray_Entry(RedJsonArray hArray, unsigned idx, RedJsonValue_t *pEntry);
+
+/*
+ * _RedJsonNumber - Result of _RedJson_ParseNumber.  <dbl> is always set;
+ *      <i64> or <u64> holds the exact value when <type> says so.
+ */
+typedef struct
+{
+    RedJsonNumberTypeEnum type;
+    double dbl;
+    int64_t i64;
+    uint64_t u64;
+} _RedJsonNumber;
+
+/*
+ * _RedJson_ParseNumber - Parse the JSON number starting at <s>.
+ *
+ *      Never reads at or beyond <end>, and does not depend on the current
+ *      locale.  Parsing stops at the first byte that cannot continue the
+ *      number; the caller decides whether that byte is a valid delimiter.
+ *
+ *      Returns the number of bytes consumed, or 0 if <s> does not start with
+ *      a number matching -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+ *      or the number is too large in magnitude for a double.
+ */
+size_t _RedJson_ParseNumber(const char *s, const char *end, _RedJsonNumber *pNum);
+
+/*
+ * _RedJson_DoubleToInt64, _RedJson_DoubleToUint64 - Truncate <d> toward
+ *      zero, saturating at the limits of the type.  NaN becomes 0.
+ */
+int64_t _RedJson_DoubleToInt64(double d);
+uint64_t _RedJson_DoubleToUint64(double d);
+
+/*
+ * _RED_JSON_NUMBER_BUFFER_SIZE - Buffer size sufficient for any output of the
+ *      _RedJson_Format* functions, including the terminating null.
+ */
+#define _RED_JSON_NUMBER_BUFFER_SIZE 32
+
+/*
+ * _RedJson_FormatDouble - Write the shortest decimal string that parses back
+ *      to exactly <value>.  NaN and infinities are written as null.
+ *
+ *      Returns the length of the null-terminated string written to <buf>.
+ */
+size_t _RedJson_FormatDouble(double value, char *buf);
+
+/*
+ * _RedJson_FormatInt64, _RedJson_FormatUint64 - Write <value> in decimal.
+ *
+ *      Returns the length of the null-terminated string written to <buf>.
+ */
+size_t _RedJson_FormatInt64(int64_t value, char *buf);
+size_t _RedJson_FormatUint64(uint64_t value, char *buf);
+
+/*
+ * _RedJson_FormatNumberValue - Format a number value according to how it is
+ *      stored.
+ */
+size_t _RedJson_FormatNumberValue(RedJsonValue hVal, char *buf);
+
+/*
+ * _RedJsonNumber_ToValue - Create a RedJsonValue of the appropriate number
+ *      type.
+ */
+RedJsonValue _RedJsonNumber_ToValue(const _RedJsonNumber *pNum);
+
+/*
+ * _RedJson_FindEscape - Return the index of the first byte in <s> that must
+ *      be escaped inside a JSON string ('"', '\\' or a control character),
+ *      or <n> if there is none.
+ */
+size_t _RedJson_FindEscape(const char *s, size_t n);
+
+/*
+ * _RedJson_FindStructural - Return the index of the first '"', '{', '}', '['
+ *      or ']' in <s>, or <n> if there is none.
+ */
+size_t _RedJson_FindStructural(const char *s, size_t n);
+
+/*
+ * _RedJson_SpanSpace - Return the number of JSON whitespace bytes (space,
+ *      tab, CR, LF) at the start of <s>.
+ */
+size_t _RedJson_SpanSpace(const char *s, size_t n);
+
+/*
+ * _RedJson_ValidateUtf8 - Check that <s> continues valid UTF-8.
+ *
+ *      <pState> carries an incomplete multi-byte sequence from one call to
+ *      the next; start it at _RED_JSON_UTF8_ACCEPT.  The input is complete
+ *      and valid only if the final state is _RED_JSON_UTF8_ACCEPT.
+ *
+ *      Returns <n>, or the index of the first invalid byte, in which case
+ *      *<pState> is _RED_JSON_UTF8_REJECT.
+ */
+#define _RED_JSON_UTF8_ACCEPT 0
+#define _RED_JSON_UTF8_REJECT 8
+size_t _RedJson_ValidateUtf8(const char *s, size_t n, unsigned *pState);
+
+/*
+ * _RedJson_EncodeUtf8 - Write code point <cp> to <out> (at least 4 bytes).
+ *
+ *      Returns the number of bytes written.
+ */
+size_t _RedJson_EncodeUtf8(uint32_t cp, char *out);
+
+/*
+ * _RedJson_ScanString - Find the end of the JSON string body starting at
+ *      <s>, just past the opening quote, without decoding it.
+ *
+ *      On success *<pStop> points at the closing quote and *<pEscaped> says
+ *      whether the body holds escapes.  On failure *<pStop> points at the
+ *      offending byte.
+ */
+RedJsonErrorEnum _RedJson_ScanString(const char *s, const char *end, bool *pEscaped, const char **pStop);
+
+/*
+ * _RedJson_UnescapeString - Decode the string body [<s>, <quote>) found by
+ *      _RedJson_ScanString into <out>, which must have room for
+ *      <quote> - <s> + 1 bytes, and null-terminate it.
+ *
+ *      Unless <allowNul>, a \u0000 escape fails with RED_JSON_ERROR_BAD_ESCAPE:
+ *      DOM string values are plain C strings, with no length to carry it.
+ *
+ *      On success *<pLength> is the decoded length.  On failure *<pStop>
+ *      points at the offending byte.
+ */
+RedJsonErrorEnum _RedJson_UnescapeString(
+        const char *s,
+        const char *quote,
+        bool escaped,
+        bool allowNul,
+        char *out,
+        size_t *pLength,
+        const char **pStop);
+
+/*
+ * _RedJson_CheckString - Check the string body [<s>, <quote>) found by
+ *      _RedJson_ScanString exactly as _RedJson_UnescapeString would, without
+ *      decoding it anywhere.
+ */
+RedJsonErrorEnum _RedJson_CheckString(const char *s, const char *quote, bool escaped, bool allowNul, const char **pStop);
+
+/*
+ * _RedJson_DecodeString - Decode the JSON string body starting at <s>, just
+ *      past the opening quote.  <allowNul> is as for _RedJson_UnescapeString.
+ *
+ *      On success *<pOut> is a newly allocated, null-terminated copy with all
+ *      escapes decoded, *<pLength> its length, and *<pStop> points at the
+ *      closing quote.  On failure *<pStop> points at the offending byte.
+ */
+RedJsonErrorEnum _RedJson_DecodeString(
+        const char *s,
+        const char *end,
+        bool allowNul,
+        char **pOut,
+        size_t *pLength,
+        const char **pStop);
+
+/*
+ * _RedJsonKey_Hash - Hash <length> bytes of key text.
+ */
+uint32_t _RedJsonKey_Hash(const char *sz, size_t length);
+
+/*
+ * _RedJson_Hash64 - 64-bit hash of <length> bytes, for content hashes that
+ *      must practically never collide.
+ */
+uint64_t _RedJson_Hash64(const char *s, size_t length, uint64_t seed);
+
+/*
+ * _RedJsonKey_New - Create a key that belongs to no table, with a reference
+ *      count of 0.
+ */
+RedJsonKey _RedJsonKey_New(const char *sz, size_t length, uint32_t hash);
+
+/*
+ * _RedJsonKey_Release - Drop one reference to <key>, freeing it at zero.
+ */
+void _RedJsonKey_Release(RedJsonKey key);
+
+/*
+ * _RedJsonKeyTable_InternN - Find or add the key for <length> bytes at <sz>.
+ *      If <table> is full the key is created outside it.  Either way the
+ *      caller must take a reference (REF) to keep the key.
+ */
+RedJsonKey _RedJsonKeyTable_InternN(RedJsonKeyTable table, const char *sz, size_t length);
+
+/*
+ * _RedJsonKeyTable_NewPrivate - Create a table limited to
+ *      _RED_JSON_KEY_TABLE_PRIVATE_MAX_KEYS keys.
+ */
+RedJsonKeyTable _RedJsonKeyTable_NewPrivate(void);
+
+/*
+ * _RedJson_ErrorAt - Build an error for byte <offset> of <text>, working out
+ *      its line and column.
+ */
+RedJsonError_t _RedJson_ErrorAt(const char *text, size_t offset, RedJsonErrorEnum code);
+
+/*
+ * _RedJsonValue_TakeString - Create a string value that takes ownership of
+ *      the heap allocated <sz>.  The caller owns the one reference.
+ */
+RedJsonValue _RedJsonValue_TakeString(char *sz);
+
+/*
+ * _RedJsonParseFrame - One open container on the parser's stack.
+ */
+typedef struct
+{
+    RedJsonObject obj;          /* exactly one of obj and array is set */
+    RedJsonArray array;
+    bool empty;
+} _RedJsonParseFrame;
+
+/*
+ * _RED_JSON_POOL_CHUNK_SIZE - Size of the string chunks of a
+ *      RedJsonDocument.  Longer strings get a chunk of their own.
+ */
+#define _RED_JSON_POOL_CHUNK_SIZE 65536
+
+/*
+ * _RedJsonPool - Everything a RedJsonDocument keeps from one parse to the
+ *      next: recycled values, objects (with their member and index storage)
+ *      and arrays (with their item storage), string chunks, the parser's
+ *      stack and a key table.  The free lists and the stack only ever grow,
+ *      so once they reach the size of the largest message parsing draws on
+ *      them without allocating.
+ *
+ *      Pooled nodes are ordinary heap blocks: one that is still retained
+ *      when the document is reset is simply left to its owner and freed by
+ *      the usual Release.
+ */
+typedef struct _RedJsonPool_t
+{
+    ZARRAY(RedJsonValue) values;
+    ZARRAY(RedJsonObject) objects;
+    ZARRAY(RedJsonArray) arrays;
+    ZARRAY(_RedJsonBacking *) chunks;
+    unsigned chunk;             /* index of the chunk being filled */
+    size_t used;                /* bytes used in chunks[chunk] */
+    ZARRAY(_RedJsonParseFrame) stack;
+    RedJsonKeyTable keys;
+} _RedJsonPool;
+
+/*
+ * _RedJsonPool_RecycleObject - Release <hObj>, returning it and everything
+ *      it contains that is not retained elsewhere to <pool>.
+ */
+void _RedJsonPool_RecycleObject(_RedJsonPool *pool, RedJsonObject hObj);
+
+/*
+ * _RedJson_ParseText - RedJson_ParseWithOptions, optionally creating string
+ *      values that point into <text> instead of copies, or drawing on the
+ *      pool of a RedJsonDocument.
+ *
+ *      If <views> is not NULL <text> must be writable and lie inside it:
+ *      strings are decoded and null-terminated in place, and each string
+ *      value takes a reference to <views>.
+ *
+ *      If <pool> is not NULL, nodes, string storage, the parser's stack and
+ *      (unless <pOptions> supplies one) the key table are taken from it.
+ *      A failed parse returns its nodes to <pool>.
+ */
+RedJsonObject _RedJson_ParseText(
+        const char *text,
+        size_t length,
+        const RedJsonParseOptions_t *pOptions,
+        RedJsonError_t *pError,
+        _RedJsonBacking *views,
+        _RedJsonPool *pool);
+
+/*
+ * _RedJson_SkipSpace - Skip whitespace and comments.  Returns NULL if a
+ *      comment is not terminated.
+ */
+const char * _RedJson_SkipSpace(const char *p, const char *end);
+
+/*
+ * _RedJson_NumCpus - Number of online CPUs, the default number of worker
+ *      threads.
+ */
+unsigned _RedJson_NumCpus(void);
+
+/*
+ * _RedJsonObject_PutKey - Same as RedJsonObject_Put, sharing <key>.
+ */
+void _RedJsonObject_PutKey(RedJsonObject hObj, RedJsonKey key, RedJsonValue hVal);
+
+/*
+ * _RedJsonTapeRef_FindN - RedJsonTapeRef_Find for a key of <keyLength> bytes,
+ *      which may include embedded nulls.
+ */
+bool _RedJsonTapeRef_FindN(const RedJsonTapeRef_t *pRef, const char *szKey, size_t keyLength, RedJsonTapeRef_t *pMember);
+
+/*
+ * _RedJsonStreamParser_SetCallbackOwns - In DOM mode, transfer ownership of
+ *      each delivered subtree to the callback instead of freeing it when the
+ *      callback returns.  The callback must eventually call
+ *      RedJsonValue_Release.
+ */
+void _RedJsonStreamParser_SetCallbackOwns(RedJsonStreamParser parser, bool callbackOwns);
+
+/*
+ * _RedJsonCborDecoder - Resumable CBOR decoder behind
+ *      RedJsonStreamParser_SetFormat(parser, RED_JSON_FORMAT_CBOR).  It reports
+ *      the same SAX events, with the same depths, as the JSON lexer.
+ */
+typedef struct _RedJsonCborDecoder_t _RedJsonCborDecoder;
+
+_RedJsonCborDecoder * _RedJsonCborDecoder_New(RedJsonEventCallback fnOnEvent, void *userData);
+void _RedJsonCborDecoder_Reset(_RedJsonCborDecoder *d);
+void _RedJsonCborDecoder_Free(_RedJsonCborDecoder *d);
+
+/*
+ * _RedJsonCborDecoder_Feed - Decode the next <length> bytes.
+ *
+ *      *<pConsumed> receives the number of bytes consumed, which on failure
+ *      is the offset of the offending byte within <chunk>.
+ */
+RedJsonErrorEnum _RedJsonCborDecoder_Feed(
+        _RedJsonCborDecoder *d,
+        const char *chunk,
+        size_t length,
+        size_t *pConsumed);
+
+/*
+ * _RedJsonCborDecoder_InItem - Determine if the input so far stops in the
+ *      middle of a data item.
+ */
+bool _RedJsonCborDecoder_InItem(_RedJsonCborDecoder *d);
+
+#endif
@@ -0,0 +1,432 @@
+/*
+ *  red_json_reformat.c - Validating, minifying and pretty printing JSON text
+ *  without building a DOM.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ *
+ *  A single pass over the text follows the same grammar as
+ *  _RedJson_ParseText, keeping only a stack of closing brackets.  Tokens are
+ *  copied to the output as written, so nothing is decoded or converted:
+ *  strings are scanned and checked with the vectorized helpers of
+ *  red_json_string.c, numbers are matched against the grammar without being
+ *  converted, and whitespace runs are skipped 16 bytes at a time.
+ */
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <assert.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _REFORMAT_INDENT_WIDTH 2
+
+static const char _spaces[] = "                                                                ";
+
+/*
+ * _ReformatOut - Where tokens go.  <data> is NULL when only validating;
+ *      otherwise it grows as needed if <grow> is set.
+ */
+typedef struct
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool grow;
+    bool pretty;
+} _ReformatOut;
+
+static void _Out_Write(_ReformatOut *out, const char *s, size_t n)
+{
+    if (!out->data)
+        return;
+    if (out->length + n >= out->capacity)
+    {
+        assert(out->grow);
+        while (out->length + n >= out->capacity)
+            out->capacity *= 2;
+        out->data = realloc(out->data, out->capacity);
+        assert(out->data);
+    }
+    /* Minifying in place writes behind the read position */
+    memmove(&out->data[out->length], s, n);
+    out->length += n;
+}
+
+static void _Out_Char(_ReformatOut *out, char c)
+{
+    _Out_Write(out, &c, 1);
+}
+
+static void _Out_Newline(_ReformatOut *out, unsigned depth)
+{
+    size_t n, step;
+    if (!out->pretty)
+        return;
+    _Out_Char(out, '\n');
+    for (n = (size_t)depth * _REFORMAT_INDENT_WIDTH; n > 0; n -= step)
+    {
+        step = (n < sizeof(_spaces) - 1) ? n : sizeof(_spaces) - 1;
+        _Out_Write(out, _spaces, step);
+    }
+}
+
+static const char * _Reformat_SkipSpace(const char *p, const char *end)
+{
+    if (p < end && (unsigned char)*p <= ' ')
+        p += _RedJson_SpanSpace(p, end - p);
+    if (end - p >= 2 && p[0] == '/')
+        return _RedJson_SkipSpace(p, end);
+    return p;
+}
+
+static size_t _Reformat_Digits(const char *p, const char *end)
+{
+    const char *start = p;
+    while (p < end && *p >= '0' && *p <= '9')
+        p++;
+    return p - start;
+}
+
+/*
+ * _Reformat_Number - Match -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+ *      at <s>, as _RedJson_ParseNumber does, converting it only when it
+ *      might overflow a double.  Returns the length matched, or 0.
+ */
+static size_t _Reformat_Number(const char *s, const char *end)
+{
+    const char *p = s;
+    _RedJsonNumber num;
+    size_t n;
+
+    if (p < end && *p == '-')
+        p++;
+    n = _Reformat_Digits(p, end);
+    if (!n || (n > 1 && *p == '0'))
+        return 0;
+    p += n;
+    if (p < end && *p == '.')
+    {
+        n = _Reformat_Digits(++p, end);
+        if (!n)
+            return 0;
+        p += n;
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        if (p < end && (*p == '+' || *p == '-'))
+            p++;
+        n = _Reformat_Digits(p, end);
+        if (!n)
+            return 0;
+        p += n;
+        /* Only an exponent or a huge digit run can overflow a double; let
+         * the parser judge those so that both reject the same text */
+        return _RedJson_ParseNumber(s, end, &num) == (size_t)(p - s) ? (size_t)(p - s) : 0;
+    }
+    if (p - s > DBL_MAX_10_EXP)
+        return _RedJson_ParseNumber(s, end, &num) == (size_t)(p - s) ? (size_t)(p - s) : 0;
+    return p - s;
+}
+
+static bool _Reformat_IsNumberChar(char c)
+{
+    return (c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-';
+}
+
+/*
+ * _Reformat_String - Check the string starting with the quote at <p> and
+ *      copy it out.  <isKey> allows \u0000, as the DOM parser does in keys
+ *      only.  *<pStop> is left just past the closing quote, or at the
+ *      offending byte.
+ */
+static RedJsonErrorEnum _Reformat_String(_ReformatOut *out, const char *p, const char *end, bool isKey, const char **pStop)
+{
+    RedJsonErrorEnum err;
+    const char *quote;
+    unsigned char c;
+    bool escaped;
+
+    /* Keys and many values are short plain ASCII, settled here more cheaply
+     * than by setting up the vectorized scanners */
+    for (quote = p + 1; quote < end && quote - p <= 16; quote++)
+    {
+        c = (unsigned char)*quote;
+        if (c == '"')
+            goto plain;
+        if (c < 0x20 || c == '\\' || c >= 0x80)
+            break;
+    }
+
+    err = _RedJson_ScanString(p + 1, end, &escaped, &quote);
+    if (err)
+    {
+        *pStop = quote;
+        return err;
+    }
+    err = _RedJson_CheckString(p + 1, quote, escaped, isKey, pStop);
+    if (err)
+        return err;
+plain:
+    _Out_Write(out, p, quote + 1 - p);
+    *pStop = quote + 1;
+    return RED_JSON_OK;
+}
+
+/*
+ * _Reformat - Check the JSON object in the <length> bytes at <text> and
+ *      write it to <out> without insignificant whitespace, or laid out as
+ *      RED_JSON_FORMAT_PRETTY if <out>->pretty is set.
+ */
+static RedJsonErrorEnum _Reformat(
+        const char *text,
+        size_t length,
+        unsigned maxDepth,
+        _ReformatOut *out,
+        RedJsonError_t *pError)
+{
+    const char *p = text;
+    const char *end = text + length;
+    const char *stop;
+    char fixed[RED_JSON_DEFAULT_MAX_DEPTH];
+    char *closers = fixed;
+    RedJsonErrorEnum err;
+    unsigned depth = 0;
+    bool empty;
+    size_t n;
+
+    if (!maxDepth)
+        maxDepth = RED_JSON_DEFAULT_MAX_DEPTH;
+    if (maxDepth > RED_JSON_DEFAULT_MAX_DEPTH)
+    {
+        closers = malloc(maxDepth);
+        assert(closers);
+    }
+
+    p = _Reformat_SkipSpace(p, end);
+    if (!p || p == end)
+        goto fail_end;
+    if (*p != '{')
+        goto fail_char;
+    _Out_Char(out, '{');
+    closers[depth++] = '}';
+    empty = true;
+    p++;
+
+    for (;;)
+    {
+        /* Expect a member or element, or the end of a still empty container */
+        p = _Reformat_SkipSpace(p, end);
+        if (!p || p == end)
+            goto fail_end;
+        if (!empty || *p != closers[depth - 1])
+        {
+            _Out_Newline(out, depth);
+            if (closers[depth - 1] == '}')
+            {
+                if (*p != '"')
+                    goto fail_char;
+                err = _Reformat_String(out, p, end, true, &stop);
+                if (err)
+                {
+                    p = stop;
+                    goto fail;
+                }
+                p = _Reformat_SkipSpace(stop, end);
+                if (!p || p == end)
+                    goto fail_end;
+                if (*p != ':')
+                    goto fail_char;
+                if (out->pretty)
+                    _Out_Write(out, ": ", 2);
+                else
+                    _Out_Char(out, ':');
+                p = _Reformat_SkipSpace(p + 1, end);
+                if (!p || p == end)
+                    goto fail_end;
+            }
+
+            switch (*p)
+            {
+                case '{':
+                case '[':
+                    if (depth >= maxDepth)
+                    {
+                        err = RED_JSON_ERROR_DEPTH_EXCEEDED;
+                        goto fail;
+                    }
+                    _Out_Char(out, *p);
+                    /* '{' + 2 == '}' and '[' + 2 == ']' */
+                    closers[depth++] = *p + 2;
+                    empty = true;
+                    p++;
+                    continue;
+                case '"':
+                    err = _Reformat_String(out, p, end, false, &stop);
+                    if (err)
+                    {
+                        p = stop;
+                        goto fail;
+                    }
+                    p = stop;
+                    break;
+                case 't':
+                    if (end - p < 4 || memcmp(p, "true", 4))
+                        goto fail_char;
+                    _Out_Write(out, "true", 4);
+                    p += 4;
+                    break;
+                case 'f':
+                    if (end - p < 5 || memcmp(p, "false", 5))
+                        goto fail_char;
+                    _Out_Write(out, "false", 5);
+                    p += 5;
+                    break;
+                case 'n':
+                    if (end - p < 4 || memcmp(p, "null", 4))
+                        goto fail_char;
+                    _Out_Write(out, "null", 4);
+                    p += 4;
+                    break;
+                default:
+                    if (*p != '-' && (*p < '0' || *p > '9'))
+                        goto fail_char;
+                    n = _Reformat_Number(p, end);
+                    if (!n || (p + n < end && _Reformat_IsNumberChar(p[n])))
+                    {
+                        err = RED_JSON_ERROR_BAD_NUMBER;
+                        goto fail;
+                    }
+                    _Out_Write(out, p, n);
+                    p += n;
+                    break;
+            }
+            empty = false;
+
+            p = _Reformat_SkipSpace(p, end);
+            if (!p || p == end)
+                goto fail_end;
+            if (*p == ',')
+            {
+                _Out_Char(out, ',');
+                p++;
+                continue;
+            }
+            if (*p != closers[depth - 1])
+                goto fail_char;
+        }
+
+        /* *p closes the top container, and possibly its ancestors after it */
+        for (;;)
+        {
+            depth--;
+            if (!empty)
+                _Out_Newline(out, depth);
+            _Out_Char(out, *p);
+            empty = false;
+            p++;
+            if (!depth)
+                goto done;
+            p = _Reformat_SkipSpace(p, end);
+            if (!p || p == end)
+                goto fail_end;
+            if (*p == ',')
+            {
+                _Out_Char(out, ',');
+                p++;
+                break;
+            }
+            if (*p != closers[depth - 1])
+                goto fail_char;
+        }
+    }
+
+done:
+    p = _Reformat_SkipSpace(p, end);
+    if (!p)
+        goto fail_end;
+    if (p != end)
+        goto fail_char;
+    if (closers != fixed)
+        free(closers);
+    if (out->data)
+        out->data[out->length] = 0;
+    return RED_JSON_OK;
+
+fail_end:
+    p = end;
+    err = RED_JSON_ERROR_UNEXPECTED_END;
+    goto fail;
+fail_char:
+    err = RED_JSON_ERROR_UNEXPECTED_CHAR;
+fail:
+    if (closers != fixed)
+        free(closers);
+    if (pError)
+        *pError = _RedJson_ErrorAt(text, p - text, err);
+    return err;
+}
+
+RedJsonErrorEnum RedJson_Validate(
+        const char *text,
+        size_t length,
+        const RedJsonParseOptions_t *pOptions,
+        RedJsonError_t *pError)
+{
+    _ReformatOut out;
+    memset(&out, 0, sizeof(out));
+    return _Reformat(text, length, pOptions ? pOptions->maxDepth : 0, &out, pError);
+}
+
+RedJsonErrorEnum RedJson_Minify(
+        const char *text,
+        size_t length,
+        char *out,
+        size_t *pOutLength,
+        RedJsonError_t *pError)
+{
+    RedJsonErrorEnum err;
+    _ReformatOut o;
+
+    o.data = out;
+    o.length = 0;
+    o.capacity = length + 1;
+    o.grow = false;
+    o.pretty = false;
+    err = _Reformat(text, length, 0, &o, pError);
+    if (!err && pOutLength)
+        *pOutLength = o.length;
+    return err;
+}
+
+char * RedJson_Prettify(const char *text, size_t length, RedJsonError_t *pError)
+{
+    _ReformatOut out;
+
+    /* Pretty output of typical minified input is about a third larger */
+    out.capacity = length + length / 2 + 64;
+    out.data = malloc(out.capacity);
+    assert(out.data);
+    out.length = 0;
+    out.grow = true;
+    out.pretty = true;
+    if (_Reformat(text, length, 0, &out, pError) != RED_JSON_OK)
+    {
+        free(out.data);
+        return NULL;
+    }
+    return out.data;
+}
@@ -0,0 +1,908 @@
+/*
+ *  red_json_stream.c - Resumable push parser for chunked JSON input.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ */
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Lexer states.  Everything that can be interrupted by a chunk boundary has
+ * its own state so Feed can return at any byte and pick up where it left off.
+ */
+typedef enum
+{
+    _STREAM_LEX_NONE,
+    _STREAM_LEX_STRING,
+    _STREAM_LEX_ESCAPE,
+    _STREAM_LEX_UNICODE,
+    _STREAM_LEX_SURROGATE_BACKSLASH,
+    _STREAM_LEX_SURROGATE_U,
+    _STREAM_LEX_NUMBER,
+    _STREAM_LEX_LITERAL,
+    _STREAM_LEX_COMMENT_START,
+    _STREAM_LEX_COMMENT,
+    _STREAM_LEX_COMMENT_STAR,
+} _StreamLexEnum;
+
+/*
+ * Grammar states: what the parser will accept next.
+ */
+typedef enum
+{
+    _STREAM_EXPECT_VALUE,
+    _STREAM_EXPECT_VALUE_OR_END,
+    _STREAM_EXPECT_KEY_OR_END,
+    _STREAM_EXPECT_KEY,
+    _STREAM_EXPECT_COLON,
+    _STREAM_EXPECT_COMMA_OR_END,
+} _StreamExpectEnum;
+
+typedef struct
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+} _StreamBuffer;
+
+typedef struct
+{
+    RedJsonValue container;
+    RedJsonKey key;
+} _StreamDomFrame;
+
+struct RedJsonStreamParser_t
+{
+    _StreamLexEnum lex;
+    _StreamBuffer token;
+    bool stringIsKey;
+    const char *literal;
+    unsigned literalPos;
+    unsigned unicodeDigits;
+    uint32_t unicode;
+    uint32_t highSurrogate;
+    unsigned utf8State;
+
+    _StreamExpectEnum expect;
+    ZARRAY(char) stack;
+
+    size_t offset;
+    unsigned line;
+    size_t lineStart;
+    RedJsonError_t error;
+
+    RedJsonEventCallback fnOnEvent;
+    void *userData;
+
+    unsigned domDepth;
+    RedJsonSubtreeCallback fnOnValue;
+    void *domUserData;
+    ZARRAY(_StreamDomFrame) frames;
+    char *deliverKey;
+    bool callbackOwns;
+    RedJsonKeyTable keys;
+    bool ownsKeys;
+
+    _RedJsonCborDecoder *cbor;
+};
+
+static bool _StreamBuffer_Reserve(_StreamBuffer *buf, size_t extra)
+{
+    size_t needed = buf->length + extra + 1;
+    if (needed > buf->capacity)
+    {
+        size_t newCapacity = buf->capacity ? buf->capacity : 64;
+        char *newData;
+        while (newCapacity < needed)
+            newCapacity *= 2;
+        newData = realloc(buf->data, newCapacity);
+        if (!newData)
+            return false;
+        buf->data = newData;
+        buf->capacity = newCapacity;
+    }
+    return true;
+}
+
+static bool _StreamBuffer_Append(_StreamBuffer *buf, const char *src, size_t n)
+{
+    if (!_StreamBuffer_Reserve(buf, n))
+        return false;
+    memcpy(&buf->data[buf->length], src, n);
+    buf->length += n;
+    buf->data[buf->length] = 0;
+    return true;
+}
+
+static bool _StreamBuffer_AppendUtf8(_StreamBuffer *buf, uint32_t cp)
+{
+    char out[4];
+    return _StreamBuffer_Append(buf, out, _RedJson_EncodeUtf8(cp, out));
+}
+
+static int _HexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static bool _IsNumberChar(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.'
+        || c == 'e' || c == 'E';
+}
+
+static unsigned _Stream_Depth(RedJsonStreamParser p)
+{
+    return ZARRAY_NUM_ITEMS(p->stack);
+}
+
+static bool _Stream_ValueAllowed(RedJsonStreamParser p)
+{
+    return p->expect == _STREAM_EXPECT_VALUE
+        || p->expect == _STREAM_EXPECT_VALUE_OR_END;
+}
+
+static void _Stream_AfterValue(RedJsonStreamParser p)
+{
+    p->expect = _Stream_Depth(p) ? _STREAM_EXPECT_COMMA_OR_END : _STREAM_EXPECT_VALUE;
+}
+
+static RedJsonErrorEnum _Stream_Emit(RedJsonStreamParser p, RedJsonEvent_t *event)
+{
+    return p->fnOnEvent(event, p->userData) ? RED_JSON_OK : RED_JSON_ERROR_ABORTED;
+}
+
+static RedJsonErrorEnum _Stream_EmitSimple(RedJsonStreamParser p, RedJsonEventEnum type, unsigned depth)
+{
+    RedJsonEvent_t event;
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.depth = depth;
+    return _Stream_Emit(p, &event);
+}
+
+static RedJsonErrorEnum _Stream_Open(RedJsonStreamParser p, char bracket)
+{
+    RedJsonErrorEnum err;
+    unsigned depth = _Stream_Depth(p);
+    if (!_Stream_ValueAllowed(p))
+        return RED_JSON_ERROR_UNEXPECTED_CHAR;
+    ZARRAY_APPEND(p->stack, bracket);
+    if (bracket == '{')
+    {
+        p->expect = _STREAM_EXPECT_KEY_OR_END;
+        err = _Stream_EmitSimple(p, RED_JSON_EVENT_BEGIN_OBJECT, depth);
+    }
+    else
+    {
+        p->expect = _STREAM_EXPECT_VALUE_OR_END;
+        err = _Stream_EmitSimple(p, RED_JSON_EVENT_BEGIN_ARRAY, depth);
+    }
+    return err;
+}
+
+static RedJsonErrorEnum _Stream_Close(RedJsonStreamParser p, char bracket)
+{
+    unsigned depth = _Stream_Depth(p);
+    if (!depth || ZARRAY_TAIL(p->stack) != bracket)
+        return RED_JSON_ERROR_UNEXPECTED_CHAR;
+    if (bracket == '{')
+    {
+        if (p->expect != _STREAM_EXPECT_KEY_OR_END && p->expect != _STREAM_EXPECT_COMMA_OR_END)
+            return RED_JSON_ERROR_UNEXPECTED_CHAR;
+    }
+    else
+    {
+        if (p->expect != _STREAM_EXPECT_VALUE_OR_END && p->expect != _STREAM_EXPECT_COMMA_OR_END)
+            return RED_JSON_ERROR_UNEXPECTED_CHAR;
+    }
+    ZARRAY_SHRINK_BY_ONE(p->stack);
+    _Stream_AfterValue(p);
+    return _Stream_EmitSimple(p,
+            (bracket == '{') ? RED_JSON_EVENT_END_OBJECT : RED_JSON_EVENT_END_ARRAY,
+            depth - 1);
+}
+
+static RedJsonErrorEnum _Stream_CompleteString(RedJsonStreamParser p)
+{
+    RedJsonEvent_t event;
+    memset(&event, 0, sizeof(event));
+    event.depth = _Stream_Depth(p);
+    event.sz = p->token.data ? p->token.data : "";
+    event.length = p->token.length;
+    if (p->stringIsKey)
+    {
+        event.type = RED_JSON_EVENT_KEY;
+        p->expect = _STREAM_EXPECT_COLON;
+    }
+    else
+    {
+        event.type = RED_JSON_EVENT_STRING;
+        _Stream_AfterValue(p);
+    }
+    return _Stream_Emit(p, &event);
+}
+
+static RedJsonErrorEnum _Stream_CompleteNumber(RedJsonStreamParser p)
+{
+    RedJsonEvent_t event;
+    _RedJsonNumber num;
+    const char *end = p->token.data + p->token.length;
+    if (_RedJson_ParseNumber(p->token.data, end, &num) != p->token.length)
+        return RED_JSON_ERROR_BAD_NUMBER;
+    memset(&event, 0, sizeof(event));
+    event.type = RED_JSON_EVENT_NUMBER;
+    event.depth = _Stream_Depth(p);
+    event.number = num.dbl;
+    event.numberType = num.type;
+    event.int64 = num.i64;
+    event.uint64 = num.u64;
+    p->lex = _STREAM_LEX_NONE;
+    _Stream_AfterValue(p);
+    return _Stream_Emit(p, &event);
+}
+
+static RedJsonErrorEnum _Stream_CompleteLiteral(RedJsonStreamParser p)
+{
+    RedJsonEvent_t event;
+    memset(&event, 0, sizeof(event));
+    event.depth = _Stream_Depth(p);
+    switch (p->literal[0])
+    {
+        case 't':
+            event.type = RED_JSON_EVENT_BOOLEAN;
+            event.boolean = true;
+            break;
+        case 'f':
+            event.type = RED_JSON_EVENT_BOOLEAN;
+            event.boolean = false;
+            break;
+        default:
+            event.type = RED_JSON_EVENT_NULL;
+            break;
+    }
+    _Stream_AfterValue(p);
+    return _Stream_Emit(p, &event);
+}
+
+static RedJsonErrorEnum _Stream_CompleteUnicode(RedJsonStreamParser p)
+{
+    uint32_t cp = p->unicode;
+    if (p->highSurrogate)
+    {
+        if (cp < 0xDC00 || cp > 0xDFFF)
+            return RED_JSON_ERROR_BAD_ESCAPE;
+        cp = 0x10000 + ((p->highSurrogate - 0xD800) << 10) + (cp - 0xDC00);
+        p->highSurrogate = 0;
+    }
+    else if (cp >= 0xD800 && cp <= 0xDBFF)
+    {
+        p->highSurrogate = cp;
+        p->lex = _STREAM_LEX_SURROGATE_BACKSLASH;
+        return RED_JSON_OK;
+    }
+    else if (cp >= 0xDC00 && cp <= 0xDFFF)
+    {
+        return RED_JSON_ERROR_BAD_ESCAPE;
+    }
+    else if (!cp && p->fnOnValue && !p->stringIsKey)
+    {
+        /* DOM string values are plain C strings */
+        return RED_JSON_ERROR_BAD_ESCAPE;
+    }
+    p->lex = _STREAM_LEX_STRING;
+    return _StreamBuffer_AppendUtf8(&p->token, cp) ? RED_JSON_OK : RED_JSON_ERROR_OUT_OF_MEMORY;
+}
+
+static RedJsonErrorEnum _Stream_SetError(RedJsonStreamParser p, RedJsonErrorEnum err)
+{
+    p->error.code = err;
+    p->error.offset = p->offset;
+    p->error.line = p->line;
+    p->error.column = (unsigned)(p->offset - p->lineStart) + 1;
+    return err;
+}
+
+/*
+ * _Stream_Advance - Update line and offset bookkeeping for <n> consumed bytes.
+ */
+static void _Stream_Advance(RedJsonStreamParser p, const char *chunk, size_t n)
+{
+    const char *nl = chunk;
+    const char *end = chunk + n;
+    while ((nl = memchr(nl, '\n', end - nl)) != NULL)
+    {
+        p->line++;
+        nl++;
+        p->lineStart = p->offset + (nl - chunk);
+    }
+    p->offset += n;
+}
+
+RedJsonErrorEnum RedJsonStreamParser_Feed(
+        RedJsonStreamParser p,
+        const char *chunk,
+        size_t length)
+{
+    RedJsonErrorEnum err = RED_JSON_OK;
+    size_t i = 0;
+
+    if (p->error.code)
+        return p->error.code;
+
+    if (p->cbor)
+    {
+        /* Binary input has no lines; the column is the offset plus one */
+        err = _RedJsonCborDecoder_Feed(p->cbor, chunk, length, &i);
+        p->offset += i;
+        return err ? _Stream_SetError(p, err) : RED_JSON_OK;
+    }
+
+    while (i < length)
+    {
+        char c = chunk[i];
+        switch (p->lex)
+        {
+            case _STREAM_LEX_NONE:
+            {
+                switch (c)
+                {
+                    case ' ':
+                    case '\t':
+                    case '\n':
+                    case '\r':
+                        i++;
+                        break;
+                    case '{':
+                    case '[':
+                        err = _Stream_Open(p, c);
+                        i++;
+                        break;
+                    case '}':
+                        err = _Stream_Close(p, '{');
+                        i++;
+                        break;
+                    case ']':
+                        err = _Stream_Close(p, '[');
+                        i++;
+                        break;
+                    case ',':
+                        if (p->expect != _STREAM_EXPECT_COMMA_OR_END)
+                        {
+                            err = RED_JSON_ERROR_UNEXPECTED_CHAR;
+                            break;
+                        }
+                        p->expect = (ZARRAY_TAIL(p->stack) == '{') ?
+                            _STREAM_EXPECT_KEY : _STREAM_EXPECT_VALUE;
+                        i++;
+                        break;
+                    case ':':
+                        if (p->expect != _STREAM_EXPECT_COLON)
+                        {
+                            err = RED_JSON_ERROR_UNEXPECTED_CHAR;
+                            break;
+                        }
+                        p->expect = _STREAM_EXPECT_VALUE;
+                        i++;
+                        break;
+                    case '"':
+                        if (p->expect == _STREAM_EXPECT_KEY || p->expect == _STREAM_EXPECT_KEY_OR_END)
+                            p->stringIsKey = true;
+                        else if (_Stream_ValueAllowed(p))
+                            p->stringIsKey = false;
+                        else
+                        {
+                            err = RED_JSON_ERROR_UNEXPECTED_CHAR;
+                            break;
+                        }
+                        p->token.length = 0;
+                        p->lex = _STREAM_LEX_STRING;
+                        i++;
+                        break;
+                    case 't':
+                    case 'f':
+                    case 'n':
+                        if (!_Stream_ValueAllowed(p))
+                        {
+                            err = RED_JSON_ERROR_UNEXPECTED_CHAR;
+                            break;
+                        }
+                        p->literal = (c == 't') ? "true" : (c == 'f') ? "false" : "null";
+                        p->literalPos = 1;
+                        p->lex = _STREAM_LEX_LITERAL;
+                        i++;
+                        break;
+                    case '/':
+                        p->lex = _STREAM_LEX_COMMENT_START;
+                        i++;
+                        break;
+                    default:
+                        if ((c >= '0' && c <= '9') || c == '-')
+                        {
+                            if (!_Stream_ValueAllowed(p))
+                            {
+                                err = RED_JSON_ERROR_UNEXPECTED_CHAR;
+                                break;
+                            }
+                            p->token.length = 0;
+                            p->lex = _STREAM_LEX_NUMBER;
+                        }
+                        else
+                        {
+                            err = RED_JSON_ERROR_UNEXPECTED_CHAR;
+                        }
+                        break;
+                }
+                break;
+            }
+            case _STREAM_LEX_STRING:
+            {
+                /* Copy the longest run of ordinary characters in one go.  A
+                 * multi-byte sequence may span chunks but not an escape. */
+                size_t start = i;
+                size_t run = _RedJson_FindEscape(&chunk[i], length - i);
+                size_t valid = _RedJson_ValidateUtf8(&chunk[i], run, &p->utf8State);
+                if (valid < run)
+                {
+                    i += valid;
+                    err = RED_JSON_ERROR_BAD_UTF8;
+                    break;
+                }
+                i += run;
+                if (i > start && !_StreamBuffer_Append(&p->token, &chunk[start], i - start))
+                {
+                    err = RED_JSON_ERROR_OUT_OF_MEMORY;
+                    break;
+                }
+                if (i == length)
+                    break;
+                if (p->utf8State != _RED_JSON_UTF8_ACCEPT)
+                {
+                    err = RED_JSON_ERROR_BAD_UTF8;
+                    break;
+                }
+                if (chunk[i] == '"')
+                {
+                    if (!_StreamBuffer_Reserve(&p->token, 0))
+                    {
+                        err = RED_JSON_ERROR_OUT_OF_MEMORY;
+                        break;
+                    }
+                    p->token.data[p->token.length] = 0;
+                    p->lex = _STREAM_LEX_NONE;
+                    err = _Stream_CompleteString(p);
+                }
+                else if (chunk[i] == '\\')
+                {
+                    p->lex = _STREAM_LEX_ESCAPE;
+                }
+                else
+                {
+                    err = RED_JSON_ERROR_BAD_STRING;
+                    break;
+                }
+                i++;
+                break;
+            }
+            case _STREAM_LEX_ESCAPE:
+            {
+                char decoded;
+                switch (c)
+                {
+                    case '"': decoded = '"'; break;
+                    case '\\': decoded = '\\'; break;
+                    case '/': decoded = '/'; break;
+                    case 'b': decoded = '\b'; break;
+                    case 'f': decoded = '\f'; break;
+                    case 'n': decoded = '\n'; break;
+                    case 'r': decoded = '\r'; break;
+                    case 't': decoded = '\t'; break;
+                    case 'u':
+                        p->unicode = 0;
+                        p->unicodeDigits = 0;
+                        p->lex = _STREAM_LEX_UNICODE;
+                        i++;
+                        continue;
+                    default:
+                        err = RED_JSON_ERROR_BAD_ESCAPE;
+                        break;
+                }
+                if (err)
+                    break;
+                if (!_StreamBuffer_Append(&p->token, &decoded, 1))
+                {
+                    err = RED_JSON_ERROR_OUT_OF_MEMORY;
+                    break;
+                }
+                p->lex = _STREAM_LEX_STRING;
+                i++;
+                break;
+            }
+            case _STREAM_LEX_UNICODE:
+            {
+                int digit = _HexDigitValue(c);
+                if (digit < 0)
+                {
+                    err = RED_JSON_ERROR_BAD_ESCAPE;
+                    break;
+                }
+                p->unicode = (p->unicode << 4) | (uint32_t)digit;
+                p->unicodeDigits++;
+                i++;
+                if (p->unicodeDigits == 4)
+                    err = _Stream_CompleteUnicode(p);
+                break;
+            }
+            case _STREAM_LEX_SURROGATE_BACKSLASH:
+            {
+                if (c != '\\')
+                {
+                    err = RED_JSON_ERROR_BAD_ESCAPE;
+                    break;
+                }
+                p->lex = _STREAM_LEX_SURROGATE_U;
+                i++;
+                break;
+            }
+            case _STREAM_LEX_SURROGATE_U:
+            {
+                if (c != 'u')
+                {
+                    err = RED_JSON_ERROR_BAD_ESCAPE;
+                    break;
+                }
+                p->unicode = 0;
+                p->unicodeDigits = 0;
+                p->lex = _STREAM_LEX_UNICODE;
+                i++;
+                break;
+            }
+            case _STREAM_LEX_NUMBER:
+            {
+                size_t start = i;
+                while (i < length && _IsNumberChar(chunk[i]))
+                    i++;
+                if (i > start && !_StreamBuffer_Append(&p->token, &chunk[start], i - start))
+                {
+                    err = RED_JSON_ERROR_OUT_OF_MEMORY;
+                    break;
+                }
+                /* The terminating byte is left for the next state */
+                if (i < length)
+                    err = _Stream_CompleteNumber(p);
+                break;
+            }
+            case _STREAM_LEX_LITERAL:
+            {
+                if (c != p->literal[p->literalPos])
+                {
+                    err = RED_JSON_ERROR_UNEXPECTED_CHAR;
+                    break;
+                }
+                p->literalPos++;
+                i++;
+                if (!p->literal[p->literalPos])
+                {
+                    p->lex = _STREAM_LEX_NONE;
+                    err = _Stream_CompleteLiteral(p);
+                }
+                break;
+            }
+            case _STREAM_LEX_COMMENT_START:
+            {
+                if (c != '*')
+                {
+                    err = RED_JSON_ERROR_UNEXPECTED_CHAR;
+                    break;
+                }
+                p->lex = _STREAM_LEX_COMMENT;
+                i++;
+                break;
+            }
+            case _STREAM_LEX_COMMENT:
+            {
+                const char *star = memchr(&chunk[i], '*', length - i);
+                if (!star)
+                {
+                    i = length;
+                    break;
+                }
+                i = (star - chunk) + 1;
+                p->lex = _STREAM_LEX_COMMENT_STAR;
+                break;
+            }
+            case _STREAM_LEX_COMMENT_STAR:
+            {
+                if (c == '/')
+                    p->lex = _STREAM_LEX_NONE;
+                else if (c != '*')
+                    p->lex = _STREAM_LEX_COMMENT;
+                i++;
+                break;
+            }
+        }
+        if (err)
+            goto fail;
+    }
+    _Stream_Advance(p, chunk, length);
+    return RED_JSON_OK;
+
+fail:
+    _Stream_Advance(p, chunk, i);
+    return _Stream_SetError(p, err);
+}
+
+RedJsonErrorEnum RedJsonStreamParser_Finish(RedJsonStreamParser p)
+{
+    RedJsonErrorEnum err = RED_JSON_OK;
+    if (p->error.code)
+        return p->error.code;
+
+    if (p->cbor)
+    {
+        if (_RedJsonCborDecoder_InItem(p->cbor))
+            err = RED_JSON_ERROR_UNEXPECTED_END;
+    }
+    else
+    {
+        if (p->lex == _STREAM_LEX_NUMBER)
+            err = _Stream_CompleteNumber(p);
+        if (!err && (p->lex != _STREAM_LEX_NONE || _Stream_Depth(p)))
+            err = RED_JSON_ERROR_UNEXPECTED_END;
+    }
+    return err ? _Stream_SetError(p, err) : RED_JSON_OK;
+}
+
+RedJsonError_t RedJsonStreamParser_GetError(RedJsonStreamParser p)
+{
+    return p->error;
+}
+
+/*
+ * DOM mode: builds subtrees from the SAX events.  Only containers at or below
+ * the delivery depth get a frame; everything above it is never materialized.
+ */
+static bool _StreamDom_Complete(RedJsonStreamParser p, RedJsonValue val, unsigned depth)
+{
+    _StreamDomFrame *parent;
+    bool keepGoing;
+
+    if (!val)
+        return false;
+
+    if (depth == p->domDepth)
+    {
+        keepGoing = p->fnOnValue(val, p->deliverKey, p->domUserData);
+        if (!p->callbackOwns)
+            RedJsonValue_Release(val);
+        free(p->deliverKey);
+        p->deliverKey = NULL;
+        return keepGoing;
+    }
+
+    parent = &ZARRAY_TAIL(p->frames);
+    if (parent->container->type == RED_JSON_VALUE_TYPE_OBJECT)
+    {
+        _RedJsonObject_PutKey(parent->container->val.hObj, parent->key, val);
+        _RedJsonKey_Release(parent->key);
+        parent->key = NULL;
+    }
+    else
+    {
+        RedJsonArray_Append(parent->container->val.hArray, val);
+    }
+    return true;
+}
+
+static bool _StreamDom_OnEvent(const RedJsonEvent_t *event, void *userData)
+{
+    RedJsonStreamParser p = userData;
+    _StreamDomFrame frame;
+    RedJsonValue val;
+    RedJsonKey key;
+
+    if (event->depth < p->domDepth)
+        return true;
+
+    switch (event->type)
+    {
+        case RED_JSON_EVENT_KEY:
+        {
+            if (event->depth == p->domDepth)
+            {
+                char *key = malloc(event->length + 1);
+                if (!key)
+                    return false;
+                memcpy(key, event->sz, event->length + 1);
+                free(p->deliverKey);
+                p->deliverKey = key;
+            }
+            else
+            {
+                if (!p->keys)
+                {
+                    p->keys = _RedJsonKeyTable_NewPrivate();
+                    p->ownsKeys = true;
+                }
+                key = _RedJsonKeyTable_InternN(p->keys, event->sz, event->length);
+                if (ZARRAY_TAIL(p->frames).key)
+                    _RedJsonKey_Release(ZARRAY_TAIL(p->frames).key);
+                ZARRAY_TAIL(p->frames).key = REF(key);
+            }
+            return true;
+        }
+        case RED_JSON_EVENT_BEGIN_OBJECT:
+        case RED_JSON_EVENT_BEGIN_ARRAY:
+        {
+            if (event->type == RED_JSON_EVENT_BEGIN_OBJECT)
+                frame.container = RedJsonValue_FromObject(RedJsonObject_New());
+            else
+                frame.container = RedJsonValue_FromArray(RedJsonArray_New());
+            frame.key = NULL;
+            ZARRAY_APPEND(p->frames, frame);
+            return true;
+        }
+        case RED_JSON_EVENT_END_OBJECT:
+        case RED_JSON_EVENT_END_ARRAY:
+        {
+            frame = ZARRAY_TAIL(p->frames);
+            ZARRAY_SHRINK_BY_ONE(p->frames);
+            if (frame.key)
+                _RedJsonKey_Release(frame.key);
+            val = frame.container;
+            break;
+        }
+        case RED_JSON_EVENT_STRING:
+            val = RedJsonValue_FromString(event->sz);
+            break;
+        case RED_JSON_EVENT_NUMBER:
+            if (event->numberType == RED_JSON_NUMBER_INT64)
+                val = RedJsonValue_FromInt64(event->int64);
+            else if (event->numberType == RED_JSON_NUMBER_UINT64)
+                val = RedJsonValue_FromUint64(event->uint64);
+            else
+                val = RedJsonValue_FromNumber(event->number);
+            break;
+        case RED_JSON_EVENT_BOOLEAN:
+            val = RedJsonValue_FromBoolean(event->boolean);
+            break;
+        default:
+            val = RedJsonValue_Null();
+            break;
+    }
+    return _StreamDom_Complete(p, val, event->depth);
+}
+
+static void _StreamDom_Discard(RedJsonStreamParser p)
+{
+    _StreamDomFrame frame;
+    while (ZARRAY_NUM_ITEMS(p->frames))
+    {
+        frame = ZARRAY_TAIL(p->frames);
+        ZARRAY_SHRINK_BY_ONE(p->frames);
+        if (frame.key)
+            _RedJsonKey_Release(frame.key);
+        RedJsonValue_Release(frame.container);
+    }
+    free(p->deliverKey);
+    p->deliverKey = NULL;
+}
+
+RedJsonStreamParser RedJsonStreamParser_New(
+        RedJsonEventCallback fnOnEvent,
+        void *userData)
+{
+    RedJsonStreamParser p;
+    p = calloc(1, sizeof(struct RedJsonStreamParser_t));
+    if (!p)
+        return NULL;
+    p->stack = ZARRAY_NEW(char, 0);
+    p->frames = ZARRAY_NEW(_StreamDomFrame, 0);
+    if (!p->stack || !p->frames)
+    {
+        RedJsonStreamParser_Free(p);
+        return NULL;
+    }
+    p->fnOnEvent = fnOnEvent;
+    p->userData = userData;
+    RedJsonStreamParser_Reset(p);
+    return p;
+}
+
+RedJsonStreamParser RedJsonStreamParser_NewDom(
+        unsigned depth,
+        RedJsonSubtreeCallback fnOnValue,
+        void *userData)
+{
+    RedJsonStreamParser p;
+    p = RedJsonStreamParser_New(_StreamDom_OnEvent, NULL);
+    if (!p)
+        return NULL;
+    p->userData = p;
+    p->domDepth = depth;
+    p->fnOnValue = fnOnValue;
+    p->domUserData = userData;
+    return p;
+}
+
+void _RedJsonStreamParser_SetCallbackOwns(RedJsonStreamParser p, bool callbackOwns)
+{
+    p->callbackOwns = callbackOwns;
+}
+
+void RedJsonStreamParser_SetKeyTable(RedJsonStreamParser p, RedJsonKeyTable keys)
+{
+    if (p->ownsKeys)
+        RedJsonKeyTable_Free(p->keys);
+    p->keys = keys;
+    p->ownsKeys = false;
+}
+
+RedJsonErrorEnum RedJsonStreamParser_SetFormat(RedJsonStreamParser p, RedJsonFormatEnum format)
+{
+    if (format != RED_JSON_FORMAT_CBOR)
+    {
+        _RedJsonCborDecoder_Free(p->cbor);
+        p->cbor = NULL;
+        return RED_JSON_OK;
+    }
+    if (!p->cbor)
+        p->cbor = _RedJsonCborDecoder_New(p->fnOnEvent, p->userData);
+    return p->cbor ? RED_JSON_OK : RED_JSON_ERROR_OUT_OF_MEMORY;
+}
+
+void RedJsonStreamParser_Reset(RedJsonStreamParser p)
+{
+    _StreamDom_Discard(p);
+    if (p->cbor)
+        _RedJsonCborDecoder_Reset(p->cbor);
+    ZARRAY_RESIZE(p->stack, 0);
+    p->lex = _STREAM_LEX_NONE;
+    p->expect = _STREAM_EXPECT_VALUE;
+    p->token.length = 0;
+    p->highSurrogate = 0;
+    p->utf8State = _RED_JSON_UTF8_ACCEPT;
+    p->offset = 0;
+    p->line = 1;
+    p->lineStart = 0;
+    memset(&p->error, 0, sizeof(p->error));
+}
+
+void RedJsonStreamParser_Free(RedJsonStreamParser p)
+{
+    if (!p)
+        return;
+    if (p->frames)
+    {
+        _StreamDom_Discard(p);
+        ZARRAY_FREE(p->frames);
+    }
+    if (p->ownsKeys)
+        RedJsonKeyTable_Free(p->keys);
+    _RedJsonCborDecoder_Free(p->cbor);
+    ZARRAY_FREE(p->stack);
+    free(p->token.data);
+    free(p);
+}
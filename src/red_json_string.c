@@ -0,0 +1,552 @@
+/*
+ *  red_json_string.c - String scanning, UTF-8 validation and escape decoding
+ *  shared by the JSON parsers and writer.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ *
+ *  Almost all JSON string content is plain text that needs neither escaping
+ *  nor multi-byte validation, so the scanners below look at 16 bytes per step
+ *  with SSE2 (8 bytes per step with plain 64-bit arithmetic elsewhere) and
+ *  only drop to byte-at-a-time code at the bytes that actually matter.
+ */
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * UTF-8 validator states.  The NEED states count the continuation bytes still
+ * expected, so any continuation byte moves NEEDn to NEEDn-1 (ACCEPT == 0).
+ * The remaining states restrict the second byte of a sequence to rule out
+ * overlong encodings, surrogates and code points above U+10FFFF.
+ */
+enum
+{
+    _UTF8_NEED1 = 1,
+    _UTF8_NEED2 = 2,
+    _UTF8_NEED3 = 3,
+    _UTF8_AFTER_E0,     /* A0..BF */
+    _UTF8_AFTER_ED,     /* 80..9F */
+    _UTF8_AFTER_F0,     /* 90..BF */
+    _UTF8_AFTER_F4,     /* 80..8F */
+};
+
+#if !defined(__SSE2__)
+#define _SWAR_ONES 0x0101010101010101ULL
+#define _SWAR_HIGHS 0x8080808080808080ULL
+
+static uint64_t _Load64(const char *s)
+{
+    uint64_t v;
+    memcpy(&v, s, sizeof(v));
+    return v;
+}
+#endif
+
+static bool _NeedsEscape(unsigned char c)
+{
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+size_t _RedJson_FindEscape(const char *s, size_t n)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        /* Unsigned v <= 0x1F  <=>  min(v, 0x1F) == v */
+        __m128i hit = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask)
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+    }
+#else
+    for (; i + 8 <= n; i += 8)
+    {
+        /* Standard "has zero byte" / "has byte less than" tests; a hit only
+         * says some byte in the word matched, so locate it below. */
+        uint64_t v = _Load64(s + i);
+        uint64_t q = v ^ (_SWAR_ONES * '"');
+        uint64_t b = v ^ (_SWAR_ONES * '\\');
+        uint64_t hit = ((q - _SWAR_ONES) & ~q) | ((b - _SWAR_ONES) & ~b) | ((v - _SWAR_ONES * 0x20) & ~v);
+        if (hit & _SWAR_HIGHS)
+            break;
+    }
+#endif
+    for (; i < n; i++)
+    {
+        if (_NeedsEscape((unsigned char)s[i]))
+            return i;
+    }
+    return n;
+}
+
+size_t _RedJson_FindStructural(const char *s, size_t n)
+{
+    size_t i = 0;
+    unsigned char c;
+#if defined(__SSE2__)
+    /* OR-ing in 0x20 maps '[' to '{' and ']' to '}', and nothing else onto
+     * either */
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i folded = _mm_or_si128(v, lower);
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask)
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        c = (unsigned char)s[i] | 0x20;
+        if (s[i] == '"' || c == '{' || c == '}')
+            return i;
+    }
+    return n;
+}
+
+size_t _RedJson_SpanSpace(const char *s, size_t n)
+{
+    size_t i = 0;
+    char c;
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i hit = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, newline)),
+                _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, tab)));
+        int mask = _mm_movemask_epi8(hit) ^ 0xFFFF;
+        if (mask)
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        c = s[i];
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t')
+            return i;
+    }
+    return n;
+}
+
+/*
+ * _FindNonAscii - Return the index of the first byte >= 0x80 in <s>, or <n>.
+ */
+static size_t _FindNonAscii(const char *s, size_t n)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16)
+    {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i)));
+        if (mask)
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+    }
+#else
+    for (; i + 8 <= n; i += 8)
+    {
+        if (_Load64(s + i) & _SWAR_HIGHS)
+            break;
+    }
+#endif
+    for (; i < n; i++)
+    {
+        if ((unsigned char)s[i] >= 0x80)
+            return i;
+    }
+    return n;
+}
+
+static unsigned _Utf8_Lead(unsigned char c)
+{
+    if (c < 0x80)
+        return _RED_JSON_UTF8_ACCEPT;
+    if (c < 0xC2)
+        return _RED_JSON_UTF8_REJECT;
+    if (c < 0xE0)
+        return _UTF8_NEED1;
+    if (c == 0xE0)
+        return _UTF8_AFTER_E0;
+    if (c == 0xED)
+        return _UTF8_AFTER_ED;
+    if (c < 0xF0)
+        return _UTF8_NEED2;
+    if (c == 0xF0)
+        return _UTF8_AFTER_F0;
+    if (c < 0xF4)
+        return _UTF8_NEED3;
+    if (c == 0xF4)
+        return _UTF8_AFTER_F4;
+    return _RED_JSON_UTF8_REJECT;
+}
+
+static unsigned _Utf8_Step(unsigned state, unsigned char c)
+{
+    switch (state)
+    {
+        case _RED_JSON_UTF8_ACCEPT:
+            return _Utf8_Lead(c);
+        case _UTF8_NEED1:
+        case _UTF8_NEED2:
+        case _UTF8_NEED3:
+            return ((c & 0xC0) == 0x80) ? state - 1 : _RED_JSON_UTF8_REJECT;
+        case _UTF8_AFTER_E0:
+            return (c >= 0xA0 && c <= 0xBF) ? _UTF8_NEED1 : _RED_JSON_UTF8_REJECT;
+        case _UTF8_AFTER_ED:
+            return (c >= 0x80 && c <= 0x9F) ? _UTF8_NEED1 : _RED_JSON_UTF8_REJECT;
+        case _UTF8_AFTER_F0:
+            return (c >= 0x90 && c <= 0xBF) ? _UTF8_NEED2 : _RED_JSON_UTF8_REJECT;
+        case _UTF8_AFTER_F4:
+            return (c >= 0x80 && c <= 0x8F) ? _UTF8_NEED2 : _RED_JSON_UTF8_REJECT;
+    }
+    return _RED_JSON_UTF8_REJECT;
+}
+
+size_t _RedJson_ValidateUtf8(const char *s, size_t n, unsigned *pState)
+{
+    const unsigned char *u = (const unsigned char *)s;
+    unsigned state = *pState;
+    size_t i = 0;
+
+    while (i < n)
+    {
+        if (state == _RED_JSON_UTF8_ACCEPT)
+        {
+            i += _FindNonAscii(s + i, n - i);
+            /* Whole sequences that fit are checked without the state machine;
+             * multilingual text is almost entirely made of these. */
+            while (i + 4 <= n)
+            {
+                unsigned char c = u[i];
+                if (c < 0x80)
+                    i++;
+                else if (c >= 0xC2 && c < 0xE0 && (u[i + 1] & 0xC0) == 0x80)
+                    i += 2;
+                else if (c > 0xE0 && c < 0xF0 && c != 0xED
+                        && (u[i + 1] & 0xC0) == 0x80 && (u[i + 2] & 0xC0) == 0x80)
+                    i += 3;
+                else
+                    break;
+            }
+            if (i == n)
+                break;
+        }
+        state = _Utf8_Step(state, u[i]);
+        if (state == _RED_JSON_UTF8_REJECT)
+        {
+            *pState = state;
+            return i;
+        }
+        i++;
+    }
+    *pState = state;
+    return n;
+}
+
+size_t _RedJson_EncodeUtf8(uint32_t cp, char *out)
+{
+    if (cp < 0x80)
+    {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800)
+    {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/*
+ * _Hex4 - Decode the 4 hex digits at <s>.  Returns -1 if any is invalid.
+ */
+static long _Hex4(const char *s)
+{
+    long value = 0;
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        char c = s[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value |= c - 'A' + 10;
+        else
+            return -1;
+    }
+    return value;
+}
+
+/*
+ * _DecodeEscape - Decode the escape sequence at <s> (just past the backslash)
+ *      into <out>.  Returns the number of input bytes consumed, or 0 if the
+ *      sequence is invalid.
+ */
+static size_t _DecodeEscape(const char *s, const char *end, char *out, size_t *pOutLength)
+{
+    long cp, low;
+    if (s >= end)
+        return 0;
+    *pOutLength = 1;
+    switch (*s)
+    {
+        case '"': *out = '"'; return 1;
+        case '\\': *out = '\\'; return 1;
+        case '/': *out = '/'; return 1;
+        case 'b': *out = '\b'; return 1;
+        case 'f': *out = '\f'; return 1;
+        case 'n': *out = '\n'; return 1;
+        case 'r': *out = '\r'; return 1;
+        case 't': *out = '\t'; return 1;
+        case 'u':
+            break;
+        default:
+            return 0;
+    }
+    if (end - s < 5 || (cp = _Hex4(s + 1)) < 0)
+        return 0;
+    if (cp >= 0xDC00 && cp <= 0xDFFF)
+        return 0;
+    if (cp >= 0xD800 && cp <= 0xDBFF)
+    {
+        if (end - s < 11 || s[5] != '\\' || s[6] != 'u')
+            return 0;
+        low = _Hex4(s + 7);
+        if (low < 0xDC00 || low > 0xDFFF)
+            return 0;
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        *pOutLength = _RedJson_EncodeUtf8((uint32_t)cp, out);
+        return 11;
+    }
+    *pOutLength = _RedJson_EncodeUtf8((uint32_t)cp, out);
+    return 5;
+}
+
+RedJsonErrorEnum _RedJson_ScanString(const char *s, const char *end, bool *pEscaped, const char **pStop)
+{
+    const char *p = s;
+
+    /* Control characters are rejected here */
+    *pEscaped = false;
+    for (;;)
+    {
+        p += _RedJson_FindEscape(p, end - p);
+        if (p >= end)
+        {
+            *pStop = end;
+            return RED_JSON_ERROR_UNEXPECTED_END;
+        }
+        if (*p == '"')
+            break;
+        if (*p != '\\')
+        {
+            *pStop = p;
+            return RED_JSON_ERROR_BAD_STRING;
+        }
+        *pEscaped = true;
+        p += 2;
+        if (p > end)
+            p = end;
+    }
+    *pStop = p;
+    return RED_JSON_OK;
+}
+
+RedJsonErrorEnum _RedJson_UnescapeString(
+        const char *s,
+        const char *quote,
+        bool escaped,
+        bool allowNul,
+        char *out,
+        size_t *pLength,
+        const char **pStop)
+{
+    const char *p = s;
+    const char *end = quote;
+    const char *bad;
+    char *dest;
+    unsigned state = _RED_JSON_UTF8_ACCEPT;
+    size_t n, used;
+
+    if (!escaped)
+    {
+        n = _RedJson_ValidateUtf8(s, end - s, &state);
+        if (n < (size_t)(end - s) || state != _RED_JSON_UTF8_ACCEPT)
+        {
+            *pStop = s + n;
+            return RED_JSON_ERROR_BAD_UTF8;
+        }
+        memcpy(out, s, end - s);
+        out[end - s] = 0;
+        *pLength = end - s;
+        return RED_JSON_OK;
+    }
+
+    /* Decode runs between escapes; a multi-byte sequence may not be split
+     * by an escape */
+    dest = out;
+    while (p < end)
+    {
+        n = _RedJson_FindEscape(p, end - p);
+        bad = p + _RedJson_ValidateUtf8(p, n, &state);
+        if (bad < p + n)
+            goto bad_utf8;
+        memcpy(dest, p, n);
+        dest += n;
+        p += n;
+        if (p == end)
+            break;
+        if (state != _RED_JSON_UTF8_ACCEPT)
+        {
+            bad = p;
+            goto bad_utf8;
+        }
+        n = _DecodeEscape(p + 1, end, dest, &used);
+        if (!n || (!allowNul && !*dest))
+        {
+            *pStop = p;
+            return RED_JSON_ERROR_BAD_ESCAPE;
+        }
+        dest += used;
+        p += 1 + n;
+    }
+    if (state != _RED_JSON_UTF8_ACCEPT)
+    {
+        bad = end;
+        goto bad_utf8;
+    }
+    *dest = 0;
+    *pLength = dest - out;
+    return RED_JSON_OK;
+
+bad_utf8:
+    *pStop = bad;
+    return RED_JSON_ERROR_BAD_UTF8;
+}
+
+RedJsonErrorEnum _RedJson_CheckString(const char *s, const char *quote, bool escaped, bool allowNul, const char **pStop)
+{
+    const char *p = s;
+    unsigned state = _RED_JSON_UTF8_ACCEPT;
+    char scratch[4];
+    size_t n, used;
+
+    while (p < quote)
+    {
+        n = escaped ? _RedJson_FindEscape(p, quote - p) : (size_t)(quote - p);
+        used = _RedJson_ValidateUtf8(p, n, &state);
+        if (used < n)
+        {
+            *pStop = p + used;
+            return RED_JSON_ERROR_BAD_UTF8;
+        }
+        p += n;
+        if (p == quote)
+            break;
+        if (state != _RED_JSON_UTF8_ACCEPT)
+        {
+            *pStop = p;
+            return RED_JSON_ERROR_BAD_UTF8;
+        }
+        n = _DecodeEscape(p + 1, quote, scratch, &used);
+        if (!n || (!allowNul && !scratch[0]))
+        {
+            *pStop = p;
+            return RED_JSON_ERROR_BAD_ESCAPE;
+        }
+        p += 1 + n;
+    }
+    if (state != _RED_JSON_UTF8_ACCEPT)
+    {
+        *pStop = quote;
+        return RED_JSON_ERROR_BAD_UTF8;
+    }
+    return RED_JSON_OK;
+}
+
+RedJsonErrorEnum _RedJson_DecodeString(
+        const char *s,
+        const char *end,
+        bool allowNul,
+        char **pOut,
+        size_t *pLength,
+        const char **pStop)
+{
+    RedJsonErrorEnum err;
+    const char *quote;
+    bool escaped;
+    char *out;
+
+    err = _RedJson_ScanString(s, end, &escaped, &quote);
+    if (err)
+    {
+        *pStop = quote;
+        return err;
+    }
+    out = malloc(quote - s + 1);
+    if (!out)
+    {
+        *pStop = s;
+        return RED_JSON_ERROR_OUT_OF_MEMORY;
+    }
+    err = _RedJson_UnescapeString(s, quote, escaped, allowNul, out, pLength, pStop);
+    if (err)
+    {
+        free(out);
+        return err;
+    }
+    *pOut = out;
+    *pStop = quote;
+    return RED_JSON_OK;
+}
@@ -0,0 +1,516 @@
+/*
+ *  red_json_tape.c - Flat, read-only JSON documents.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ *
+ *  Each tape word has an ASCII tag in its top 8 bits and a 56-bit payload:
+ *
+ *      '{' '['     bits 0-31: index just past the matching close word
+ *                  bits 32-55: member or element count (saturates)
+ *      '}' ']'     index of the matching open word
+ *      '"'         offset of a string (or key) in the string buffer
+ *      'l' 'u' 'd' none; the next word holds the int64, uint64 or double
+ *      't' 'f' 'n' none
+ *
+ *  Each string in the string buffer is its length (a size_t) followed by its
+ *  bytes and a terminating null.
+ */
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _TAG_SHIFT 56
+#define _PAYLOAD_MASK ((UINT64_C(1) << _TAG_SHIFT) - 1)
+#define _COUNT_SHIFT 32
+#define _COUNT_MAX 0xFFFFFFu
+
+#define _TAPE_INITIAL_WORDS 256
+#define _TAPE_INITIAL_STRINGS 1024
+
+struct RedJsonTape_t
+{
+    uint64_t *words;
+    uint32_t numWords;
+    uint32_t capacity;
+    char *strings;
+    size_t stringsLength;
+    size_t stringsCapacity;
+};
+
+static uint64_t _Word(char tag, uint64_t payload)
+{
+    return ((uint64_t)(unsigned char)tag << _TAG_SHIFT) | payload;
+}
+
+static char _Tag(uint64_t word)
+{
+    return (char)(word >> _TAG_SHIFT);
+}
+
+static uint32_t _After(uint64_t word)
+{
+    return (uint32_t)word;
+}
+
+/*
+ * Building.  The tape is filled in from the events of a SAX stream parser;
+ * open brackets are patched with their count and close position when the
+ * container ends.
+ */
+typedef struct
+{
+    uint32_t start;         /* tape word of the open bracket */
+    uint32_t count;
+} _TapeOpen;
+
+typedef struct
+{
+    RedJsonTape tape;
+    _TapeOpen *open;
+    unsigned depth;
+    unsigned openCapacity;
+    bool complete;          /* the top-level value has been read */
+    bool extra;             /* a second top-level value was found */
+} _TapeBuilder;
+
+static void _Tape_Append(RedJsonTape tape, uint64_t word)
+{
+    if (tape->numWords == tape->capacity)
+    {
+        tape->capacity *= 2;
+        tape->words = realloc(tape->words, tape->capacity * sizeof(uint64_t));
+        assert(tape->words);
+    }
+    tape->words[tape->numWords++] = word;
+}
+
+static void _Tape_AppendString(RedJsonTape tape, const char *sz, size_t length)
+{
+    size_t needed = sizeof(size_t) + length + 1;
+    size_t offset = tape->stringsLength;
+    while (tape->stringsCapacity - offset < needed)
+    {
+        tape->stringsCapacity *= 2;
+        tape->strings = realloc(tape->strings, tape->stringsCapacity);
+        assert(tape->strings);
+    }
+    memcpy(&tape->strings[offset], &length, sizeof(size_t));
+    memcpy(&tape->strings[offset + sizeof(size_t)], sz, length);
+    tape->strings[offset + sizeof(size_t) + length] = '\0';
+    tape->stringsLength += needed;
+    _Tape_Append(tape, _Word('"', offset));
+}
+
+static void _Tape_AppendRaw(RedJsonTape tape, char tag, const void *pBits)
+{
+    uint64_t bits;
+    memcpy(&bits, pBits, sizeof(bits));
+    _Tape_Append(tape, _Word(tag, 0));
+    _Tape_Append(tape, bits);
+}
+
+static void _Tape_Open(_TapeBuilder *b, char tag)
+{
+    if (b->depth == b->openCapacity)
+    {
+        b->openCapacity = b->openCapacity ? 2 * b->openCapacity : 16;
+        b->open = realloc(b->open, b->openCapacity * sizeof(_TapeOpen));
+        assert(b->open);
+    }
+    b->open[b->depth].start = b->tape->numWords;
+    b->open[b->depth].count = 0;
+    b->depth++;
+    _Tape_Append(b->tape, _Word(tag, 0));
+}
+
+static void _Tape_Close(_TapeBuilder *b, char tag)
+{
+    RedJsonTape tape = b->tape;
+    _TapeOpen *open = &b->open[--b->depth];
+    uint64_t count = (open->count > _COUNT_MAX) ? _COUNT_MAX : open->count;
+    _Tape_Append(tape, _Word(tag, open->start));
+    tape->words[open->start] |= (count << _COUNT_SHIFT) | tape->numWords;
+}
+
+static bool _Tape_OnEvent(const RedJsonEvent_t *event, void *userData)
+{
+    _TapeBuilder *b = userData;
+    RedJsonTape tape = b->tape;
+
+    switch (event->type)
+    {
+        case RED_JSON_EVENT_END_OBJECT:
+            _Tape_Close(b, '}');
+            break;
+        case RED_JSON_EVENT_END_ARRAY:
+            _Tape_Close(b, ']');
+            break;
+        case RED_JSON_EVENT_KEY:
+            _Tape_AppendString(tape, event->sz, event->length);
+            return true;
+        default:
+            if (!b->depth && b->complete)
+            {
+                b->extra = true;
+                return false;
+            }
+            if (b->depth)
+                b->open[b->depth - 1].count++;
+            switch (event->type)
+            {
+                case RED_JSON_EVENT_BEGIN_OBJECT:
+                    _Tape_Open(b, '{');
+                    return true;
+                case RED_JSON_EVENT_BEGIN_ARRAY:
+                    _Tape_Open(b, '[');
+                    return true;
+                case RED_JSON_EVENT_STRING:
+                    _Tape_AppendString(tape, event->sz, event->length);
+                    break;
+                case RED_JSON_EVENT_NUMBER:
+                    if (event->numberType == RED_JSON_NUMBER_INT64)
+                        _Tape_AppendRaw(tape, 'l', &event->int64);
+                    else if (event->numberType == RED_JSON_NUMBER_UINT64)
+                        _Tape_AppendRaw(tape, 'u', &event->uint64);
+                    else
+                        _Tape_AppendRaw(tape, 'd', &event->number);
+                    break;
+                case RED_JSON_EVENT_BOOLEAN:
+                    _Tape_Append(tape, _Word(event->boolean ? 't' : 'f', 0));
+                    break;
+                default:
+                    _Tape_Append(tape, _Word('n', 0));
+                    break;
+            }
+            break;
+    }
+    if (!b->depth)
+        b->complete = true;
+    return true;
+}
+
+RedJsonTape RedJsonTape_Parse(const char *text, size_t length, RedJsonError_t *pError)
+{
+    _TapeBuilder b;
+    RedJsonStreamParser parser;
+    RedJsonErrorEnum err;
+    RedJsonError_t error;
+    RedJsonTape tape;
+
+    memset(&b, 0, sizeof(b));
+    tape = b.tape = calloc(1, sizeof(struct RedJsonTape_t));
+    assert(tape);
+    tape->capacity = _TAPE_INITIAL_WORDS;
+    tape->words = malloc(tape->capacity * sizeof(uint64_t));
+    tape->stringsCapacity = _TAPE_INITIAL_STRINGS;
+    tape->strings = malloc(tape->stringsCapacity);
+    assert(tape->words && tape->strings);
+
+    parser = RedJsonStreamParser_New(_Tape_OnEvent, &b);
+    assert(parser);
+    err = RedJsonStreamParser_Feed(parser, text, length);
+    if (!err)
+        err = RedJsonStreamParser_Finish(parser);
+    error = RedJsonStreamParser_GetError(parser);
+    RedJsonStreamParser_Free(parser);
+    free(b.open);
+
+    if (b.extra)
+        error.code = RED_JSON_ERROR_UNEXPECTED_CHAR;
+    else if (!err && !b.complete)
+        error = _RedJson_ErrorAt(text, length, RED_JSON_ERROR_UNEXPECTED_END);
+    if (b.extra || err || !b.complete)
+    {
+        if (pError)
+            *pError = error;
+        RedJsonTape_Free(tape);
+        return NULL;
+    }
+
+    /* Give back the unused part of the doubling growth */
+    tape->words = realloc(tape->words, tape->numWords * sizeof(uint64_t));
+    tape->capacity = tape->numWords;
+    if (tape->stringsLength)
+    {
+        tape->strings = realloc(tape->strings, tape->stringsLength);
+        tape->stringsCapacity = tape->stringsLength;
+    }
+    return tape;
+}
+
+void RedJsonTape_Free(RedJsonTape tape)
+{
+    if (!tape)
+        return;
+    free(tape->words);
+    free(tape->strings);
+    free(tape);
+}
+
+size_t RedJsonTape_MemoryUsage(RedJsonTape tape)
+{
+    return sizeof(struct RedJsonTape_t) + tape->capacity * sizeof(uint64_t) + tape->stringsCapacity;
+}
+
+RedJsonTapeRef_t RedJsonTape_Root(RedJsonTape tape)
+{
+    RedJsonTapeRef_t ref;
+    ref._tape = tape;
+    ref._idx = 0;
+    ref._key = 0;
+    return ref;
+}
+
+/*
+ * Navigation
+ */
+static uint64_t _Ref_Word(const RedJsonTapeRef_t *pRef)
+{
+    return pRef->_tape->words[pRef->_idx];
+}
+
+/*
+ * _Ref_Skip - Return the index of the tape word just past the value at <idx>.
+ */
+static uint32_t _Ref_Skip(RedJsonTape tape, uint32_t idx)
+{
+    switch (_Tag(tape->words[idx]))
+    {
+        case '{':
+        case '[':
+            return _After(tape->words[idx]);
+        case 'l':
+        case 'u':
+        case 'd':
+            return idx + 2;
+        default:
+            return idx + 1;
+    }
+}
+
+static const char * _Ref_String(RedJsonTape tape, uint32_t idx, size_t *pLength)
+{
+    const char *entry = &tape->strings[tape->words[idx] & _PAYLOAD_MASK];
+    if (pLength)
+        memcpy(pLength, entry, sizeof(size_t));
+    return entry + sizeof(size_t);
+}
+
+RedJsonValueTypeEnum RedJsonTapeRef_GetType(const RedJsonTapeRef_t *pRef)
+{
+    switch (_Tag(_Ref_Word(pRef)))
+    {
+        case '{': return RED_JSON_VALUE_TYPE_OBJECT;
+        case '[': return RED_JSON_VALUE_TYPE_ARRAY;
+        case '"': return RED_JSON_VALUE_TYPE_STRING;
+        case 'l':
+        case 'u':
+        case 'd': return RED_JSON_VALUE_TYPE_NUMBER;
+        case 't':
+        case 'f': return RED_JSON_VALUE_TYPE_BOOLEAN;
+        case 'n': return RED_JSON_VALUE_TYPE_NULL;
+        default: return RED_JSON_VALUE_TYPE_INVALID;
+    }
+}
+
+unsigned RedJsonTapeRef_NumItems(const RedJsonTapeRef_t *pRef)
+{
+    uint64_t word = _Ref_Word(pRef);
+    unsigned count = (unsigned)((word & _PAYLOAD_MASK) >> _COUNT_SHIFT);
+    RedJsonTapeRef_t child;
+    bool more;
+
+    assert(_Tag(word) == '{' || _Tag(word) == '[');
+    if (count < _COUNT_MAX)
+        return count;
+    count = 0;
+    for (more = RedJsonTapeRef_First(pRef, &child); more; more = RedJsonTapeRef_Next(&child))
+        count++;
+    return count;
+}
+
+bool RedJsonTapeRef_First(const RedJsonTapeRef_t *pRef, RedJsonTapeRef_t *pChild)
+{
+    RedJsonTape tape = pRef->_tape;
+    char tag = _Tag(_Ref_Word(pRef));
+    uint32_t idx = pRef->_idx + 1;
+
+    assert(tag == '{' || tag == '[');
+    if (_Tag(tape->words[idx]) == tag + 2)
+        return false;
+    pChild->_tape = tape;
+    pChild->_key = (tag == '{') ? idx : 0;
+    pChild->_idx = (tag == '{') ? idx + 1 : idx;
+    return true;
+}
+
+bool RedJsonTapeRef_Next(RedJsonTapeRef_t *pChild)
+{
+    RedJsonTape tape = pChild->_tape;
+    uint32_t idx = _Ref_Skip(tape, pChild->_idx);
+    char tag;
+
+    if (idx >= tape->numWords)
+        return false;
+    tag = _Tag(tape->words[idx]);
+    if (tag == '}' || tag == ']')
+        return false;
+    if (pChild->_key)
+    {
+        pChild->_key = idx;
+        idx++;
+    }
+    pChild->_idx = idx;
+    return true;
+}
+
+bool RedJsonTapeRef_Find(const RedJsonTapeRef_t *pRef, const char *szKey, RedJsonTapeRef_t *pMember)
+{
+    return _RedJsonTapeRef_FindN(pRef, szKey, strlen(szKey), pMember);
+}
+
+bool _RedJsonTapeRef_FindN(const RedJsonTapeRef_t *pRef, const char *szKey, size_t keyLength, RedJsonTapeRef_t *pMember)
+{
+    RedJsonTapeRef_t member;
+    bool more, found = false;
+
+    if (_Tag(_Ref_Word(pRef)) != '{')
+        return false;
+    for (more = RedJsonTapeRef_First(pRef, &member); more; more = RedJsonTapeRef_Next(&member))
+    {
+        size_t length;
+        const char *key = _Ref_String(member._tape, member._key, &length);
+        if (length == keyLength && !memcmp(key, szKey, keyLength))
+        {
+            *pMember = member;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool RedJsonTapeRef_Index(const RedJsonTapeRef_t *pRef, unsigned idx, RedJsonTapeRef_t *pElement)
+{
+    RedJsonTapeRef_t element;
+    bool more;
+
+    if (_Tag(_Ref_Word(pRef)) != '[')
+        return false;
+    for (more = RedJsonTapeRef_First(pRef, &element); more && idx; more = RedJsonTapeRef_Next(&element))
+        idx--;
+    if (more)
+        *pElement = element;
+    return more;
+}
+
+const char * RedJsonTapeRef_GetKey(const RedJsonTapeRef_t *pRef)
+{
+    return pRef->_key ? _Ref_String(pRef->_tape, pRef->_key, NULL) : NULL;
+}
+
+const char * RedJsonTapeRef_GetString(const RedJsonTapeRef_t *pRef)
+{
+    assert(_Tag(_Ref_Word(pRef)) == '"');
+    return _Ref_String(pRef->_tape, pRef->_idx, NULL);
+}
+
+size_t RedJsonTapeRef_GetStringLength(const RedJsonTapeRef_t *pRef)
+{
+    size_t length;
+    assert(_Tag(_Ref_Word(pRef)) == '"');
+    _Ref_String(pRef->_tape, pRef->_idx, &length);
+    return length;
+}
+
+/*
+ * _Ref_Number - Unpack the number at <pRef>.
+ */
+static _RedJsonNumber _Ref_Number(const RedJsonTapeRef_t *pRef)
+{
+    _RedJsonNumber num;
+    const uint64_t *bits = &pRef->_tape->words[pRef->_idx + 1];
+    switch (_Tag(_Ref_Word(pRef)))
+    {
+        case 'l':
+            num.type = RED_JSON_NUMBER_INT64;
+            memcpy(&num.i64, bits, sizeof(num.i64));
+            num.dbl = (double)num.i64;
+            break;
+        case 'u':
+            num.type = RED_JSON_NUMBER_UINT64;
+            memcpy(&num.u64, bits, sizeof(num.u64));
+            num.dbl = (double)num.u64;
+            break;
+        default:
+            assert(_Tag(_Ref_Word(pRef)) == 'd');
+            num.type = RED_JSON_NUMBER_DOUBLE;
+            memcpy(&num.dbl, bits, sizeof(num.dbl));
+            break;
+    }
+    return num;
+}
+
+double RedJsonTapeRef_GetNumber(const RedJsonTapeRef_t *pRef)
+{
+    return _Ref_Number(pRef).dbl;
+}
+
+int64_t RedJsonTapeRef_GetInt64(const RedJsonTapeRef_t *pRef)
+{
+    _RedJsonNumber num = _Ref_Number(pRef);
+    switch (num.type)
+    {
+        case RED_JSON_NUMBER_INT64:
+            return num.i64;
+        case RED_JSON_NUMBER_UINT64:
+            return (num.u64 > INT64_MAX) ? INT64_MAX : (int64_t)num.u64;
+        default:
+            return _RedJson_DoubleToInt64(num.dbl);
+    }
+}
+
+uint64_t RedJsonTapeRef_GetUint64(const RedJsonTapeRef_t *pRef)
+{
+    _RedJsonNumber num = _Ref_Number(pRef);
+    switch (num.type)
+    {
+        case RED_JSON_NUMBER_INT64:
+            return (num.i64 < 0) ? 0 : (uint64_t)num.i64;
+        case RED_JSON_NUMBER_UINT64:
+            return num.u64;
+        default:
+            return _RedJson_DoubleToUint64(num.dbl);
+    }
+}
+
+RedJsonNumberTypeEnum RedJsonTapeRef_GetNumberType(const RedJsonTapeRef_t *pRef)
+{
+    return _Ref_Number(pRef).type;
+}
+
+bool RedJsonTapeRef_GetBoolean(const RedJsonTapeRef_t *pRef)
+{
+    char tag = _Tag(_Ref_Word(pRef));
+    assert(tag == 't' || tag == 'f');
+    return tag == 't';
+}
+
+bool RedJsonTapeRef_IsNull(const RedJsonTapeRef_t *pRef)
+{
+    return _Tag(_Ref_Word(pRef)) == 'n';
+}
@@ -0,0 +1,968 @@
+/*
+ *  red_json_write.c - JSON serialization to strings, buffers and streams.
+ *
+ *  Author: Gregory Prsiament (greg@toruslabs.com)
+ *
+ *  ===========================================================================
+ *  Creative Commons CC0 1.0 Universal - Public Domain
+ *
+ *  To the extent possible under law, Gregory Prisament has waived all
+ *  copyright and related or neighboring rights to RedTest. This work is
+ *  published from: United States.
+ *
+ *  For details please refer to either:
+ *      - http://creativecommons.org/publicdomain/zero/1.0/legalcode
+ *      - The LICENSE file in this directory, if present.
+ *  ===========================================================================
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "red_json.h"
+#include "red_json_private.h"
+
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define _WRITE_INITIAL_CAPACITY 256
+#define _WRITE_INDENT_WIDTH 2
+#define _WRITE_SINK_BUFFER_SIZE (64 * 1024)
+
+/*
+ * Destination of a streaming writer.  Exactly one of <fd> (>= 0), <fp> or
+ * <fnWrite> is used.
+ */
+typedef struct
+{
+    int fd;
+    FILE *fp;
+    RedJsonWriteCallback fnWrite;
+    void *userData;
+} _JsonSink;
+
+/*
+ * Output buffer.  Everything is appended to a single buffer which, depending
+ * on the mode:
+ *
+ *      - grows geometrically (<growable>),
+ *      - is caller-supplied storage that silently drops what does not fit
+ *        while still counting it in <total>, or
+ *      - is a bounded staging area that is flushed to <sink> whenever it
+ *        fills up.
+ *
+ * <capacity> excludes the byte reserved for the terminating null.
+ */
+typedef struct
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+    size_t total;
+    bool growable;
+    bool failed;
+    _JsonSink *sink;
+    RedJsonFormatEnum format;
+    unsigned depth;
+} _JsonOut;
+
+/*
+ * Escape character for each byte: 0 if the byte is copied verbatim, 'u' for
+ * \u00XX, otherwise the character following the backslash.
+ */
+static const char _escapes[256] =
+{
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    ['"'] = '"',
+    ['\\'] = '\\',
+};
+
+static const char _hexDigits[] = "0123456789abcdef";
+
+static const char _spaces[] = "                                                                ";
+
+static bool _Out_Grow(_JsonOut *out, size_t extra)
+{
+    size_t newCapacity = out->capacity ? out->capacity * 2 : _WRITE_INITIAL_CAPACITY;
+    char *newData;
+    if (newCapacity < out->length + extra)
+        newCapacity = out->length + extra;
+    newData = realloc(out->data, newCapacity + 1);
+    if (!newData)
+    {
+        out->failed = true;
+        return false;
+    }
+    out->data = newData;
+    out->capacity = newCapacity;
+    return true;
+}
+
+/*
+ * _Fd_WriteAll - Write both ranges to <fd> with as few system calls as
+ *      possible, retrying on partial writes and EINTR.
+ */
+static bool _Fd_WriteAll(int fd, const char *a, size_t aLength, const char *b, size_t bLength)
+{
+    struct iovec iov[2];
+    struct iovec *v = iov;
+    int count = 0;
+    ssize_t n;
+
+    if (aLength)
+    {
+        iov[count].iov_base = (void *)a;
+        iov[count].iov_len = aLength;
+        count++;
+    }
+    if (bLength)
+    {
+        iov[count].iov_base = (void *)b;
+        iov[count].iov_len = bLength;
+        count++;
+    }
+    while (count > 0)
+    {
+        n = writev(fd, v, count);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        while (count > 0 && (size_t)n >= v->iov_len)
+        {
+            n -= v->iov_len;
+            v++;
+            count--;
+        }
+        if (count > 0)
+        {
+            v->iov_base = (char *)v->iov_base + n;
+            v->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+/*
+ * _Sink_Write - Deliver <a> followed by <b> to the sink.
+ */
+static bool _Sink_Write(_JsonSink *sink, const char *a, size_t aLength, const char *b, size_t bLength)
+{
+    if (sink->fd >= 0)
+        return _Fd_WriteAll(sink->fd, a, aLength, b, bLength);
+    if (sink->fp)
+    {
+        return (!aLength || fwrite(a, 1, aLength, sink->fp) == aLength)
+            && (!bLength || fwrite(b, 1, bLength, sink->fp) == bLength);
+    }
+    return (!aLength || sink->fnWrite(a, aLength, sink->userData))
+        && (!bLength || sink->fnWrite(b, bLength, sink->userData));
+}
+
+static bool _Out_Flush(_JsonOut *out)
+{
+    if (!out->failed && out->length && !_Sink_Write(out->sink, out->data, out->length, NULL, 0))
+        out->failed = true;
+    out->length = 0;
+    return !out->failed;
+}
+
+/*
+ * _Out_Spill - Make room in a sink-backed buffer.  Payloads at least half the
+ *      buffer size are handed to the sink together with the buffered bytes
+ *      (one writev for fds) instead of being copied.
+ */
+static void _Out_Spill(_JsonOut *out, const char *s, size_t n)
+{
+    if (out->failed)
+        return;
+    if (n >= out->capacity / 2)
+    {
+        if (!_Sink_Write(out->sink, out->data, out->length, s, n))
+            out->failed = true;
+        out->length = 0;
+        return;
+    }
+    if (_Out_Flush(out))
+    {
+        memcpy(out->data, s, n);
+        out->length = n;
+    }
+}
+
+static void _Out_Write(_JsonOut *out, const char *s, size_t n)
+{
+    if (!n)
+        return;
+    out->total += n;
+    if (out->capacity - out->length < n)
+    {
+        if (out->sink)
+        {
+            _Out_Spill(out, s, n);
+            return;
+        }
+        if (!out->growable || !_Out_Grow(out, n))
+        {
+            n = out->capacity - out->length;
+        }
+    }
+    if (n)
+        memcpy(out->data + out->length, s, n);
+    out->length += n;
+}
+
+static void _Out_Char(_JsonOut *out, char c)
+{
+    if (out->length < out->capacity)
+    {
+        out->data[out->length++] = c;
+        out->total++;
+    }
+    else
+    {
+        _Out_Write(out, &c, 1);
+    }
+}
+
+static void _Out_Newline(_JsonOut *out)
+{
+    size_t n;
+    if (out->format != RED_JSON_FORMAT_PRETTY)
+        return;
+    _Out_Char(out, '\n');
+    n = (size_t)out->depth * _WRITE_INDENT_WIDTH;
+    while (n > 0)
+    {
+        size_t step = (n < sizeof(_spaces) - 1) ? n : sizeof(_spaces) - 1;
+        _Out_Write(out, _spaces, step);
+        n -= step;
+    }
+}
+
+static void _Out_String(_JsonOut *out, const char *s, size_t n)
+{
+    const char *end = s + n;
+    char esc[6];
+    size_t run;
+
+    _Out_Char(out, '"');
+    for (;;)
+    {
+        run = _RedJson_FindEscape(s, end - s);
+        _Out_Write(out, s, run);
+        s += run;
+        if (s == end)
+            break;
+        esc[0] = '\\';
+        esc[1] = _escapes[(unsigned char)*s];
+        if (esc[1] == 'u')
+        {
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = _hexDigits[(unsigned char)*s >> 4];
+            esc[5] = _hexDigits[*s & 0xF];
+            _Out_Write(out, esc, 6);
+        }
+        else
+        {
+            _Out_Write(out, esc, 2);
+        }
+        s++;
+    }
+    _Out_Char(out, '"');
+}
+
+static void _Out_Number(_JsonOut *out, RedJsonValue hVal)
+{
+    char number[_RED_JSON_NUMBER_BUFFER_SIZE];
+    size_t n;
+    if (out->capacity - out->length >= _RED_JSON_NUMBER_BUFFER_SIZE)
+    {
+        /* Format in place; the null lands in spare capacity */
+        n = _RedJson_FormatNumberValue(hVal, out->data + out->length);
+        out->length += n;
+        out->total += n;
+        return;
+    }
+    n = _RedJson_FormatNumberValue(hVal, number);
+    _Out_Write(out, number, n);
+}
+
+static void _Write_Value(_JsonOut *out, RedJsonValue hVal);
+
+static void _Write_Object(_JsonOut *out, RedJsonObject hObj)
+{
+    const _RedJsonMember *member;
+    unsigned i;
+
+    _Out_Char(out, '{');
+    out->depth++;
+    for (i = 0; i < hObj->numMembers; i++)
+    {
+        member = &hObj->members[i];
+        if (i)
+            _Out_Char(out, ',');
+        _Out_Newline(out);
+        _Out_String(out, member->key->sz, member->key->length);
+        if (out->format == RED_JSON_FORMAT_PRETTY)
+            _Out_Write(out, ": ", 2);
+        else
+            _Out_Char(out, ':');
+        _Write_Value(out, member->value);
+    }
+    out->depth--;
+    if (hObj->numMembers)
+        _Out_Newline(out);
+    _Out_Char(out, '}');
+}
+
+static void _Write_Array(_JsonOut *out, RedJsonArray hArray)
+{
+    RedJsonValue_t entry;
+    unsigned i, numItems;
+
+    numItems = RedJsonArray_NumItems(hArray);
+    _Out_Char(out, '[');
+    out->depth++;
+    for (i = 0; i < numItems; i++)
+    {
+        if (i)
+            _Out_Char(out, ',');
+        _Out_Newline(out);
+        _Write_Value(out, _RedJsonArray_Entry(hArray, i, &entry));
+    }
+    out->depth--;
+    if (numItems)
+        _Out_Newline(out);
+    _Out_Char(out, ']');
+}
+
+static void _Write_Value(_JsonOut *out, RedJsonValue hVal)
+{
+    switch (hVal->type)
+    {
+        case RED_JSON_VALUE_TYPE_STRING:
+            _Out_String(out, hVal->val.sz, strlen(hVal->val.sz));
+            break;
+        case RED_JSON_VALUE_TYPE_NUMBER:
+            _Out_Number(out, hVal);
+            break;
+        case RED_JSON_VALUE_TYPE_BOOLEAN:
+            if (hVal->val.boolean)
+                _Out_Write(out, "true", 4);
+            else
+                _Out_Write(out, "false", 5);
+            break;
+        case RED_JSON_VALUE_TYPE_OBJECT:
+            _Write_Object(out, hVal->val.hObj);
+            break;
+        case RED_JSON_VALUE_TYPE_ARRAY:
+            _Write_Array(out, hVal->val.hArray);
+            break;
+        case RED_JSON_VALUE_TYPE_NULL:
+            _Out_Write(out, "null", 4);
+            break;
+        case RED_JSON_VALUE_TYPE_INVALID:
+            assert(!"Unexpected JSON type!");
+            break;
+    }
+}
+
+/*
+ *  CBOR OUTPUT
+ */
+
+#define _CBOR_FALSE 0xF4
+#define _CBOR_TRUE 0xF5
+#define _CBOR_NULL 0xF6
+#define _CBOR_HALF 0xF9
+#define _CBOR_SINGLE 0xFA
+#define _CBOR_DOUBLE 0xFB
+#define _CBOR_ARRAY_INDEFINITE 0x9F
+#define _CBOR_MAP_INDEFINITE 0xBF
+#define _CBOR_BREAK 0xFF
+
+/*
+ * _Cbor_HeadSized - Write <initial> followed by the low <argBytes> bytes of
+ *      <arg>, most significant first.
+ */
+static void _Cbor_HeadSized(_JsonOut *out, unsigned char initial, uint64_t arg, unsigned argBytes)
+{
+    unsigned char head[9];
+    unsigned i;
+    head[0] = initial;
+    for (i = argBytes; i > 0; i--)
+    {
+        head[i] = (unsigned char)arg;
+        arg >>= 8;
+    }
+    _Out_Write(out, (const char *)head, argBytes + 1);
+}
+
+/*
+ * _Cbor_Head - Write the shortest head for major type <major> and argument
+ *      <arg>.
+ */
+static void _Cbor_Head(_JsonOut *out, unsigned major, uint64_t arg)
+{
+    unsigned char initial = (unsigned char)(major << 5);
+    if (arg < 24)
+        _Out_Char(out, (char)(initial | arg));
+    else if (arg <= 0xFF)
+        _Cbor_HeadSized(out, initial | 24, arg, 1);
+    else if (arg <= 0xFFFF)
+        _Cbor_HeadSized(out, initial | 25, arg, 2);
+    else if (arg <= 0xFFFFFFFF)
+        _Cbor_HeadSized(out, initial | 26, arg, 4);
+    else
+        _Cbor_HeadSized(out, initial | 27, arg, 8);
+}
+
+static void _Cbor_Int64(_JsonOut *out, int64_t val)
+{
+    if (val >= 0)
+        _Cbor_Head(out, 0, (uint64_t)val);
+    else
+        _Cbor_Head(out, 1, (uint64_t)(-(val + 1)));
+}
+
+/*
+ * _Cbor_ToHalf - Convert <f> to IEEE half precision if that is exact.  NaNs
+ *      all become the canonical quiet NaN.
+ */
+static bool _Cbor_ToHalf(float f, uint16_t *pHalf)
+{
+    uint32_t bits, full;
+    uint16_t sign;
+    int exponent;
+    uint32_t mantissa;
+    unsigned shift;
+
+    memcpy(&bits, &f, sizeof(bits));
+    sign = (uint16_t)((bits >> 16) & 0x8000);
+    exponent = (int)((bits >> 23) & 0xFF) - 127;
+    mantissa = bits & 0x7FFFFF;
+    if (exponent == 128)
+    {
+        *pHalf = sign | 0x7C00 | (mantissa ? 0x200 : 0);
+        return true;
+    }
+    if (exponent == -127 && !mantissa)
+    {
+        *pHalf = sign;
+        return true;
+    }
+    if (exponent >= -14 && exponent <= 15)
+    {
+        if (mantissa & 0x1FFF)
+            return false;
+        *pHalf = sign | (uint16_t)((exponent + 15) << 10) | (uint16_t)(mantissa >> 13);
+        return true;
+    }
+    if (exponent >= -24 && exponent < -14)
+    {
+        /* Subnormal half: the value is a multiple of 2^-24 */
+        full = mantissa | 0x800000;
+        shift = (unsigned)(-exponent - 1);
+        if (full & ((1u << shift) - 1))
+            return false;
+        *pHalf = sign | (uint16_t)(full >> shift);
+        return true;
+    }
+    return false;
+}
+
+static void _Cbor_Double(_JsonOut *out, double val)
+{
+    uint64_t bits64;
+    uint32_t bits32;
+    uint16_t half;
+    float f;
+
+    if (isnan(val) || isinf(val) || (fabs(val) <= FLT_MAX && (double)(float)val == val))
+    {
+        f = (float)val;
+        if (_Cbor_ToHalf(f, &half))
+        {
+            _Cbor_HeadSized(out, _CBOR_HALF, half, 2);
+            return;
+        }
+        memcpy(&bits32, &f, sizeof(bits32));
+        _Cbor_HeadSized(out, _CBOR_SINGLE, bits32, 4);
+        return;
+    }
+    memcpy(&bits64, &val, sizeof(bits64));
+    _Cbor_HeadSized(out, _CBOR_DOUBLE, bits64, 8);
+}
+
+static void _Cbor_String(_JsonOut *out, const char *s, size_t n)
+{
+    _Cbor_Head(out, 3, n);
+    _Out_Write(out, s, n);
+}
+
+static void _Cbor_Value(_JsonOut *out, RedJsonValue hVal);
+
+static void _Cbor_Object(_JsonOut *out, RedJsonObject hObj)
+{
+    const _RedJsonMember *member;
+    unsigned i;
+
+    _Cbor_Head(out, 5, hObj->numMembers);
+    for (i = 0; i < hObj->numMembers; i++)
+    {
+        member = &hObj->members[i];
+        _Cbor_String(out, member->key->sz, member->key->length);
+        _Cbor_Value(out, member->value);
+    }
+}
+
+static void _Cbor_Array(_JsonOut *out, RedJsonArray hArray)
+{
+    RedJsonValue_t entry;
+    unsigned i, numItems;
+
+    numItems = RedJsonArray_NumItems(hArray);
+    _Cbor_Head(out, 4, numItems);
+    for (i = 0; i < numItems; i++)
+        _Cbor_Value(out, _RedJsonArray_Entry(hArray, i, &entry));
+}
+
+static void _Cbor_Value(_JsonOut *out, RedJsonValue hVal)
+{
+    switch (hVal->type)
+    {
+        case RED_JSON_VALUE_TYPE_STRING:
+            _Cbor_String(out, hVal->val.sz, strlen(hVal->val.sz));
+            break;
+        case RED_JSON_VALUE_TYPE_NUMBER:
+            if (hVal->meta.numberType == RED_JSON_NUMBER_INT64)
+                _Cbor_Int64(out, hVal->val.i64);
+            else if (hVal->meta.numberType == RED_JSON_NUMBER_UINT64)
+                _Cbor_Head(out, 0, hVal->val.u64);
+            else
+                _Cbor_Double(out, hVal->val.dbl);
+            break;
+        case RED_JSON_VALUE_TYPE_BOOLEAN:
+            _Out_Char(out, (char)(hVal->val.boolean ? _CBOR_TRUE : _CBOR_FALSE));
+            break;
+        case RED_JSON_VALUE_TYPE_OBJECT:
+            _Cbor_Object(out, hVal->val.hObj);
+            break;
+        case RED_JSON_VALUE_TYPE_ARRAY:
+            _Cbor_Array(out, hVal->val.hArray);
+            break;
+        case RED_JSON_VALUE_TYPE_NULL:
+            _Out_Char(out, (char)_CBOR_NULL);
+            break;
+        case RED_JSON_VALUE_TYPE_INVALID:
+            assert(!"Unexpected JSON type!");
+            break;
+    }
+}
+
+/*
+ * _Out_Value, _Out_Object - Serialize a DOM value in the output's format.
+ */
+static void _Out_Value(_JsonOut *out, RedJsonValue hVal)
+{
+    if (out->format == RED_JSON_FORMAT_CBOR)
+        _Cbor_Value(out, hVal);
+    else
+        _Write_Value(out, hVal);
+}
+
+static void _Out_Object(_JsonOut *out, RedJsonObject hObj)
+{
+    if (out->format == RED_JSON_FORMAT_CBOR)
+        _Cbor_Object(out, hObj);
+    else
+        _Write_Object(out, hObj);
+}
+
+static void _Out_InitGrowable(_JsonOut *out, RedJsonFormatEnum format)
+{
+    memset(out, 0, sizeof(*out));
+    out->growable = true;
+    out->format = format;
+}
+
+static void _Out_InitFixed(_JsonOut *out, RedJsonFormatEnum format, char *buf, size_t bufSize)
+{
+    memset(out, 0, sizeof(*out));
+    out->data = buf;
+    out->capacity = bufSize ? bufSize - 1 : 0;
+    out->format = format;
+}
+
+static char * _Out_FinishGrowable(_JsonOut *out)
+{
+    if (out->failed || (!out->data && !_Out_Grow(out, 0)))
+    {
+        free(out->data);
+        return NULL;
+    }
+    out->data[out->length] = '\0';
+    return out->data;
+}
+
+char * RedJsonValue_ToJsonString(RedJsonValue jsonVal)
+{
+    return RedJsonValue_ToFormattedJsonString(jsonVal, RED_JSON_FORMAT_PRETTY);
+}
+
+char * RedJsonObject_ToJsonString(RedJsonObject jsonObj)
+{
+    return RedJsonObject_ToFormattedJsonString(jsonObj, RED_JSON_FORMAT_PRETTY);
+}
+
+char * RedJsonValue_ToFormattedJsonString(RedJsonValue jsonVal, RedJsonFormatEnum format)
+{
+    _JsonOut out;
+    assert(format != RED_JSON_FORMAT_CBOR && "Use RedJsonValue_ToCbor");
+    _Out_InitGrowable(&out, format);
+    _Write_Value(&out, jsonVal);
+    return _Out_FinishGrowable(&out);
+}
+
+char * RedJsonObject_ToFormattedJsonString(RedJsonObject jsonObj, RedJsonFormatEnum format)
+{
+    _JsonOut out;
+    assert(format != RED_JSON_FORMAT_CBOR && "Use RedJsonValue_ToCbor");
+    _Out_InitGrowable(&out, format);
+    _Write_Object(&out, jsonObj);
+    return _Out_FinishGrowable(&out);
+}
+
+size_t RedJsonValue_WriteJson(RedJsonValue jsonVal, RedJsonFormatEnum format, char *buf, size_t bufSize)
+{
+    _JsonOut out;
+    _Out_InitFixed(&out, format, buf, bufSize);
+    _Out_Value(&out, jsonVal);
+    if (bufSize)
+        buf[out.length] = '\0';
+    return out.total;
+}
+
+size_t RedJsonObject_WriteJson(RedJsonObject jsonObj, RedJsonFormatEnum format, char *buf, size_t bufSize)
+{
+    _JsonOut out;
+    _Out_InitFixed(&out, format, buf, bufSize);
+    _Out_Object(&out, jsonObj);
+    if (bufSize)
+        buf[out.length] = '\0';
+    return out.total;
+}
+
+char * RedJsonValue_ToCbor(RedJsonValue jsonVal, size_t *pLength)
+{
+    _JsonOut out;
+    char *data;
+    _Out_InitGrowable(&out, RED_JSON_FORMAT_CBOR);
+    _Cbor_Value(&out, jsonVal);
+    data = _Out_FinishGrowable(&out);
+    *pLength = data ? out.length : 0;
+    return data;
+}
+
+/*
+ *  STREAMING WRITER
+ */
+
+struct RedJsonWriter_t
+{
+    _JsonOut out;
+    _JsonSink sink;
+    ZARRAY(char) stack;
+    bool first;
+    bool afterKey;
+};
+
+static RedJsonWriter _Writer_New(const _JsonSink *sink, RedJsonFormatEnum format)
+{
+    RedJsonWriter w = calloc(1, sizeof(struct RedJsonWriter_t));
+    if (!w)
+        return NULL;
+    w->sink = *sink;
+    w->out.data = malloc(_WRITE_SINK_BUFFER_SIZE + 1);
+    w->out.capacity = _WRITE_SINK_BUFFER_SIZE;
+    w->out.sink = &w->sink;
+    w->out.format = format;
+    w->stack = ZARRAY_NEW(char, 0);
+    w->first = true;
+    if (!w->out.data || !w->stack)
+    {
+        RedJsonWriter_Free(w);
+        return NULL;
+    }
+    return w;
+}
+
+RedJsonWriter RedJsonWriter_NewFd(int fd, RedJsonFormatEnum format)
+{
+    _JsonSink sink = {fd, NULL, NULL, NULL};
+    return _Writer_New(&sink, format);
+}
+
+RedJsonWriter RedJsonWriter_NewFile(FILE *fp, RedJsonFormatEnum format)
+{
+    _JsonSink sink = {-1, fp, NULL, NULL};
+    return _Writer_New(&sink, format);
+}
+
+RedJsonWriter RedJsonWriter_NewCallback(RedJsonWriteCallback fnWrite, void *userData, RedJsonFormatEnum format)
+{
+    _JsonSink sink = {-1, NULL, fnWrite, userData};
+    return _Writer_New(&sink, format);
+}
+
+static bool _Writer_IsCbor(RedJsonWriter w)
+{
+    return w->out.format == RED_JSON_FORMAT_CBOR;
+}
+
+static RedJsonErrorEnum _Writer_Status(RedJsonWriter w)
+{
+    return w->out.failed ? RED_JSON_ERROR_IO : RED_JSON_OK;
+}
+
+static char _Writer_Container(RedJsonWriter w)
+{
+    unsigned depth = ZARRAY_NUM_ITEMS(w->stack);
+    return depth ? ZARRAY_AT(w->stack, depth - 1) : 0;
+}
+
+/*
+ * _Writer_BeforeValue - Emit whatever separates the next value from the
+ *      previous one.  Top-level values are separated by newlines, so a
+ *      compact writer can produce NDJSON.  CBOR needs no separators.
+ */
+static void _Writer_BeforeValue(RedJsonWriter w)
+{
+    char container = _Writer_Container(w);
+    if (container == '{')
+    {
+        assert(w->afterKey && "RedJsonWriter: object member written without a key");
+        w->afterKey = false;
+        return;
+    }
+    if (!w->first && !_Writer_IsCbor(w))
+    {
+        if (container)
+            _Out_Char(&w->out, ',');
+        else
+            _Out_Char(&w->out, '\n');
+    }
+    if (container)
+        _Out_Newline(&w->out);
+    w->first = false;
+}
+
+static RedJsonErrorEnum _Writer_Begin(RedJsonWriter w, char open)
+{
+    _Writer_BeforeValue(w);
+    if (_Writer_IsCbor(w))
+        _Out_Char(&w->out, (char)(open == '{' ? _CBOR_MAP_INDEFINITE : _CBOR_ARRAY_INDEFINITE));
+    else
+        _Out_Char(&w->out, open);
+    ZARRAY_APPEND(w->stack, open);
+    w->out.depth++;
+    w->first = true;
+    return _Writer_Status(w);
+}
+
+static RedJsonErrorEnum _Writer_End(RedJsonWriter w, char open, char close)
+{
+    assert(_Writer_Container(w) == open && !w->afterKey && "RedJsonWriter: unbalanced End call");
+    ZARRAY_SHRINK_BY_ONE(w->stack);
+    w->out.depth--;
+    if (!w->first)
+        _Out_Newline(&w->out);
+    _Out_Char(&w->out, _Writer_IsCbor(w) ? (char)_CBOR_BREAK : close);
+    w->first = false;
+    return _Writer_Status(w);
+}
+
+RedJsonErrorEnum RedJsonWriter_BeginObject(RedJsonWriter w)
+{
+    return _Writer_Begin(w, '{');
+}
+
+RedJsonErrorEnum RedJsonWriter_EndObject(RedJsonWriter w)
+{
+    return _Writer_End(w, '{', '}');
+}
+
+RedJsonErrorEnum RedJsonWriter_BeginArray(RedJsonWriter w)
+{
+    return _Writer_Begin(w, '[');
+}
+
+RedJsonErrorEnum RedJsonWriter_EndArray(RedJsonWriter w)
+{
+    return _Writer_End(w, '[', ']');
+}
+
+RedJsonErrorEnum RedJsonWriter_Key(RedJsonWriter w, const char *szKey)
+{
+    assert(_Writer_Container(w) == '{' && !w->afterKey && "RedJsonWriter: key outside of object");
+    if (_Writer_IsCbor(w))
+    {
+        _Cbor_String(&w->out, szKey, strlen(szKey));
+    }
+    else
+    {
+        if (!w->first)
+            _Out_Char(&w->out, ',');
+        _Out_Newline(&w->out);
+        _Out_String(&w->out, szKey, strlen(szKey));
+        if (w->out.format == RED_JSON_FORMAT_PRETTY)
+            _Out_Write(&w->out, ": ", 2);
+        else
+            _Out_Char(&w->out, ':');
+    }
+    w->first = false;
+    w->afterKey = true;
+    return _Writer_Status(w);
+}
+
+RedJsonErrorEnum RedJsonWriter_String(RedJsonWriter w, const char *sz)
+{
+    _Writer_BeforeValue(w);
+    if (_Writer_IsCbor(w))
+        _Cbor_String(&w->out, sz, strlen(sz));
+    else
+        _Out_String(&w->out, sz, strlen(sz));
+    return _Writer_Status(w);
+}
+
+RedJsonErrorEnum RedJsonWriter_Number(RedJsonWriter w, double val)
+{
+    char number[_RED_JSON_NUMBER_BUFFER_SIZE];
+    _Writer_BeforeValue(w);
+    if (_Writer_IsCbor(w))
+        _Cbor_Double(&w->out, val);
+    else
+        _Out_Write(&w->out, number, _RedJson_FormatDouble(val, number));
+    return _Writer_Status(w);
+}
+
+RedJsonErrorEnum RedJsonWriter_Int64(RedJsonWriter w, int64_t val)
+{
+    char number[_RED_JSON_NUMBER_BUFFER_SIZE];
+    _Writer_BeforeValue(w);
+    if (_Writer_IsCbor(w))
+        _Cbor_Int64(&w->out, val);
+    else
+        _Out_Write(&w->out, number, _RedJson_FormatInt64(val, number));
+    return _Writer_Status(w);
+}
+
+RedJsonErrorEnum RedJsonWriter_Uint64(RedJsonWriter w, uint64_t val)
+{
+    char number[_RED_JSON_NUMBER_BUFFER_SIZE];
+    _Writer_BeforeValue(w);
+    if (_Writer_IsCbor(w))
+        _Cbor_Head(&w->out, 0, val);
+    else
+        _Out_Write(&w->out, number, _RedJson_FormatUint64(val, number));
+    return _Writer_Status(w);
+}
+
+RedJsonErrorEnum RedJsonWriter_Boolean(RedJsonWriter w, bool val)
+{
+    _Writer_BeforeValue(w);
+    if (_Writer_IsCbor(w))
+        _Out_Char(&w->out, (char)(val ? _CBOR_TRUE : _CBOR_FALSE));
+    else if (val)
+        _Out_Write(&w->out, "true", 4);
+    else
+        _Out_Write(&w->out, "false", 5);
+    return _Writer_Status(w);
+}
+
+RedJsonErrorEnum RedJsonWriter_Null(RedJsonWriter w)
+{
+    _Writer_BeforeValue(w);
+    if (_Writer_IsCbor(w))
+        _Out_Char(&w->out, (char)_CBOR_NULL);
+    else
+        _Out_Write(&w->out, "null", 4);
+    return _Writer_Status(w);
+}
+
+RedJsonErrorEnum RedJsonWriter_Value(RedJsonWriter w, RedJsonValue jsonVal)
+{
+    _Writer_BeforeValue(w);
+    _Out_Value(&w->out, jsonVal);
+    return _Writer_Status(w);
+}
+
+RedJsonErrorEnum RedJsonWriter_Flush(RedJsonWriter w)
+{
+    _Out_Flush(&w->out);
+    if (!w->out.failed && w->sink.fp && fflush(w->sink.fp) != 0)
+        w->out.failed = true;
+    return _Writer_Status(w);
+}
+
+RedJsonErrorEnum RedJsonWriter_Finish(RedJsonWriter w)
+{
+    RedJsonErrorEnum err = RedJsonWriter_Flush(w);
+    if (!err && (ZARRAY_NUM_ITEMS(w->stack) || w->afterKey))
+        err = RED_JSON_ERROR_UNEXPECTED_END;
+    return err;
+}
+
+size_t RedJsonWriter_BytesWritten(RedJsonWriter w)
+{
+    return w->out.total;
+}
+
+void RedJsonWriter_Free(RedJsonWriter w)
+{
+    if (!w)
+        return;
+    if (w->stack)
+        ZARRAY_FREE(w->stack);
+    free(w->out.data);
+    free(w);
+}
+
+static RedJsonErrorEnum _WriteToSink(RedJsonWriter w, RedJsonValue jsonVal)
+{
+    RedJsonErrorEnum err;
+    if (!w)
+        return RED_JSON_ERROR_OUT_OF_MEMORY;
+    err = RedJsonWriter_Value(w, jsonVal);
+    if (!err)
+        err = RedJsonWriter_Finish(w);
+    RedJsonWriter_Free(w);
+    return err;
+}
+
+RedJsonErrorEnum RedJsonValue_WriteToFd(RedJsonValue jsonVal, RedJsonFormatEnum format, int fd)
+{
+    return _WriteToSink(RedJsonWriter_NewFd(fd, format), jsonVal);
+}
+
+RedJsonErrorEnum RedJsonValue_WriteToFile(RedJsonValue jsonVal, RedJsonFormatEnum format, FILE *fp)
+{
+    return _WriteToSink(RedJsonWriter_NewFile(fp, format), jsonVal);
+}
+
+RedJsonErrorEnum RedJsonValue_WriteToCallback(
+        RedJsonValue jsonVal,
+        RedJsonFormatEnum format,
+        RedJsonWriteCallback fnWrite,
+        void *userData)
+{
+    return _WriteToSink(RedJsonWriter_NewCallback(fnWrite, userData, format), jsonVal);
+}
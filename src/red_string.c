@@ -8,6 +8,7 @@
 #include "zarray.h"
 #include <assert.h>
 #include <ctype.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -23,6 +24,7 @@ typedef struct RedString_t
     // data consists of length chars followed by null-terminator.
     char *data;
     unsigned length; /* in bytes? characters? */
+    unsigned capacity; /* bytes allocated for data, including the terminator */
 } RedString_t; 
 
 typedef struct RedStringList_t
@@ -30,13 +32,34 @@ typedef struct RedStringList_t
     ZARRAY(RedString) array;
 } RedStringList_t;
 
+/*
+ * _RedString_Grow -- Make room in <s> for <length> characters plus the
+ *      terminator.  Capacity at least doubles each time it grows, so that a
+ *      sequence of appends copies each character O(1) times on average.
+ *      <length> must leave room for the terminator in an unsigned.
+ */
+static void _RedString_Grow(RedString s, unsigned length)
+{
+    unsigned capacity;
+    if (length < s->capacity)
+        return;
+    assert(length < UINT_MAX);
+    capacity = _MAX(s->capacity, 16);
+    while (capacity <= length)
+        capacity = (capacity > UINT_MAX / 2) ? length + 1 : capacity * 2;
+    s->data = realloc(s->data, capacity);
+    assert(s->data);
+    s->capacity = capacity;
+}
+
 RedString RedString_New(const char *src)
 {
     RedString hNew = malloc(sizeof(RedString_t));
     hNew->length = src ? strlen(src) : 0;
+    hNew->capacity = hNew->length + 1;
     hNew->data = malloc(hNew->length + 1);
     if (src)
-        strncpy(hNew->data, src, hNew->length);
+        memcpy(hNew->data, src, hNew->length);
     hNew->data[hNew->length] = 0;
     return hNew;
 }
@@ -45,6 +68,7 @@ RedString RedString_NewLength(const char *src, unsigned length)
 {
     RedString hNew = malloc(sizeof(RedString_t));
     hNew->length = src ? _MIN(length, strlen(src)) : 0;
+    hNew->capacity = hNew->length + 1;
     hNew->data = malloc(hNew->length + 1);
     if (src)
         strncpy(hNew->data, src, hNew->length);
@@ -105,12 +129,12 @@ void RedString_Free(RedString s)
 
 void RedString_Set(RedString hOut, const char *in)
 {
-    free(hOut->data);
-    hOut->length = in ? strlen(in) : 0;
-    hOut->data = malloc(hOut->length + 1);
+    unsigned length = in ? strlen(in) : 0;
+    _RedString_Grow(hOut, length);
     if (in)
-        strcpy(hOut->data, in);
-    hOut->data[hOut->length] = 0;
+        memmove(hOut->data, in, length);
+    hOut->length = length;
+    hOut->data[length] = 0;
 }
 
 void RedString_Clear(RedString hOut)
@@ -123,6 +147,30 @@ unsigned RedString_Length(const RedString hRedString)
     return hRedString->length;
 }
 
+unsigned RedString_Capacity(ConstRedString hRedString)
+{
+    return hRedString->capacity - 1;
+}
+
+void RedString_Reserve(RedString hRedString, unsigned length)
+{
+    if (length < hRedString->capacity)
+        return;
+    assert(length < UINT_MAX);
+    hRedString->data = realloc(hRedString->data, length + 1);
+    assert(hRedString->data);
+    hRedString->capacity = length + 1;
+}
+
+void RedString_ShrinkToFit(RedString hRedString)
+{
+    if (hRedString->capacity == hRedString->length + 1)
+        return;
+    hRedString->data = realloc(hRedString->data, hRedString->length + 1);
+    assert(hRedString->data);
+    hRedString->capacity = hRedString->length + 1;
+}
+
 /* TODO: unicode support */
 unsigned RedString_Bytes(const RedString hRedString)
 {
@@ -139,10 +187,9 @@ void RedString_Copy(RedString hResult, const RedString hSrc)
     if (hSrc == hResult)
         return;
 
-    free(hResult->data);
+    _RedString_Grow(hResult, hSrc->length);
     hResult->length = hSrc->length;
-    hResult->data = malloc(hSrc->length+1);
-    strncpy(hResult->data, hSrc->data, hResult->length);
+    memcpy(hResult->data, hSrc->data, hResult->length);
     hResult->data[hResult->length] = 0;
 }
 
@@ -294,7 +341,7 @@ void RedString_SubString(
         int start, 
         int end)
 {
-    char *newData;
+    unsigned length;
 
     if (start < 0)
         start = (int)hSrc->length + start;
@@ -305,23 +352,13 @@ void RedString_SubString(
     start = _MIN(_MAX(start, 0), hSrc->length - 1);
     end = _MIN(_MAX(end, 0), hSrc->length - 1);
 
-    if (end < start)
-    {
-        newData = malloc(1);
-        newData[0] = 0;
-        free(hResult->data);
-        hResult->data = newData;
-        hResult->length = 0;
-    }
-    else
-    {
-        newData = malloc(end - start + 2);
-        memcpy(newData, &hSrc->data[start], end - start + 1);
-        newData[end - start + 1] = 0;
-        free(hResult->data);
-        hResult->data = newData;
-        hResult->length = end - start + 1;
-    }
+    /* hResult may be hSrc, whose characters then just move to the front */
+    length = (end < start) ? 0 : end - start + 1;
+    if (hResult != hSrc)
+        _RedString_Grow(hResult, length);
+    memmove(hResult->data, &hSrc->data[start], length);
+    hResult->data[length] = 0;
+    hResult->length = length;
     return;
 }
 
@@ -332,38 +369,55 @@ unsigned RedString_Tounsigned(ConstRedString hRedString)
 
 void RedString_Append(RedString hOriginal, const RedString hAppend)
 {
-    unsigned sumLength;
-    sumLength = hOriginal->length + hAppend->length;
-    hOriginal->data = realloc(hOriginal->data, sumLength + 1);
-    memcpy(&hOriginal->data[hOriginal->length], hAppend->data, hAppend->length);
-    hOriginal->data[sumLength] = 0;
-    hOriginal->length = sumLength;
+    /* Appending a string to itself reads from the buffer being grown */
+    unsigned length = hAppend->length;
+    assert(length < UINT_MAX - hOriginal->length);
+    _RedString_Grow(hOriginal, hOriginal->length + length);
+    memcpy(&hOriginal->data[hOriginal->length], hAppend->data, length);
+    hOriginal->length += length;
+    hOriginal->data[hOriginal->length] = 0;
 }
 
 void RedString_AppendChars(RedString hOriginal, const char *pAppend)
 {
-    unsigned sumLength;
-    sumLength = hOriginal->length + strlen(pAppend);
-    hOriginal->data = realloc(hOriginal->data, sumLength + 1);
-    memcpy(&hOriginal->data[hOriginal->length], pAppend, strlen(pAppend));
-    hOriginal->data[sumLength] = 0;
-    hOriginal->length = sumLength;
+    RedString_AppendLength(hOriginal, pAppend, strlen(pAppend));
+}
+
+void RedString_AppendLength(RedString hOriginal, const char *pAppend, unsigned length)
+{
+    /* <pAppend> may point into the buffer that is about to move */
+    uintptr_t offset = (uintptr_t)pAppend - (uintptr_t)hOriginal->data;
+    bool inside = offset < hOriginal->capacity;
+    assert(length < UINT_MAX - hOriginal->length);
+    _RedString_Grow(hOriginal, hOriginal->length + length);
+    if (inside)
+        pAppend = hOriginal->data + offset;
+    memcpy(&hOriginal->data[hOriginal->length], pAppend, length);
+    hOriginal->length += length;
+    hOriginal->data[hOriginal->length] = 0;
 }
 
 void RedString_AppendPrintf(RedString hOriginal, const char *fmt, unsigned size, ...)
 {
-    char * tmpResult;
+    char scratch[256], *tmpResult;
     va_list args;
+    int n;
 
-    tmpResult = malloc(size+1);
+    if (!size)
+        return;
 
+    /* The arguments may point into <hOriginal>, so format elsewhere first;
+     * short results need no allocation.  At most size - 1 characters fit. */
+    tmpResult = size <= sizeof(scratch) ? scratch : malloc(size);
+    assert(tmpResult);
     va_start(args, size);
-    vsnprintf(tmpResult, (size_t)size, fmt, args);
+    n = vsnprintf(tmpResult, (size_t)size, fmt, args);
     va_end(args);
 
-    RedString_AppendChars(hOriginal, tmpResult);
-
-    free(tmpResult);
+    if (n > 0)
+        RedString_AppendLength(hOriginal, tmpResult, _MIN((unsigned)n, size - 1));
+    if (tmpResult != scratch)
+        free(tmpResult);
 }
 
 void RedString_RemoveToChar(RedString hRedString, char c)
@@ -412,7 +466,7 @@ void RedString_Hash(RedString hResult, ConstRedString hSrc)
         sum >>= 5;
     }
 
-    hResult->data = realloc(hResult->data, 14);
+    _RedString_Grow(hResult, 13);
     memcpy(hResult->data, result, 13);
     hResult->data[13] = 0;
     hResult->length = 13;
@@ -438,10 +492,9 @@ void RedString_Rot13(RedString hResult, RedString hOriginal)
             newData[i] = hOriginal->data[i];
         }
     }
-    free(hResult->data);
+    _RedString_Grow(hResult, hOriginal->length);
     hResult->length = hOriginal->length;
-    hResult->data = malloc(hOriginal->length+1);
-    strncpy(hResult->data, newData, hResult->length);
+    memcpy(hResult->data, newData, hResult->length);
     hResult->data[hResult->length] = 0;
     free(newData);
 }
@@ -499,10 +552,15 @@ const char * RedStringList_GetStringChars(RedStringList hList, unsigned idx)
 
 void RedStringList_Join(RedString hString, RedStringList hList, const char *joiner)
 {
-    /* TODO: optimize */
     int numItems = ZARRAY_NUM_ITEMS(hList->array);
+    unsigned total = 0;
     int i;
     RedString_Clear(hString);
+    for (i = 0; i < numItems; i++)
+        total += ZARRAY_AT(hList->array, i)->length;
+    if (joiner && numItems > 1)
+        total += (numItems - 1) * strlen(joiner);
+    RedString_Reserve(hString, total);
     for (i = 0; i < numItems; i++)
     {
         RedString_Append(hString, ZARRAY_AT(hList->array, i));
@@ -15,12 +15,412 @@
  *      - The LICENSE file in this directory, if present.
  *  ===========================================================================
  */
+#define _POSIX_C_SOURCE 200809L
+
 #include "red_json.h"
+#include "red_string.h"
 #include "red_test.h"
 
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * _LogEvent -- SAX callback that appends a compact description of each event
+ * to a RedString, so that event streams produced by different chunkings of
+ * the same input can be compared.
+ */
+static bool _LogEvent(const RedJsonEvent_t *event, void *userData)
+{
+    RedString log = userData;
+    switch (event->type)
+    {
+        case RED_JSON_EVENT_BEGIN_OBJECT: RedString_AppendChars(log, "{"); break;
+        case RED_JSON_EVENT_END_OBJECT: RedString_AppendChars(log, "}"); break;
+        case RED_JSON_EVENT_BEGIN_ARRAY: RedString_AppendChars(log, "["); break;
+        case RED_JSON_EVENT_END_ARRAY: RedString_AppendChars(log, "]"); break;
+        case RED_JSON_EVENT_KEY: RedString_AppendPrintf(log, "K%u<%s>", 1024, event->depth, event->sz); break;
+        case RED_JSON_EVENT_STRING: RedString_AppendPrintf(log, "S%u<%s>", 1024, event->depth, event->sz); break;
+        case RED_JSON_EVENT_NUMBER: RedString_AppendPrintf(log, "N%u<%.17g>", 1024, event->depth, event->number); break;
+        case RED_JSON_EVENT_BOOLEAN: RedString_AppendChars(log, event->boolean ? "T" : "F"); break;
+        case RED_JSON_EVENT_NULL: RedString_AppendChars(log, "0"); break;
+    }
+    return true;
+}
+
+/*
+ * _StreamInChunks -- Feed <text> to a new SAX stream parser using chunk sizes
+ * drawn from a simple LCG (1 to <maxChunk> bytes).  Returns the event log.
+ */
+static RedString _StreamInChunks(const char *text, unsigned seed, unsigned maxChunk, RedJsonErrorEnum *pErr)
+{
+    RedString log = RedString_New(NULL);
+    RedJsonStreamParser parser = RedJsonStreamParser_New(_LogEvent, log);
+    size_t length = strlen(text);
+    size_t pos = 0;
+    RedJsonErrorEnum err = RED_JSON_OK;
+    while (pos < length && !err)
+    {
+        size_t n;
+        seed = seed * 1103515245 + 12345;
+        n = 1 + (seed >> 16) % maxChunk;
+        if (n > length - pos)
+            n = length - pos;
+        err = RedJsonStreamParser_Feed(parser, &text[pos], n);
+        pos += n;
+    }
+    if (!err)
+        err = RedJsonStreamParser_Finish(parser);
+    RedJsonStreamParser_Free(parser);
+    *pErr = err;
+    return log;
+}
+
+static bool _SumField(RedJsonValue value, const char *szKey, void *userData)
+{
+    double *pSum = userData;
+    *pSum += RedJsonObject_GetNumber(RedJsonValue_GetObject(value), "a");
+    return true;
+}
+
+static bool _CaptureNumber(const RedJsonEvent_t *event, void *userData)
+{
+    *(RedJsonEvent_t *)userData = *event;
+    return true;
+}
+
+/*
+ * _ParseOneNumber -- Run <text> through a SAX stream parser and return the
+ * last NUMBER event.
+ */
+static RedJsonEvent_t _ParseOneNumber(const char *text)
+{
+    RedJsonEvent_t event;
+    RedJsonStreamParser parser = RedJsonStreamParser_New(_CaptureNumber, &event);
+    memset(&event, 0, sizeof(event));
+    RedJsonStreamParser_Feed(parser, text, strlen(text));
+    RedJsonStreamParser_Finish(parser);
+    RedJsonStreamParser_Free(parser);
+    return event;
+}
+
+static bool _SameDouble(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+typedef struct
+{
+    char data[4096];
+    size_t length;
+    bool fail;
+} _Capture;
+
+static bool _CaptureOutput(const char *data, size_t length, void *userData)
+{
+    _Capture *capture = userData;
+    if (capture->fail || capture->length + length >= sizeof(capture->data))
+        return false;
+    memcpy(&capture->data[capture->length], data, length);
+    capture->length += length;
+    capture->data[capture->length] = '\0';
+    return true;
+}
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    unsigned count;
+    double sum;
+    bool inOrder;
+} _NdjsonTally;
+
+static bool _TallyRecord(RedJsonValue record, void *userData)
+{
+    _NdjsonTally *tally = userData;
+    double id = RedJsonObject_GetNumber(RedJsonValue_GetObject(record), "id");
+    pthread_mutex_lock(&tally->mutex);
+    if (id != tally->count)
+        tally->inOrder = false;
+    tally->count++;
+    tally->sum += id;
+    pthread_mutex_unlock(&tally->mutex);
+    return true;
+}
+
+/*
+ * _CheckWideRecord -- Subtree callback for the key interning test: verifies
+ * every member of a {"key0":0, "key1":1, ...} object.
+ */
+static bool _CheckWideRecord(RedJsonValue value, const char *szKey, void *userData)
+{
+    RedJsonObject obj = RedJsonValue_GetObject(value);
+    char key[16];
+    unsigned i, n = RedJsonObject_NumItems(obj);
+    for (i = 0; i < n; i++)
+    {
+        snprintf(key, sizeof(key), "key%u", i);
+        if (!RedJsonObject_HasKey(obj, key) || RedJsonObject_GetInt64(obj, key) != i)
+            return true;
+    }
+    if (n == 5000)
+        (*(unsigned *)userData)++;
+    return true;
+}
+
+/*
+ * _WriteTape -- Replay the tape value at <pRef> through <writer>, so a tape
+ * can be compared with the DOM built from the same text.
+ */
+static void _WriteTape(RedJsonWriter writer, const RedJsonTapeRef_t *pRef)
+{
+    RedJsonTapeRef_t child;
+    bool more;
+    switch (RedJsonTapeRef_GetType(pRef))
+    {
+        case RED_JSON_VALUE_TYPE_OBJECT:
+            RedJsonWriter_BeginObject(writer);
+            for (more = RedJsonTapeRef_First(pRef, &child); more; more = RedJsonTapeRef_Next(&child))
+            {
+                RedJsonWriter_Key(writer, RedJsonTapeRef_GetKey(&child));
+                _WriteTape(writer, &child);
+            }
+            RedJsonWriter_EndObject(writer);
+            break;
+        case RED_JSON_VALUE_TYPE_ARRAY:
+            RedJsonWriter_BeginArray(writer);
+            for (more = RedJsonTapeRef_First(pRef, &child); more; more = RedJsonTapeRef_Next(&child))
+                _WriteTape(writer, &child);
+            RedJsonWriter_EndArray(writer);
+            break;
+        case RED_JSON_VALUE_TYPE_STRING:
+            RedJsonWriter_String(writer, RedJsonTapeRef_GetString(pRef));
+            break;
+        case RED_JSON_VALUE_TYPE_NUMBER:
+            if (RedJsonTapeRef_GetNumberType(pRef) == RED_JSON_NUMBER_INT64)
+                RedJsonWriter_Int64(writer, RedJsonTapeRef_GetInt64(pRef));
+            else if (RedJsonTapeRef_GetNumberType(pRef) == RED_JSON_NUMBER_UINT64)
+                RedJsonWriter_Uint64(writer, RedJsonTapeRef_GetUint64(pRef));
+            else
+                RedJsonWriter_Number(writer, RedJsonTapeRef_GetNumber(pRef));
+            break;
+        case RED_JSON_VALUE_TYPE_BOOLEAN:
+            RedJsonWriter_Boolean(writer, RedJsonTapeRef_GetBoolean(pRef));
+            break;
+        default:
+            RedJsonWriter_Null(writer);
+            break;
+    }
+}
+
+/*
+ * _CborHex -- Encode <val> as CBOR and write it to <hex> as a hex string.
+ * Consumes <val>.
+ */
+static const char * _CborHex(RedJsonValue val, char *hex)
+{
+    size_t length, i;
+    char *data = RedJsonValue_ToCbor(val, &length);
+    for (i = 0; i < length; i++)
+        sprintf(&hex[2 * i], "%02x", (unsigned char)data[i]);
+    hex[2 * length] = '\0';
+    free(data);
+    RedJsonValue_Release(val);
+    return hex;
+}
+
+static size_t _FromHex(const char *hex, char *data)
+{
+    size_t i, length = strlen(hex) / 2;
+    unsigned byte;
+    for (i = 0; i < length; i++)
+    {
+        sscanf(&hex[2 * i], "%2x", &byte);
+        data[i] = (char)byte;
+    }
+    return length;
+}
+
+/*
+ * _CborDecodesTo -- Check that the hex encoded CBOR item decodes to a value
+ * whose compact JSON is <json>.
+ */
+static bool _CborDecodesTo(const char *hex, const char *json)
+{
+    char data[256];
+    RedJsonValue val = RedJson_ParseCbor(data, _FromHex(hex, data), NULL);
+    char *out;
+    bool ok;
+    if (!val)
+        return false;
+    out = RedJsonValue_ToFormattedJsonString(val, RED_JSON_FORMAT_COMPACT);
+    ok = !strcmp(out, json);
+    free(out);
+    RedJsonValue_Release(val);
+    return ok;
+}
+
+static RedJsonErrorEnum _CborError(const char *hex, size_t *pOffset)
+{
+    char data[1024];
+    RedJsonError_t error;
+    if (RedJson_ParseCbor(data, _FromHex(hex, data), &error))
+        return RED_JSON_OK;
+    *pOffset = error.offset;
+    return error.code;
+}
+
+typedef struct
+{
+    char *code;
+    int32_t lane;
+} _TestVenue;
+
+typedef struct
+{
+    int64_t id;
+    uint64_t seq;
+    double price;
+    bool open;
+    char *symbol;
+    _TestVenue venue;
+    int32_t aXbYc;      /* same length and sampled bytes as "aZbWc" */
+    int32_t aZbWc;
+} _TestOrder;
+
+static const RedJsonField_t _testVenueFields[] = {
+    RED_JSON_FIELD(_TestVenue, code, RED_JSON_FIELD_STRING),
+    RED_JSON_FIELD(_TestVenue, lane, RED_JSON_FIELD_INT32),
+    RED_JSON_FIELDS_END
+};
+
+static const RedJsonField_t _testOrderFields[] = {
+    RED_JSON_FIELD(_TestOrder, id, RED_JSON_FIELD_INT64),
+    RED_JSON_FIELD(_TestOrder, seq, RED_JSON_FIELD_UINT64),
+    RED_JSON_FIELD_NAMED(_TestOrder, price, "px", RED_JSON_FIELD_DOUBLE),
+    RED_JSON_FIELD(_TestOrder, open, RED_JSON_FIELD_BOOLEAN),
+    RED_JSON_FIELD(_TestOrder, symbol, RED_JSON_FIELD_STRING),
+    RED_JSON_FIELD_OBJECT(_TestOrder, venue, _testVenueFields),
+    RED_JSON_FIELD(_TestOrder, aXbYc, RED_JSON_FIELD_INT32),
+    RED_JSON_FIELD(_TestOrder, aZbWc, RED_JSON_FIELD_INT32),
+    RED_JSON_FIELDS_END
+};
+
+static RedJsonErrorEnum _BindError(RedJsonBinding binding, const char *text, size_t *pOffset)
+{
+    _TestOrder order;
+    RedJsonError_t error;
+    RedJsonErrorEnum err;
+    memset(&order, 0, sizeof(order));
+    err = RedJsonBinding_Parse(binding, text, strlen(text), &order, &error);
+    RedJsonBinding_FreeMembers(binding, &order);
+    if (err)
+        *pOffset = error.offset;
+    return err;
+}
+
+static bool _PathWriteValue(RedJsonValue value, void *userData)
+{
+    return RedJsonWriter_Value(userData, value) == RED_JSON_OK;
+}
+
+static bool _PathWriteTape(const RedJsonTapeRef_t *pRef, void *userData)
+{
+    _WriteTape(userData, pRef);
+    return true;
+}
 
+static bool _PathSumValue(RedJsonValue value, void *userData)
+{
+    *(double *)userData += RedJsonValue_GetNumber(value);
+    return true;
+}
+
+/*
+ * _PathMatches - Evaluate <szPath> over both a DOM and a tape of the same
+ * document.  Returns the matches as a JSON array, or "MISMATCH" if the two
+ * disagree, or "BAD PATH".
+ */
+static const char * _PathMatches(const char *szPath, RedJsonObject obj, RedJsonTape tape, _Capture *capture)
+{
+    RedJsonPath path = RedJsonPath_Compile(szPath, NULL);
+    RedJsonTapeRef_t root = RedJsonTape_Root(tape);
+    _Capture tapeCapture;
+    RedJsonWriter w;
+    unsigned n, nTape;
+
+    if (!path)
+        return "BAD PATH";
+    memset(capture, 0, sizeof(*capture));
+    w = RedJsonWriter_NewCallback(_CaptureOutput, capture, RED_JSON_FORMAT_COMPACT);
+    RedJsonWriter_BeginArray(w);
+    n = RedJsonPath_EvalObject(path, obj, _PathWriteValue, w);
+    RedJsonWriter_EndArray(w);
+    RedJsonWriter_Finish(w);
+    RedJsonWriter_Free(w);
+
+    memset(&tapeCapture, 0, sizeof(tapeCapture));
+    w = RedJsonWriter_NewCallback(_CaptureOutput, &tapeCapture, RED_JSON_FORMAT_COMPACT);
+    RedJsonWriter_BeginArray(w);
+    nTape = RedJsonPath_EvalTape(path, &root, _PathWriteTape, w);
+    RedJsonWriter_EndArray(w);
+    RedJsonWriter_Finish(w);
+    RedJsonWriter_Free(w);
+    RedJsonPath_Free(path);
+    return (n == nTape && !strcmp(capture->data, tapeCapture.data)) ? capture->data : "MISMATCH";
+}
+
+static size_t _PathErrorOffset(const char *szPath)
+{
+    RedJsonError_t error;
+    RedJsonPath path = RedJsonPath_Compile(szPath, &error);
+    if (path || error.code != RED_JSON_ERROR_BAD_PATH)
+    {
+        RedJsonPath_Free(path);
+        return (size_t)-1;
+    }
+    return error.offset;
+}
+
+static char * _DiffText(RedJsonObject from, RedJsonObject to)
+{
+    RedJsonValue patch = RedJsonValue_FromArray(RedJson_Diff(from, to));
+    char *out = RedJsonValue_ToFormattedJsonString(patch, RED_JSON_FORMAT_COMPACT);
+    RedJsonValue_Release(patch);
+    return out;
+}
+
+static RedJsonErrorEnum _ApplyPatchText(RedJsonObject doc, const char *patchText, unsigned *pFailedOp)
+{
+    char wrapped[1024];
+    RedJsonObject holder;
+    RedJsonErrorEnum err;
+    snprintf(wrapped, sizeof(wrapped), "{\"patch\": %s}", patchText);
+    holder = RedJson_Parse(wrapped);
+    err = RedJson_ApplyPatch(doc, RedJsonObject_GetArray(holder, "patch"), pFailedOp);
+    RedJsonObject_Release(holder);
+    return err;
+}
+
+/*
+ * _DiffRoundTrips - Check that the diff of two documents turns the first
+ *      into the second.
+ */
+static bool _DiffRoundTrips(const char *fromText, const char *toText)
+{
+    RedJsonObject from = RedJson_Parse(fromText);
+    RedJsonObject to = RedJson_Parse(toText);
+    RedJsonArray patch = RedJson_Diff(from, to);
+    bool ok = RedJson_ApplyPatch(from, patch, NULL) == RED_JSON_OK && RedJsonObject_Equals(from, to);
+    RedJsonArray_Release(patch);
+    RedJsonObject_Release(from);
+    RedJsonObject_Release(to);
+    return ok;
+}
 
 int main(int argc, const char *argv[])
 {
@@ -49,6 +449,8 @@ int main(int argc, const char *argv[])
 
         out = RedJsonValue_ToJsonString(val);
         printf("%s\n", out);
+        free(out);
+        RedJsonValue_Release(val);
     }
 
     {
@@ -60,8 +462,1906 @@ int main(int argc, const char *argv[])
         array = RedJsonObject_GetArray(obj, "cow");
         printf("%s\n", RedJsonArray_GetEntryString(array, 0));
         printf("%s\n", RedJsonArray_GetEntryString(array, 1));
+        RedJsonObject_Release(obj);
+    }
+
+    /* Streaming parser: random chunk splitting must not change the events */
+    {
+        const char *json =
+            "/* header */ {\"name\" : \"Caf\\u00e9 \\\"q\\\" \\ud83d\\ude00\\n\",\n"
+            "  \"nums\" : [0, -12, 3.25, 6.02e23, -1E-7, 12345678901234],\n"
+            "  \"flags\" : [true, false, null],\n"
+            "  \"nested\" : {\"a\" : {\"b\" : [[], {}, [\"x\\/y\\t\"]]}}\n"
+            "} 42 \"tail\"";
+        RedString expected, actual;
+        RedJsonErrorEnum err;
+        unsigned seed;
+        bool allMatch = true;
+
+        expected = _StreamInChunks(json, 1, 100000, &err);
+        RedTest_Verify(suite, "Stream: whole document parses", err == RED_JSON_OK);
+        RedTest_Verify(suite, "Stream: surrogate pair decoded",
+                RedString_ContainsChars(expected, "Caf\xc3\xa9 \"q\" \xf0\x9f\x98\x80\n"));
+        RedTest_Verify(suite, "Stream: trailing top-level values",
+                RedString_ContainsChars(expected, "}N0<42>S0<tail>"));
+
+        for (seed = 1; seed <= 200; seed++)
+        {
+            actual = _StreamInChunks(json, seed, 1 + seed % 13, &err);
+            if (err || RedString_Compare(expected, actual, 0))
+                allMatch = false;
+            RedString_Free(actual);
+        }
+        RedTest_Verify(suite, "Stream: 200 random chunkings produce identical events", allMatch);
+        RedString_Free(expected);
+    }
+
+    /* Streaming parser: errors carry position information */
+    {
+        const char *json = "{\"a\" : 1,\n \"b\" : tru }";
+        RedString log = RedString_New(NULL);
+        RedJsonStreamParser parser = RedJsonStreamParser_New(_LogEvent, log);
+        RedJsonError_t error;
+        RedJsonStreamParser_Feed(parser, json, 12);
+        RedJsonStreamParser_Feed(parser, json + 12, strlen(json) - 12);
+        error = RedJsonStreamParser_GetError(parser);
+        RedTest_Verify(suite, "Stream: bad literal detected", error.code == RED_JSON_ERROR_UNEXPECTED_CHAR);
+        RedTest_Verify(suite, "Stream: error offset", error.offset == 20);
+        RedTest_Verify(suite, "Stream: error line/column", error.line == 2 && error.column == 11);
+
+        RedJsonStreamParser_Reset(parser);
+        RedJsonStreamParser_Feed(parser, "[1, 2", 5);
+        RedTest_Verify(suite, "Stream: truncated input reported",
+                RedJsonStreamParser_Finish(parser) == RED_JSON_ERROR_UNEXPECTED_END);
+        RedJsonStreamParser_Free(parser);
+        RedString_Free(log);
+    }
+
+    /* Streaming parser: DOM subtrees delivered at depth 1 */
+    {
+        const char *json = "[{\"a\" : 1}, {\"a\" : 2, \"a\" : 20}, {\"a\" : 3}]";
+        double sum = 0;
+        size_t i;
+        RedJsonStreamParser parser = RedJsonStreamParser_NewDom(1, _SumField, &sum);
+        for (i = 0; json[i]; i++)
+            RedJsonStreamParser_Feed(parser, &json[i], 1);
+        RedTest_Verify(suite, "Stream DOM: finish ok", RedJsonStreamParser_Finish(parser) == RED_JSON_OK);
+        RedTest_Verify(suite, "Stream DOM: three records, last duplicate wins", sum == 24);
+        RedJsonStreamParser_Free(parser);
+    }
+
+    /* NDJSON reader: ordered and unordered delivery across many chunks */
+    {
+        char path[] = "/tmp/test_json_ndjsonXXXXXX";
+        int fd = mkstemp(path);
+        FILE *fp = fdopen(fd, "w");
+        RedJsonNdjsonOptions_t options;
+        RedJsonError_t error;
+        _NdjsonTally tally;
+        unsigned i;
+
+        for (i = 0; i < 5000; i++)
+            fprintf(fp, "{\"id\" : %u, \"msg\" : \"line\\n%u\"}%s\n", i, i, (i % 7) ? "" : "\r");
+        fclose(fp);
+
+        memset(&tally, 0, sizeof(tally));
+        pthread_mutex_init(&tally.mutex, NULL);
+        tally.inOrder = true;
+        options.numThreads = 4;
+        options.ordered = true;
+        options.chunkSize = 512;
+        RedTest_Verify(suite, "NDJSON ordered: success",
+                RedJson_ReadNdjsonFile(path, &options, _TallyRecord, &tally, NULL) == RED_JSON_OK);
+        RedTest_Verify(suite, "NDJSON ordered: all records", tally.count == 5000);
+        RedTest_Verify(suite, "NDJSON ordered: file order", tally.inOrder);
+
+        tally.count = 0;
+        tally.sum = 0;
+        options.ordered = false;
+        RedTest_Verify(suite, "NDJSON unordered: success",
+                RedJson_ReadNdjsonFile(path, &options, _TallyRecord, &tally, NULL) == RED_JSON_OK);
+        RedTest_Verify(suite, "NDJSON unordered: all records",
+                tally.count == 5000 && tally.sum == 4999.0 * 5000 / 2);
+
+        fp = fopen(path, "a");
+        fprintf(fp, "{\"id\" : 1}\n{\"id\" 2}\n");
+        fclose(fp);
+        RedTest_Verify(suite, "NDJSON: malformed line reported",
+                RedJson_ReadNdjsonFile(path, &options, _TallyRecord, &tally, &error) == RED_JSON_ERROR_UNEXPECTED_CHAR);
+        RedTest_Verify(suite, "NDJSON: error line number", error.line == 5002 && error.column == 7);
+        RedTest_Verify(suite, "NDJSON: missing file",
+                RedJson_ReadNdjsonFile("/nonexistent/file.ndjson", NULL, _TallyRecord, &tally, NULL) == RED_JSON_ERROR_IO);
+
+        pthread_mutex_destroy(&tally.mutex);
+        unlink(path);
+    }
+
+    /* Number parsing: correctly rounded doubles */
+    {
+        const char *hard[] = {
+            "0.1", "2.2250738585072011e-308", "2.2250738585072014e-308",
+            "4.9e-324", "2.4703282292062327e-324", "2.4703282292062328e-324",
+            "1.7976931348623157e308", "1.7976931348623158e308", "1e-400",
+            "9007199254740993.0", "123456789012345678901234567890e-10",
+            "7.0420557077594588669468784357561207962098443483187940792729600000e+59",
+            "0.000000000000000000000000000000000000000000001234567890123456789012",
+            "-65.613616999999977", "43.420273000000009", "-0.0", "1e23",
+        };
+        unsigned i, seed = 7;
+        bool allMatch = true;
+        char buf[64];
+
+        for (i = 0; i < sizeof(hard) / sizeof(hard[0]); i++)
+        {
+            if (!_SameDouble(_ParseOneNumber(hard[i]).number, strtod(hard[i], NULL)))
+                allMatch = false;
+        }
+        RedTest_Verify(suite, "Number: hard cases match strtod", allMatch);
+
+        for (i = 0; i < 20000 && allMatch; i++)
+        {
+            uint64_t bits;
+            double d;
+            seed = seed * 1103515245 + 12345;
+            bits = (uint64_t)seed << 32;
+            seed = seed * 1103515245 + 12345;
+            bits |= seed;
+            memcpy(&d, &bits, sizeof(d));
+            if (d != d || d - d != 0)
+                continue;
+            sprintf(buf, (i & 1) ? "%.17g" : "%.15g", d);
+            if (!_SameDouble(_ParseOneNumber(buf).number, strtod(buf, NULL)))
+                allMatch = false;
+        }
+        RedTest_Verify(suite, "Number: random doubles match strtod", allMatch);
+    }
+
+    /* Number parsing: integers are kept exactly */
+    {
+        RedJsonEvent_t event;
+        RedJsonErrorEnum err;
+        RedJsonObject obj;
+        RedJsonValue val;
+        char *out;
+
+        event = _ParseOneNumber("9223372036854775807");
+        RedTest_Verify(suite, "Number: INT64_MAX exact",
+                event.numberType == RED_JSON_NUMBER_INT64 && event.int64 == INT64_MAX);
+        event = _ParseOneNumber("-9223372036854775808");
+        RedTest_Verify(suite, "Number: INT64_MIN exact",
+                event.numberType == RED_JSON_NUMBER_INT64 && event.int64 == INT64_MIN);
+        event = _ParseOneNumber("18446744073709551615");
+        RedTest_Verify(suite, "Number: UINT64_MAX exact",
+                event.numberType == RED_JSON_NUMBER_UINT64 && event.uint64 == UINT64_MAX);
+        event = _ParseOneNumber("18446744073709551616");
+        RedTest_Verify(suite, "Number: integer overflow becomes double",
+                event.numberType == RED_JSON_NUMBER_DOUBLE && event.number == 18446744073709551616.0);
+        event = _ParseOneNumber("-0");
+        RedTest_Verify(suite, "Number: negative zero keeps its sign",
+                event.numberType == RED_JSON_NUMBER_DOUBLE && _SameDouble(event.number, -0.0));
+        RedString_Free(_StreamInChunks("[012]", 1, 100, &err));
+        RedTest_Verify(suite, "Number: leading zero rejected", err == RED_JSON_ERROR_BAD_NUMBER);
+
+        {
+            /* Doubles past DBL_MAX would be written back as null */
+            const char *overflows[] = {"{\"a\": 1e400}", "{\"a\": -1.7976931348623159e308}", "{\"a\": 1e309}"};
+            RedString huge = RedString_New("{\"a\": 1");
+            RedJsonError_t error;
+            unsigned i;
+            bool rejected = true;
+
+            for (i = 0; i < 310; i++)
+                RedString_AppendChars(huge, "0");
+            RedString_AppendChars(huge, ".5}");
+            for (i = 0; i < sizeof(overflows) / sizeof(overflows[0]); i++)
+            {
+                obj = RedJson_ParseWithOptions(overflows[i], strlen(overflows[i]), NULL, &error);
+                rejected = rejected && !obj && error.code == RED_JSON_ERROR_BAD_NUMBER && error.offset == 6
+                        && RedJson_Validate(overflows[i], strlen(overflows[i]), NULL, NULL) == RED_JSON_ERROR_BAD_NUMBER;
+                RedString_Free(_StreamInChunks(overflows[i], 1, 100, &err));
+                rejected = rejected && err == RED_JSON_ERROR_BAD_NUMBER;
+            }
+            obj = RedJson_ParseWithOptions(RedString_GetChars(huge), RedString_Length(huge), NULL, &error);
+            rejected = rejected && !obj && error.code == RED_JSON_ERROR_BAD_NUMBER
+                    && RedJson_Validate(RedString_GetChars(huge), RedString_Length(huge), NULL, NULL) == RED_JSON_ERROR_BAD_NUMBER;
+            RedString_Free(huge);
+            obj = RedJson_Parse("{\"a\": 1.7976931348623157e308, \"b\": 1e-400}");
+            rejected = rejected && obj && RedJsonObject_GetNumber(obj, "a") == DBL_MAX && RedJsonObject_GetNumber(obj, "b") == 0;
+            RedJsonObject_Release(obj);
+            RedTest_Verify(suite, "Number: overflow to infinity rejected", rejected);
+        }
+
+        obj = RedJson_Parse("{\"id\" : 9007199254740993, \"big\" : 18446744073709551615, \"x\" : 2.5}");
+        RedTest_Verify(suite, "Number: DOM keeps integers above 2^53",
+                RedJsonObject_GetInt64(obj, "id") == 9007199254740993LL
+                && RedJsonValue_GetNumberType(RedJsonObject_Get(obj, "id")) == RED_JSON_NUMBER_INT64);
+        RedTest_Verify(suite, "Number: DOM uint64 accessors",
+                RedJsonObject_GetUint64(obj, "big") == UINT64_MAX
+                && RedJsonObject_GetInt64(obj, "big") == INT64_MAX);
+        RedTest_Verify(suite, "Number: doubles truncate to integers",
+                RedJsonObject_GetInt64(obj, "x") == 2 && RedJsonObject_GetNumber(obj, "x") == 2.5);
+        RedJsonObject_Release(obj);
+
+        val = RedJsonValue_FromInt64(INT64_MIN);
+        out = RedJsonValue_ToJsonString(val);
+        RedTest_Verify(suite, "Number: int64 serialized exactly", !strcmp(out, "-9223372036854775808"));
+        free(out);
+        RedJsonValue_Release(val);
+    }
+
+    /* Number formatting: shortest representation that round-trips */
+    {
+        static const struct { double value; const char *expected; } cases[] = {
+            {1.0, "1"}, {0.1, "0.1"}, {-2.5, "-2.5"}, {0.3, "0.3"}, {-0.0, "-0"},
+            {1e21, "1e+21"}, {123456789012345680000.0, "123456789012345680000"},
+            {1e-7, "1e-7"}, {1.5e-6, "0.0000015"}, {5e-324, "5e-324"},
+            {1.7976931348623157e308, "1.7976931348623157e+308"},
+        };
+        unsigned i, seed = 11;
+        bool allMatch = true;
+        RedJsonValue val;
+        char *out;
+
+        for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        {
+            val = RedJsonValue_FromNumber(cases[i].value);
+            out = RedJsonValue_ToJsonString(val);
+            if (strcmp(out, cases[i].expected))
+                allMatch = false;
+            free(out);
+            RedJsonValue_Release(val);
+        }
+        RedTest_Verify(suite, "Number: shortest formatting", allMatch);
+
+        val = RedJsonValue_FromNumber(0.0 / 0.0 * 0.0);
+        out = RedJsonValue_ToJsonString(val);
+        RedTest_Verify(suite, "Number: NaN written as null", !strcmp(out, "null"));
+        free(out);
+        RedJsonValue_Release(val);
+
+        for (i = 0; i < 20000 && allMatch; i++)
+        {
+            uint64_t bits;
+            double d;
+            seed = seed * 1103515245 + 12345;
+            bits = (uint64_t)seed << 32;
+            seed = seed * 1103515245 + 12345;
+            bits |= seed;
+            memcpy(&d, &bits, sizeof(d));
+            if (d != d || d - d != 0)
+                continue;
+            val = RedJsonValue_FromNumber(d);
+            out = RedJsonValue_ToJsonString(val);
+            if (!_SameDouble(_ParseOneNumber(out).number, d))
+                allMatch = false;
+            free(out);
+            RedJsonValue_Release(val);
+        }
+        RedTest_Verify(suite, "Number: random doubles round-trip through the writer", allMatch);
+    }
+
+    /* Writer: compact and pretty layouts, escaping, fixed buffers */
+    {
+        RedJsonObject obj;
+        RedJsonArray array;
+        RedJsonValue val;
+        char buf[16];
+        char *out;
+        size_t n;
+
+        array = RedJsonArray_New();
+        RedJsonArray_AppendInt64(array, 1);
+        RedJsonArray_Append(array, RedJsonValue_FromArray(RedJsonArray_New()));
+        RedJsonArray_AppendString(array, "tab\tquote\"back\\slash\x01");
+        obj = RedJsonObject_New();
+        RedJsonObject_SetArray(obj, "a", array);
+        val = RedJsonValue_FromObject(obj);
+
+        out = RedJsonValue_ToFormattedJsonString(val, RED_JSON_FORMAT_COMPACT);
+        RedTest_Verify(suite, "Writer: compact layout and escaping",
+                !strcmp(out, "{\"a\":[1,[],\"tab\\tquote\\\"back\\\\slash\\u0001\"]}"));
+        free(out);
+
+        out = RedJsonValue_ToFormattedJsonString(val, RED_JSON_FORMAT_PRETTY);
+        RedTest_Verify(suite, "Writer: pretty layout",
+                !strcmp(out, "{\n  \"a\": [\n    1,\n    [],\n    \"tab\\tquote\\\"back\\\\slash\\u0001\"\n  ]\n}"));
+        free(out);
+
+        n = RedJsonValue_WriteJson(val, RED_JSON_FORMAT_COMPACT, buf, sizeof(buf));
+        RedTest_Verify(suite, "Writer: fixed buffer reports full length",
+                n == 44 && strlen(buf) == sizeof(buf) - 1 && !strncmp(buf, "{\"a\":[1,[],\"tab", sizeof(buf) - 1));
+        RedTest_Verify(suite, "Writer: size query with no buffer",
+                RedJsonValue_WriteJson(val, RED_JSON_FORMAT_COMPACT, NULL, 0) == 44);
+        RedJsonValue_Release(val);
+
+        val = RedJsonValue_FromObject(RedJsonObject_New());
+        out = RedJsonValue_ToFormattedJsonString(val, RED_JSON_FORMAT_PRETTY);
+        RedTest_Verify(suite, "Writer: empty object", !strcmp(out, "{}"));
+        free(out);
+        RedJsonValue_Release(val);
+    }
+
+    /* Streaming writer */
+    {
+        _Capture capture;
+        RedJsonWriter w;
+        RedJsonObject obj;
+        RedJsonValue dom;
+        RedJsonErrorEnum err;
+        char path[] = "/tmp/test_json_writerXXXXXX";
+        char *big, *readBack;
+        int fd;
+        size_t bigLength = 300000, n;
+        FILE *fp;
+
+        memset(&capture, 0, sizeof(capture));
+        w = RedJsonWriter_NewCallback(_CaptureOutput, &capture, RED_JSON_FORMAT_COMPACT);
+        obj = RedJsonObject_New();
+        RedJsonObject_SetInt64(obj, "n", 7);
+        dom = RedJsonValue_FromObject(obj);
+        RedJsonWriter_BeginObject(w);
+        RedJsonWriter_Key(w, "a");
+        RedJsonWriter_BeginArray(w);
+        RedJsonWriter_Number(w, 0.5);
+        RedJsonWriter_String(w, "x\ny");
+        RedJsonWriter_Boolean(w, true);
+        RedJsonWriter_Null(w);
+        RedJsonWriter_EndArray(w);
+        RedJsonWriter_Key(w, "dom");
+        RedJsonWriter_Value(w, dom);
+        RedJsonWriter_EndObject(w);
+        RedJsonWriter_Uint64(w, UINT64_MAX);
+        err = RedJsonWriter_Finish(w);
+        RedTest_Verify(suite, "Writer stream: compact events and DOM subtree",
+                err == RED_JSON_OK && !strcmp(capture.data,
+                    "{\"a\":[0.5,\"x\\ny\",true,null],\"dom\":{\"n\":7}}\n18446744073709551615"));
+        RedTest_Verify(suite, "Writer stream: byte count",
+                RedJsonWriter_BytesWritten(w) == capture.length);
+        RedJsonWriter_Free(w);
+
+        memset(&capture, 0, sizeof(capture));
+        w = RedJsonWriter_NewCallback(_CaptureOutput, &capture, RED_JSON_FORMAT_PRETTY);
+        RedJsonWriter_BeginObject(w);
+        RedJsonWriter_Key(w, "a");
+        RedJsonWriter_BeginArray(w);
+        RedJsonWriter_Int64(w, 1);
+        RedJsonWriter_BeginObject(w);
+        RedJsonWriter_EndObject(w);
+        RedJsonWriter_EndArray(w);
+        RedJsonWriter_Key(w, "dom");
+        RedJsonWriter_Value(w, dom);
+        RedJsonWriter_EndObject(w);
+        RedTest_Verify(suite, "Writer stream: pretty layout matches DOM writer",
+                RedJsonWriter_Finish(w) == RED_JSON_OK && !strcmp(capture.data,
+                    "{\n  \"a\": [\n    1,\n    {}\n  ],\n  \"dom\": {\n    \"n\": 7\n  }\n}"));
+        RedJsonWriter_Free(w);
+
+        memset(&capture, 0, sizeof(capture));
+        capture.fail = true;
+        w = RedJsonWriter_NewCallback(_CaptureOutput, &capture, RED_JSON_FORMAT_COMPACT);
+        RedJsonWriter_BeginArray(w);
+        RedJsonWriter_EndArray(w);
+        err = RedJsonWriter_Flush(w);
+        RedTest_Verify(suite, "Writer stream: sink errors are sticky",
+                err == RED_JSON_ERROR_IO && RedJsonWriter_Null(w) == RED_JSON_ERROR_IO);
+        RedJsonWriter_Free(w);
+
+        memset(&capture, 0, sizeof(capture));
+        w = RedJsonWriter_NewCallback(_CaptureOutput, &capture, RED_JSON_FORMAT_COMPACT);
+        RedJsonWriter_BeginArray(w);
+        RedTest_Verify(suite, "Writer stream: unclosed container reported",
+                RedJsonWriter_Finish(w) == RED_JSON_ERROR_UNEXPECTED_END);
+        RedJsonWriter_Free(w);
+
+        /* A string larger than the buffer goes through the writev path */
+        big = malloc(bigLength + 1);
+        memset(big, 'z', bigLength);
+        big[bigLength] = '\0';
+        fd = mkstemp(path);
+        w = RedJsonWriter_NewFd(fd, RED_JSON_FORMAT_COMPACT);
+        RedJsonWriter_BeginArray(w);
+        RedJsonWriter_String(w, "head");
+        RedJsonWriter_String(w, big);
+        RedJsonWriter_String(w, "tail");
+        RedJsonWriter_EndArray(w);
+        err = RedJsonWriter_Finish(w);
+        RedJsonWriter_Free(w);
+        close(fd);
+
+        readBack = malloc(bigLength + 64);
+        fp = fopen(path, "r");
+        n = fread(readBack, 1, bigLength + 64, fp);
+        fclose(fp);
+        RedTest_Verify(suite, "Writer fd: large payload written in order",
+                err == RED_JSON_OK && n == bigLength + 18
+                && !memcmp(readBack, "[\"head\",\"zzz", 12)
+                && !memcmp(&readBack[n - 10], "z\",\"tail\"]", 10));
+
+        fp = fopen(path, "w");
+        err = RedJsonValue_WriteToFile(dom, RED_JSON_FORMAT_COMPACT, fp);
+        fclose(fp);
+        fp = fopen(path, "r");
+        n = fread(readBack, 1, bigLength, fp);
+        fclose(fp);
+        RedTest_Verify(suite, "Writer file: DOM value", err == RED_JSON_OK && n == 7 && !memcmp(readBack, "{\"n\":7}", 7));
+
+        free(readBack);
+        free(big);
+        unlink(path);
+        RedJsonValue_Release(dom);
+    }
+
+    /* Object representation: insertion order, indexed lookups past the
+     * small-object threshold, duplicate keys from untrusted input */
+    {
+        RedJsonObject obj;
+        RedJsonValue val;
+        char key[16], **keys;
+        char *out;
+        unsigned i;
+        bool ok = true;
+
+        obj = RedJsonObject_New();
+        RedJsonObject_SetNumber(obj, "zeta", 1);
+        RedJsonObject_SetNumber(obj, "alpha", 2);
+        RedJsonObject_SetNumber(obj, "mid", 3);
+        out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+        RedTest_Verify(suite, "Object: members kept in insertion order", !strcmp(out, "{\"zeta\":1,\"alpha\":2,\"mid\":3}"));
+        free(out);
+        RedJsonObject_Release(obj);
+
+        obj = RedJsonObject_New();
+        for (i = 0; i < 1000; i++)
+        {
+            snprintf(key, sizeof(key), "k%u", i);
+            RedJsonObject_SetInt64(obj, key, i);
+        }
+        for (i = 0; i < 1000 && ok; i++)
+        {
+            snprintf(key, sizeof(key), "k%u", i);
+            ok = RedJsonObject_HasKey(obj, key) && RedJsonObject_GetInt64(obj, key) == i;
+        }
+        keys = RedJsonObject_NewKeysArray(obj);
+        RedTest_Verify(suite, "Object: large object lookups",
+                ok && RedJsonObject_NumItems(obj) == 1000
+                && !RedJsonObject_HasKey(obj, "k1000") && !RedJsonObject_Get(obj, "")
+                && !strcmp(keys[0], "k0") && !strcmp(keys[999], "k999") && !keys[1000]);
+        RedJsonObject_FreeKeysArray(keys);
+        RedJsonObject_Release(obj);
+
+        obj = RedJson_Parse("{\"a\":1,\"b\":2,\"a\":3}");
+        val = RedJsonObject_Get(obj, "a");
+        RedTest_Verify(suite, "Object: duplicate key keeps the last value",
+                obj && RedJsonObject_NumItems(obj) == 2 && val && RedJsonValue_GetInt64(val) == 3);
+        RedJsonObject_Release(obj);
+    }
+
+    /* Key interning */
+    {
+        RedJsonKeyTable keys = RedJsonKeyTable_New();
+        RedJsonKeyTable other = RedJsonKeyTable_New();
+        RedJsonKey idKey = RedJsonKeyTable_Intern(keys, "id");
+        RedJsonObject a, b, built;
+        RedJsonStreamParser parser;
+        RedString big = RedString_New(NULL);
+        unsigned i, count = 0;
+        bool ok = true;
+        char *out;
+
+        a = RedJson_ParseWithKeyTable("{\"id\":1,\"name\":\"x\",\"sub\":{\"id\":2}}", keys);
+        b = RedJson_ParseWithKeyTable("{\"name\":\"y\",\"id\":3}", keys);
+        RedTest_Verify(suite, "Keys: shared across documents",
+                RedJsonKeyTable_NumKeys(keys) == 3
+                && RedJsonKeyTable_Intern(keys, "id") == idKey
+                && !strcmp(RedJsonKey_GetChars(idKey), "id")
+                && RedJsonValue_GetInt64(RedJsonObject_GetByKey(a, idKey)) == 1
+                && RedJsonValue_GetInt64(RedJsonObject_GetByKey(b, idKey)) == 3
+                && RedJsonValue_GetInt64(RedJsonObject_GetByKey(RedJsonObject_GetObject(a, "sub"), idKey)) == 2
+                && !RedJsonObject_GetByKey(b, RedJsonKeyTable_Intern(keys, "missing")));
+
+        RedTest_Verify(suite, "Keys: handles from another table match by content",
+                RedJsonValue_GetInt64(RedJsonObject_GetByKey(a, RedJsonKeyTable_Intern(other, "id"))) == 1
+                && RedJsonObject_Get(b, "name") != NULL);
+
+        built = RedJsonObject_New();
+        RedJsonObject_SetByKey(built, idKey, RedJsonValue_FromInt64(7));
+        RedJsonObject_SetNumber(built, "n", 1);
+        out = RedJsonObject_ToFormattedJsonString(built, RED_JSON_FORMAT_COMPACT);
+        RedTest_Verify(suite, "Keys: SetByKey", !strcmp(out, "{\"id\":7,\"n\":1}") && RedJsonObject_GetInt64(built, "id") == 7);
+        free(out);
+        RedJsonObject_Release(built);
+
+        /* Objects keep their keys alive after the table is gone */
+        RedJsonKeyTable_Free(keys);
+        RedJsonKeyTable_Free(other);
+        RedTest_Verify(suite, "Keys: objects outlive their table",
+                RedJsonObject_GetInt64(a, "id") == 1 && !strcmp(RedJsonObject_GetString(b, "name"), "y"));
+        RedJsonObject_Release(a);
+        RedJsonObject_Release(b);
+
+        /* More distinct keys than a parser-private table holds */
+        RedString_AppendChars(big, "[{");
+        for (i = 0; i < 5000; i++)
+            RedString_AppendPrintf(big, "%s\"key%u\":%u", 64, i ? "," : "", i, i);
+        RedString_AppendChars(big, "}]");
+        keys = RedJsonKeyTable_New();
+        parser = RedJsonStreamParser_NewDom(1, _CheckWideRecord, &count);
+        RedJsonStreamParser_Feed(parser, RedString_GetChars(big), RedString_Length(big));
+        ok = RedJsonStreamParser_Finish(parser) == RED_JSON_OK && count == 1;
+        RedJsonStreamParser_Reset(parser);
+        RedJsonStreamParser_SetKeyTable(parser, keys);
+        RedJsonStreamParser_Feed(parser, RedString_GetChars(big), RedString_Length(big));
+        ok = ok && RedJsonStreamParser_Finish(parser) == RED_JSON_OK && count == 2;
+        RedTest_Verify(suite, "Keys: private table limit and caller-supplied table",
+                ok && RedJsonKeyTable_NumKeys(keys) == 5000);
+        RedJsonStreamParser_Free(parser);
+        RedJsonKeyTable_Free(keys);
+        RedString_Free(big);
+    }
+
+    /* String escapes and UTF-8 validation */
+    {
+        static const char *bad[] =
+        {
+            "[\"\xC0\x80\"]",               /* overlong */
+            "[\"\xED\xA0\x80\"]",           /* surrogate */
+            "[\"\xF4\x90\x80\x80\"]",       /* above U+10FFFF */
+            "[\"\xF5\x80\x80\x80\"]",
+            "[\"\x80\"]",                   /* stray continuation */
+            "[\"abc\xE6\x97\"]",            /* truncated by the quote */
+            "[\"\xE6\x97\\n\"]",            /* split by an escape */
+        };
+        const char *multilingual = "[\"naïve café – 日本語 – \xF0\x9F\x98\x80\"]";
+        char text[256], longText[512], *out;
+        RedJsonObject obj, parsed;
+        RedJsonErrorEnum err;
+        RedString log;
+        RedJsonError_t error;
+        RedJsonStreamParser parser;
+        bool ok = true;
+        unsigned i, seed;
+        size_t offset;
+
+        obj = RedJson_Parse("{\"s\":\"q\\\"b\\\\s\\/\\b\\f\\n\\r\\t\\u00e9\\u65e5\\ud83d\\ude00!\"}");
+        RedTest_Verify(suite, "Parse: escapes decoded", obj
+                && !strcmp(RedJsonObject_GetString(obj, "s"), "q\"b\\s/\b\f\n\r\t\xC3\xA9\xE6\x97\xA5\xF0\x9F\x98\x80!"));
+        RedJsonObject_Release(obj);
+
+        obj = RedJson_Parse("{\"s\":\"\\ud83d\"}");
+        RedTest_Verify(suite, "Parse: lone surrogate escape rejected", !obj);
+
+        for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+        {
+            snprintf(text, sizeof(text), "{\"s\":%s}", bad[i]);
+            obj = RedJson_Parse(text);
+            ok = ok && !obj;
+            for (seed = 0; seed < 8; seed++)
+            {
+                RedString_Free(_StreamInChunks(bad[i], seed, 3, &err));
+                ok = ok && err == RED_JSON_ERROR_BAD_UTF8;
+            }
+        }
+        RedTest_Verify(suite, "UTF-8: malformed sequences rejected by both parsers", ok);
+
+        log = RedString_New(NULL);
+        parser = RedJsonStreamParser_New(_LogEvent, log);
+        err = RedJsonStreamParser_Feed(parser, "[\"abcdefghijklmnopqrstuv\xFF\"]", 27);
+        error = RedJsonStreamParser_GetError(parser);
+        RedJsonStreamParser_Free(parser);
+        RedString_Free(log);
+        RedTest_Verify(suite, "UTF-8: error offset is the bad byte",
+                err == RED_JSON_ERROR_BAD_UTF8 && error.offset == 24);
+
+        ok = true;
+        for (seed = 0; seed < 16; seed++)
+        {
+            log = _StreamInChunks(multilingual, seed, 3, &err);
+            ok = ok && err == RED_JSON_OK && !strcmp(RedString_GetChars(log), "[S1<naïve café – 日本語 – \xF0\x9F\x98\x80>]");
+            RedString_Free(log);
+        }
+        RedTest_Verify(suite, "UTF-8: sequences split across chunks accepted", ok);
+
+        /* \u0000 fits a key, which carries its length, but not a string value */
+        obj = RedJson_ParseWithOptions("{\"s\": \"x\\u0000y\"}", 17, NULL, &error);
+        RedTest_Verify(suite, "Parse: \\u0000 in a string value rejected",
+                !obj && error.code == RED_JSON_ERROR_BAD_ESCAPE && error.offset == 8
+                && RedJson_Validate("{\"s\": \"x\\u0000y\"}", 17, NULL, NULL) == RED_JSON_ERROR_BAD_ESCAPE);
+        obj = RedJson_Parse("{\"x\\u0000y\": 1}");
+        out = obj ? RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT) : NULL;
+        RedTest_Verify(suite, "Parse: \\u0000 in a key kept", out && !strcmp(out, "{\"x\\u0000y\":1}"));
+        free(out);
+        RedJsonObject_Release(obj);
+        parser = RedJsonStreamParser_NewDom(1, _SumField, NULL);
+        err = RedJsonStreamParser_Feed(parser, "[\"x\\u0000y\"]", 13);
+        RedJsonStreamParser_Free(parser);
+        RedTest_Verify(suite, "Stream DOM: \\u0000 in a string value rejected", err == RED_JSON_ERROR_BAD_ESCAPE);
+        RedTest_Verify(suite, "CBOR: NUL in a text string value rejected",
+                _CborError("8163780079", &offset) == RED_JSON_ERROR_BAD_STRING && offset == 1);
+
+        /* Every escapable byte at every position relative to a 16-byte block */
+        ok = true;
+        for (i = 0; i < 40 && ok; i++)
+        {
+            unsigned c;
+            for (c = 0; c < 0x80 && ok; c++)
+            {
+                memset(longText, 'x', 48);
+                longText[i] = (char)c;
+                longText[48] = '\0';
+                if (!c)
+                    longText[i] = '\x1F';
+                obj = RedJsonObject_New();
+                RedJsonObject_SetString(obj, "s", longText);
+                out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+                parsed = RedJson_Parse(out);
+                ok = parsed && !strcmp(RedJsonObject_GetString(parsed, "s"), longText);
+                free(out);
+                RedJsonObject_Release(obj);
+                RedJsonObject_Release(parsed);
+            }
+        }
+        RedTest_Verify(suite, "Writer/Parse: escape round-trip at every offset", ok);
+    }
+
+    /* On-demand cursor */
+    {
+        const char *text =
+            " {\"skip\": {\"a\": [1, \"}]\\\"{[\", {\"b\": \"]\"}], \"c\": \"\\\\\"},\n"
+            "  \"long\": [\"a string longer than one block, with ]}\\\" inside it {[\"],\n"
+            "  \"k\\u0065y\": \"escaped\", \"items\": [10, -20, 30.5, true, null, \"s\\u00e9\"],\n"
+            "  \"big\": 18446744073709551615, \"dup\": 1, \"dup\": 2, \"empty\": [], \"last\": {\"x\": false}}";
+        RedJsonCursor_t doc, v, child;
+        RedJsonValue value;
+        RedJsonErrorEnum err;
+        const char *raw;
+        size_t rawLength;
+        int64_t i64 = 0;
+        uint64_t u64 = 0;
+        double dbl = 0;
+        bool flag = true, ok;
+        char *sz = NULL, *out;
+        unsigned count;
+
+        err = RedJsonCursor_Init(&doc, text, strlen(text));
+        RedTest_Verify(suite, "Cursor: init", err == RED_JSON_OK && RedJsonCursor_GetType(&doc) == RED_JSON_VALUE_TYPE_OBJECT);
+
+        ok = !RedJsonCursor_Find(&doc, "last", &v)
+                && !RedJsonCursor_Find(&v, "x", &child)
+                && !RedJsonCursor_GetBoolean(&child, &flag) && !flag;
+        RedTest_Verify(suite, "Cursor: find skips strings holding brackets and quotes", ok);
+
+        ok = !RedJsonCursor_Find(&doc, "key", &v) && !RedJsonCursor_GetString(&v, &sz) && !strcmp(sz, "escaped");
+        free(sz);
+        ok = ok && !RedJsonCursor_GetKey(&v, &sz) && !strcmp(sz, "key");
+        free(sz);
+        RedTest_Verify(suite, "Cursor: escaped key matched", ok);
+
+        ok = !RedJsonCursor_Find(&doc, "items", &v)
+                && !RedJsonCursor_Index(&v, 1, &child) && !RedJsonCursor_GetInt64(&child, &i64) && i64 == -20
+                && !RedJsonCursor_Index(&v, 2, &child) && !RedJsonCursor_GetNumber(&child, &dbl) && dbl == 30.5
+                && RedJsonCursor_GetInt64(&child, &i64) == RED_JSON_ERROR_WRONG_TYPE
+                && !RedJsonCursor_Index(&v, 4, &child) && RedJsonCursor_IsNull(&child)
+                && !RedJsonCursor_Index(&v, 5, &child) && !RedJsonCursor_GetString(&child, &sz) && !strcmp(sz, "s\xC3\xA9")
+                && RedJsonCursor_Index(&v, 6, &child) == RED_JSON_ERROR_NOT_FOUND;
+        free(sz);
+        RedTest_Verify(suite, "Cursor: array index and typed values", ok);
+
+        ok = !RedJsonCursor_Find(&doc, "big", &v)
+                && !RedJsonCursor_GetUint64(&v, &u64) && u64 == UINT64_MAX
+                && RedJsonCursor_GetInt64(&v, &i64) == RED_JSON_ERROR_WRONG_TYPE
+                && !RedJsonCursor_Find(&doc, "dup", &v) && !RedJsonCursor_GetInt64(&v, &i64) && i64 == 1;
+        RedTest_Verify(suite, "Cursor: unsigned range and first duplicate wins", ok);
+
+        RedTest_Verify(suite, "Cursor: errors",
+                RedJsonCursor_Find(&doc, "missing", &v) == RED_JSON_ERROR_NOT_FOUND
+                && !RedJsonCursor_Find(&doc, "empty", &v)
+                && RedJsonCursor_First(&v, &child) == RED_JSON_ERROR_NOT_FOUND
+                && RedJsonCursor_Find(&v, "x", &child) == RED_JSON_ERROR_WRONG_TYPE
+                && RedJsonCursor_GetString(&doc, &sz) == RED_JSON_ERROR_WRONG_TYPE
+                && RedJsonCursor_GetKey(&doc, &sz) == RED_JSON_ERROR_WRONG_TYPE
+                && RedJsonCursor_Init(&v, "  ", 2) == RED_JSON_ERROR_UNEXPECTED_END
+                && !RedJsonCursor_Init(&v, "{\"a\": [1, 2", 11)
+                && RedJsonCursor_Find(&v, "b", &child) == RED_JSON_ERROR_UNEXPECTED_END);
+
+        count = 0;
+        for (err = RedJsonCursor_First(&doc, &child); !err; err = RedJsonCursor_Next(&child))
+            count++;
+        RedTest_Verify(suite, "Cursor: iterate members", err == RED_JSON_ERROR_NOT_FOUND && count == 9);
+
+        ok = !RedJsonCursor_Find(&doc, "skip", &v) && !RedJsonCursor_GetRaw(&v, &raw, &rawLength)
+                && rawLength == 43 && raw[0] == '{' && raw[rawLength - 1] == '}';
+        ok = ok && !RedJsonCursor_GetValue(&v, &value);
+        out = ok ? RedJsonValue_ToFormattedJsonString(value, RED_JSON_FORMAT_COMPACT) : NULL;
+        RedTest_Verify(suite, "Cursor: raw span and full parse of a subtree",
+                out && !strcmp(out, "{\"a\":[1,\"}]\\\"{[\",{\"b\":\"]\"}],\"c\":\"\\\\\"}"));
+        free(out);
+        if (ok)
+            RedJsonValue_Release(value);
+
+        ok = !RedJsonCursor_Init(&v, "[\"\xC0\x80\"]", 6) && RedJsonCursor_GetValue(&v, &value) == RED_JSON_ERROR_BAD_UTF8
+                && !RedJsonCursor_Init(&v, "42", 2) && !RedJsonCursor_GetUint64(&v, &u64) && u64 == 42
+                && !RedJsonCursor_Init(&v, "4x", 2) && RedJsonCursor_GetUint64(&v, &u64) == RED_JSON_ERROR_BAD_NUMBER
+                && !RedJsonCursor_Init(&v, "nullx", 5) && !RedJsonCursor_IsNull(&v);
+        RedTest_Verify(suite, "Cursor: values are validated when extracted", ok);
+    }
+
+    /* Tape documents */
+    {
+        const char *text =
+            "{\"name\": \"tape\", \"nums\": [0, -12, 3.25, 18446744073709551615, -9223372036854775808, 1e300],\n"
+            "  \"flags\": [true, false, null], \"nested\": {\"a\": {\"b\": [[], {}, [\"x\\u0000y\"]]}},\n"
+            "  \"empty\": {}, \"last\": \"caf\\u00e9\"}";
+        RedJsonTape tape;
+        RedJsonTapeRef_t root, v, child;
+        RedJsonWriter w;
+        RedJsonError_t error;
+        _Capture capture;
+        RedString big;
+        unsigned i;
+        bool ok;
+
+        tape = RedJsonTape_Parse(text, strlen(text), &error);
+        root = RedJsonTape_Root(tape);
+        memset(&capture, 0, sizeof(capture));
+        w = RedJsonWriter_NewCallback(_CaptureOutput, &capture, RED_JSON_FORMAT_COMPACT);
+        _WriteTape(w, &root);
+        RedJsonWriter_Finish(w);
+        RedJsonWriter_Free(w);
+        /* _WriteTape goes through RedJsonWriter_String, which stops at the NUL */
+        RedTest_Verify(suite, "Tape: traversal visits every value", tape && !strcmp(capture.data,
+                "{\"name\":\"tape\",\"nums\":[0,-12,3.25,18446744073709551615,-9223372036854775808,1e+300],"
+                "\"flags\":[true,false,null],\"nested\":{\"a\":{\"b\":[[],{},[\"x\"]]}},\"empty\":{},"
+                "\"last\":\"caf\xC3\xA9\"}"));
+
+        ok = RedJsonTapeRef_NumItems(&root) == 6
+                && RedJsonTapeRef_Find(&root, "nums", &v) && RedJsonTapeRef_NumItems(&v) == 6
+                && RedJsonTapeRef_Index(&v, 3, &child) && RedJsonTapeRef_GetUint64(&child) == UINT64_MAX
+                && RedJsonTapeRef_GetInt64(&child) == INT64_MAX
+                && RedJsonTapeRef_Index(&v, 4, &child) && RedJsonTapeRef_GetInt64(&child) == INT64_MIN
+                && RedJsonTapeRef_GetUint64(&child) == 0
+                && RedJsonTapeRef_Index(&v, 5, &child) && RedJsonTapeRef_GetInt64(&child) == INT64_MAX
+                && !RedJsonTapeRef_Index(&v, 6, &child)
+                && RedJsonTapeRef_Find(&root, "last", &v) && !strcmp(RedJsonTapeRef_GetKey(&v), "last")
+                && !strcmp(RedJsonTapeRef_GetString(&v), "caf\xC3\xA9")
+                && !RedJsonTapeRef_Next(&v)
+                && RedJsonTapeRef_Find(&root, "empty", &v) && !RedJsonTapeRef_First(&v, &child)
+                && RedJsonTapeRef_NumItems(&v) == 0 && !RedJsonTapeRef_Find(&root, "missing", &v)
+                && RedJsonTapeRef_Find(&root, "flags", &v) && RedJsonTapeRef_Index(&v, 2, &child)
+                && RedJsonTapeRef_IsNull(&child) && RedJsonTapeRef_GetKey(&child) == NULL;
+        RedTest_Verify(suite, "Tape: lookups and scalars", ok);
+
+        ok = RedJsonTapeRef_Find(&root, "nested", &v) && RedJsonTapeRef_Find(&v, "a", &v)
+                && RedJsonTapeRef_Find(&v, "b", &v) && RedJsonTapeRef_Index(&v, 2, &v)
+                && RedJsonTapeRef_Index(&v, 0, &child) && RedJsonTapeRef_GetStringLength(&child) == 3
+                && !memcmp(RedJsonTapeRef_GetString(&child), "x\0y", 4);
+        RedTest_Verify(suite, "Tape: nested lookup and embedded nulls", ok);
+        RedJsonTape_Free(tape);
+
+        tape = RedJsonTape_Parse("{\"k\": 1, \"k\": 2}", 16, NULL);
+        root = RedJsonTape_Root(tape);
+        RedTest_Verify(suite, "Tape: duplicate key keeps the last value",
+                RedJsonTapeRef_Find(&root, "k", &v) && RedJsonTapeRef_GetInt64(&v) == 2);
+        RedJsonTape_Free(tape);
+
+        tape = RedJsonTape_Parse("42", 2, NULL);
+        root = RedJsonTape_Root(tape);
+        ok = tape && RedJsonTapeRef_GetNumber(&root) == 42 && !RedJsonTapeRef_Next(&root);
+        RedJsonTape_Free(tape);
+        ok = ok && !RedJsonTape_Parse("[1, 2] 3", 8, &error) && error.code == RED_JSON_ERROR_UNEXPECTED_CHAR;
+        ok = ok && !RedJsonTape_Parse(" \n ", 3, &error) && error.code == RED_JSON_ERROR_UNEXPECTED_END
+                && error.line == 2 && error.column == 2;
+        ok = ok && !RedJsonTape_Parse("{\"a\": [1,}", 10, &error) && error.code == RED_JSON_ERROR_UNEXPECTED_CHAR;
+        RedTest_Verify(suite, "Tape: scalar root and errors", ok);
+
+        /* Deep nesting and a large array */
+        big = RedString_New(NULL);
+        for (i = 0; i < 1000; i++)
+            RedString_AppendChars(big, "[");
+        for (i = 0; i < 1000; i++)
+            RedString_AppendChars(big, "]");
+        tape = RedJsonTape_Parse(RedString_GetChars(big), RedString_Length(big), NULL);
+        root = RedJsonTape_Root(tape);
+        ok = tape != NULL;
+        for (i = 0; ok && i < 999; i++)
+            ok = RedJsonTapeRef_NumItems(&root) == 1 && RedJsonTapeRef_First(&root, &root);
+        ok = ok && RedJsonTapeRef_NumItems(&root) == 0;
+        RedJsonTape_Free(tape);
+        RedString_Clear(big);
+        RedString_AppendChars(big, "[0");
+        for (i = 1; i < 100000; i++)
+            RedString_AppendPrintf(big, ",%u", 16, i);
+        RedString_AppendChars(big, "]");
+        tape = RedJsonTape_Parse(RedString_GetChars(big), RedString_Length(big), NULL);
+        root = RedJsonTape_Root(tape);
+        ok = ok && RedJsonTapeRef_NumItems(&root) == 100000
+                && RedJsonTapeRef_Index(&root, 99999, &v) && RedJsonTapeRef_GetUint64(&v) == 99999
+                && RedJsonTape_MemoryUsage(tape) < 100000 * 16 + 4096;
+        RedTest_Verify(suite, "Tape: deep nesting and large arrays", ok);
+        RedJsonTape_Free(tape);
+        RedString_Free(big);
+    }
+
+    /* Parser depth limit and error reporting */
+    {
+        RedJsonParseOptions_t options;
+        RedJsonError_t error;
+        RedJsonObject obj;
+        const char *text;
+        RedString deep = RedString_New(NULL);
+        unsigned i;
+        bool ok;
+
+        for (i = 0; i < 100000; i++)
+            RedString_AppendChars(deep, "{\"a\":[");
+        obj = RedJson_ParseWithOptions(RedString_GetChars(deep), RedString_Length(deep), NULL, &error);
+        RedTest_Verify(suite, "Parse: deep nesting fails without recursion",
+                !obj && error.code == RED_JSON_ERROR_DEPTH_EXCEEDED
+                && error.offset == 6 * (RED_JSON_DEFAULT_MAX_DEPTH / 2));
+
+        RedString_Clear(deep);
+        for (i = 0; i < 10; i++)
+            RedString_AppendChars(deep, "{\"a\":");
+        RedString_AppendChars(deep, "1");
+        for (i = 0; i < 10; i++)
+            RedString_AppendChars(deep, "}");
+        memset(&options, 0, sizeof(options));
+        options.maxDepth = 10;
+        obj = RedJson_ParseWithOptions(RedString_GetChars(deep), RedString_Length(deep), &options, &error);
+        ok = obj != NULL;
+        RedJsonObject_Release(obj);
+        options.maxDepth = 9;
+        obj = RedJson_ParseWithOptions(RedString_GetChars(deep), RedString_Length(deep), &options, &error);
+        RedTest_Verify(suite, "Parse: configurable depth limit",
+                ok && !obj && error.code == RED_JSON_ERROR_DEPTH_EXCEEDED && error.offset == 5 * 9);
+        RedString_Free(deep);
+
+        obj = RedJson_ParseWithOptions("{\"a\": 1,\n  \"b\": [1, 2,\n  x]}", 28, NULL, &error);
+        ok = !obj && error.code == RED_JSON_ERROR_UNEXPECTED_CHAR && error.offset == 25
+                && error.line == 3 && error.column == 3;
+        obj = RedJson_ParseWithOptions("{\"a\": [1, 2", 11, NULL, &error);
+        ok = ok && !obj && error.code == RED_JSON_ERROR_UNEXPECTED_END && error.offset == 11;
+        obj = RedJson_ParseWithOptions("{\"a\": 01}", 9, NULL, &error);
+        ok = ok && !obj && error.code == RED_JSON_ERROR_BAD_NUMBER && error.offset == 6;
+        obj = RedJson_ParseWithOptions("{\"a\": \"x\\q\"}", 12, NULL, &error);
+        ok = ok && !obj && error.code == RED_JSON_ERROR_BAD_ESCAPE;
+        obj = RedJson_ParseWithOptions("{\"a\": tru}", 10, NULL, &error);
+        ok = ok && !obj && error.code == RED_JSON_ERROR_UNEXPECTED_CHAR && error.offset == 6;
+        obj = RedJson_ParseWithOptions("{} {}", 5, NULL, &error);
+        ok = ok && !obj && error.code == RED_JSON_ERROR_UNEXPECTED_CHAR && error.offset == 3;
+        obj = RedJson_ParseWithOptions("{} /* x", 7, NULL, &error);
+        ok = ok && !obj && error.code == RED_JSON_ERROR_UNEXPECTED_END;
+        obj = RedJson_ParseWithOptions("[1]", 3, NULL, &error);
+        ok = ok && !obj && error.code == RED_JSON_ERROR_UNEXPECTED_CHAR && error.offset == 0;
+        obj = RedJson_ParseWithOptions("{\"a\": [}", 8, NULL, &error);
+        ok = ok && !obj && error.code == RED_JSON_ERROR_UNEXPECTED_CHAR && error.offset == 7;
+        obj = RedJson_ParseWithOptions("{\"a\": {,}}", 10, NULL, &error);
+        ok = ok && !obj && error.code == RED_JSON_ERROR_UNEXPECTED_CHAR && error.offset == 7;
+        obj = RedJson_ParseWithOptions("{\"a\" 1}", 7, NULL, &error);
+        ok = ok && !obj && error.code == RED_JSON_ERROR_UNEXPECTED_CHAR && error.offset == 5;
+        RedTest_Verify(suite, "Parse: error codes and positions", ok);
+
+        text = " /* c */ {\"a\": [], \"b\": {}, \"c\": [[{}]], \"d\": -0.5e1} /* end */ ";
+        obj = RedJson_ParseWithOptions(text, strlen(text), NULL, &error);
+        RedTest_Verify(suite, "Parse: comments and empty containers",
+                obj && RedJsonObject_GetNumber(obj, "d") == -5
+                && RedJsonArray_NumItems(RedJsonObject_GetArray(obj, "c")) == 1
+                && RedJsonObject_NumItems(RedJsonObject_GetObject(obj, "b")) == 0);
+        RedJsonObject_Release(obj);
+
+        {
+            RedJsonDocument doc = RedJsonDocument_New();
+            char *out;
+
+            /* The dropped value is an object that itself repeats keys */
+            text = "{\"a\": 1, \"b\": [2], \"a\": {\"a\": 3, \"a\": {\"x\": [4]}}, \"c\": 5}";
+            obj = RedJson_Parse(text);
+            out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+            ok = !strcmp(out, "{\"a\":{\"a\":{\"x\":[4]}},\"b\":[2],\"c\":5}");
+            free(out);
+            RedJsonObject_Release(obj);
+
+            memset(&options, 0, sizeof(options));
+            options.duplicateKeys = RED_JSON_DUPLICATE_KEY_FIRST_WINS;
+            for (i = 0; i < 3 && ok; i++)
+            {
+                obj = i ? RedJsonDocument_Parse(doc, text, strlen(text), &options, &error)
+                        : RedJson_ParseWithOptions(text, strlen(text), &options, &error);
+                out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+                ok = !strcmp(out, "{\"a\":1,\"b\":[2],\"c\":5}") && !strcmp(RedJsonObject_GetKeyAt(obj, 2), "c");
+                free(out);
+                if (!i)
+                    RedJsonObject_Release(obj);
+            }
+
+            options.duplicateKeys = RED_JSON_DUPLICATE_KEY_ERROR;
+            for (i = 0; i < 3 && ok; i++)
+            {
+                obj = i ? RedJsonDocument_Parse(doc, text, strlen(text), &options, &error)
+                        : RedJson_ParseWithOptions(text, strlen(text), &options, &error);
+                ok = !obj && error.code == RED_JSON_ERROR_DUPLICATE_KEY && error.offset == 19;
+            }
+            text = "{\"a\": {\"b\": 1}, \"b\": {\"a\": 1, \"b\": 2, \"c\": {\"c\": 1}}}";
+            obj = RedJsonDocument_Parse(doc, text, strlen(text), &options, &error);
+            ok = ok && obj && RedJsonObject_GetInt64(RedJsonObject_GetObject(obj, "b"), "b") == 2;
+            RedJsonDocument_Free(doc);
+            RedTest_Verify(suite, "Parse: duplicate key policies", ok);
+        }
+    }
+
+    /* Packed arrays */
+    {
+        const char *text = "{\"d\": [1.5, 2, -3], \"i\": [1, 2, 3], \"b\": [true, false], \"m\": [1, \"x\"], \"e\": []}";
+        const double *doubles;
+        const int64_t *ints;
+        RedJsonObject obj, copy, other;
+        RedJsonArray arr, patch;
+        RedJsonValue val;
+        RedJsonDocument doc;
+        RedJsonPath path;
+        const char *mixed = "{\"d\": [true, 1.5]}";
+        double extra[2] = {4.25, 5}, sum = 0;
+        char *out;
+        unsigned i;
+        bool ok;
+
+        obj = RedJson_Parse(text);
+        arr = RedJsonObject_GetArray(obj, "d");
+        doubles = RedJsonArray_GetDoubles(arr);
+        ok = RedJsonArray_GetStorage(arr) == RED_JSON_ARRAY_STORAGE_DOUBLES && doubles
+                && RedJsonArray_NumItems(arr) == 3 && doubles[0] == 1.5 && doubles[1] == 2 && doubles[2] == -3
+                && RedJsonArray_GetEntryInt64(arr, 1) == 2 && RedJsonArray_IsEntryNumber(arr, 0)
+                && !RedJsonArray_GetInt64s(arr);
+        arr = RedJsonObject_GetArray(obj, "i");
+        ints = RedJsonArray_GetInt64s(arr);
+        ok = ok && RedJsonArray_GetStorage(arr) == RED_JSON_ARRAY_STORAGE_INT64S && ints && ints[2] == 3;
+        arr = RedJsonObject_GetArray(obj, "b");
+        ok = ok && RedJsonArray_GetStorage(arr) == RED_JSON_ARRAY_STORAGE_BOOLEANS
+                && RedJsonArray_GetBooleans(arr)[0] && !RedJsonArray_GetEntryBoolean(arr, 1)
+                && RedJsonArray_IsEntryBoolean(arr, 1);
+        arr = RedJsonObject_GetArray(obj, "m");
+        ok = ok && RedJsonArray_GetStorage(arr) == RED_JSON_ARRAY_STORAGE_VALUES
+                && RedJsonArray_GetEntryInt64(arr, 0) == 1 && !strcmp(RedJsonArray_GetEntryString(arr, 1), "x");
+        ok = ok && RedJsonArray_GetStorage(RedJsonObject_GetArray(obj, "e")) == RED_JSON_ARRAY_STORAGE_VALUES;
+        out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+        ok = ok && !strcmp(out, "{\"d\":[1.5,2,-3],\"i\":[1,2,3],\"b\":[true,false],\"m\":[1,\"x\"],\"e\":[]}");
+        free(out);
+        RedTest_Verify(suite, "Packed arrays: parser packs numbers and booleans", ok);
+
+        /* Reads and path queries leave the buffers alone; GetEntry and
+         * GetFirst, which hand out values, have none to give */
+        path = RedJsonPath_Compile("$.d[*]", NULL);
+        ok = RedJsonPath_EvalObject(path, obj, _PathSumValue, &sum) == 3 && sum == 0.5;
+        RedJsonPath_Free(path);
+        path = RedJsonPath_Compile("/i/2", NULL);
+        ok = ok && RedJsonPath_EvalObject(path, obj, _PathSumValue, &sum) == 1 && sum == 3.5;
+        RedJsonPath_Free(path);
+        path = RedJsonPath_Compile("$.b[-1]", NULL);
+        ok = ok && RedJsonPath_EvalObject(path, obj, NULL, NULL) == 1
+                && RedJsonArray_GetStorage(RedJsonObject_GetArray(obj, "d")) == RED_JSON_ARRAY_STORAGE_DOUBLES
+                && RedJsonArray_GetStorage(RedJsonObject_GetArray(obj, "i")) == RED_JSON_ARRAY_STORAGE_INT64S
+                && RedJsonArray_GetStorage(RedJsonObject_GetArray(obj, "b")) == RED_JSON_ARRAY_STORAGE_BOOLEANS;
+        ok = ok && !RedJsonPath_GetFirst(path, obj)
+                && RedJsonArray_GetStorage(RedJsonObject_GetArray(obj, "b")) == RED_JSON_ARRAY_STORAGE_BOOLEANS;
+        RedJsonPath_Free(path);
+        RedTest_Verify(suite, "Packed arrays: path queries read without unpacking", ok);
+
+        /* A clone shares the packed array until it is modified */
+        copy = RedJsonObject_Clone(obj);
+        arr = RedJsonObject_GetArray(copy, "d");
+        ok = arr == RedJsonObject_GetArray(obj, "d") && !RedJsonArray_GetEntry(arr, 1)
+                && RedJsonArray_IsEntryNumber(arr, 1) && RedJsonArray_GetEntryNumber(arr, 1) == 2
+                && RedJsonArray_GetStorage(RedJsonObject_GetArray(obj, "d")) == RED_JSON_ARRAY_STORAGE_DOUBLES;
+        arr = RedJsonObject_GetMutableArray(copy, "d");
+        RedJsonArray_SetEntry(arr, 1, RedJsonValue_FromString("two"));
+        ok = ok && RedJsonArray_GetStorage(arr) == RED_JSON_ARRAY_STORAGE_VALUES
+                && RedJsonArray_GetEntry(arr, 1) && !strcmp(RedJsonArray_GetEntryString(arr, 1), "two")
+                && RedJsonArray_GetStorage(RedJsonObject_GetArray(obj, "d")) == RED_JSON_ARRAY_STORAGE_DOUBLES
+                && RedJsonArray_GetEntryNumber(RedJsonObject_GetArray(obj, "d"), 1) == 2;
+        RedJsonObject_Release(copy);
+        RedTest_Verify(suite, "Packed arrays: reads through a clone leave the source packed", ok);
+
+        /* Ints widen to doubles while exact; anything else unpacks */
+        arr = RedJsonArray_New();
+        RedJsonArray_AppendInt64(arr, 7);
+        RedJsonArray_AppendNumber(arr, 0.5);
+        RedJsonArray_AppendDoubles(arr, extra, 2);
+        ok = RedJsonArray_GetStorage(arr) == RED_JSON_ARRAY_STORAGE_DOUBLES && RedJsonArray_NumItems(arr) == 4
+                && RedJsonArray_GetDoubles(arr)[0] == 7 && RedJsonArray_GetDoubles(arr)[3] == 5;
+        RedJsonArray_SetEntryNumber(arr, 0, 8);
+        RedJsonArray_AppendInt64(arr, INT64_MAX);
+        ok = ok && RedJsonArray_GetStorage(arr) == RED_JSON_ARRAY_STORAGE_VALUES && RedJsonArray_NumItems(arr) == 5
+                && RedJsonArray_GetEntryNumber(arr, 0) == 8 && RedJsonArray_GetEntryInt64(arr, 4) == INT64_MAX;
+        RedJsonArray_Release(arr);
+        arr = RedJsonArray_New();
+        RedJsonArray_AppendBoolean(arr, true);
+        RedJsonArray_AppendNull(arr);
+        ok = ok && RedJsonArray_GetStorage(arr) == RED_JSON_ARRAY_STORAGE_VALUES && RedJsonArray_GetEntryBoolean(arr, 0)
+                && RedJsonArray_IsEntryNull(arr, 1);
+        RedJsonArray_Release(arr);
+        RedTest_Verify(suite, "Packed arrays: appends pack and unpack as needed", ok);
+
+        /* Copies, comparisons and diffs see through the layout */
+        copy = RedJsonObject_Clone(obj);
+        other = RedJson_Parse("{\"d\": [1.5, 2, -3], \"i\": [1, 2, 3], \"b\": [true, false], \"m\": [1, \"x\"], \"e\": []}");
+        arr = RedJsonObject_GetMutableArray(other, "d");
+        RedJsonArray_SetEntry(arr, 0, RedJsonValue_FromNumber(1.5));
+        ok = RedJsonArray_GetStorage(arr) == RED_JSON_ARRAY_STORAGE_VALUES
+                && RedJsonObject_Equals(obj, other) && RedJsonObject_Equals(copy, other)
+                && RedJsonArray_GetStorage(RedJsonObject_GetArray(copy, "d")) == RED_JSON_ARRAY_STORAGE_DOUBLES;
+        patch = RedJson_Diff(obj, other);
+        ok = ok && RedJsonArray_NumItems(patch) == 0;
+        RedJsonArray_Release(patch);
+        RedJsonArray_SetEntryNumber(RedJsonObject_GetMutableArray(copy, "d"), 1, 2.5);
+        RedJsonArray_AppendInt64(RedJsonObject_GetMutableArray(copy, "i"), 4);
+        patch = RedJson_Diff(obj, copy);
+        val = RedJsonValue_FromArray(patch);
+        out = RedJsonValue_ToFormattedJsonString(val, RED_JSON_FORMAT_COMPACT);
+        ok = ok && !strcmp(out, "[{\"op\":\"replace\",\"path\":\"/d/1\",\"value\":2.5},"
+                "{\"op\":\"add\",\"path\":\"/i/3\",\"value\":4}]");
+        free(out);
+        ok = ok && RedJson_ApplyPatch(obj, patch, NULL) == RED_JSON_OK && RedJsonObject_Equals(obj, copy);
+        RedJsonValue_Release(val);
+        RedJsonObject_Release(other);
+        RedJsonObject_Release(copy);
+        RedJsonObject_Release(obj);
+        RedTest_Verify(suite, "Packed arrays: clone, equals, diff and patch", ok);
+
+        /* Documents reuse packed buffers across parses */
+        doc = RedJsonDocument_New();
+        ok = true;
+        for (i = 0; i < 3 && ok; i++)
+        {
+            obj = i == 1 ? RedJsonDocument_Parse(doc, mixed, strlen(mixed), NULL, NULL)
+                    : RedJsonDocument_Parse(doc, text, strlen(text), NULL, NULL);
+            out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+            ok = i == 1 ? !strcmp(out, "{\"d\":[true,1.5]}")
+                    : !strcmp(out, "{\"d\":[1.5,2,-3],\"i\":[1,2,3],\"b\":[true,false],\"m\":[1,\"x\"],\"e\":[]}");
+            free(out);
+        }
+        RedJsonDocument_Free(doc);
+        RedTest_Verify(suite, "Packed arrays: documents reuse packed storage", ok);
+    }
+
+    /* CBOR */
+    {
+        const char *text =
+            "{\"name\": \"cbor\", \"nums\": [0, -12, 3.25, 0.1, 18446744073709551615, -9223372036854775808, 1e300],\n"
+            "  \"flags\": [true, false, null], \"nested\": {\"a\": {\"b\": [[], {}, [\"x\\u0001y\"]]}},\n"
+            "  \"empty\": {}, \"last\": \"caf\\u00e9\"}";
+        RedJsonObject obj, members;
+        RedJsonArray items;
+        RedJsonValue val, dom;
+        RedJsonTape tape;
+        RedJsonTapeRef_t root;
+        RedJsonStreamParser parser;
+        RedJsonWriter w;
+        RedJsonError_t error;
+        RedJsonErrorEnum err;
+        RedString fromJson, fromCbor;
+        _Capture capture;
+        char hex[256];
+        char *data, *out, *expected;
+        size_t length, offset = 0, i;
+        bool ok;
+
+        members = RedJsonObject_New();
+        RedJsonObject_SetInt64(members, "a", 1);
+        items = RedJsonArray_New();
+        RedJsonArray_AppendInt64(items, 2);
+        RedJsonArray_AppendInt64(items, 3);
+        RedJsonObject_SetArray(members, "b", items);
+        ok = !strcmp(_CborHex(RedJsonValue_FromInt64(0), hex), "00")
+            && !strcmp(_CborHex(RedJsonValue_FromInt64(23), hex), "17")
+            && !strcmp(_CborHex(RedJsonValue_FromInt64(24), hex), "1818")
+            && !strcmp(_CborHex(RedJsonValue_FromInt64(1000), hex), "1903e8")
+            && !strcmp(_CborHex(RedJsonValue_FromInt64(1000000), hex), "1a000f4240")
+            && !strcmp(_CborHex(RedJsonValue_FromInt64(1000000000000LL), hex), "1b000000e8d4a51000")
+            && !strcmp(_CborHex(RedJsonValue_FromUint64(UINT64_MAX), hex), "1bffffffffffffffff")
+            && !strcmp(_CborHex(RedJsonValue_FromInt64(-1), hex), "20")
+            && !strcmp(_CborHex(RedJsonValue_FromInt64(-1000), hex), "3903e7")
+            && !strcmp(_CborHex(RedJsonValue_FromInt64(INT64_MIN), hex), "3b7fffffffffffffff")
+            && !strcmp(_CborHex(RedJsonValue_FromNumber(0.0), hex), "f90000")
+            && !strcmp(_CborHex(RedJsonValue_FromNumber(-0.0), hex), "f98000")
+            && !strcmp(_CborHex(RedJsonValue_FromNumber(1.5), hex), "f93e00")
+            && !strcmp(_CborHex(RedJsonValue_FromNumber(65504.0), hex), "f97bff")
+            && !strcmp(_CborHex(RedJsonValue_FromNumber(5.960464477539063e-8), hex), "f90001")
+            && !strcmp(_CborHex(RedJsonValue_FromNumber(100000.0), hex), "fa47c35000")
+            && !strcmp(_CborHex(RedJsonValue_FromNumber(1.1), hex), "fb3ff199999999999a")
+            && !strcmp(_CborHex(RedJsonValue_FromNumber(-4.1), hex), "fbc010666666666666")
+            && !strcmp(_CborHex(RedJsonValue_FromNumber(INFINITY), hex), "f97c00")
+            && !strcmp(_CborHex(RedJsonValue_FromNumber(NAN), hex), "f97e00")
+            && !strcmp(_CborHex(RedJsonValue_FromBoolean(true), hex), "f5")
+            && !strcmp(_CborHex(RedJsonValue_FromBoolean(false), hex), "f4")
+            && !strcmp(_CborHex(RedJsonValue_Null(), hex), "f6")
+            && !strcmp(_CborHex(RedJsonValue_FromString(""), hex), "60")
+            && !strcmp(_CborHex(RedJsonValue_FromString("\xc3\xbc"), hex), "62c3bc")
+            && !strcmp(_CborHex(RedJsonValue_FromObject(members), hex), "a26161016162820203");
+        RedTest_Verify(suite, "CBOR: encoding matches RFC 8949 examples", ok);
+
+        ok = _CborDecodesTo("9f018202039f0405ffff", "[1,[2,3],[4,5]]")
+            && _CborDecodesTo("83019f0203ff820405", "[1,[2,3],[4,5]]")
+            && _CborDecodesTo("bf61610161629f0203ffff", "{\"a\":1,\"b\":[2,3]}")
+            && _CborDecodesTo("a56161614161626142616361436164614461656145",
+                    "{\"a\":\"A\",\"b\":\"B\",\"c\":\"C\",\"d\":\"D\",\"e\":\"E\"}")
+            && _CborDecodesTo("7f657374726561646d696e67ff", "\"streaming\"")
+            && _CborDecodesTo("c074323031332d30332d32315432303a30343a30305a", "\"2013-03-21T20:04:00Z\"")
+            && _CborDecodesTo("3903e7", "-1000")
+            && _CborDecodesTo("1bffffffffffffffff", "18446744073709551615")
+            && _CborDecodesTo("f93e00", "1.5")
+            && _CborDecodesTo("fa47c35000", "100000")
+            && _CborDecodesTo("fb3ff199999999999a", "1.1")
+            && _CborDecodesTo("f7", "null")
+            && _CborDecodesTo("80", "[]")
+            && _CborDecodesTo("a0", "{}");
+        data = malloc(16);
+        val = RedJson_ParseCbor(data, _FromHex("3bffffffffffffffff", data), NULL);
+        ok = ok && RedJsonValue_GetNumberType(val) == RED_JSON_NUMBER_DOUBLE
+            && RedJsonValue_GetNumber(val) == -18446744073709551616.0;
+        free(data);
+        RedJsonValue_Release(val);
+        RedTest_Verify(suite, "CBOR: decoding RFC 8949 examples", ok);
+
+        obj = RedJson_Parse(text);
+        expected = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+        dom = RedJsonValue_FromObject(obj);
+        data = RedJsonValue_ToCbor(dom, &length);
+        val = RedJson_ParseCbor(data, length, &error);
+        out = val ? RedJsonValue_ToFormattedJsonString(val, RED_JSON_FORMAT_COMPACT) : NULL;
+        RedTest_Verify(suite, "CBOR: DOM round trip",
+                out && !strcmp(out, expected) && length < strlen(expected)
+                && RedJsonArray_GetEntryUint64(RedJsonObject_GetArray(RedJsonValue_GetObject(val), "nums"), 4) == UINT64_MAX);
+        free(out);
+        free(expected);
+        free(data);
+        RedJsonValue_Release(val);
+        RedJsonValue_Release(dom);
+
+        /* Streamed with indefinite lengths, then decoded a byte at a time */
+        tape = RedJsonTape_Parse(text, strlen(text), NULL);
+        root = RedJsonTape_Root(tape);
+        memset(&capture, 0, sizeof(capture));
+        w = RedJsonWriter_NewCallback(_CaptureOutput, &capture, RED_JSON_FORMAT_CBOR);
+        _WriteTape(w, &root);
+        RedJsonWriter_Int64(w, 7);
+        err = RedJsonWriter_Finish(w);
+        RedJsonWriter_Free(w);
+        RedJsonTape_Free(tape);
+
+        fromJson = RedString_New(NULL);
+        parser = RedJsonStreamParser_New(_LogEvent, fromJson);
+        RedJsonStreamParser_Feed(parser, text, strlen(text));
+        RedJsonStreamParser_Feed(parser, " 7", 2);
+        RedJsonStreamParser_Finish(parser);
+        RedJsonStreamParser_Free(parser);
+
+        fromCbor = RedString_New(NULL);
+        parser = RedJsonStreamParser_New(_LogEvent, fromCbor);
+        ok = !err && !RedJsonStreamParser_SetFormat(parser, RED_JSON_FORMAT_CBOR)
+            && capture.data[0] == (char)0xbf;
+        for (i = 0; i < capture.length && ok; i++)
+            ok = !RedJsonStreamParser_Feed(parser, &capture.data[i], 1);
+        ok = ok && !RedJsonStreamParser_Finish(parser);
+        RedJsonStreamParser_Free(parser);
+        RedTest_Verify(suite, "CBOR: streaming writer and chunked decoding",
+                ok && RedString_Equals(fromJson, RedString_GetChars(fromCbor)));
+        RedString_Free(fromJson);
+        RedString_Free(fromCbor);
+
+        ok = _CborError("8301", &offset) == RED_JSON_ERROR_UNEXPECTED_END
+            && _CborError("19", &offset) == RED_JSON_ERROR_UNEXPECTED_END
+            && _CborError("", &offset) == RED_JSON_ERROR_UNEXPECTED_END
+            && _CborError("824101", &offset) == RED_JSON_ERROR_BAD_CBOR && offset == 1
+            && _CborError("a10102", &offset) == RED_JSON_ERROR_BAD_CBOR && offset == 1
+            && _CborError("62c328", &offset) == RED_JSON_ERROR_BAD_UTF8 && offset == 2
+            && _CborError("7f616101ff", &offset) == RED_JSON_ERROR_BAD_CBOR && offset == 3
+            && _CborError("ff", &offset) == RED_JSON_ERROR_BAD_CBOR && offset == 0
+            && _CborError("a16161ff", &offset) == RED_JSON_ERROR_BAD_CBOR && offset == 3
+            && _CborError("1c", &offset) == RED_JSON_ERROR_BAD_CBOR && offset == 0
+            && _CborError("f820", &offset) == RED_JSON_ERROR_BAD_CBOR && offset == 0
+            && _CborError("0102", &offset) == RED_JSON_ERROR_BAD_CBOR && offset == 1
+            && _CborError("1f", &offset) == RED_JSON_ERROR_BAD_CBOR;
+        {
+            char deep[2 * (RED_JSON_DEFAULT_MAX_DEPTH + 1) + 3];
+            for (i = 0; i <= RED_JSON_DEFAULT_MAX_DEPTH; i++)
+                memcpy(&deep[2 * i], "81", 2);
+            strcpy(&deep[2 * i], "00");
+            ok = ok && _CborError(deep, &offset) == RED_JSON_ERROR_DEPTH_EXCEEDED
+                && offset == RED_JSON_DEFAULT_MAX_DEPTH;
+        }
+        RedTest_Verify(suite, "CBOR: malformed and unsupported input", ok);
+    }
+
+    {
+        const char *text = "{\"id\": -7, \"seq\": 18446744073709551615, \"px\": 101.25, \"open\": true,"
+                " \"skip\": {\"venue\": [1, {\"id\": 2}]}, \"symbol\": \"ABC\", \"venue\": {\"code\": \"X\\u00e9\","
+                " \"lane\": 3, \"extra\": null}, \"aXbYc\": 1, \"aZbWc\": 2, \"symbol\": \"DEF\", \"tags\": []}";
+        RedJsonBinding binding = RedJsonBinding_New(_testOrderFields);
+        _TestOrder order, copy;
+        RedJsonErrorEnum err;
+        size_t offset = 0;
+        char *out;
+        bool ok;
+
+        memset(&order, 0, sizeof(order));
+        order.venue.lane = 99;
+        err = RedJsonBinding_Parse(binding, text, strlen(text), &order, NULL);
+        ok = !err && order.id == -7 && order.seq == UINT64_MAX && order.price == 101.25 && order.open
+                && !strcmp(order.symbol, "DEF") && !strcmp(order.venue.code, "X\xC3\xA9")
+                && order.venue.lane == 3 && order.aXbYc == 1 && order.aZbWc == 2;
+        RedTest_Verify(suite, "Binding: members, nesting, unknown keys and repeats", ok);
+
+        err = RedJsonBinding_Parse(binding, "{\"symbol\": null, \"venue\": {}, \"id\": 5}", 38, &order, NULL);
+        ok = !err && !order.symbol && order.id == 5 && order.venue.lane == 3 && !strcmp(order.venue.code, "X\xC3\xA9");
+        RedTest_Verify(suite, "Binding: missing members kept and null clears strings", ok);
+
+        out = RedJsonBinding_ToJsonString(binding, &order);
+        memset(&copy, 0, sizeof(copy));
+        ok = out && !strcmp(out, "{\"id\":5,\"seq\":18446744073709551615,\"px\":101.25,\"open\":true,"
+                "\"symbol\":null,\"venue\":{\"code\":\"X\xC3\xA9\",\"lane\":3},\"aXbYc\":1,\"aZbWc\":2}")
+                && !RedJsonBinding_Parse(binding, out, strlen(out), &copy, NULL)
+                && !memcmp(&copy.venue.lane, &order.venue.lane, sizeof(int32_t)) && copy.seq == order.seq
+                && !strcmp(copy.venue.code, order.venue.code);
+        free(out);
+        RedJsonBinding_FreeMembers(binding, &copy);
+        RedJsonBinding_FreeMembers(binding, &order);
+        RedTest_Verify(suite, "Binding: write and parse back", ok && !order.venue.code && !copy.venue.code);
+
+        ok = _BindError(binding, "{\"id\": 1.5}", &offset) == RED_JSON_ERROR_WRONG_TYPE
+                && _BindError(binding, "{\"venue\": {\"lane\": 2147483648}}", &offset) == RED_JSON_ERROR_WRONG_TYPE
+                && _BindError(binding, "{\"seq\": -1}", &offset) == RED_JSON_ERROR_WRONG_TYPE
+                && _BindError(binding, "{\"venue\": 1}", &offset) == RED_JSON_ERROR_WRONG_TYPE
+                && _BindError(binding, "{\"symbol\": [\"a\"]}", &offset) == RED_JSON_ERROR_WRONG_TYPE
+                && _BindError(binding, "[1]", &offset) == RED_JSON_ERROR_WRONG_TYPE
+                && _BindError(binding, "{} {}", &offset) == RED_JSON_ERROR_UNEXPECTED_CHAR
+                && _BindError(binding, "{\"skip\": [}", &offset) == RED_JSON_ERROR_UNEXPECTED_CHAR && offset == 11
+                && _BindError(binding, "{\"id\": 1", &offset) == RED_JSON_ERROR_UNEXPECTED_END
+                && _BindError(binding, " ", &offset) == RED_JSON_ERROR_UNEXPECTED_END && offset == 1;
+        RedTest_Verify(suite, "Binding: errors", ok);
+        RedJsonBinding_Free(binding);
+    }
+
+    /* Reference counting and copy-on-write clones */
+    {
+        const char *text = "{\"name\": \"svc\", \"db\": {\"host\": \"a\", \"pool\": {\"size\": 4}},"
+                " \"routes\": [{\"path\": \"/x\"}, {\"path\": \"/y\"}], \"tags\": [\"t\"]}";
+        RedJsonObject base = RedJson_Parse(text);
+        RedJsonObject copy, db, pool, route, obj;
+        RedJsonArray routes;
+        RedJsonValue kept;
+        char *before, *after, *out, key[16];
+        unsigned i;
+        bool ok;
+
+        kept = RedJsonValue_Retain(RedJsonObject_Get(base, "db"));
+        obj = RedJson_Parse(text);
+        RedJsonObject_Release(obj);
+        ok = RedJsonObject_GetInt64(RedJsonObject_GetObject(RedJsonValue_GetObject(kept), "pool"), "size") == 4;
+        RedJsonValue_Release(kept);
+        RedJsonValue_Release(NULL);
+        RedTest_Verify(suite, "Refcount: retained subtree outlives a released document", ok);
+
+        before = RedJsonObject_ToFormattedJsonString(base, RED_JSON_FORMAT_COMPACT);
+        copy = RedJsonObject_Clone(base);
+        ok = RedJsonObject_Get(copy, "db") == RedJsonObject_Get(base, "db")
+                && RedJsonObject_Get(copy, "routes") == RedJsonObject_Get(base, "routes");
+        RedJsonObject_Put(copy, "name", RedJsonValue_FromString("other"));
+        RedJsonObject_Unset(copy, "tags");
+        db = RedJsonObject_GetMutableObject(copy, "db");
+        pool = RedJsonObject_GetMutableObject(db, "pool");
+        RedJsonObject_Put(pool, "size", RedJsonValue_FromInt64(16));
+        routes = RedJsonObject_GetMutableArray(copy, "routes");
+        route = RedJsonArray_GetMutableEntryObject(routes, 1);
+        RedJsonObject_SetBoolean(route, "auth", true);
+        ok = ok && db != RedJsonObject_GetObject(base, "db")
+                && RedJsonObject_GetMutableObject(copy, "db") == db
+                && RedJsonObject_Get(db, "host") == RedJsonObject_Get(RedJsonObject_GetObject(base, "db"), "host")
+                && RedJsonArray_GetEntry(routes, 0) == RedJsonArray_GetEntry(RedJsonObject_GetArray(base, "routes"), 0);
+        after = RedJsonObject_ToFormattedJsonString(base, RED_JSON_FORMAT_COMPACT);
+        out = RedJsonObject_ToFormattedJsonString(copy, RED_JSON_FORMAT_COMPACT);
+        RedTest_Verify(suite, "Clone: modified paths copied, the rest shared", ok && !strcmp(before, after));
+        RedTest_Verify(suite, "Clone: modifications visible in the copy only", !strcmp(out,
+                "{\"name\":\"other\",\"db\":{\"host\":\"a\",\"pool\":{\"size\":16}},"
+                "\"routes\":[{\"path\":\"/x\"},{\"path\":\"/y\",\"auth\":true}]}"));
+        free(before);
+        free(after);
+        free(out);
+        RedJsonObject_Release(base);
+        ok = RedJsonObject_GetInt64(pool, "size") == 16 && !strcmp(RedJsonObject_GetString(db, "host"), "a");
+        RedJsonObject_Release(copy);
+
+        obj = RedJsonObject_New();
+        for (i = 0; i < 100; i++)
+        {
+            snprintf(key, sizeof(key), "k%u", i);
+            RedJsonObject_SetInt64(obj, key, i);
+        }
+        for (i = 0; i < 100; i += 2)
+        {
+            snprintf(key, sizeof(key), "k%u", i);
+            RedJsonObject_Unset(obj, key);
+        }
+        RedJsonObject_Unset(obj, "missing");
+        for (i = 0; i < 100 && ok; i++)
+        {
+            snprintf(key, sizeof(key), "k%u", i);
+            ok = RedJsonObject_HasKey(obj, key) == (i % 2 == 1) && (i % 2 == 0 || RedJsonObject_GetInt64(obj, key) == i);
+        }
+        for (i = 0; i < 50 && ok; i++)
+        {
+            snprintf(key, sizeof(key), "k%u", 2 * i + 1);
+            ok = !strcmp(RedJsonObject_GetKeyAt(obj, i), key)
+                    && RedJsonValue_GetInt64(RedJsonObject_GetValueAt(obj, i)) == 2 * i + 1;
+        }
+        routes = RedJsonArray_New();
+        RedJsonArray_AppendNumber(routes, 1);
+        RedJsonArray_AppendNull(routes);
+        RedJsonArray_SetEntryString(routes, 0, "s");
+        RedJsonArray_SetEntryObject(routes, 1, obj);
+        ok = ok && RedJsonObject_NumItems(obj) == 50 && !strcmp(RedJsonArray_GetEntryString(routes, 0), "s")
+                && RedJsonArray_GetEntryObject(routes, 1) == obj;
+        RedJsonArray_Release(routes);
+        RedTest_Verify(suite, "Refcount: released originals, Unset and SetEntry", ok);
+    }
+
+    /* Compiled paths */
+    {
+        const char *text = "{\"data\": {\"items\": [{\"price\": 1, \"qty\": 2}, {\"price\": 2.5},"
+                " {\"price\": 4, \"tags\": [\"a\", \"b\"]}, {\"name\": \"x\"}]},"
+                " \"a/b\": {\"m~n\": 7}, \"\": {\"\": 8}, \"arr\": [10, 11, 12, 13, 14, 15],"
+                " \"\u00e9\": 1, \"0\": \"zero\", \"*\": true}";
+        RedJsonObject obj = RedJson_Parse(text);
+        RedJsonTape tape = RedJsonTape_Parse(text, strlen(text), NULL);
+        RedJsonTapeRef_t root = RedJsonTape_Root(tape), match;
+        RedJsonPath path;
+        _Capture capture;
+        bool ok;
+
+        ok = !strcmp(_PathMatches("/data/items/*/price", obj, tape, &capture), "[1,2.5,4]")
+                && !strcmp(_PathMatches("$.data.items[*].price", obj, tape, &capture), "[1,2.5,4]")
+                && !strcmp(_PathMatches("/data/items/2/tags/1", obj, tape, &capture), "[\"b\"]")
+                && !strcmp(_PathMatches("/a~1b/m~0n", obj, tape, &capture), "[7]")
+                && !strcmp(_PathMatches("//", obj, tape, &capture), "[8]")
+                && !strcmp(_PathMatches("/0", obj, tape, &capture), "[\"zero\"]")
+                && !strcmp(_PathMatches("/data/items/9/price", obj, tape, &capture), "[]")
+                && !strcmp(_PathMatches("/data/items/01", obj, tape, &capture), "[]")
+                && !strcmp(_PathMatches("/arr/x/y", obj, tape, &capture), "[]");
+        RedTest_Verify(suite, "Path: JSON pointers and wildcards", ok);
+
+        ok = !strcmp(_PathMatches("$.arr[1:5:2]", obj, tape, &capture), "[11,13]")
+                && !strcmp(_PathMatches("$.arr[::-2]", obj, tape, &capture), "[15,13,11]")
+                && !strcmp(_PathMatches("$.arr[-2:]", obj, tape, &capture), "[14,15]")
+                && !strcmp(_PathMatches("$.arr[ 4 : 1 : -1 ]", obj, tape, &capture), "[14,13,12]")
+                && !strcmp(_PathMatches("$.arr[-1]", obj, tape, &capture), "[15]")
+                && !strcmp(_PathMatches("$.arr[:0]", obj, tape, &capture), "[]")
+                && !strcmp(_PathMatches("$.arr[::0]", obj, tape, &capture), "[]")
+                && !strcmp(_PathMatches("$.arr[-100:100:3]", obj, tape, &capture), "[10,13]")
+                && !strcmp(_PathMatches("$.data.items[1:][\"price\"]", obj, tape, &capture), "[2.5,4]")
+                && !strcmp(_PathMatches("$['a/b'][\"m~n\"]", obj, tape, &capture), "[7]")
+                && !strcmp(_PathMatches("$['\\u00e9']", obj, tape, &capture), "[1]")
+                && !strcmp(_PathMatches("$['*']", obj, tape, &capture), "[true]")
+                && !strcmp(_PathMatches("$.arr.*", obj, tape, &capture), "[10,11,12,13,14,15]")
+                && !strcmp(_PathMatches("$.data[0]", obj, tape, &capture), "[]");
+        RedTest_Verify(suite, "Path: JSONPath names, indexes and slices", ok);
+
+        path = RedJsonPath_Compile("$.data.items[*]", NULL);
+        ok = RedJsonPath_EvalObject(path, obj, NULL, NULL) == 4
+                && RedJsonPath_GetFirst(path, obj) == RedJsonArray_GetEntry(
+                        RedJsonObject_GetArray(RedJsonObject_GetObject(obj, "data"), "items"), 0)
+                && RedJsonPath_GetFirstTape(path, &root, &match)
+                && RedJsonTapeRef_GetType(&match) == RED_JSON_VALUE_TYPE_OBJECT;
+        RedJsonPath_Free(path);
+        path = RedJsonPath_Compile("", NULL);
+        ok = ok && RedJsonPath_EvalObject(path, obj, NULL, NULL) == 1 && !RedJsonPath_GetFirst(path, obj)
+                && !strncmp(_PathMatches("", obj, tape, &capture), "[{\"data\":", 9);
+        RedJsonPath_Free(path);
+        path = RedJsonPath_Compile("$.nothing", NULL);
+        ok = ok && !RedJsonPath_GetFirst(path, obj) && !RedJsonPath_GetFirstTape(path, &root, &match);
+        RedJsonPath_Free(path);
+        RedTest_Verify(suite, "Path: match counts and first match", ok);
+
+        ok = _PathErrorOffset("$..x") == 2
+                && _PathErrorOffset("$[?(@.a)]") == 2
+                && _PathErrorOffset("$[1,2]") == 3
+                && _PathErrorOffset("$['x") == 4
+                && _PathErrorOffset("$[01]") == 3
+                && _PathErrorOffset("$[-0]") == 3
+                && _PathErrorOffset("$.1a") == 2
+                && _PathErrorOffset("$['\\q']") == 4
+                && _PathErrorOffset("$[9007199254740992]") == 18
+                && _PathErrorOffset("a/b") == 0
+                && _PathErrorOffset("/a~2") == 2
+                && _PathErrorOffset("$[1:2:3:4]") == 7;
+        RedTest_Verify(suite, "Path: syntax errors", ok);
+        RedJsonTape_Free(tape);
+        RedJsonObject_Release(obj);
+    }
+
+    /* Memory mapped files */
+    {
+        const char *text = "{\"name\": \"plain\", \"esc\": \"tab\\there \\u00e9\\ud83d\\ude00\", \"list\": [\"a\", \"\", {\"k\": \"v\"}],"
+                " \"n\": 12, \"empty\": {}}";
+        char path[] = "/tmp/test_json_fileXXXXXX";
+        char readBack[256];
+        RedJsonParseOptions_t options;
+        RedJsonError_t error;
+        RedJsonObject obj, viewObj, expected;
+        RedJsonValue kept;
+        char *out, *viewOut, *expectedOut;
+        int fd = mkstemp(path);
+        FILE *fp;
+        size_t n;
+        bool ok;
+
+        ok = write(fd, text, strlen(text)) == (ssize_t)strlen(text);
+        close(fd);
+        memset(&options, 0, sizeof(options));
+        options.stringViews = true;
+        expected = RedJson_Parse(text);
+        obj = RedJson_ParseFile(path);
+        viewObj = RedJson_ParseFileWithOptions(path, &options, &error);
+        expectedOut = RedJsonObject_ToFormattedJsonString(expected, RED_JSON_FORMAT_COMPACT);
+        out = obj ? RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT) : NULL;
+        viewOut = viewObj ? RedJsonObject_ToFormattedJsonString(viewObj, RED_JSON_FORMAT_COMPACT) : NULL;
+        RedTest_Verify(suite, "File: parse matches parsing the text", ok && out && !strcmp(out, expectedOut));
+        RedTest_Verify(suite, "File: string views match copied strings", viewOut && !strcmp(viewOut, expectedOut));
+        free(out);
+        free(viewOut);
+        free(expectedOut);
+
+        kept = RedJsonValue_Retain(RedJsonObject_Get(viewObj, "esc"));
+        RedJsonObject_Release(viewObj);
+        RedJsonObject_Release(obj);
+        RedJsonObject_Release(expected);
+        fp = fopen(path, "r");
+        n = fread(readBack, 1, sizeof(readBack), fp);
+        fclose(fp);
+        out = RedJsonValue_GetString(kept);
+        ok = !strcmp(out, "tab\there \xC3\xA9\xF0\x9F\x98\x80") && n == strlen(text) && !memcmp(readBack, text, n);
+        free(out);
+        RedJsonValue_Release(kept);
+        RedTest_Verify(suite, "File: views outlive the document and leave the file intact", ok);
+
+        fp = fopen(path, "w");
+        fputs("{\"a\": \"x\", \"b\": \"\\q\"}", fp);
+        fclose(fp);
+        ok = !RedJson_ParseFileWithOptions(path, &options, &error)
+                && error.code == RED_JSON_ERROR_BAD_ESCAPE && error.offset == 17;
+        fp = fopen(path, "w");
+        fclose(fp);
+        ok = ok && !RedJson_ParseFileWithOptions(path, NULL, &error) && error.code == RED_JSON_ERROR_UNEXPECTED_END;
+        unlink(path);
+        ok = ok && !RedJson_ParseFileWithOptions(path, &options, &error) && error.code == RED_JSON_ERROR_IO
+                && !RedJson_ParseFile(path);
+        RedTest_Verify(suite, "File: errors", ok);
+    }
+
+    /* Reusable documents */
+    {
+        const char *messages[] = {
+            "{\"id\": 1, \"method\": \"get\", \"params\": {\"keys\": [\"a\", \"b\"], \"limit\": 10}}",
+            "{\"id\": 2, \"method\": \"put\", \"params\": {\"key\": \"k\\u00e9\\n\", \"value\": [1.5, true, null, {}]}}",
+            "{\"a\": 1, \"b\": 2, \"c\": 3, \"d\": 4, \"e\": 5, \"f\": 6, \"g\": 7, \"h\": 8, \"i\": 9,"
+                " \"j\": 10, \"k\": 11, \"l\": 12, \"m\": 13, \"n\": 14, \"o\": 15, \"p\": 16, \"q\": 17, \"r\": [[]]}",
+            "{\"id\": 3}",
+            "{}",
+        };
+        RedJsonDocument doc = RedJsonDocument_New();
+        RedJsonObject obj, expected, keptObj;
+        RedJsonValue keptStr;
+        RedJsonError_t error, expectedError;
+        char *big, *out, *expectedOut;
+        unsigned i, round;
+        bool ok = true;
+
+        big = malloc(100003);
+        memcpy(big, "{\"s\": \"", 7);
+        memset(big + 7, 'x', 99993);
+        memcpy(big + 100000, "\"}", 3);
+        for (round = 0; round < 3; round++)
+        {
+            for (i = 0; i < sizeof(messages) / sizeof(messages[0]); i++)
+            {
+                obj = RedJsonDocument_Parse(doc, messages[i], strlen(messages[i]), NULL, NULL);
+                expected = RedJson_Parse(messages[i]);
+                out = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+                expectedOut = RedJsonObject_ToFormattedJsonString(expected, RED_JSON_FORMAT_COMPACT);
+                ok = ok && obj == RedJsonDocument_GetRoot(doc) && !strcmp(out, expectedOut)
+                        && (i != 2 || RedJsonObject_GetInt64(obj, "q") == 17);
+                free(out);
+                free(expectedOut);
+                RedJsonObject_Release(expected);
+            }
+            obj = RedJsonDocument_Parse(doc, big, strlen(big), NULL, NULL);
+            ok = ok && strlen(RedJsonObject_GetString(obj, "s")) == 99993;
+        }
+        free(big);
+        RedTest_Verify(suite, "Document: reused parses match fresh parses", ok);
+
+        obj = RedJsonDocument_Parse(doc, messages[0], strlen(messages[0]), NULL, NULL);
+        keptObj = RedJsonObject_Retain(RedJsonObject_GetObject(obj, "params"));
+        keptStr = RedJsonValue_Retain(RedJsonObject_Get(obj, "method"));
+        obj = RedJsonDocument_Parse(doc, messages[1], strlen(messages[1]), NULL, NULL);
+        out = RedJsonObject_ToFormattedJsonString(keptObj, RED_JSON_FORMAT_COMPACT);
+        expectedOut = RedJsonValue_GetString(keptStr);
+        ok = !strcmp(out, "{\"keys\":[\"a\",\"b\"],\"limit\":10}") && !strcmp(expectedOut, "get")
+                && !strcmp(RedJsonObject_GetString(RedJsonObject_GetObject(obj, "params"), "key"), "k\xC3\xA9\n");
+        free(out);
+        free(expectedOut);
+        RedJsonDocument_Reset(doc);
+        ok = ok && !RedJsonDocument_GetRoot(doc) && RedJsonObject_GetInt64(keptObj, "limit") == 10;
+        RedJsonObject_Release(keptObj);
+        RedJsonValue_Release(keptStr);
+        RedTest_Verify(suite, "Document: retained values outlive reuse", ok);
+
+        for (i = 0; i < sizeof(messages) / sizeof(messages[0]); i++)
+        {
+            out = malloc(strlen(messages[i]));
+            memcpy(out, messages[i], strlen(messages[i]) - 1);
+            out[strlen(messages[i]) - 1] = ',';
+            obj = RedJsonDocument_Parse(doc, out, strlen(messages[i]), NULL, &error);
+            RedJson_ParseWithOptions(out, strlen(messages[i]), NULL, &expectedError);
+            ok = ok && !obj && !RedJsonDocument_GetRoot(doc) && error.code == expectedError.code
+                    && error.offset == expectedError.offset;
+            free(out);
+        }
+        obj = RedJsonDocument_Parse(doc, messages[3], strlen(messages[3]), NULL, NULL);
+        ok = ok && RedJsonObject_GetInt64(obj, "id") == 3;
+        RedJsonDocument_Free(doc);
+        RedJsonDocument_Free(NULL);
+        RedTest_Verify(suite, "Document: failed parses recycle and report like ParseWithOptions", ok);
+    }
+
+    /* Parallel array parsing */
+    {
+        static const struct { const char *text; RedJsonErrorEnum code; size_t offset; } bad[] = {
+            {"[1,]", RED_JSON_ERROR_UNEXPECTED_CHAR, 3},
+            {"[,1]", RED_JSON_ERROR_UNEXPECTED_CHAR, 1},
+            {"[1,,2]", RED_JSON_ERROR_UNEXPECTED_CHAR, 3},
+            {"[1 2]", RED_JSON_ERROR_UNEXPECTED_CHAR, 3},
+            {"[{\"a\":}]", RED_JSON_ERROR_UNEXPECTED_CHAR, 6},
+            {"[1", RED_JSON_ERROR_UNEXPECTED_END, 2},
+            {"[1,", RED_JSON_ERROR_UNEXPECTED_END, 3},
+            {"[", RED_JSON_ERROR_UNEXPECTED_END, 1},
+            {"", RED_JSON_ERROR_UNEXPECTED_END, 0},
+            {"{}", RED_JSON_ERROR_UNEXPECTED_CHAR, 0},
+            {"[1]x", RED_JSON_ERROR_UNEXPECTED_CHAR, 3},
+            {"[1]]", RED_JSON_ERROR_UNEXPECTED_CHAR, 3},
+            {"[1}", RED_JSON_ERROR_UNEXPECTED_CHAR, 2},
+            {"[[1],[2,[3]]", RED_JSON_ERROR_UNEXPECTED_END, 12},
+        };
+        static const size_t chunkSizes[] = {1, 7, 0};
+        RedJsonParallelOptions_t options;
+        RedJsonError_t error;
+        RedJsonObject expected;
+        RedJsonArray array;
+        RedJsonValue value;
+        char *text, *out, *expectedOut;
+        size_t length = 0;
+        unsigned i, j;
+        bool ok = true;
+
+        text = malloc(200000);
+        length += sprintf(text, "{\"a\": [");
+        for (i = 0; i < 2000; i++)
+        {
+            switch (i % 5)
+            {
+                case 0:
+                    length += sprintf(text + length, "{\"id\": %u, \"s\": \"x,]}\\\"[{%u\", \"t\": [%u, {}]}", i, i, i);
+                    break;
+                case 1:
+                    length += sprintf(text + length, "%u.5", i);
+                    break;
+                case 2:
+                    length += sprintf(text + length, " /* ,]} */ \"s%u\\\\\"", i);
+                    break;
+                case 3:
+                    length += sprintf(text + length, "[[], [\"]\", null], true]");
+                    break;
+                default:
+                    length += sprintf(text + length, "{}");
+                    break;
+            }
+            if (i < 1999)
+                text[length++] = ',';
+        }
+        length += sprintf(text + length, " ]}");
+        expected = RedJson_Parse(text);
+        expectedOut = RedJsonValue_ToFormattedJsonString(RedJsonObject_Get(expected, "a"), RED_JSON_FORMAT_COMPACT);
+        for (i = 0; i < 3; i++)
+        {
+            memset(&options, 0, sizeof(options));
+            options.numThreads = 1 + i * 2;
+            options.chunkSize = chunkSizes[i];
+            array = RedJson_ParseArrayParallel(text + 6, length - 7, &options, NULL);
+            value = array ? RedJsonValue_FromArray(array) : NULL;
+            out = value ? RedJsonValue_ToFormattedJsonString(value, RED_JSON_FORMAT_COMPACT) : NULL;
+            ok = ok && out && !strcmp(out, expectedOut) && RedJsonArray_NumItems(array) == 2000;
+            free(out);
+            RedJsonValue_Release(value);
+        }
+        free(expectedOut);
+        RedJsonObject_Release(expected);
+        free(text);
+        RedTest_Verify(suite, "Parallel: same result as a sequential parse", ok);
+
+        array = RedJson_ParseArrayParallel(" [ ] ", 5, NULL, NULL);
+        ok = array && RedJsonArray_NumItems(array) == 0;
+        RedJsonArray_Release(array);
+        array = RedJson_ParseArrayParallel("[{\"k\": [1]}]", 12, NULL, NULL);
+        ok = ok && array && RedJsonArray_NumItems(array) == 1
+                && RedJsonArray_GetEntryNumber(RedJsonObject_GetArray(RedJsonArray_GetEntryObject(array, 0), "k"), 0) == 1;
+        RedJsonArray_Release(array);
+        memset(&options, 0, sizeof(options));
+        options.numThreads = 2;
+        options.chunkSize = 4;
+        array = RedJson_ParseArrayParallel("[1.5, 2, 3.25, 4, 5.5]", 22, &options, NULL);
+        ok = ok && array && RedJsonArray_GetStorage(array) == RED_JSON_ARRAY_STORAGE_DOUBLES
+                && RedJsonArray_NumItems(array) == 5 && RedJsonArray_GetDoubles(array)[4] == 5.5;
+        RedJsonArray_Release(array);
+        array = RedJson_ParseArrayParallel("[1, 2, 3.25, true, 5]", 21, &options, NULL);
+        ok = ok && array && RedJsonArray_NumItems(array) == 5 && RedJsonArray_GetEntryBoolean(array, 3)
+                && RedJsonArray_GetEntryNumber(array, 2) == 3.25 && RedJsonArray_GetEntryInt64(array, 4) == 5;
+        RedJsonArray_Release(array);
+        RedTest_Verify(suite, "Parallel: empty and single element arrays", ok);
+
+        for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+        {
+            for (j = 0; j < 3; j++)
+            {
+                memset(&options, 0, sizeof(options));
+                options.numThreads = 2;
+                options.chunkSize = chunkSizes[j];
+                array = RedJson_ParseArrayParallel(bad[i].text, strlen(bad[i].text), &options, &error);
+                if (array || error.code != bad[i].code || error.offset != bad[i].offset)
+                {
+                    printf("Parallel: \"%s\" (chunk %u): code %d offset %u\n",
+                            bad[i].text, (unsigned)chunkSizes[j], error.code, (unsigned)error.offset);
+                    ok = false;
+                }
+                RedJsonArray_Release(array);
+            }
+        }
+        RedTest_Verify(suite, "Parallel: errors match a sequential parse", ok);
+    }
+
+    /* Diff and patch */
+    {
+        static const char *pairs[][2] = {
+            {"{}", "{}"},
+            {"{\"a\": 1}", "{\"a\": 2}"},
+            {"{\"a\": 1, \"b\": [1, 2]}", "{\"b\": [1, 2], \"c\": null}"},
+            {"{\"a\": {\"b\": {\"c\": [1, {\"d\": true}]}}}", "{\"a\": {\"b\": {\"c\": [1, {\"d\": false}]}}}"},
+            {"{\"l\": [1, 2, 3, 4, 5]}", "{\"l\": [0, 1, 2, 3, 4, 5]}"},
+            {"{\"l\": [1, 2, 3, 4, 5]}", "{\"l\": [1, 2, 4, 5]}"},
+            {"{\"l\": [1, 2, 3, 4, 5]}", "{\"l\": [1, 9, 8, 7, 6, 5]}"},
+            {"{\"l\": [1, 2, 3, 4, 5]}", "{\"l\": [5]}"},
+            {"{\"l\": [1, 2, 3]}", "{\"l\": []}"},
+            {"{\"l\": [[1, 2], {\"x\": 1}]}", "{\"l\": {\"x\": 1}}"},
+            {"{\"a/b\": 1, \"m~n\": 2, \"\": 3}", "{\"a/b\": 4, \"m~n\": 5}"},
+            {"{\"s\": \"x\", \"n\": 1}", "{\"s\": 1, \"n\": \"x\"}"},
+        };
+        RedJsonObject a, b, c, inner;
+        RedJsonValue one, oneDouble, big, bigDouble;
+        unsigned i, failedOp;
+        char *out, *before;
+        bool ok = true;
+
+        for (i = 0; i < sizeof(pairs) / sizeof(pairs[0]) && ok; i++)
+            ok = _DiffRoundTrips(pairs[i][0], pairs[i][1]) && _DiffRoundTrips(pairs[i][1], pairs[i][0]);
+        RedTest_Verify(suite, "Diff: applying the diff gives the target", ok);
+
+        a = RedJson_Parse("{\"a\": 1, \"b\": {\"c\": [1, 2, 3], \"d\": \"x\"}, \"e/f\": 0, \"g\": 1}");
+        b = RedJson_Parse("{\"g\": 1.0, \"b\": {\"d\": \"x\", \"c\": [1, 3]}, \"e/f\": 0, \"h\": [true]}");
+        out = _DiffText(a, b);
+        ok = !strcmp(out, "[{\"op\":\"remove\",\"path\":\"/a\"},{\"op\":\"remove\",\"path\":\"/b/c/1\"},"
+                "{\"op\":\"add\",\"path\":\"/h\",\"value\":[true]}]");
+        free(out);
+        RedJsonObject_Release(a);
+        RedJsonObject_Release(b);
+
+        one = RedJsonValue_FromInt64(1);
+        oneDouble = RedJsonValue_FromNumber(1.0);
+        big = RedJsonValue_FromUint64(UINT64_MAX);
+        bigDouble = RedJsonValue_FromNumber(18446744073709551615.0);
+        a = RedJson_Parse("{\"x\": [1, {\"y\": null}], \"z\": \"s\"}");
+        b = RedJson_Parse("{\"z\": \"s\", \"x\": [1.0, {\"y\": null}]}");
+        c = RedJson_Parse("{\"z\": \"s\", \"x\": [{\"y\": null}, 1]}");
+        ok = ok && RedJsonValue_Equals(one, oneDouble) && !RedJsonValue_Equals(big, bigDouble)
+                && RedJsonValue_Equals(big, big) && RedJsonObject_Equals(a, b) && !RedJsonObject_Equals(a, c);
+        RedJsonValue_Release(one);
+        RedJsonValue_Release(oneDouble);
+        RedJsonValue_Release(big);
+        RedJsonValue_Release(bigDouble);
+        RedTest_Verify(suite, "Diff: numbers compare by value, objects ignore member order", ok);
+
+        /* Cached hashes are dropped along the path of every change */
+        out = _DiffText(a, b);
+        ok = !strcmp(out, "[]");
+        free(out);
+        inner = RedJsonArray_GetMutableEntryObject(RedJsonObject_GetMutableArray(b, "x"), 1);
+        RedJsonObject_Put(inner, "y", RedJsonValue_FromBoolean(false));
+        out = _DiffText(a, b);
+        ok = ok && !strcmp(out, "[{\"op\":\"replace\",\"path\":\"/x/1/y\",\"value\":false}]");
+        free(out);
+        RedJsonArray_AppendNull(RedJsonObject_GetMutableArray(b, "x"));
+        RedJsonObject_Unset(a, "z");
+        out = _DiffText(a, b);
+        ok = ok && !strcmp(out, "[{\"op\":\"replace\",\"path\":\"/x/1/y\",\"value\":false},"
+                "{\"op\":\"add\",\"path\":\"/x/2\",\"value\":null},{\"op\":\"add\",\"path\":\"/z\",\"value\":\"s\"}]");
+        free(out);
+        RedJsonObject_Release(b);
+        b = RedJsonObject_Clone(a);
+        RedJsonObject_Put(RedJsonArray_GetMutableEntryObject(RedJsonObject_GetMutableArray(b, "x"), 1),
+                "w", RedJsonValue_FromInt64(2));
+        out = _DiffText(a, b);
+        ok = ok && !strcmp(out, "[{\"op\":\"add\",\"path\":\"/x/1/w\",\"value\":2}]");
+        free(out);
+        RedJsonObject_Release(a);
+        RedJsonObject_Release(b);
+        RedJsonObject_Release(c);
+        RedTest_Verify(suite, "Diff: modifications invalidate cached hashes", ok);
+
+        a = RedJson_Parse("{\"key\\u0000x\": 1, \"key\": 2}");
+        b = RedJson_Parse("{\"key\\u0000x\": 1, \"key\": 3}");
+        c = RedJson_Parse("{\"key\": 3}");
+        out = _DiffText(a, b);
+        ok = a && b && c && !strcmp(out, "[{\"op\":\"replace\",\"path\":\"/key\",\"value\":3}]")
+                && !RedJson_Diff(a, c) && !RedJson_Diff(c, a);
+        free(out);
+        RedJsonObject_Release(a);
+        RedJsonObject_Release(b);
+        RedJsonObject_Release(c);
+        RedTest_Verify(suite, "Diff: paths through keys holding NUL refused", ok);
+
+        a = RedJson_Parse("{\"foo\": [\"bar\", \"baz\"], \"a/b\": 1, \"m~n\": {\"q\": 2}}");
+        ok = _ApplyPatchText(a, "[{\"op\": \"add\", \"path\": \"/foo/1\", \"value\": \"qux\"},"
+                "{\"op\": \"test\", \"path\": \"/foo\", \"value\": [\"bar\", \"qux\", \"baz\"]},"
+                "{\"op\": \"remove\", \"path\": \"/foo/0\"},"
+                "{\"op\": \"replace\", \"path\": \"/a~1b\", \"value\": [1]},"
+                "{\"op\": \"add\", \"path\": \"/a~1b/-\", \"value\": 2},"
+                "{\"op\": \"move\", \"from\": \"/m~0n/q\", \"path\": \"/q\"},"
+                "{\"op\": \"copy\", \"from\": \"/foo\", \"path\": \"/m~0n/foo\"},"
+                "{\"op\": \"add\", \"path\": \"/m~0n/foo/0\", \"value\": {}},"
+                "{\"op\": \"test\", \"path\": \"/q\", \"value\": 2.0}]", &failedOp) == RED_JSON_OK;
+        out = RedJsonObject_ToFormattedJsonString(a, RED_JSON_FORMAT_COMPACT);
+        ok = ok && !strcmp(out, "{\"foo\":[\"qux\",\"baz\"],\"a/b\":[1,2],\"m~n\":{\"foo\":[{},\"qux\",\"baz\"]},\"q\":2}");
+        free(out);
+        ok = ok && _ApplyPatchText(a, "[{\"op\": \"replace\", \"path\": \"\", \"value\": {\"r\": 1}}]", NULL) == RED_JSON_OK
+                && RedJsonObject_NumItems(a) == 1 && RedJsonObject_GetInt64(a, "r") == 1;
+        RedTest_Verify(suite, "Patch: RFC 6902 operations", ok);
+
+        before = RedJsonObject_ToFormattedJsonString(a, RED_JSON_FORMAT_COMPACT);
+        {
+            static const struct
+            {
+                const char *patch;
+                RedJsonErrorEnum err;
+            } cases[] = {
+                {"[{\"op\": \"remove\", \"path\": \"/missing\"}]", RED_JSON_ERROR_NOT_FOUND},
+                {"[{\"op\": \"replace\", \"path\": \"/x\", \"value\": 1}]", RED_JSON_ERROR_NOT_FOUND},
+                {"[{\"op\": \"add\", \"path\": \"/x/y\", \"value\": 1}]", RED_JSON_ERROR_NOT_FOUND},
+                {"[{\"op\": \"add\", \"path\": \"/l/4\", \"value\": 1}]", RED_JSON_ERROR_NOT_FOUND},
+                {"[{\"op\": \"add\", \"path\": \"/l/01\", \"value\": 1}]", RED_JSON_ERROR_NOT_FOUND},
+                {"[{\"op\": \"remove\", \"path\": \"/l/-\"}]", RED_JSON_ERROR_NOT_FOUND},
+                {"[{\"op\": \"add\", \"path\": \"r\", \"value\": 1}]", RED_JSON_ERROR_BAD_PATH},
+                {"[{\"op\": \"add\", \"path\": \"/a~2\", \"value\": 1}]", RED_JSON_ERROR_BAD_PATH},
+                {"[{\"op\": \"move\", \"from\": \"/o\", \"path\": \"/o/p\"}]", RED_JSON_ERROR_BAD_PATH},
+                {"[{\"op\": \"add\", \"path\": \"/r\"}]", RED_JSON_ERROR_WRONG_TYPE},
+                {"[{\"op\": \"frobnicate\", \"path\": \"/r\"}]", RED_JSON_ERROR_WRONG_TYPE},
+                {"[{\"op\": \"copy\", \"path\": \"/r\"}]", RED_JSON_ERROR_WRONG_TYPE},
+                {"[{\"path\": \"/r\"}]", RED_JSON_ERROR_WRONG_TYPE},
+                {"[7]", RED_JSON_ERROR_WRONG_TYPE},
+                {"[{\"op\": \"remove\", \"path\": \"\"}]", RED_JSON_ERROR_WRONG_TYPE},
+                {"[{\"op\": \"replace\", \"path\": \"\", \"value\": [1]}]", RED_JSON_ERROR_WRONG_TYPE},
+                {"[{\"op\": \"test\", \"path\": \"/r\", \"value\": \"1\"}]", RED_JSON_ERROR_TEST_FAILED},
+            };
+            RedJsonErrorEnum err;
+            ok = _ApplyPatchText(a, "[{\"op\": \"add\", \"path\": \"/l\", \"value\": [1, 2]},"
+                    "{\"op\": \"add\", \"path\": \"/o\", \"value\": {\"p\": 0}}]", NULL) == RED_JSON_OK;
+            free(before);
+            before = RedJsonObject_ToFormattedJsonString(a, RED_JSON_FORMAT_COMPACT);
+            for (i = 0; i < sizeof(cases) / sizeof(cases[0]) && ok; i++)
+            {
+                char patch[512];
+
+                /* Earlier operations must be rolled back too */
+                snprintf(patch, sizeof(patch), "[{\"op\": \"add\", \"path\": \"/l/0\", \"value\": 0},"
+                        "{\"op\": \"remove\", \"path\": \"/o/p\"}, %s", cases[i].patch + 1);
+                failedOp = 0;
+                err = _ApplyPatchText(a, patch, &failedOp);
+                out = RedJsonObject_ToFormattedJsonString(a, RED_JSON_FORMAT_COMPACT);
+                ok = err == cases[i].err && failedOp == 2 && !strcmp(out, before);
+                if (!ok)
+                    printf("Patch error case %u: err %d failedOp %u %s\n", i, err, failedOp, out);
+                free(out);
+            }
+        }
+        free(before);
+        RedJsonObject_Release(a);
+        RedTest_Verify(suite, "Patch: failures leave the document unchanged", ok);
+    }
+
+    /* Validation and reformatting */
+    {
+        static const char *texts[] =
+        {
+            " /* c */ {\"a\": [], \"b\": {}, \"c\": [[{}]], \"d\": -0.5e1} /* end */ ",
+            "{\"s\": \"caf\xc3\xa9 \\u00e9 \\ud83d\\ude00 \\\"q\\\"\", \"n\": [0, -1, 1.5, 2E+3, 1e-2]}",
+            "{\"a\": 1,\n  \"b\": [1, 2,\n  x]}",
+            "{\"a\": [1, 2",
+            "{\"a\": 01}",
+            "{\"a\": 1.}",
+            "{\"a\": -}",
+            "{\"a\": 1e}",
+            "{\"a\": \"x\\q\"}",
+            "{\"a\": \"\\ud800\"}",
+            "{\"a\": \"\xc3\"}",
+            "{\"a\": \"\xed\xa0\x80\"}",
+            "{\"a\": \"tab\there\"}",
+            "{\"a\": \"open",
+            "{\"a\": tru}",
+            "{} {}",
+            "{} /* x",
+            "[1]",
+            "{\"a\": [}",
+            "{\"a\": {,}}",
+            "{\"a\" 1}",
+            "{\"a\": 1,}",
+            "",
+        };
+        RedJsonParseOptions_t options;
+        RedJsonError_t error, expected;
+        RedJsonObject obj;
+        RedJsonErrorEnum err;
+        RedString deep = RedString_New(NULL);
+        char *compact, *pretty, *out;
+        size_t length;
+        unsigned i;
+        bool ok = true;
 
+        for (i = 0; i < sizeof(texts) / sizeof(texts[0]) && ok; i++)
+        {
+            memset(&expected, 0, sizeof(expected));
+            obj = RedJson_ParseWithOptions(texts[i], strlen(texts[i]), NULL, &expected);
+            err = RedJson_Validate(texts[i], strlen(texts[i]), NULL, &error);
+            ok = obj ? err == RED_JSON_OK
+                    : (err == expected.code && error.offset == expected.offset && error.line == expected.line);
+            if (!ok)
+                printf("Validate case %u: %d at %zu, parser %d at %zu\n", i, err, error.offset, expected.code, expected.offset);
+            RedJsonObject_Release(obj);
+        }
+        for (i = 0; i < 600; i++)
+            RedString_AppendChars(deep, "{\"a\":[");
+        options.keys = NULL;
+        options.maxDepth = 2000;
+        err = RedJson_Validate(RedString_GetChars(deep), RedString_Length(deep), NULL, &error);
+        ok = ok && err == RED_JSON_ERROR_DEPTH_EXCEEDED && error.offset == 6 * (RED_JSON_DEFAULT_MAX_DEPTH / 2);
+        err = RedJson_Validate(RedString_GetChars(deep), RedString_Length(deep), &options, &error);
+        ok = ok && err == RED_JSON_ERROR_UNEXPECTED_END;
+        RedString_Free(deep);
+        RedTest_Verify(suite, "Validate: same verdict and position as the parser", ok);
 
+        obj = RedJson_Parse(texts[1]);
+        compact = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_COMPACT);
+        pretty = RedJsonObject_ToFormattedJsonString(obj, RED_JSON_FORMAT_PRETTY);
+        RedJsonObject_Release(obj);
+        out = malloc(strlen(pretty) + 1);
+        err = RedJson_Minify(pretty, strlen(pretty), out, &length, NULL);
+        ok = err == RED_JSON_OK && length == strlen(compact) && !strcmp(out, compact);
+        free(out);
+        out = RedJson_Prettify(compact, strlen(compact), NULL);
+        ok = ok && out && !strcmp(out, pretty);
+        free(out);
+        out = strdup(texts[0]);
+        err = RedJson_Minify(out, strlen(out), out, &length, NULL);
+        ok = ok && err == RED_JSON_OK && !strcmp(out, "{\"a\":[],\"b\":{},\"c\":[[{}]],\"d\":-0.5e1}");
+        free(out);
+        ok = ok && RedJson_Prettify(texts[2], strlen(texts[2]), &error) == NULL
+                && error.code == RED_JSON_ERROR_UNEXPECTED_CHAR && error.offset == 25;
+        RedTest_Verify(suite, "Minify, Prettify: match the writer's layouts, in place too", ok);
+        free(compact);
+        free(pretty);
     }
 
     return RedTest_End(suite);
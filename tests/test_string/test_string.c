@@ -212,6 +212,57 @@ int main(int argc, const char *argv[])
         RedString_Free(s1);
     }
 
+    /* Test RedString_AppendLength, Reserve, Capacity, ShrinkToFit */
+    {
+        RedString s0;
+        unsigned i, capacity;
+        bool match, stable = true;
+
+        s0 = RedString_New("MON");
+        RedString_AppendLength(s0, " TUE WED", 4);
+        match = !RedString_CompareChars(RedString_GetChars(s0), "MON TUE", 0);
+        RedTest_Verify(suite, "AppendLength Length is 7", (RedString_Length(s0) == 7));
+        RedTest_Verify(suite, "Content is \"MON TUE\"", match);
+
+        RedString_AppendLength(s0, RedString_GetChars(s0), 3);
+        match = !RedString_CompareChars(RedString_GetChars(s0), "MON TUEMON", 0);
+        RedTest_Verify(suite, "AppendLength from itself", match);
+        RedString_Append(s0, s0);
+        match = !RedString_CompareChars(RedString_GetChars(s0), "MON TUEMONMON TUEMON", 0);
+        RedTest_Verify(suite, "Append to itself", match);
+        RedString_AppendPrintf(s0, "[%s]", 64, RedString_GetChars(s0));
+        match = !RedString_CompareChars(RedString_GetChars(s0),
+                "MON TUEMONMON TUEMON[MON TUEMONMON TUEMON]", 0);
+        RedTest_Verify(suite, "AppendPrintf from itself", match);
+        RedString_AppendPrintf(s0, "%s%s", 1000, RedString_GetChars(s0), RedString_GetChars(s0));
+        match = !RedString_CompareChars(&RedString_GetChars(s0)[2 * 42],
+                "MON TUEMONMON TUEMON[MON TUEMONMON TUEMON]", 0);
+        RedTest_Verify(suite, "AppendPrintf from itself, long result", (match && RedString_Length(s0) == 3 * 42));
+
+        RedString_Clear(s0);
+        RedString_Reserve(s0, 1000);
+        capacity = RedString_Capacity(s0);
+        RedTest_Verify(suite, "Reserve makes room", (capacity >= 1000 && RedString_Length(s0) == 0));
+        for (i = 0; i < 100; i++)
+        {
+            RedString_AppendChars(s0, "0123456789");
+            stable = stable && RedString_Capacity(s0) == capacity;
+        }
+        RedTest_Verify(suite, "Appends within capacity keep the buffer", stable);
+        RedString_AppendChars(s0, "!");
+        RedTest_Verify(suite, "Capacity grows geometrically", (RedString_Capacity(s0) >= 2 * capacity));
+        RedTest_Verify(suite, "Length is 1001", (RedString_Length(s0) == 1001));
+
+        RedString_SubString(s0, s0, 0, 4);
+        RedString_ShrinkToFit(s0);
+        match = !RedString_CompareChars(RedString_GetChars(s0), "01234", 0);
+        RedTest_Verify(suite, "ShrinkToFit keeps the content", match && RedString_Capacity(s0) == 5);
+        RedString_Reserve(s0, 2);
+        RedTest_Verify(suite, "Reserve never shrinks", (RedString_Capacity(s0) == 5));
+
+        RedString_Free(s0);
+    }
+
 
     /* Test RedString_RemoveToChar */
     /* Test RedString_ToNewChars */
@@ -138,5 +138,17 @@ int main(int argc, const char *argv[])
 
     ZTEST_VERIFY(zt, "str1 and str0 now both have 1 mil Zs", !strncmp(str0->item, str1->item, ONE_THOUSAND));
 
+    /* Truncate keeps the storage */
+    {
+        char *storage = str1->item;
+        unsigned capacity = str1->actualNumItems;
+        ZARRAY_TRUNCATE(str1, 0);
+        ZTEST_VERIFY(zt, "truncate to 0 items", ZARRAY_NUM_ITEMS(str1) == 0);
+        for (i = 0; i < ONE_THOUSAND; i++)
+            ZARRAY_APPEND(str1, 'Y');
+        ZTEST_VERIFY(zt, "truncate keeps storage",
+                str1->item == storage && str1->actualNumItems == capacity && str1->item[ONE_THOUSAND - 1] == 'Y');
+    }
+
     return ZTEST_END(zt);
 }
@@ -133,7 +133,7 @@ public:
 
 #define ZARRAY(typ) ZARRAY_STRUCT(typ) *
 
-static unsigned _ZArray_NextPowerOfTwo(unsigned x)
+static inline unsigned _ZArray_NextPowerOfTwo(unsigned x)
 {
     /* From http://acius2.blogspot.com/2007/11/calculating-next-power-of-2.html */
     x--;
@@ -159,8 +159,8 @@ static unsigned _ZArray_NextPowerOfTwo(unsigned x)
 #define ZARRAY_NEW(typ, startNumItems) \
     _ZARRAY_RETURN_CAST(typ) _ZArray_AllocGeneric(sizeof(typ), startNumItems)
 
-static void * _ZArray_AllocGenericZeroed(unsigned elemSize, unsigned startNumItems);
-static void * _ZArray_AllocGeneric(unsigned elemSize, unsigned startNumItems)
+static inline void * _ZArray_AllocGenericZeroed(unsigned elemSize, unsigned startNumItems);
+static inline void * _ZArray_AllocGeneric(unsigned elemSize, unsigned startNumItems)
 {
     unsigned actualNumItems;
     typedef ZARRAY_STRUCT(void) _Struct;
@@ -188,7 +188,7 @@ static void * _ZArray_AllocGeneric(unsigned elemSize, unsigned startNumItems)
 
 #define ZARRAY_NEW_ZEROED(typ, startNumItems) \
     _ZARRAY_RETURN_CAST(typ) _ZArray_AllocGenericZeroed(sizeof(typ), startNumItems)
-static void * _ZArray_AllocGenericZeroed(unsigned elemSize, unsigned startNumItems)
+static inline void * _ZArray_AllocGenericZeroed(unsigned elemSize, unsigned startNumItems)
 {
     unsigned actualNumItems;
     typedef ZARRAY_STRUCT(void) _Struct;
@@ -233,7 +233,7 @@ static void * _ZArray_AllocGenericZeroed(unsigned elemSize, unsigned startNumIte
  * @retval unsigned number of elements in the array
  */
 #define ZARRAY_NUM_ITEMS(zarray) _ZArray_NumItemsGeneric((void *)zarray)
-static unsigned _ZArray_NumItemsGeneric(void * zarray)
+static inline unsigned _ZArray_NumItemsGeneric(void * zarray)
 {
     _ZARRAY_DEBUG_VERIFY_IS_ZARRAY("ZARRAY_NUM_ITEMS", (ZARRAY(void))zarray);
     return ((ZARRAY(void))(zarray))->numItems;
@@ -366,6 +366,28 @@ static unsigned _ZArray_NumItemsGeneric(void * zarray)
         } \
     } while (0)
 
+/**
+ * Reduce the number of items to <newSize> without releasing any storage.
+ *
+ * Unlike ZARRAY_SHRINK and ZARRAY_RESIZE this never reallocates, so an
+ * array that is repeatedly filled and emptied (a stack or a free list)
+ * stops allocating once it has reached its largest size.
+ *
+ * @param [in,out] zarray specifies the dynamic array to truncate.
+ *
+ * @param [in] newSize specifies the new number of items, which must not be
+ *          greater than the current number.
+ *
+ * @return None
+ */
+#define ZARRAY_TRUNCATE(zarray, newSize) \
+    do { \
+        _ZARRAY_DEBUG_VERIFY_IS_ZARRAY("ZARRAY_TRUNCATE", zarray);  \
+        _ZARRAY_DEBUG_VERIFY((newSize) <= (zarray)->numItems, \
+                "ERROR in ZARRAY_TRUNCATE: <newSize> exceeds the number of items."); \
+        (zarray)->numItems = (newSize); \
+    } while (0)
+
 #define ZARRAY_APPEND(zarray, value) \
     do { \
         _ZARRAY_DEBUG_VERIFY_IS_ZARRAY("ZARRAY_APPEND", zarray);  \